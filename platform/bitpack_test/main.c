@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "../../src/dng/dng.h"
+
+#define ROR32(v,a) ((v) >> (a) | (v) << (32-(a)))
+#define ROL32(v,a) ((v) << (a) | (v) >> (32-(a)))
+#define ROL16(v,a) ((v) << (a) | (v) >> (16-(a)))
+
+/* Plain scalar versions, as dng.c had them before the SIMD paths.
+ * Both touch a word past the image, so the buffers get some slack */
+void reference_unpack(uint16_t * output_buffer, uint16_t * input_buffer, uint32_t pixel_count, uint32_t bpp)
+{
+    uint32_t mask = (1 << bpp) - 1;
+    for (uint32_t pixel_index = 0; pixel_index < pixel_count; pixel_index++)
+    {
+        uint32_t bits_offset = pixel_index * bpp;
+        uint32_t rotate_value = 16 + ((32 - bpp) - bits_offset % 16);
+        uint32_t uncorrected_data = *((uint32_t *)&input_buffer[bits_offset / 16]);
+        output_buffer[pixel_index] = (uint16_t)(ROR32(uncorrected_data, rotate_value) & mask);
+    }
+}
+
+void reference_pack(uint16_t * output_buffer, uint16_t * input_buffer, uint32_t pixel_count, uint32_t bpp, int big_endian)
+{
+    uint32_t bits_free = 16 - bpp;
+    uint16_t * packed_bits = output_buffer;
+
+    packed_bits[0] = input_buffer[0] << bits_free;
+    for (uint32_t pixel_index = 1; pixel_index < pixel_count; pixel_index++)
+    {
+        uint32_t bits_offset = (pixel_index * bits_free) % 16;
+        uint32_t bits_to_rol = bits_free + bits_offset + (bits_offset > 0) * 16;
+        uint32_t data = ROL32((uint32_t)input_buffer[pixel_index], bits_to_rol);
+        *(uint32_t *)packed_bits = (*(uint32_t *)packed_bits & 0x0000FFFF) | data;
+
+        if(bits_offset > 0 && bits_offset <= bpp)
+        {
+            if(big_endian) *(uint16_t *)packed_bits = ROL16(*(uint16_t *)packed_bits, 8);
+            packed_bits++;
+        }
+    }
+}
+
+/* Packed data is placed right before an unreadable page, so reading past it crashes */
+uint8_t * guarded_alloc(size_t size, void ** block, size_t * block_size)
+{
+#ifndef _WIN32
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t pages = (size + page - 1) / page + 1;
+    uint8_t * mem = mmap(NULL, pages * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return NULL;
+    mprotect(mem + (pages - 1) * page, page, PROT_NONE);
+    *block = mem;
+    *block_size = pages * page;
+    return mem + (pages - 1) * page - size;
+#else
+    *block = malloc(size);
+    *block_size = size;
+    return *block;
+#endif
+}
+
+void guarded_free(void * block, size_t block_size)
+{
+#ifndef _WIN32
+    munmap(block, block_size);
+#else
+    (void)block_size;
+    free(block);
+#endif
+}
+
+static uint32_t random_state = 1;
+uint16_t random16()
+{
+    random_state = random_state * 1103515245u + 12345u;
+    return random_state >> 16;
+}
+
+/* Returns 1 on failure */
+int test_size(int width, int height, uint32_t bpp)
+{
+    uint32_t pixel_count = width * height;
+    size_t packed_words = ((uint64_t)pixel_count * bpp + 15) / 16;
+    int failed = 0;
+
+    uint16_t * pixels = malloc(pixel_count * 2);
+    uint16_t * unpacked = malloc(pixel_count * 2);
+    uint16_t * reference = malloc(pixel_count * 2);
+    uint16_t * packed = calloc(packed_words + 2, 2);
+    uint16_t * reference_packed = calloc(packed_words + 2, 2);
+
+    for (uint32_t i = 0; i < pixel_count; i++) pixels[i] = random16() & ((1 << bpp) - 1);
+
+    for (int big_endian = 0; big_endian < 2; big_endian++)
+    {
+        memset(packed, 0, (packed_words + 2) * 2);
+        memset(reference_packed, 0, (packed_words + 2) * 2);
+        dng_pack_image_bits(packed, pixels, width, height, bpp, big_endian);
+        reference_pack(reference_packed, pixels, pixel_count, bpp, big_endian);
+        if (memcmp(packed, reference_packed, packed_words * 2))
+        {
+            printf("FAIL: pack %ix%i %u bit, big endian %i\n", width, height, bpp, big_endian);
+            failed++;
+        }
+    }
+
+    /* Unpack straight from the end of a mapping, like a frame from a mapped MLV file */
+    void * block;
+    size_t block_size;
+    size_t packed_bytes = packed_words * 2;
+    uint8_t * guarded = guarded_alloc(packed_bytes, &block, &block_size);
+    dng_pack_image_bits(packed, pixels, width, height, bpp, 0);
+    memcpy(guarded, packed, packed_bytes);
+
+    dng_unpack_image_bits(unpacked, (uint16_t *)guarded, width, height, bpp);
+    reference_unpack(reference, packed, pixel_count, bpp);
+    if (memcmp(unpacked, reference, pixel_count * 2) || memcmp(unpacked, pixels, pixel_count * 2))
+    {
+        printf("FAIL: unpack %ix%i %u bit\n", width, height, bpp);
+        failed++;
+    }
+
+    guarded_free(block, block_size);
+    free(pixels);
+    free(unpacked);
+    free(reference);
+    free(packed);
+    free(reference_packed);
+    return (failed) ? 1 : 0;
+}
+
+int main()
+{
+    int failed = 0;
+    int tests = 0;
+
+    for (uint32_t bpp = 10; bpp <= 14; bpp += 2)
+    {
+        /* Every tail length after the 8 pixel groups, in small and large images */
+        for (int width = 1; width <= 64; width++, tests++)
+            failed += test_size(width, 1, bpp);
+        for (int width = 1920; width < 1920 + 16; width++, tests++)
+            failed += test_size(width, 1080, bpp);
+    }
+
+    printf("%i/%i tests passed\n", tests - failed, tests);
+    return (failed) ? 1 : 0;
+}
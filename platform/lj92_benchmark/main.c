@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <omp.h>
+
+#include "../../src/mlv/liblj92/lj92.h"
+
+/* lj92_baseline.c, the decoder before the 64 bit bit reservoir */
+int baseline_lj92_open(lj92* lj, uint8_t* data, int datalen, int* width, int* height, int* bitdepth, int* components);
+int baseline_lj92_decode(lj92 lj, uint16_t* target, int writeLength, int skipLength, uint16_t* linearize, int linearizeLength);
+void baseline_lj92_close(lj92 lj);
+int baseline_lj92_encode(uint16_t* image, int width, int height, int bitdepth, int readLength, int skipLength,
+                         uint16_t* delinearize, int delinearizeLength, uint8_t** encoded, int* encodedLength);
+
+/* Each decoder runs this long on a frame, at least once */
+#define RUN_SECONDS 0.5
+
+static uint32_t random_state = 1;
+uint16_t random16()
+{
+    random_state = random_state * 1103515245u + 12345u;
+    return random_state >> 16;
+}
+
+/* Smooth gradient with noise of the given bits, like a raw frame at low to high ISO */
+void make_image(uint16_t * image, int width, int height, uint32_t bpp, int noise_bits)
+{
+    int max = (1 << bpp) - 1;
+    int noise = (1 << noise_bits) - 1;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int value = (x * max / width + y * max / height) / 4 + (random16() & noise) - noise / 2;
+            image[x + y * width] = (value < 0) ? 0 : (value > max) ? max : value;
+        }
+    }
+}
+
+/* Decodes a whole frame, returns the LJ92 error code */
+int decode(int baseline, uint8_t * data, int size, uint16_t * output, int * pixels)
+{
+    lj92 decoder;
+    int width, height, bitdepth, components;
+    int ret = (baseline) ? baseline_lj92_open(&decoder, data, size, &width, &height, &bitdepth, &components)
+                         : lj92_open(&decoder, data, size, &width, &height, &bitdepth, &components);
+    if (ret != LJ92_ERROR_NONE) return ret;
+
+    *pixels = width * height * components;
+    ret = (baseline) ? baseline_lj92_decode(decoder, output, *pixels, 0, NULL, 0)
+                     : lj92_decode(decoder, output, *pixels, 0, NULL, 0);
+    if (baseline) baseline_lj92_close(decoder);
+    else lj92_close(decoder);
+    return ret;
+}
+
+/* Milliseconds per decode */
+double time_decode(int baseline, uint8_t * data, int size, uint16_t * output)
+{
+    int pixels, runs = 0;
+    double start = omp_get_wtime(), now;
+    do
+    {
+        decode(baseline, data, size, output, &pixels);
+        runs++;
+        now = omp_get_wtime();
+    } while (now - start < RUN_SECONDS);
+    return (now - start) * 1000.0 / runs;
+}
+
+/* Returns 1 if the decoders don't agree */
+int benchmark_frame(const char * name, uint8_t * data, int size, int max_pixels)
+{
+    uint16_t * old_output = malloc(max_pixels * sizeof(uint16_t));
+    uint16_t * new_output = malloc(max_pixels * sizeof(uint16_t));
+    int old_pixels = 0, new_pixels = 0;
+    int failed = 0;
+
+    memset(old_output, 0, max_pixels * sizeof(uint16_t));
+    memset(new_output, 0xAB, max_pixels * sizeof(uint16_t));
+    int old_ret = decode(1, data, size, old_output, &old_pixels);
+    int new_ret = decode(0, data, size, new_output, &new_pixels);
+
+    if (old_ret != LJ92_ERROR_NONE || new_ret != LJ92_ERROR_NONE || old_pixels > max_pixels)
+    {
+        printf("%-28s FAIL: decoder error (old %i, new %i)\n", name, old_ret, new_ret);
+        failed = 1;
+    }
+    else if (old_pixels != new_pixels || memcmp(old_output, new_output, old_pixels * sizeof(uint16_t)))
+    {
+        printf("%-28s FAIL: output differs\n", name);
+        failed = 1;
+    }
+    else
+    {
+        double old_ms = time_decode(1, data, size, old_output);
+        double new_ms = time_decode(0, data, size, new_output);
+        printf("%-28s old %8.2f ms  new %8.2f ms  %5.2fx  (%.0f MPix/s)\n",
+               name, old_ms, new_ms, old_ms / new_ms, old_pixels / new_ms / 1000.0);
+    }
+
+    free(old_output);
+    free(new_output);
+    return failed;
+}
+
+/* LJ92 streams from files (e.g. frames cut out of a lossless MLV) */
+int benchmark_file(const char * file_name)
+{
+    FILE * file = fopen(file_name, "rb");
+    if (!file)
+    {
+        printf("%-28s FAIL: can't open\n", file_name);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t * data = malloc(size);
+    int failed = 1;
+    if (data && fread(data, 1, size, file) == (size_t)size)
+    {
+        /* Width and height from the header */
+        lj92 decoder;
+        int width, height, bitdepth, components;
+        if (lj92_open(&decoder, data, size, &width, &height, &bitdepth, &components) == LJ92_ERROR_NONE)
+        {
+            lj92_close(decoder);
+            failed = benchmark_frame(file_name, data, size, width * height * components);
+        }
+        else printf("%-28s FAIL: no LJ92 stream\n", file_name);
+    }
+    free(data);
+    fclose(file);
+    return failed;
+}
+
+int main(int argc, char ** argv)
+{
+    static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 5208, 3478 } };
+    static const int noise_bits[] = { 4, 8 };
+    int failed = 0;
+    int tests = 0;
+
+    /* Frames given on the command line instead of generated ones */
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++, tests++) failed += benchmark_file(argv[i]);
+        printf("%i/%i frames bit-identical\n", tests - failed, tests);
+        return (failed) ? 1 : 0;
+    }
+
+    for (uint32_t bpp = 10; bpp <= 14; bpp += 2)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for (size_t n = 0; n < sizeof(noise_bits) / sizeof(noise_bits[0]); n++, tests++)
+            {
+                /* Encoded like a lossless DNG: two bayer rows side by side */
+                int width = sizes[s][0] * 2;
+                int height = sizes[s][1] / 2;
+                uint16_t * image = malloc(width * height * sizeof(uint16_t));
+                uint8_t * encoded = NULL;
+                int encoded_size = 0;
+                char name[64];
+
+                make_image(image, width, height, bpp, noise_bits[n]);
+                snprintf(name, sizeof(name), "%ix%i %u bit, noise %i", sizes[s][0], sizes[s][1], bpp, noise_bits[n]);
+                if (baseline_lj92_encode(image, width, height, bpp, width * height, 0, NULL, 0, &encoded, &encoded_size) != LJ92_ERROR_NONE)
+                {
+                    printf("%-28s FAIL: encoder\n", name);
+                    failed++;
+                }
+                else
+                {
+                    failed += benchmark_frame(name, encoded, encoded_size, width * height);
+                }
+
+                free(encoded);
+                free(image);
+            }
+        }
+    }
+
+    printf("%i/%i frames bit-identical\n", tests - failed, tests);
+    return (failed) ? 1 : 0;
+}
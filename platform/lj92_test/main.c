@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../src/mlv/liblj92/lj92.h"
+
+static uint32_t random_state = 1;
+uint16_t random16()
+{
+    random_state = random_state * 1103515245u + 12345u;
+    return random_state >> 16;
+}
+
+/* Smooth gradient with some noise, so the huffman table looks like one of a real frame */
+void make_image(uint16_t * image, int width, int height, uint32_t bpp)
+{
+    int max = (1 << bpp) - 1;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int value = (x * max / width + y * max / height) / 2 + (random16() & 63) - 32;
+            image[x + y * width] = (value < 0) ? 0 : (value > max) ? max : value;
+        }
+    }
+}
+
+/* Same as dng_compress_image(): two bayer rows side by side, the output buffer holds the raw frame */
+int compress_dng(lj92_encoder encoder, uint16_t * output_buffer, uint16_t * input_buffer, size_t * output_buffer_size, int width, int height, uint32_t bpp, int slices)
+{
+    int new_width = width * 2;
+    int new_height = height / 2;
+    int compressed_size = 0;
+    int ret = lj92_encoder_encode(encoder, input_buffer, new_width, new_height, (int)bpp, new_width * new_height, 0, NULL, 0, slices,
+                                  (uint8_t*)output_buffer, width * height * sizeof(uint16_t), &compressed_size);
+    *output_buffer_size = compressed_size;
+    return ret;
+}
+
+/* Same as dng_decompress_image() */
+int decompress_dng(uint16_t * output_buffer, uint16_t * input_buffer, size_t input_buffer_size, int width, int height, uint32_t bpp)
+{
+    int components = 1;
+    lj92 decoder_object;
+
+    int ret = lj92_open(&decoder_object, (uint8_t*)input_buffer, input_buffer_size, &width, &height, (int*)&bpp, &components);
+    if(ret != LJ92_ERROR_NONE) return ret;
+
+    ret = lj92_decode(decoder_object, output_buffer, width * height * components, 0, NULL, 0);
+    lj92_close(decoder_object);
+    return ret;
+}
+
+/* DRI marker, only written for more than one slice */
+int has_restart_interval(uint8_t * data, size_t size)
+{
+    for (size_t i = 0; i + 1 < size; i++)
+    {
+        if (data[i] == 0xff && data[i + 1] == 0xdd) return 1;
+        if (data[i] == 0xff && data[i + 1] == 0xda) return 0; /* start of scan */
+    }
+    return 0;
+}
+
+/* Returns 1 on failure */
+int test_size(lj92_encoder encoder, int width, int height, uint32_t bpp, int slices)
+{
+    size_t pixel_count = (size_t)width * height;
+    int failed = 0;
+
+    uint16_t * image = malloc(pixel_count * 2);
+    uint16_t * compressed = malloc(pixel_count * 2);
+    uint16_t * decompressed = malloc(pixel_count * 2);
+    size_t compressed_size = 0;
+
+    make_image(image, width, height, bpp);
+    memset(decompressed, 0xAB, pixel_count * 2);
+
+    int ret = compress_dng(encoder, compressed, image, &compressed_size, width, height, bpp, slices);
+    if (ret != LJ92_ERROR_NONE)
+    {
+        printf("FAIL: compress %ix%i %u bit, %i slices (error %i)\n", width, height, bpp, slices, ret);
+        failed++;
+    }
+    else if ((slices > 1 && height / 2 > 1) != has_restart_interval((uint8_t *)compressed, compressed_size))
+    {
+        printf("FAIL: restart interval %ix%i %u bit, %i slices\n", width, height, bpp, slices);
+        failed++;
+    }
+    else if ((ret = decompress_dng(decompressed, compressed, compressed_size, width, height, bpp)) != LJ92_ERROR_NONE)
+    {
+        printf("FAIL: decompress %ix%i %u bit, %i slices (error %i)\n", width, height, bpp, slices, ret);
+        failed++;
+    }
+    else if (memcmp(decompressed, image, pixel_count * 2))
+    {
+        printf("FAIL: round trip %ix%i %u bit, %i slices\n", width, height, bpp, slices);
+        failed++;
+    }
+
+    free(image);
+    free(compressed);
+    free(decompressed);
+    return (failed) ? 1 : 0;
+}
+
+int main()
+{
+    static const int sizes[][2] = { { 1920, 1080 }, { 1736, 976 }, { 1280, 2 }, { 512, 64 }, { 72, 38 } };
+    static const int slices[] = { 1, 2, 3, 4, 7, 8, 16, 64, 5000 };
+    int failed = 0;
+    int tests = 0;
+
+    /* One encoder for everything, like a DNG export: buffers and huffman table are reused */
+    lj92_encoder encoder;
+    if (lj92_encoder_open(&encoder, 4) != LJ92_ERROR_NONE)
+    {
+        printf("FAIL: encoder\n");
+        return 1;
+    }
+
+    for (uint32_t bpp = 10; bpp <= 16; bpp += 2)
+    {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            for (size_t n = 0; n < sizeof(slices) / sizeof(slices[0]); n++, tests++)
+                failed += test_size(encoder, sizes[s][0], sizes[s][1], bpp, slices[n]);
+        }
+    }
+
+    lj92_encoder_close(encoder);
+    printf("%i/%i tests passed\n", tests - failed, tests);
+    return (failed) ? 1 : 0;
+}
@@ -337,6 +337,8 @@ void MLVBlenderExportMLV(MLVBlender_t * Blender, const char * OutputPath)
 
     uint16_t * buffer16 = malloc(sizeof(uint16_t) * frame_size);
     uint8_t * buffer_compressed = malloc(2 * frame_size * sizeof(uint16_t));
+    lj92_encoder encoder;
+    lj92_encoder_open(&encoder, LJ92_TABLE_FRAMES);
 
 
     for (uint64_t f = 0; f < longest_vid; ++f)
@@ -364,7 +366,7 @@ void MLVBlenderExportMLV(MLVBlender_t * Blender, const char * OutputPath)
         }
 
         size_t frame_size_compressed = 0;
-        int ret = dng_compress_image(buffer_compressed, buffer16, &frame_size_compressed, result_width, result_height, bitdepth);
+        int ret = dng_compress_image(encoder, buffer_compressed, buffer16, &frame_size_compressed, result_width, result_height, bitdepth, 1);
 
         /* Write frame */
         mlv_vidf_hdr_t vidf_hdr = { 0 };
@@ -381,6 +383,7 @@ void MLVBlenderExportMLV(MLVBlender_t * Blender, const char * OutputPath)
 
     free(buffer16);
     free(buffer_compressed);
+    lj92_encoder_close(encoder);
 
     printf("blacklevel = %i, whitelevel = %i\n", getMlvBlackLevel(mlv_object), getMlvWhiteLevel(mlv_object));
 
@@ -24,9 +24,12 @@ SourceFiles=(
     ../../src/debayer/ahd.c
     ../../src/mlv/llrawproc/dualiso.c
     ../../src/dng/dng.c
+    ../../src/dng/bitpack.c
     ../../src/mlv/llrawproc/darkframe.c
     ../../src/mlv/audio_mlv.c
     ../../src/processing/blur_threaded.c
+    ../../src/processing/processing_pool.c
+    ../../src/processing/core_budget.c
     ../../src/processing/denoiser/denoiser_2d_median.c
     ../../src/processing/interpolation/cosine_interpolation.c
     ../../src/debayer/wb_conversion.c
@@ -0,0 +1,84 @@
+/*!
+ * \file CdngExportThread.cpp
+ * \author masc4ii
+ * \copyright 2024
+ * \brief Worker threads for concurrent cinema DNG export, each with its own DNG scratch buffers
+ */
+
+#include "CdngExportThread.h"
+#include <omp.h>
+
+//Constructor
+CdngExportJobs::CdngExportJobs( const QVector<uint32_t> &frames, const QVector<QString> &fileNames, const QString &propertiesFileName )
+{
+    m_frames = frames;
+    m_fileNames = fileNames;
+    m_states.fill( Pending, frames.size() );
+    m_propertiesFileName = propertiesFileName;
+    m_nextJob = 0;
+    m_abort = false;
+}
+
+//Get next frame to save, false if nothing left or aborted
+bool CdngExportJobs::takeJob( int *job )
+{
+    m_mutex.lock();
+    bool retVal = !m_abort && m_nextJob < m_frames.size();
+    if( retVal ) *job = m_nextJob++;
+    m_mutex.unlock();
+    return retVal;
+}
+
+//Worker reports a saved frame
+void CdngExportJobs::setResult( int job, bool ok )
+{
+    m_mutex.lock();
+    m_states[job] = ok ? Saved : Failed;
+    m_resultReady.wakeAll();
+    m_mutex.unlock();
+}
+
+//Wait (max timeout) until the job is done
+CdngExportJobs::JobState CdngExportJobs::waitResult( int job, unsigned long timeoutMs )
+{
+    m_mutex.lock();
+    if( m_states.at( job ) == Pending ) m_resultReady.wait( &m_mutex, timeoutMs );
+    JobState retVal = m_states.at( job );
+    m_mutex.unlock();
+    return retVal;
+}
+
+//No more new jobs for the workers
+void CdngExportJobs::abort( void )
+{
+    m_mutex.lock();
+    m_abort = true;
+    m_mutex.unlock();
+}
+
+//Constructor
+CdngExportThread::CdngExportThread( mlvObject_t *pMlvObject, dngObject_t *pDngObject, CdngExportJobs *pJobs, bool singleThreaded )
+{
+    m_pMlvObject = pMlvObject;
+    m_pDngObject = pDngObject;
+    m_pJobs = pJobs;
+    m_singleThreaded = singleThreaded;
+}
+
+//Save frames until the queue is empty
+void CdngExportThread::run( void )
+{
+    //Many workers: parallelism comes from the frames, not from OpenMP inside each frame
+    if( m_singleThreaded ) omp_set_num_threads( 1 );
+
+    int job;
+    while( m_pJobs->takeJob( &job ) )
+    {
+#ifdef Q_OS_UNIX
+        int ret = saveDngFrame( m_pMlvObject, m_pDngObject, m_pJobs->frame( job ), m_pJobs->fileName( job ).toUtf8().data(), m_pJobs->propertiesFileName().toUtf8().data() );
+#else
+        int ret = saveDngFrame( m_pMlvObject, m_pDngObject, m_pJobs->frame( job ), m_pJobs->fileName( job ).toLatin1().data(), m_pJobs->propertiesFileName().toLatin1().data() );
+#endif
+        m_pJobs->setResult( job, ret == 0 );
+    }
+}
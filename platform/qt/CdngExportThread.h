@@ -0,0 +1,57 @@
+/*!
+ * \file CdngExportThread.h
+ * \author masc4ii
+ * \copyright 2024
+ * \brief Worker threads for concurrent cinema DNG export, each with its own DNG scratch buffers
+ */
+
+#ifndef CDNGEXPORTTHREAD_H
+#define CDNGEXPORTTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QString>
+#include "../../src/mlv_include.h"
+
+//Frames to be saved, shared by all workers. Frames are taken in order, results are checked in order.
+class CdngExportJobs
+{
+public:
+    enum JobState{ Pending, Saved, Failed };
+
+    CdngExportJobs( const QVector<uint32_t> &frames, const QVector<QString> &fileNames, const QString &propertiesFileName );
+    bool takeJob( int *job );
+    void setResult( int job, bool ok );
+    JobState waitResult( int job, unsigned long timeoutMs );
+    void abort( void );
+    uint32_t frame( int job ) const { return m_frames.at( job ); }
+    QString fileName( int job ) const { return m_fileNames.at( job ); }
+    QString propertiesFileName( void ) const { return m_propertiesFileName; }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_resultReady;
+    QVector<uint32_t> m_frames;
+    QVector<QString> m_fileNames;
+    QVector<JobState> m_states;
+    QString m_propertiesFileName;
+    int m_nextJob;
+    bool m_abort;
+};
+
+class CdngExportThread : public QThread
+{
+public:
+    CdngExportThread( mlvObject_t *pMlvObject, dngObject_t *pDngObject, CdngExportJobs *pJobs, bool singleThreaded );
+
+private:
+    void run( void );
+    mlvObject_t *m_pMlvObject;
+    dngObject_t *m_pDngObject;
+    CdngExportJobs *m_pJobs;
+    bool m_singleThreaded;
+};
+
+#endif // CDNGEXPORTTHREAD_H
@@ -0,0 +1,236 @@
+/*!
+ * \file ExportPipeline.cpp
+ * \author masc4ii
+ * \copyright 2024
+ * \brief Bounded frame pipeline for ffmpeg pipe export: render -> scale -> reorder -> write
+ */
+
+#include "ExportPipeline.h"
+#include "avir/avirthreadpool.h"
+#include <stdlib.h>
+
+//Scaling threads (AVIR scales each frame multithreaded itself, 2 frames keep the cores busy)
+#define SCALE_THREADS 2
+
+//Filter bank and worker threads are built once, the cores are taken from the budget per frame
+struct ExportPipeline::scaler_t
+{
+    scaler_t() : pool( false ), resizer( 16, 0, avir::CImageResizerParamsUltra() ) { vars.ThreadPool = &pool; }
+    avir_scale_thread_pool pool;
+    avir::CImageResizerVars vars;
+    avir::CImageResizer<> resizer;
+};
+
+//Constructor
+ExportPipeline::ExportPipeline( FILE *pPipe,
+                                uint16_t inWidth, uint16_t inHeight,
+                                uint16_t outWidth, uint16_t outHeight,
+                                bool scaled, int framesInFlight )
+{
+    m_pPipe = pPipe;
+    m_inWidth = inWidth;
+    m_inHeight = inHeight;
+    m_outWidth = outWidth;
+    m_outHeight = outHeight;
+    m_scaled = scaled;
+    m_renderSlot = -1;
+    m_nextSequence = 0;
+    m_nextWrite = 0;
+    m_stop = false;
+    m_error = false;
+
+    //At least one frame rendering, one writing and one per scaler
+    int scaleThreads = m_scaled ? SCALE_THREADS : 0;
+    if( framesInFlight < scaleThreads + 2 ) framesInFlight = scaleThreads + 2;
+
+    //Allocate all buffers once. With less memory there are less frames in flight, down to one
+    //frame at a time. Without any frame buffer the pipeline is not valid and no stage starts
+    for( int i = 0; i < framesInFlight; i++ )
+    {
+        slot_t slot;
+        slot.in = ( uint16_t* )malloc( m_inWidth * m_inHeight * 3 * sizeof( uint16_t ) );
+        if( !slot.in ) break;
+        if( m_scaled )
+        {
+            slot.out = ( uint16_t* )malloc( m_outWidth * m_outHeight * 3 * sizeof( uint16_t ) );
+            if( !slot.out )
+            {
+                free( slot.in );
+                break;
+            }
+        }
+        else slot.out = slot.in;
+        slot.sequence = 0;
+        m_slots.append( slot );
+        m_freeSlots.enqueue( i );
+    }
+    if( m_slots.isEmpty() )
+    {
+        m_error = true;
+        return;
+    }
+
+    //Start stages
+    for( int i = 0; i < scaleThreads; i++ )
+    {
+        m_scalers.append( new scaler_t() );
+        m_threads.append( new StageThread( this, m_scalers.last() ) );
+    }
+    m_threads.append( new StageThread( this, NULL ) );
+    for( int i = 0; i < m_threads.size(); i++ ) m_threads.at(i)->start();
+}
+
+//Destructor
+ExportPipeline::~ExportPipeline()
+{
+    m_mutex.lock();
+    m_stop = true;
+    m_scaleReady.wakeAll();
+    m_writeReady.wakeAll();
+    m_mutex.unlock();
+
+    for( int i = 0; i < m_threads.size(); i++ )
+    {
+        m_threads.at(i)->wait();
+        delete m_threads.at(i);
+    }
+    for( int i = 0; i < m_scalers.size(); i++ ) delete m_scalers.at(i);
+
+    for( int i = 0; i < m_slots.size(); i++ )
+    {
+        if( m_scaled ) free( m_slots[i].out );
+        free( m_slots[i].in );
+    }
+}
+
+//Get a free frame buffer for rendering, blocks until a frame left the pipeline
+uint16_t *ExportPipeline::acquireFrameBuffer( void )
+{
+    if( !isValid() ) return NULL;
+    m_mutex.lock();
+    while( m_freeSlots.isEmpty() ) m_slotFree.wait( &m_mutex );
+    m_renderSlot = m_freeSlots.dequeue();
+    uint16_t *buffer = m_slots[m_renderSlot].in;
+    m_mutex.unlock();
+    return buffer;
+}
+
+//Rendered frame goes to the scaler, or directly to the writer
+void ExportPipeline::submitFrameBuffer( uint16_t *buffer )
+{
+    m_mutex.lock();
+    if( m_renderSlot < 0 || m_slots[m_renderSlot].in != buffer )
+    {
+        m_mutex.unlock();
+        return;
+    }
+    m_slots[m_renderSlot].sequence = m_nextSequence++;
+    if( m_scaled )
+    {
+        m_scaleQueue.enqueue( m_renderSlot );
+        m_scaleReady.wakeOne();
+    }
+    else
+    {
+        m_reorder.insert( m_slots[m_renderSlot].sequence, m_renderSlot );
+        m_writeReady.wakeOne();
+    }
+    m_renderSlot = -1;
+    m_mutex.unlock();
+}
+
+//Wait until the writer has drained the pipeline
+void ExportPipeline::finish( void )
+{
+    m_mutex.lock();
+    while( m_nextWrite < m_nextSequence ) m_allWritten.wait( &m_mutex );
+    m_mutex.unlock();
+}
+
+//Could the frame buffers be allocated?
+bool ExportPipeline::isValid( void )
+{
+    return !m_slots.isEmpty();
+}
+
+//Did fwrite fail (or the allocation)?
+bool ExportPipeline::hasError( void )
+{
+    m_mutex.lock();
+    bool retVal = m_error;
+    m_mutex.unlock();
+    return retVal;
+}
+
+//Frames which reached the pipe
+uint32_t ExportPipeline::framesWritten( void )
+{
+    m_mutex.lock();
+    uint32_t retVal = m_nextWrite;
+    m_mutex.unlock();
+    return retVal;
+}
+
+//Scaling stage, frames may finish out of order
+void ExportPipeline::scaleLoop( scaler_t *scaler )
+{
+    m_mutex.lock();
+    while( true )
+    {
+        while( !m_stop && m_scaleQueue.isEmpty() ) m_scaleReady.wait( &m_mutex );
+        if( m_stop ) break;
+        int slot = m_scaleQueue.dequeue();
+        m_mutex.unlock();
+
+        scaleFrame( scaler, &m_slots[slot] );
+
+        m_mutex.lock();
+        m_reorder.insert( m_slots[slot].sequence, slot );
+        m_writeReady.wakeOne();
+    }
+    m_mutex.unlock();
+}
+
+//Writing stage, takes frames strictly in render order
+void ExportPipeline::writeLoop( void )
+{
+    uint32_t frameSize = m_outWidth * m_outHeight * 3;
+    m_mutex.lock();
+    while( true )
+    {
+        while( !m_stop && !m_reorder.contains( m_nextWrite ) ) m_writeReady.wait( &m_mutex );
+        if( m_stop ) break;
+        int slot = m_reorder.take( m_nextWrite );
+        bool error = m_error;
+        m_mutex.unlock();
+
+        //Blocks while ffmpeg is busy, meanwhile the other stages continue
+        if( !error )
+        {
+            if( fwrite( m_slots[slot].out, sizeof( uint16_t ), frameSize, m_pPipe ) != frameSize ) error = true;
+            fflush( m_pPipe );
+        }
+
+        m_mutex.lock();
+        if( error ) m_error = true;
+        m_nextWrite++;
+        m_freeSlots.enqueue( slot );
+        m_slotFree.wakeOne();
+        m_allWritten.wakeAll();
+    }
+    m_mutex.unlock();
+}
+
+//AVIR resize of one frame
+void ExportPipeline::scaleFrame( scaler_t *scaler, slot_t *slot )
+{
+    scaler->pool.acquireBudget();
+    scaler->resizer.resizeImage( slot->in,
+                                 m_inWidth,
+                                 m_inHeight, 0,
+                                 slot->out,
+                                 m_outWidth,
+                                 m_outHeight,
+                                 3, 0, &scaler->vars );
+    scaler->pool.releaseBudget();
+}
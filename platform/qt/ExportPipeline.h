@@ -0,0 +1,94 @@
+/*!
+ * \file ExportPipeline.h
+ * \author masc4ii
+ * \copyright 2024
+ * \brief Bounded frame pipeline for ffmpeg pipe export: render -> scale -> reorder -> write
+ */
+
+#ifndef EXPORTPIPELINE_H
+#define EXPORTPIPELINE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QQueue>
+#include <QMap>
+#include <stdio.h>
+#include <stdint.h>
+
+class ExportPipeline
+{
+public:
+    ExportPipeline( FILE *pPipe,
+                    uint16_t inWidth, uint16_t inHeight,
+                    uint16_t outWidth, uint16_t outHeight,
+                    bool scaled, int framesInFlight );
+    ~ExportPipeline();
+
+    //False if not even one frame buffer could be allocated, nothing can be exported then
+    bool isValid( void );
+    //Render stage: get a free frame buffer (blocks while all frames are in flight), NULL if not valid
+    uint16_t *acquireFrameBuffer( void );
+    //Render stage: hand the rendered buffer over to scale & write stages
+    void submitFrameBuffer( uint16_t *buffer );
+    //Wait until all submitted frames are written to the pipe
+    void finish( void );
+    //Writing to the pipe failed, or the pipeline is not valid
+    bool hasError( void );
+    //Frames which reached the pipe
+    uint32_t framesWritten( void );
+
+private:
+    typedef struct {
+        uint16_t *in;
+        uint16_t *out;
+        uint32_t sequence;
+    } slot_t;
+
+    //AVIR thread pool and resizer of one scaling thread, reused for all frames
+    struct scaler_t;
+
+    class StageThread : public QThread
+    {
+    public:
+        //Writer if there is no scaler
+        StageThread( ExportPipeline *pipeline, scaler_t *scaler ) : m_pPipeline( pipeline ), m_pScaler( scaler ) {}
+    private:
+        void run( void ){ if( !m_pScaler ) m_pPipeline->writeLoop(); else m_pPipeline->scaleLoop( m_pScaler ); }
+        ExportPipeline *m_pPipeline;
+        scaler_t *m_pScaler;
+    };
+
+    void scaleLoop( scaler_t *scaler );
+    void writeLoop( void );
+    void scaleFrame( scaler_t *scaler, slot_t *slot );
+
+    FILE *m_pPipe;
+    uint16_t m_inWidth;
+    uint16_t m_inHeight;
+    uint16_t m_outWidth;
+    uint16_t m_outHeight;
+    bool m_scaled;
+
+    QMutex m_mutex;
+    QWaitCondition m_slotFree;
+    QWaitCondition m_scaleReady;
+    QWaitCondition m_writeReady;
+    QWaitCondition m_allWritten;
+
+    QVector<slot_t> m_slots;
+    QQueue<int> m_freeSlots;
+    QQueue<int> m_scaleQueue;
+    QMap<uint32_t, int> m_reorder;
+    int m_renderSlot;
+    uint32_t m_nextSequence;
+    uint32_t m_nextWrite;
+    bool m_stop;
+    bool m_error;
+
+    QVector<StageThread*> m_threads;
+    QVector<scaler_t*> m_scalers;
+};
+
+#endif // EXPORTPIPELINE_H
@@ -51,6 +51,7 @@ void GraphicsZoomView::resetZoom()
     qreal targetScale = (qreal)percentZoom / 100.0;
     qreal scaleFactor = targetScale / transform().m11();
     scale( scaleFactor, scaleFactor );
+    emit viewChanged();
 }
 
 //Set white balance picker active
@@ -102,6 +103,7 @@ void GraphicsZoomView::shortCutZoomIn()
     double scaleFactor = 1.5;
     // Zoom in
     scale( scaleFactor, scaleFactor );
+    emit viewChanged();
 }
 
 //Shortcut Zoom Out
@@ -116,6 +118,7 @@ void GraphicsZoomView::shortCutZoomOut()
     double scaleFactor = 1.5;
     // Zoom in
     scale( 1.0 / scaleFactor, 1.0 / scaleFactor );
+    emit viewChanged();
 }
 
 //Methods for changing the cursor
@@ -191,6 +194,14 @@ void GraphicsZoomView::wheelEvent(QWheelEvent *event)
     {
         //do nothing
     }
+    emit viewChanged();
+}
+
+//The view was scrolled (scrollbars or dragging)
+void GraphicsZoomView::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    emit viewChanged();
 }
 
 //Show the wb picker icon as cursor
@@ -35,6 +35,7 @@ public slots:
 signals:
     void wbPicked( int x, int y );
     void bpPicked( int x, int y );
+    void viewChanged( void );
 
 protected:
     enum PickerState{ NoPicker, WbPicker, BpPicker };
@@ -46,6 +47,7 @@ protected:
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
+    void scrollContentsBy(int dx, int dy);
     void setPipetteCursor();
     bool m_isZoomEnabled;
     PickerState m_pickerState;
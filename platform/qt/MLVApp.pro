@@ -166,6 +166,7 @@ SOURCES += \
     ../../src/processing/cube_lut.c \
     ../../src/mlv/llrawproc/dualiso.c \
     ../../src/dng/dng.c \
+    ../../src/dng/bitpack.c \
     ScopesLabel.cpp \
     InfoDialog.cpp \
     StatusDialog.cpp \
@@ -184,6 +185,8 @@ SOURCES += \
     NoScrollSlider.cpp \
     ColorToolButton.cpp \
     RenderFrameThread.cpp \
+    ExportPipeline.cpp \
+    CdngExportThread.cpp \
     GraphicsPolygonMoveItem.cpp \
     GradientElement.cpp \
     VectorScope.cpp \
@@ -193,6 +196,8 @@ SOURCES += \
     ../../src/mlv/audio_mlv.c \
     Updater/updaterUI/cupdaterdialog.cpp \
     ../../src/processing/blur_threaded.c \
+    ../../src/processing/processing_pool.c \
+    ../../src/processing/core_budget.c \
     Scripting.cpp \
     FcpxmlAssistantDialog.cpp \
     FcpxmlSelectDialog.cpp \
@@ -303,6 +308,8 @@ HEADERS += MainWindow.h \
     NoScrollSlider.h \
     ColorToolButton.h \
     RenderFrameThread.h \
+    ExportPipeline.h \
+    CdngExportThread.h \
     GraphicsPolygonMoveItem.h \
     GradientElement.h \
     VectorScope.h \
@@ -313,6 +320,8 @@ HEADERS += MainWindow.h \
     ../../src/mlv/macros.h \
     Updater/updaterUI/cupdaterdialog.h \
     ../../src/processing/blur_threaded.h \
+    ../../src/processing/processing_pool.h \
+    ../../src/processing/core_budget.h \
     Scripting.h \
     FcpxmlAssistantDialog.h \
     FcpxmlSelectDialog.h \
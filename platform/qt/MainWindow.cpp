@@ -12,6 +12,7 @@
 #include <QMessageBox>
 #include <QThread>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QSettings>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #include <QDesktopWidget>
@@ -60,11 +61,16 @@
 #include "FocusPixelMapManager.h"
 #include "StatusFpmDialog.h"
 #include "RenameDialog.h"
+#include "ExportPipeline.h"
+#include "CdngExportThread.h"
 
 /* spaceTag argument options: ffmpeg color space tag number compliant */
 #define SPACETAG_REC709   1   /* rec709 color space */
 #define SPACETAG_UNKNOWN  2   /* No color space tag set */
 
+/* Frames rendered, scaled and written in parallel while exporting via pipe */
+#define EXPORT_FRAMES_IN_FLIGHT 4
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -115,6 +121,8 @@ MainWindow::MainWindow(int &argc, char **argv, QWidget *parent) :
     //Set bools for draw rules
     m_dontDraw = true;
     m_frameStillDrawing = false;
+    m_previewScale = 1;
+    m_viewerRegion = QRect();
     m_frameChanged = false;
     m_fileLoaded = false;
     m_fpsOverride = false;
@@ -590,7 +598,9 @@ void MainWindow::drawFrame( void )
     if( ui->actionPlay->isChecked() && ui->actionDropFrameMode->isChecked() )
     {
         //If we are in playback, dropmode, we calculated the exact frame to sync the timeline
-        m_pRenderThread->renderFrame( m_newPosDropMode );
+        m_previewScale = getPreviewScale();
+        m_viewerRegion = getViewerRegion();
+        m_pRenderThread->renderFrame( m_newPosDropMode, m_previewScale, m_viewerRegion );
 
         //Draw TimeCode
         if( !m_tcModeDuration )
@@ -606,7 +616,9 @@ void MainWindow::drawFrame( void )
     else
     {
         //Else we render the frame which is selected by the slider
-        m_pRenderThread->renderFrame( ui->horizontalSliderPosition->value() );
+        m_previewScale = getPreviewScale();
+        m_viewerRegion = getViewerRegion();
+        m_pRenderThread->renderFrame( ui->horizontalSliderPosition->value(), m_previewScale, m_viewerRegion );
 
         //Draw TimeCode
         if( !m_tcModeDuration )
@@ -822,6 +834,23 @@ void MainWindow::on_actionFcpxmlSelectionAssistant_triggered()
     delete sd;
 }
 
+//Opens a MLV clip next to the GUI thread, so the indexing progress can be shown meanwhile
+class MlvOpenThread : public QThread
+{
+public:
+    MlvOpenThread( mlvObject_t *pMlvObject, QByteArray path, int openMode )
+        : m_pMlvObject( pMlvObject ), m_path( path ), m_openMode( openMode ), m_error( MLV_ERR_NONE ) { m_errorMessage[0] = 0; }
+    int error( void ){ return m_error; }
+    char *errorMessage( void ){ return m_errorMessage; }
+private:
+    void run( void ){ m_error = openMlvClip( m_pMlvObject, m_path.data(), m_openMode, m_errorMessage ); }
+    mlvObject_t *m_pMlvObject;
+    QByteArray m_path;
+    int m_openMode;
+    int m_error;
+    char m_errorMessage[256];
+};
+
 //Open MLV procedure
 int MainWindow::openMlv( QString fileName )
 {
@@ -845,11 +874,42 @@ int MainWindow::openMlv( QString fileName )
     }
     else
     {
+        new_MlvObject = initMlvObject();
 #ifdef Q_OS_UNIX
-        new_MlvObject = initMlvObjectWithClip( fileName.toUtf8().data(), mlvOpenMode, &mlvErr, mlvErrMsg );
+        MlvOpenThread openThread( new_MlvObject, fileName.toUtf8(), mlvOpenMode );
 #else
-        new_MlvObject = initMlvObjectWithClip( fileName.toLatin1().data(), mlvOpenMode, &mlvErr, mlvErrMsg );
+        MlvOpenThread openThread( new_MlvObject, fileName.toLatin1(), mlvOpenMode );
 #endif
+        openThread.start();
+
+        //Indexing big clips takes a while: show the progress, if the status dialog isn't used by export already
+        bool progressAllowed = !m_pStatusDialog->isVisible();
+        bool progressShown = false;
+        QElapsedTimer openTime;
+        openTime.start();
+        while( !openThread.wait( 20 ) )
+        {
+            if( !progressAllowed || openTime.elapsed() < 500 ) continue;
+            if( !progressShown )
+            {
+                m_pStatusDialog->ui->label->setText( tr( "Indexing clip..." ) );
+                m_pStatusDialog->ui->labelEstimatedTime->setText( "" );
+                m_pStatusDialog->ui->progressBar->setMaximum( 100 );
+                m_pStatusDialog->ui->pushButtonAbort->setVisible( false );
+                m_pStatusDialog->open();
+                progressShown = true;
+            }
+            m_pStatusDialog->ui->progressBar->setValue( 100 * getMlvIndexProgress( new_MlvObject ) );
+            qApp->processEvents( QEventLoop::ExcludeUserInputEvents );
+        }
+        if( progressShown )
+        {
+            m_pStatusDialog->close();
+            m_pStatusDialog->ui->pushButtonAbort->setVisible( true );
+        }
+
+        mlvErr = openThread.error();
+        strcpy( mlvErrMsg, openThread.errorMessage() );
     }
 
     if( mlvErr )
@@ -1299,6 +1359,7 @@ void MainWindow::initGui( void )
     ui->graphicsView->setScene( m_pScene );
     ui->graphicsView->show();
     connect( ui->graphicsView, SIGNAL( customContextMenuRequested(QPoint) ), this, SLOT( pictureCustomContextMenuRequested(QPoint) ) );
+    connect( ui->graphicsView, SIGNAL( viewChanged() ), this, SLOT( viewerViewChanged() ) );
     connect( m_pScene, SIGNAL( wbPicked(int,int) ), this, SLOT( whiteBalancePicked(int,int) ) );
     connect( m_pScene, SIGNAL( bpPicked(int,int) ), this, SLOT( badPixelPicked(int,int) ) );
     connect( m_pScene, SIGNAL( filesDropped(QStringList) ), this, SLOT( openMlvSet(QStringList) ) );
@@ -1614,6 +1675,7 @@ void MainWindow::readSettings()
     ui->groupBoxLinearGradient->setChecked( set.value( "expandedLinGradient", false ).toBool() );
     ui->groupBoxTransformation->setChecked( set.value( "expandedTransformation", false ).toBool() );
     ui->actionCreateMappFiles->setChecked( set.value( "createMappFiles", false ).toBool() );
+    ui->actionLosslessSlices->setChecked( set.value( "losslessSlices", false ).toBool() );
     m_timeCodePosition = set.value( "tcPos", 1 ).toUInt();
     ui->actionAutoCheckForUpdates->setChecked( set.value( "autoUpdateCheck", true ).toBool() );
     ui->actionPlaybackPosition->setChecked( set.value( "rememberPlaybackPos", false ).toBool() );
@@ -1623,6 +1685,8 @@ void MainWindow::readSettings()
     m_pRecentFilesMenu->restoreState( set.value("recentSessions").toByteArray() );
     ui->actionAskForSavingOnQuit->setChecked( set.value( "askForSavingOnQuit", true ).toBool() );
     ui->actionBetterResizer->setChecked( set.value( "betterResizerViewer", false ).toBool() );
+    ui->actionPreviewDisplayResolution->setChecked( set.value( "previewDisplayResolution", true ).toBool() );
+    ui->actionProcessVisibleRegion->setChecked( set.value( "processVisibleRegion", true ).toBool() );
     m_defaultReceiptFileName = set.value( "defaultReceiptFileName", QDir::homePath() ).toString();
     ui->actionUseDefaultReceipt->setChecked( set.value( "defaultReceiptEnabled", false ).toBool() );
     int themeId = set.value( "themeId", 0 ).toInt();
@@ -1687,6 +1751,7 @@ void MainWindow::writeSettings()
     set.setValue( "expandedLinGradient", ui->groupBoxLinearGradient->isChecked() );
     set.setValue( "expandedTransformation", ui->groupBoxTransformation->isChecked() );
     set.setValue( "createMappFiles", ui->actionCreateMappFiles->isChecked() );
+    set.setValue( "losslessSlices", ui->actionLosslessSlices->isChecked() );
     set.setValue( "tcPos", m_timeCodePosition );
     set.setValue( "autoUpdateCheck", ui->actionAutoCheckForUpdates->isChecked() );
     set.setValue( "rememberPlaybackPos", ui->actionPlaybackPosition->isChecked() );
@@ -1698,6 +1763,8 @@ void MainWindow::writeSettings()
     set.setValue( "recentSessions", m_pRecentFilesMenu->saveState() );
     set.setValue( "askForSavingOnQuit", ui->actionAskForSavingOnQuit->isChecked() );
     set.setValue( "betterResizerViewer", ui->actionBetterResizer->isChecked() );
+    set.setValue( "previewDisplayResolution", ui->actionPreviewDisplayResolution->isChecked() );
+    set.setValue( "processVisibleRegion", ui->actionProcessVisibleRegion->isChecked() );
     if( ui->actionDarkThemeStandard->isChecked() ) set.setValue( "themeId", 0 );
     else set.setValue( "themeId", 1 );
     QColor backgroundColor = ui->graphicsView->backgroundBrush().color();
@@ -2091,11 +2158,6 @@ void MainWindow::startExportPipe(QString fileName)
         }
         else
         {
-            //Buffer
-            uint32_t frameSize = getMlvWidth( m_pMlvObject ) * getMlvHeight( m_pMlvObject ) * 3;
-            uint16_t * imgBuffer;
-            imgBuffer = ( uint16_t* )malloc( frameSize * sizeof( uint16_t ) );
-
             //Frames in the export queue?!
             int totalFrames = 0;
             for( int i = 0; i < m_exportQueue.size(); i++ )
@@ -2103,49 +2165,31 @@ void MainWindow::startExportPipe(QString fileName)
                 totalFrames += m_exportQueue.at(i)->cutOut() - m_exportQueue.at(i)->cutIn() + 1;
             }
 
-            //Build buffer
-            uint16_t * imgBufferScaled;
-            imgBufferScaled = ( uint16_t* )malloc( width * height * 3 * sizeof( uint16_t ) );
+            //Render, scaling and writing to the pipe overlap, frames leave the pipeline in order
+            ExportPipeline *pipeline = new ExportPipeline( pPipeStab,
+                                                           getMlvWidth( m_pMlvObject ),
+                                                           getMlvHeight( m_pMlvObject ),
+                                                           width, height, scaled,
+                                                           EXPORT_FRAMES_IN_FLIGHT );
+            if( !pipeline->isValid() )
+            {
+                QMessageBox::critical( this, tr( "File export failed" ), tr( "Not enough memory to export.\n\nFile %1 was not exported." ).arg( fileName ) );
+            }
 
             //Get all pictures and send to pipe
             for( uint32_t i = (m_exportQueue.first()->cutIn() - 1); i < m_exportQueue.first()->cutOut(); i++ )
             {
                 if( m_codecProfile == CODEC_TIFF && m_codecOption == CODEC_TIFF_AVG && i > 128 ) break;
 
-                if( scaled )
-                {
-                    //Get picture, and lock render thread... there can only be one!
-                    m_pRenderThread->lock();
-                    getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
-                    m_pRenderThread->unlock();
-
-                    avir_scale_thread_pool scaling_pool;
-                    avir::CImageResizerVars vars; vars.ThreadPool = &scaling_pool;
-                    avir::CImageResizerParamsUltra roptions;
-                    avir::CImageResizer<> image_resizer( 16, 0, roptions );
-                    image_resizer.resizeImage( imgBuffer,
-                                               getMlvWidth(m_pMlvObject),
-                                               getMlvHeight(m_pMlvObject), 0,
-                                               imgBufferScaled,
-                                               width,
-                                               height,
-                                               3, 0, &vars );
-
-                    //Write to pipe
-                    fwrite(imgBufferScaled, sizeof( uint16_t ), width * height * 3, pPipeStab);
-                    fflush(pPipeStab);
-                }
-                else
-                {
-                    //Get picture, and lock render thread... there can only be one!
-                    m_pRenderThread->lock();
-                    getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
-                    m_pRenderThread->unlock();
-
-                    //Write to pipe
-                    fwrite(imgBuffer, sizeof( uint16_t ), frameSize, pPipeStab);
-                    fflush(pPipeStab);
-                }
+                //Get picture, and lock render thread... there can only be one!
+                uint16_t * imgBuffer = pipeline->acquireFrameBuffer();
+                if( !imgBuffer ) break;
+                m_pRenderThread->lock();
+                getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
+                m_pRenderThread->unlock();
+
+                //Scale and write to pipe in background
+                pipeline->submitFrameBuffer( imgBuffer );
 
                 //Set Status
                 m_pStatusDialog->ui->progressBar->setValue( ( i - ( m_exportQueue.first()->cutIn() - 1 ) + 1 ) >> 1 );
@@ -2157,15 +2201,19 @@ void MainWindow::startExportPipe(QString fileName)
                 checkDiskFull( fileName );
                 //Abort pressed? -> End the loop
                 if( m_exportAbortPressed ) break;
+                //ffmpeg gone? -> End the loop
+                if( pipeline->hasError() ) break;
             }
+            //Write remaining frames
+            pipeline->finish();
+            delete pipeline;
+
             //Close pipe
             if( pclose( pPipeStab ) != 0 )
             {
                 staberr = true;
                 QMessageBox::critical( this, tr( "File export failed" ), tr( "FFmpeg closed unexpectedly during stabilization.\n\nFile %1 was not exported completely." ).arg( fileName ) );
             }
-            free( imgBufferScaled );
-            free( imgBuffer );
         }
     }
 
@@ -2627,11 +2675,6 @@ void MainWindow::startExportPipe(QString fileName)
         }
         else
         {
-            //Buffer
-            uint32_t frameSize = getMlvWidth( m_pMlvObject ) * getMlvHeight( m_pMlvObject ) * 3;
-            uint16_t * imgBuffer;
-            imgBuffer = ( uint16_t* )malloc( frameSize * sizeof( uint16_t ) );
-
             //Frames in the export queue?!
             int totalFrames = 0;
             for( int i = 0; i < m_exportQueue.size(); i++ )
@@ -2639,49 +2682,31 @@ void MainWindow::startExportPipe(QString fileName)
                 totalFrames += m_exportQueue.at(i)->cutOut() - m_exportQueue.at(i)->cutIn() + 1;
             }
 
-            //Build buffer
-            uint16_t * imgBufferScaled;
-            imgBufferScaled = ( uint16_t* )malloc( width * height * 3 * sizeof( uint16_t ) );
+            //Render, scaling and writing to the pipe overlap, frames leave the pipeline in order
+            ExportPipeline *pipeline = new ExportPipeline( pPipe,
+                                                           getMlvWidth( m_pMlvObject ),
+                                                           getMlvHeight( m_pMlvObject ),
+                                                           width, height, scaled,
+                                                           EXPORT_FRAMES_IN_FLIGHT );
+            if( !pipeline->isValid() )
+            {
+                QMessageBox::critical( this, tr( "File export failed" ), tr( "Not enough memory to export.\n\nFile %1 was not exported." ).arg( fileName ) );
+            }
 
             //Get all pictures and send to pipe
             for( uint32_t i = (m_exportQueue.first()->cutIn() - 1); i < m_exportQueue.first()->cutOut(); i++ )
             {
                 if( m_codecProfile == CODEC_TIFF && m_codecOption == CODEC_TIFF_AVG && i > 128 ) break;
 
-                if( scaled )
-                {
-                    //Get picture, and lock render thread... there can only be one!
-                    m_pRenderThread->lock();
-                    getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
-                    m_pRenderThread->unlock();
-
-                    avir_scale_thread_pool scaling_pool;
-                    avir::CImageResizerVars vars; vars.ThreadPool = &scaling_pool;
-                    avir::CImageResizerParamsUltra roptions;
-                    avir::CImageResizer<> image_resizer( 16, 0, roptions );
-                    image_resizer.resizeImage( imgBuffer,
-                                               getMlvWidth(m_pMlvObject),
-                                               getMlvHeight(m_pMlvObject), 0,
-                                               imgBufferScaled,
-                                               width,
-                                               height,
-                                               3, 0, &vars );
-
-                    //Write to pipe
-                    fwrite(imgBufferScaled, sizeof( uint16_t ), width * height * 3, pPipe);
-                    fflush(pPipe);
-                }
-                else
-                {
-                    //Get picture, and lock render thread... there can only be one!
-                    m_pRenderThread->lock();
-                    getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
-                    m_pRenderThread->unlock();
-
-                    //Write to pipe
-                    fwrite(imgBuffer, sizeof( uint16_t ), frameSize, pPipe);
-                    fflush(pPipe);
-                }
+                //Get picture, and lock render thread... there can only be one!
+                uint16_t * imgBuffer = pipeline->acquireFrameBuffer();
+                if( !imgBuffer ) break;
+                m_pRenderThread->lock();
+                getMlvProcessedFrame16( m_pMlvObject, i, imgBuffer, QThread::idealThreadCount() );
+                m_pRenderThread->unlock();
+
+                //Scale and write to pipe in background
+                pipeline->submitFrameBuffer( imgBuffer );
 
                 //Set Status
                 if( !( m_exportQueue.first()->vidStabEnabled() && m_codecProfile == CODEC_H264 ) )
@@ -2702,14 +2727,18 @@ void MainWindow::startExportPipe(QString fileName)
                 checkDiskFull( fileName );
                 //Abort pressed? -> End the loop
                 if( m_exportAbortPressed ) break;
+                //ffmpeg gone? -> End the loop
+                if( pipeline->hasError() ) break;
             }
+            //Write remaining frames
+            pipeline->finish();
+            delete pipeline;
+
             //Close pipe
             if( pclose( pPipe ) != 0 )
             {
                 QMessageBox::critical( this, tr( "File export failed" ), tr( "FFmpeg closed unexpectedly during export.\n\nFile %1 was not exported completely." ).arg( fileName ) );
             }
-            free( imgBufferScaled );
-            free( imgBuffer );
         }
     }
 
@@ -2852,9 +2881,6 @@ void MainWindow::startExportCdng(QString fileName)
         picAR[2] = 1; picAR[3] = 1;
     }
 
-    //Init DNG data struct
-    dngObject_t * cinemaDng = initDngObject( m_pMlvObject, m_codecProfile - 6, getFramerate(), picAR);
-
     //Render one single frame for raw correction init
     uint32_t frameSize = getMlvWidth( m_pMlvObject ) * getMlvHeight( m_pMlvObject ) * 3;
     uint16_t * imgBuffer;
@@ -2862,7 +2888,10 @@ void MainWindow::startExportCdng(QString fileName)
     getMlvProcessedFrame16( m_pMlvObject, 0, imgBuffer, QThread::idealThreadCount() );
     free( imgBuffer );
 
-    //Output frames loop
+    //Build all file names in advance, so naming does not depend on which worker saves a frame
+    QVector<uint32_t> frames;
+    QVector<QString> dngNames;
+    QVector<QString> filePaths;
     for( uint32_t frame = m_exportQueue.first()->cutIn() - 1; frame < m_exportQueue.first()->cutOut(); frame++ )
     {
         QString dngName;
@@ -2879,22 +2908,57 @@ void MainWindow::startExportCdng(QString fileName)
         QString filePathNr = pathName;
         filePathNr = filePathNr.append( "/" + dngName );
 
-        //Save cDNG frame
+        frames.append( frame );
+        dngNames.append( dngName );
+        filePaths.append( filePathNr );
+    }
+    QString properties_fn = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
 #ifdef Q_OS_UNIX
-        QString properties_fn = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
-        properties_fn.append("/mlv-dng-params.txt");
-        if( saveDngFrame( m_pMlvObject, cinemaDng, frame, filePathNr.toUtf8().data(), properties_fn.toUtf8().data() ) )
+    properties_fn.append("/mlv-dng-params.txt");
 #else
-        QString properties_fn = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
-        properties_fn.append("\\mlv-dng-params.txt");
-        if( saveDngFrame( m_pMlvObject, cinemaDng, frame, filePathNr.toLatin1().data(), properties_fn.toLatin1().data() ) )
+    properties_fn.append("\\mlv-dng-params.txt");
 #endif
+    CdngExportJobs dngJobs( frames, filePaths, properties_fn );
+
+    //Workers: one per core, but don't use more than a quarter of the RAM for DNG scratch buffers
+    size_t dngObjectSize = (size_t)getMlvWidth( m_pMlvObject ) * getMlvHeight( m_pMlvObject ) * sizeof( uint16_t ) * 3;
+    int workers = QThread::idealThreadCount();
+    if( workers > frames.size() ) workers = frames.size();
+    if( (size_t)workers * dngObjectSize > getMemorySize() / 4 ) workers = getMemorySize() / 4 / dngObjectSize;
+    //...and not more than the core budget leaves for encoding
+    int grantedCores = core_budget_acquire( CORE_BUDGET_ENCODING, workers );
+    if( workers > grantedCores ) workers = grantedCores;
+    if( workers < 1 ) workers = 1;
+
+    //Init DNG data structs, one per worker
+    QVector<dngObject_t*> cinemaDngs;
+    QVector<CdngExportThread*> dngThreads;
+    for( int i = 0; i < workers; i++ )
+    {
+        cinemaDngs.append( initDngObject( m_pMlvObject, m_codecProfile - 6, getFramerate(), picAR) );
+        //Sliced lossless DNGs only if the user asked for it, not all applications read them
+        if( ui->actionLosslessSlices->isChecked() ) setDngLj92Slices( cinemaDngs.last(), QThread::idealThreadCount() );
+        dngThreads.append( new CdngExportThread( m_pMlvObject, cinemaDngs.at(i), &dngJobs, workers > 1 ) );
+        dngThreads.at(i)->start();
+    }
+
+    //Output frames loop, results are checked in frame order
+    for( int job = 0; job < frames.size(); job++ )
+    {
+        uint32_t frame = frames.at( job );
+
+        //Wait for the frame, keep GUI alive
+        CdngExportJobs::JobState state;
+        while( ( state = dngJobs.waitResult( job, 50 ) ) == CdngExportJobs::Pending ) qApp->processEvents();
+
+        //Save cDNG frame failed?
+        if( state == CdngExportJobs::Failed )
         {
             m_pStatusDialog->close();
             qApp->processEvents();
             int ret = QMessageBox::critical( this,
                                              tr( "MLV App - Export file error" ),
-                                             tr( "Could not save: %1\nHow do you like to proceed?" ).arg( dngName ),
+                                             tr( "Could not save: %1\nHow do you like to proceed?" ).arg( dngNames.at( job ) ),
                                              tr( "Skip frame" ),
                                              tr( "Abort current export" ),
                                              tr( "Abort batch export" ),
@@ -2916,13 +2980,22 @@ void MainWindow::startExportCdng(QString fileName)
         qApp->processEvents();
 
         //Check diskspace
-        checkDiskFull( filePathNr );
+        checkDiskFull( filePaths.at( job ) );
         //Abort pressed? -> End the loop
         if( m_exportAbortPressed ) break;
     }
 
-    //Free DNG data struct
-    freeDngObject( cinemaDng );
+    //Stop workers, frames in work are finished
+    dngJobs.abort();
+    for( int i = 0; i < dngThreads.size(); i++ )
+    {
+        dngThreads.at(i)->wait();
+        delete dngThreads.at(i);
+    }
+
+    //Free DNG data structs
+    for( int i = 0; i < cinemaDngs.size(); i++ ) freeDngObject( cinemaDngs.at(i) );
+    core_budget_release( CORE_BUDGET_ENCODING, grantedCores );
 
     //Enable GUI drawing
     m_dontDraw = false;
@@ -2978,6 +3051,8 @@ void MainWindow::startExportMlv(QString fileName)
 #else
     int ret = saveMlvHeaders( m_pMlvObject, mlvOut, exportAudio, m_codecOption, m_exportQueue.first()->cutIn(), m_exportQueue.first()->cutOut(), VERSION.toLatin1().data(), errorMessage );
 #endif
+    //Compressed MLV in one slice per core only if the user asked for it, not all applications read them
+    setMlvLj92Slices( m_pMlvObject, ( ui->actionLosslessSlices->isChecked() ) ? QThread::idealThreadCount() : 1 );
     //Output frames loop
     for( uint32_t frame = m_exportQueue.first()->cutIn() - 1; frame < m_exportQueue.first()->cutOut(); frame++ )
     {
@@ -4344,6 +4419,7 @@ void MainWindow::deleteSession()
     //Set Labels black
     ui->labelScope->setScope( NULL, 0, 0, false, false, ScopesLabel::None );
     m_pGraphicsItem->setPixmap( QPixmap( ":/IMG/IMG/TransDummy.png" ) );
+    m_pGraphicsItem->setOffset( 0, 0 );
     m_pScene->setSceneRect( 0, 0, 10, 10 );
 
     //Fake no audio track
@@ -5276,6 +5352,92 @@ void MainWindow::paintAudioTrack( void )
     ui->labelAudioTrack->setMaximumHeight( 32 );
 }
 
+//Size of the picture in the viewer in zoom fit mode
+void MainWindow::getFitSize( int *desWidth, int *desHeight )
+{
+    int actWidth;
+    int actHeight;
+    if( ui->actionFullscreen->isChecked() )
+    {
+        actWidth = QApplication::primaryScreen()->size().width();
+        actHeight = QApplication::primaryScreen()->size().height();
+    }
+    else
+    {
+        actWidth = ui->graphicsView->width();
+        actHeight = ui->graphicsView->height();
+    }
+    *desWidth = actWidth;
+    *desHeight = actWidth * getMlvHeight(m_pMlvObject) / getMlvWidth(m_pMlvObject) * getVerticalStretchFactor(false) / getHorizontalStretchFactor(false);
+    if( *desHeight > actHeight )
+    {
+        *desHeight = actHeight;
+        *desWidth = actHeight * getMlvWidth(m_pMlvObject) / getMlvHeight(m_pMlvObject) / getVerticalStretchFactor(false) * getHorizontalStretchFactor(false);
+    }
+}
+
+//How much the frame can be reduced (1, 2 or 4) before processing, so it still has display resolution
+int MainWindow::getPreviewScale( void )
+{
+    if( !ui->actionPreviewDisplayResolution->isChecked() || !ui->actionZoomFit->isChecked() ) return 1;
+
+    int desWidth;
+    int desHeight;
+    getFitSize( &desWidth, &desHeight );
+
+    for( int scale = 4; scale > 1; scale /= 2 )
+    {
+        if( getMlvPreviewWidth(m_pMlvObject, scale) >= desWidth * devicePixelRatio()
+         && getMlvPreviewHeight(m_pMlvObject, scale) >= desHeight * devicePixelRatio() )
+        {
+            return scale;
+        }
+    }
+    return 1;
+}
+
+//Part of the frame visible in the viewer, in frame pixels
+QRect MainWindow::getVisibleFrameRect( void )
+{
+    QRectF visible = ui->graphicsView->mapToScene( ui->graphicsView->viewport()->rect() ).boundingRect();
+    return QRectF( visible.left() / getHorizontalStretchFactor(false),
+                   visible.top() / getVerticalStretchFactor(false),
+                   visible.width() / getHorizontalStretchFactor(false),
+                   visible.height() / getVerticalStretchFactor(false) ).toAlignedRect()
+            .intersected( QRect( 0, 0, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject) ) );
+}
+
+//Part of the frame which is processed when zoomed in: the visible part and some more for panning. Empty for the whole frame
+QRect MainWindow::getViewerRegion( void )
+{
+    if( !ui->actionProcessVisibleRegion->isChecked() || ui->actionZoomFit->isChecked() ) return QRect();
+
+    QRect visible = getVisibleFrameRect();
+    QRect region = visible.adjusted( -visible.width() / 4, -visible.height() / 4, visible.width() / 4, visible.height() / 4 )
+                          .intersected( QRect( 0, 0, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject) ) );
+
+    //Not worth it if most of the frame is needed anyway
+    if( region.isEmpty()
+     || (qint64)region.width() * region.height() * 4 >= (qint64)getMlvWidth(m_pMlvObject) * getMlvHeight(m_pMlvObject) * 3 )
+    {
+        return QRect();
+    }
+    return region;
+}
+
+//Viewer was zoomed or scrolled: render again if the visible part is not processed
+void MainWindow::viewerViewChanged( void )
+{
+    if( !m_fileLoaded || !ui->actionProcessVisibleRegion->isChecked() || ui->actionZoomFit->isChecked() ) return;
+
+    //Whole frame is rendered and still needed
+    if( m_viewerRegion.isEmpty() && getViewerRegion().isEmpty() ) return;
+    //Visible part is still inside of the rendered region
+    if( !m_viewerRegion.isEmpty() && m_viewerRegion.contains( getVisibleFrameRect() ) ) return;
+
+    m_frameChanged = true;
+}
+
 //Draw Zebras, return: 1=under, 2=over, 3=under+over, 0=okay
 uint8_t MainWindow::drawZebras()
 {
@@ -7778,6 +7940,8 @@ void MainWindow::pictureCustomContextMenuRequested(const QPoint &pos)
     myMenu.addSeparator();
     myMenu.addMenu( ui->menuDemosaicForPlayback );
     myMenu.addAction( ui->actionBetterResizer );
+    myMenu.addAction( ui->actionPreviewDisplayResolution );
+    myMenu.addAction( ui->actionProcessVisibleRegion );
     myMenu.addAction( ui->actionViewerBackgroundColor );
     myMenu.addSeparator();
     myMenu.addAction( ui->actionShowZebras );
@@ -8291,6 +8455,8 @@ void MainWindow::exportHandler( void )
         }
         m_pStatusDialog->setTotalFrames( totalFrames );
         m_pStatusDialog->startExportTime();
+        //Core usage of this export
+        core_budget_reset_usage();
     }
     //Are there jobs?
     if( !m_exportQueue.empty() )
@@ -8358,6 +8524,10 @@ void MainWindow::exportHandler( void )
         setEnabled( true );
         //Export is ready
         exportRunning = false;
+#ifndef STDOUT_SILENT
+        //Report core usage per subsystem (debug output)
+        core_budget_print_usage();
+#endif
 
         if( !m_exportAbortPressed )
         {
@@ -9206,85 +9376,81 @@ void MainWindow::drawFrameReady()
         mode = Qt::SmoothTransformation;
     }
 
+    //Size of the rendered frame, smaller than the clip if processed at display resolution or only a region
+    int imgWidth = getMlvPreviewWidth(m_pMlvObject, m_previewScale);
+    int imgHeight = getMlvPreviewHeight(m_pMlvObject, m_previewScale);
+    if( !m_viewerRegion.isEmpty() )
+    {
+        imgWidth = m_viewerRegion.width();
+        imgHeight = m_viewerRegion.height();
+    }
+    QImage image( ( unsigned char *) m_pRawImage, imgWidth, imgHeight, imgWidth * 3, QImage::Format_RGB888 );
+
     if( ui->actionZoomFit->isChecked() )
     {
         //Some math to have the picture exactly in the frame
-        int actWidth;
-        int actHeight;
-        if( ui->actionFullscreen->isChecked() )
-        {
-            actWidth = QApplication::primaryScreen()->size().width();
-            actHeight = QApplication::primaryScreen()->size().height();
-        }
-        else
-        {
-            actWidth = ui->graphicsView->width();
-            actHeight = ui->graphicsView->height();
-        }
-        int desWidth = actWidth;
-        int desHeight = actWidth * getMlvHeight(m_pMlvObject) / getMlvWidth(m_pMlvObject) * getVerticalStretchFactor(false) / getHorizontalStretchFactor(false);
-        if( desHeight > actHeight )
-        {
-            desHeight = actHeight;
-            desWidth = actHeight * getMlvWidth(m_pMlvObject) / getMlvHeight(m_pMlvObject) / getVerticalStretchFactor(false) * getHorizontalStretchFactor(false);
-        }
+        int desWidth;
+        int desHeight;
+        getFitSize( &desWidth, &desHeight );
 
         //Get Picture
-
-
-        QPixmap pic = QPixmap::fromImage( QImage( ( unsigned char *) m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), QImage::Format_RGB888 )
-                                          .scaled( desWidth * devicePixelRatio(),
-                                                   desHeight * devicePixelRatio(),
-                                                   Qt::IgnoreAspectRatio, mode) );
+        QPixmap pic = QPixmap::fromImage( image.scaled( desWidth * devicePixelRatio(),
+                                                        desHeight * devicePixelRatio(),
+                                                        Qt::IgnoreAspectRatio, mode) );
         //Set Picture to Retina
         pic.setDevicePixelRatio( devicePixelRatio() );
         //Bring frame to GUI (fit to window)
         m_pGraphicsItem->setPixmap( pic );
+        m_pGraphicsItem->setOffset( 0, 0 );
         //Set Scene
         m_pScene->setSceneRect( 0, 0, desWidth, desHeight );
     }
     else
     {
+        //Region is placed where it is in the frame
+        m_pGraphicsItem->setOffset( m_viewerRegion.x() * getHorizontalStretchFactor(false),
+                                    m_viewerRegion.y() * getVerticalStretchFactor(false) );
+
         //Bring frame to GUI (100%)
         if( getVerticalStretchFactor(false) == 1.0
          && getHorizontalStretchFactor(false) == 1.0 ) //Fast mode for 1.0 stretch factor
         {
-            m_pGraphicsItem->setPixmap( QPixmap::fromImage( QImage( ( unsigned char *) m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), QImage::Format_RGB888 ) ) );
+            m_pGraphicsItem->setPixmap( QPixmap::fromImage( image ) );
             m_pScene->setSceneRect( 0, 0, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject) );
         }
         else
         {
             QPixmap pixmap;
+            int stretchedWidth = imgWidth * getHorizontalStretchFactor(false);
+            int stretchedHeight = imgHeight * getVerticalStretchFactor(false);
             //Qvir resize
             if( mode == Qt::SmoothTransformation && ui->actionBetterResizer->isChecked() )
             {
-                uint8_t *scaledPic = (uint8_t*)malloc( 3 * getMlvWidth(m_pMlvObject) * getHorizontalStretchFactor(false)
-                                                         * getMlvHeight(m_pMlvObject) * getVerticalStretchFactor(false)
-                                                         * sizeof( uint8_t ) );
+                uint8_t *scaledPic = (uint8_t*)malloc( 3 * stretchedWidth * stretchedHeight * sizeof( uint8_t ) );
                 avir_scale_thread_pool scaling_pool;
                 avir::CImageResizerVars vars; vars.ThreadPool = &scaling_pool;
                 avir::CImageResizerParamsUltra roptions;
                 avir::CImageResizer<> image_resizer( 8, 0, roptions );
                 image_resizer.resizeImage( m_pRawImage,
-                                           getMlvWidth(m_pMlvObject),
-                                           getMlvHeight(m_pMlvObject), 0,
+                                           imgWidth,
+                                           imgHeight, 0,
                                            scaledPic,
-                                           getMlvWidth(m_pMlvObject) * getHorizontalStretchFactor(false),
-                                           getMlvHeight(m_pMlvObject) * getVerticalStretchFactor(false),
+                                           stretchedWidth,
+                                           stretchedHeight,
                                            3, 0, &vars );
                 pixmap = QPixmap::fromImage( QImage( ( unsigned char *) scaledPic,
-                                                     getMlvWidth(m_pMlvObject) * getHorizontalStretchFactor(false),
-                                                     getMlvHeight(m_pMlvObject) * getVerticalStretchFactor(false),
+                                                     stretchedWidth,
+                                                     stretchedHeight,
+                                                     stretchedWidth * 3,
                                                      QImage::Format_RGB888 ) );
                 free( scaledPic );
             }
             //Qt resize
             else
             {
-                pixmap = QPixmap::fromImage( QImage( ( unsigned char *) m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), QImage::Format_RGB888 )
-                                             .scaled( getMlvWidth(m_pMlvObject) * getHorizontalStretchFactor(false),
-                                                      getMlvHeight(m_pMlvObject) * getVerticalStretchFactor(false),
-                                                      Qt::IgnoreAspectRatio, mode) );
+                pixmap = QPixmap::fromImage( image.scaled( stretchedWidth,
+                                                           stretchedHeight,
+                                                           Qt::IgnoreAspectRatio, mode) );
             }
             m_pGraphicsItem->setPixmap( pixmap );
             m_pScene->setSceneRect( 0, 0, getMlvWidth(m_pMlvObject) * getHorizontalStretchFactor(false), getMlvHeight(m_pMlvObject) * getVerticalStretchFactor(false) );
@@ -9305,22 +9471,22 @@ void MainWindow::drawFrameReady()
         //GetHistogram
         if( ui->actionShowHistogram->isChecked() )
         {
-            ui->labelScope->setScope( m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), under, over, ScopesLabel::ScopeHistogram );
+            ui->labelScope->setScope( m_pRawImage, imgWidth, imgHeight, under, over, ScopesLabel::ScopeHistogram );
         }
         //Waveform
         else if( ui->actionShowWaveFormMonitor->isChecked() )
         {
-            ui->labelScope->setScope( m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), under, over, ScopesLabel::ScopeWaveForm );
+            ui->labelScope->setScope( m_pRawImage, imgWidth, imgHeight, under, over, ScopesLabel::ScopeWaveForm );
         }
         //Parade
         else if( ui->actionShowParade->isChecked() )
         {
-            ui->labelScope->setScope( m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), under, over, ScopesLabel::ScopeRgbParade);
+            ui->labelScope->setScope( m_pRawImage, imgWidth, imgHeight, under, over, ScopesLabel::ScopeRgbParade);
         }
         //VectorScope
         else if( ui->actionShowVectorScope->isChecked() )
         {
-            ui->labelScope->setScope( m_pRawImage, getMlvWidth(m_pMlvObject), getMlvHeight(m_pMlvObject), under, over, ScopesLabel::ScopeVectorScope );
+            ui->labelScope->setScope( m_pRawImage, imgWidth, imgHeight, under, over, ScopesLabel::ScopeVectorScope );
         }
     }
     
@@ -10361,19 +10527,25 @@ void MainWindow::selectDebayerAlgorithm()
         if( ui->actionUseNoneDebayer->isChecked() )
         {
             setMlvUseNoneDebayer( m_pMlvObject );
-            disableMlvCaching( m_pMlvObject );
+            //Fast debayers: cache bayer frames, debayer them when shown (compressed if the clip doesn't fit)
+            setMlvCacheMode( m_pMlvObject, getMlvBayerCacheMode( m_pMlvObject ) );
+            enableMlvCaching( m_pMlvObject );
             m_pChosenDebayer->setText( tr( "None" ) );
         }
         else if( ui->actionUseSimpleDebayer->isChecked() )
         {
             setMlvUseSimpleDebayer( m_pMlvObject );
-            disableMlvCaching( m_pMlvObject );
+            //Fast debayers: cache bayer frames, debayer them when shown (compressed if the clip doesn't fit)
+            setMlvCacheMode( m_pMlvObject, getMlvBayerCacheMode( m_pMlvObject ) );
+            enableMlvCaching( m_pMlvObject );
             m_pChosenDebayer->setText( tr( "Simple" ) );
         }
         else if( ui->actionUseBilinear->isChecked() )
         {
             setMlvDontAlwaysUseAmaze( m_pMlvObject );
-            disableMlvCaching( m_pMlvObject );
+            //Fast debayers: cache bayer frames, debayer them when shown (compressed if the clip doesn't fit)
+            setMlvCacheMode( m_pMlvObject, getMlvBayerCacheMode( m_pMlvObject ) );
+            enableMlvCaching( m_pMlvObject );
             m_pChosenDebayer->setText( tr( "Bilinear" ) );
         }
         else if( ui->actionUseLmmseDebayer->isChecked() )
@@ -10415,6 +10587,7 @@ void MainWindow::selectDebayerAlgorithm()
         else if( ui->actionCaching->isChecked() )
         {
             setMlvAlwaysUseAmaze( m_pMlvObject );
+            setMlvCacheMode( m_pMlvObject, MLV_CACHE_RGB16 );
             enableMlvCaching( m_pMlvObject );
             m_pChosenDebayer->setText( tr( "AMaZE" ) );
         }
@@ -10433,6 +10606,18 @@ void MainWindow::on_actionBetterResizer_triggered()
     m_frameChanged = true;
 }
 
+//Enable/Disable processing at display resolution in viewer
+void MainWindow::on_actionPreviewDisplayResolution_triggered()
+{
+    m_frameChanged = true;
+}
+
+//Enable/Disable processing of the visible region only in zoomed viewer
+void MainWindow::on_actionProcessVisibleRegion_triggered()
+{
+    m_frameChanged = true;
+}
+
 //Show a list of installed fpm files
 void MainWindow::on_actionShowInstalledFocusPixelMaps_triggered()
 {
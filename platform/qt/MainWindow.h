@@ -217,6 +217,8 @@ private slots:
     void on_actionHelp_triggered();
     void on_actionCreateAllMappFilesNow_triggered();
     void on_actionBetterResizer_triggered();
+    void on_actionPreviewDisplayResolution_triggered();
+    void on_actionProcessVisibleRegion_triggered();
     void on_actionShowInstalledFocusPixelMaps_triggered();
     void on_actionShowInstalledBadPixelMaps_triggered();
     void on_actionViewerBackgroundColor_triggered();
@@ -344,6 +346,7 @@ private slots:
     void on_groupBoxTransformation_toggled(bool arg1);
     void exportAbort( void );
     void drawFrameReady( void );
+    void viewerViewChanged( void );
 
     void on_toolButtonGradientPaint_toggled(bool checked);
     void on_checkBoxGradientEnable_toggled(bool checked);
@@ -450,6 +453,8 @@ private:
     double m_newPosDropMode;
     bool m_dontDraw;
     bool m_frameStillDrawing;
+    int m_previewScale;
+    QRect m_viewerRegion;
     bool m_fileLoaded;
     bool m_inOpeningProcess;
     bool m_setSliders;
@@ -518,6 +523,10 @@ private:
     double getFramerate( void );
     void paintAudioTrack( void );
     uint8_t drawZebras( void );
+    void getFitSize( int *desWidth, int *desHeight );
+    int getPreviewScale( void );
+    QRect getVisibleFrameRect( void );
+    QRect getViewerRegion( void );
     void drawFrameNumberLabel( void );
     void setToolButtonFocusPixels( int index );
     void setToolButtonFocusPixelsIntMethod( int index );
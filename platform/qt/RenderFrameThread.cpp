@@ -15,6 +15,7 @@ RenderFrameThread::RenderFrameThread()
     m_initialized = false;
     m_renderFrame = false;
     m_frameReady = false;
+    m_previewScale = 1;
 }
 
 //Destructor
@@ -34,10 +35,12 @@ void RenderFrameThread::init(mlvObject_t *pMlvObject, uint8_t *pRawImage)
 }
 
 //Start rendering
-void RenderFrameThread::renderFrame(uint32_t frameNumber)
+void RenderFrameThread::renderFrame(uint32_t frameNumber, int previewScale, QRect region)
 {
     m_mutex.lock();
     m_frameNumber = frameNumber;
+    m_previewScale = previewScale;
+    m_region = region;
     m_renderFrame = true;
     m_frameReady = false;
     m_mutex.unlock();
@@ -93,7 +96,16 @@ void RenderFrameThread::run(void)
 //render the picture
 void RenderFrameThread::drawFrame()
 {
-    //Get frame from library
-    getMlvProcessedFrame8( m_pMlvObject, m_frameNumber, m_pRawImage, QThread::idealThreadCount() );
+    //Get frame from library, only the region if zoomed in, reduced if the viewer shows it smaller anyway
+    if( !m_region.isEmpty() )
+    {
+        getMlvProcessedRegionFrame8( m_pMlvObject, m_frameNumber,
+                                     m_region.x(), m_region.y(), m_region.width(), m_region.height(),
+                                     m_pRawImage, QThread::idealThreadCount() );
+    }
+    else
+    {
+        getMlvProcessedPreviewFrame8( m_pMlvObject, m_frameNumber, m_previewScale, m_pRawImage, QThread::idealThreadCount() );
+    }
     emit frameReady();
 }
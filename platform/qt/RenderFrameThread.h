@@ -10,6 +10,7 @@
 
 #include <QThread>
 #include <QMutex>
+#include <QRect>
 #include "../../src/mlv_include.h"
 
 class RenderFrameThread : public QThread
@@ -21,7 +22,7 @@ public:
     ~RenderFrameThread();
     void init( mlvObject_t *pMlvObject,
           uint8_t *pRawImage );
-    void renderFrame( uint32_t frameNumber );
+    void renderFrame( uint32_t frameNumber, int previewScale = 1, QRect region = QRect() );
     bool isFrameReady( void );
     bool isIdle( void );
     void stop( void );
@@ -40,6 +41,8 @@ private:
     bool m_renderFrame;
     bool m_frameReady;
     uint32_t m_frameNumber;
+    int m_previewScale;
+    QRect m_region;
 
     void run( void );
     void drawFrame( void );
@@ -3,14 +3,39 @@
 
 #include "ThreadPool.h"
 #include "avir.h"
+#include "../../../src/mlv_include.h"
 
 using thread_pool_base = ThreadPool;
 class avir_scale_thread_pool : public avir::CImageResizerThreadPool, public thread_pool_base
 {
 public:
+    //Scaling runs as many workloads at once as the core budget allows
+    avir_scale_thread_pool( bool acquire = true ) : _granted( 0 )
+    {
+        if( acquire ) acquireBudget();
+    }
+
+    virtual ~avir_scale_thread_pool()
+    {
+        releaseBudget();
+    }
+
+    //Long living pools hold the cores only while they scale
+    void acquireBudget()
+    {
+        releaseBudget();
+        _granted = core_budget_acquire( CORE_BUDGET_SCALING, (int)thread_pool_base::size() );
+    }
+
+    void releaseBudget()
+    {
+        core_budget_release( CORE_BUDGET_SCALING, _granted );
+        _granted = 0;
+    }
+
     virtual int getSuggestedWorkloadCount() const override
     {
-        return thread_pool_base::size();
+        return ( _granted > 1 ) ? _granted : 1;
     }
 
     virtual void addWorkload(CWorkload *const workload) override
@@ -35,6 +60,7 @@ public:
     }
 
 private:
+    int _granted;
     std::deque<std::future<void>> _tasks;
     std::deque<CWorkload*> _workloads;
 };
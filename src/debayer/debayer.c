@@ -16,9 +16,23 @@ void convert_to_log(void * data)
     // float
 }
 
+/* Pool job, one chunk each */
+static void amaze_chunk_job(void * arg, int chunk)
+{
+    demosaic(((amazeinfo_t *)arg) + chunk);
+}
+
 /* AmAZeMEmE debayer easier to use */
 void debayerAmaze(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int blacklevel)
 {
+    debayerAmazePool(debayerto, bayerdata, width, height, threads, blacklevel, NULL);
+}
+
+void debayerAmazePool(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int blacklevel, processing_pool_t * pool)
+{
+    /* Not more chunks than workers */
+    if (pool && threads > processing_pool_threads(pool)) threads = processing_pool_threads(pool);
+
     int pixelsize = width * height;
 
     /* AmAZeMEmE wants an image as floating points and 2d arrey as well */
@@ -99,14 +113,25 @@ void debayerAmaze(uint16_t * __restrict debayerto, float * __restrict bayerdata,
                 0,
                 blacklevel };
 
-            /* Create pthread! */
-            pthread_create( &thread_id[thread], NULL, (void *)&demosaic, (void *)&amaze_arguments[thread] );
         }
 
-        /* let all threads finish */
-        for (int thread = 0; thread < threads; ++thread)
+        if (pool)
         {
-            pthread_join( thread_id[thread], NULL );
+            processing_pool_run(pool, threads, threads, amaze_chunk_job, amaze_arguments);
+        }
+        else
+        {
+            /* Create pthreads! */
+            for (int thread = 0; thread < threads; ++thread)
+            {
+                pthread_create( &thread_id[thread], NULL, (void *)&demosaic, (void *)&amaze_arguments[thread] );
+            }
+
+            /* let all threads finish */
+            for (int thread = 0; thread < threads; ++thread)
+            {
+                pthread_join( thread_id[thread], NULL );
+            }
         }
 
     }
@@ -322,8 +347,27 @@ void debayerNoneThread( easydebayerinfo_t * data )
 }
 
 /* easy debayer types, threaded */
+/* Pool jobs, one chunk each */
+static void easy_chunk_job(void * arg, int chunk)
+{
+    debayerSimpleThread(((easydebayerinfo_t *)arg) + chunk);
+}
+
+static void none_chunk_job(void * arg, int chunk)
+{
+    debayerNoneThread(((easydebayerinfo_t *)arg) + chunk);
+}
+
 void debayerEasy(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int type)
 {
+    debayerEasyPool(debayerto, bayerdata, width, height, threads, type, NULL);
+}
+
+void debayerEasyPool(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int type, processing_pool_t * pool)
+{
+    /* Not more chunks than workers */
+    if (pool && threads > processing_pool_threads(pool)) threads = processing_pool_threads(pool);
+
     /* If threads is < 2 just do it normal */
     if (threads < 2)
     {
@@ -365,15 +409,26 @@ void debayerEasy(uint16_t * __restrict debayerto, float * __restrict bayerdata,
                 endchunk_y[thread],
                 startchunk_y[thread] };
 
-            /* Create pthread! */
-            if( type == 2 ) pthread_create( &thread_id[thread], NULL, (void *)&debayerNoneThread, (void *)&none_arguments[thread] );
-            else pthread_create( &thread_id[thread], NULL, (void *)&debayerSimpleThread, (void *)&none_arguments[thread] );
         }
 
-        /* let all threads finish */
-        for (int thread = 0; thread < threads; ++thread)
+        if (pool)
         {
-            pthread_join( thread_id[thread], NULL );
+            processing_pool_run(pool, threads, threads, (type == 2) ? none_chunk_job : easy_chunk_job, none_arguments);
+        }
+        else
+        {
+            /* Create pthreads! */
+            for (int thread = 0; thread < threads; ++thread)
+            {
+                if( type == 2 ) pthread_create( &thread_id[thread], NULL, (void *)&debayerNoneThread, (void *)&none_arguments[thread] );
+                else pthread_create( &thread_id[thread], NULL, (void *)&debayerSimpleThread, (void *)&none_arguments[thread] );
+            }
+
+            /* let all threads finish */
+            for (int thread = 0; thread < threads; ++thread)
+            {
+                pthread_join( thread_id[thread], NULL );
+            }
         }
     }
 }
@@ -429,3 +484,68 @@ void debayerLibRtProcess(uint16_t *debayerto, float *bayerdata, int width, int h
     free(blue2d);
     free(imagefloat2d);
 }
+
+/* Reduced size debayer for preview: each scale x scale block of the RGGB frame
+ * is binned to one RGB pixel, output is (width / scale) x (height / scale) */
+void debayerBinned(uint16_t * __restrict debayerto, uint16_t * __restrict bayerdata, int width, int height, int scale, int shift)
+{
+    int outW = width / scale;
+    int outH = height / scale;
+    int cells = scale / 2;
+    /* Sums of cells * cells bayer cells, green has two per cell */
+    int div = cells * cells;
+
+    #pragma omp parallel for
+    for (int y = 0; y < outH; ++y)
+    {
+        uint16_t * out = debayerto + y * outW * 3;
+        for (int x = 0; x < outW; ++x)
+        {
+            uint32_t r = 0, g = 0, b = 0;
+            for (int cy = 0; cy < cells; ++cy)
+            {
+                uint16_t * row = bayerdata + (y * scale + cy * 2) * width + x * scale;
+                for (int cx = 0; cx < cells * 2; cx += 2)
+                {
+                    r += row[cx];
+                    g += row[cx + 1] + row[cx + width];
+                    b += row[cx + width + 1];
+                }
+            }
+            out[x*3  ] = LIMIT16((r << shift) / div);
+            out[x*3+1] = LIMIT16((g << shift) / (div * 2));
+            out[x*3+2] = LIMIT16((b << shift) / div);
+        }
+    }
+}
+
+/* Box filters an RGB frame down by scale, output is (width / scale) x (height / scale) */
+void downscaleRgbBox(uint16_t * __restrict output, uint16_t * __restrict input, int width, int height, int scale)
+{
+    int outW = width / scale;
+    int outH = height / scale;
+    int div = scale * scale;
+
+    #pragma omp parallel for
+    for (int y = 0; y < outH; ++y)
+    {
+        uint16_t * out = output + y * outW * 3;
+        for (int x = 0; x < outW; ++x)
+        {
+            uint32_t sum[3] = { 0, 0, 0 };
+            for (int sy = 0; sy < scale; ++sy)
+            {
+                uint16_t * in = input + ((y * scale + sy) * width + x * scale) * 3;
+                for (int sx = 0; sx < scale * 3; sx += 3)
+                {
+                    sum[0] += in[sx];
+                    sum[1] += in[sx + 1];
+                    sum[2] += in[sx + 2];
+                }
+            }
+            out[x*3  ] = sum[0] / div;
+            out[x*3+1] = sum[1] / div;
+            out[x*3+2] = sum[2] / div;
+        }
+    }
+}
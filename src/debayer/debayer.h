@@ -2,6 +2,7 @@
 #define _debayer_
 
 #include <stdint.h>
+#include "../processing/processing_pool.h"
 
 /* Easy debayer types */
 void debayerEasy(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int type);
@@ -9,10 +10,17 @@ void debayerEasy(uint16_t * __restrict debayerto, float * __restrict bayerdata,
 void debayerBasic(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads);
 /* More useable amaze, threads number should be the number of cores(or threads if >= i7) your cpu has */
 void debayerAmaze(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int blacklevel);
+/* Same as debayerEasy/debayerAmaze, but the chunks run on a shared worker pool instead of own threads (pool may be NULL) */
+void debayerEasyPool(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int type, processing_pool_t * pool);
+void debayerAmazePool(uint16_t * __restrict debayerto, float * __restrict bayerdata, int width, int height, int threads, int blacklevel, processing_pool_t * pool);
 /* via librtprocess */
 void debayerLibRtProcess(uint16_t *__restrict debayerto, float *__restrict bayerdata, int width, int height, int algorithm, double camMatrix[9]);
 /* AHD debayer */
 void debayerAhd(uint16_t *__restrict debayerto, float *__restrict bayerdata, int width, int height);
+/* Preview at 1/scale size (scale 2 or 4): bins RGGB blocks from uint16 bayer data, shifted left by shift */
+void debayerBinned(uint16_t * __restrict debayerto, uint16_t * __restrict bayerdata, int width, int height, int scale, int shift);
+/* Box filters an already debayered frame down to 1/scale size */
+void downscaleRgbBox(uint16_t * __restrict output, uint16_t * __restrict input, int width, int height, int scale);
 
 /* None debayer structure for multithread */
 typedef struct {
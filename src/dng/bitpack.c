@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2014 David Milligan
+ *
+ * Updated and modified by bouncyball (2016-2017)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/* Raw bit packing and unpacking, split from dng.c so it builds without the rest of the app */
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BITPACK_AVX2
+#endif
+#endif
+
+#include "dng.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#define ROR32(v,a) ((v) >> (a) | (v) << (32-(a)))
+#define ROL32(v,a) ((v) << (a) | (v) >> (32-(a)))
+#define ROL16(v,a) ((v) << (a) | (v) >> (16-(a)))
+
+/* unpacks pixels first..pixel_count-1 (at most 16, first * bpp a multiple of 16) through
+   a zero padded copy, the 32 bit fetches must not read past the end of the packed image,
+   which may be a memory mapped file */
+static void unpack_tail_bits(uint16_t * output_buffer, uint16_t * input_buffer, uint32_t first, uint32_t pixel_count, uint32_t bpp)
+{
+    uint16_t tail[18] = { 0 };
+    uint64_t tail_start = (uint64_t)first * bpp / 8;
+    memcpy(tail, (uint8_t *)input_buffer + tail_start, ((uint64_t)pixel_count * bpp + 15) / 16 * 2 - tail_start);
+
+    uint32_t mask = (1 << bpp) - 1;
+    for (uint32_t pixel_index = first; pixel_index < pixel_count; pixel_index++)
+    {
+        uint32_t bits_offset = (pixel_index - first) * bpp;
+        uint32_t rotate_value = 16 + ((32 - bpp) - bits_offset % 16);
+        uint32_t uncorrected_data;
+        memcpy(&uncorrected_data, &tail[bits_offset / 16], 4);
+        output_buffer[pixel_index] = (uint16_t)(ROR32(uncorrected_data, rotate_value) & mask);
+    }
+}
+
+#ifdef __SSSE3__
+/* 10/12/14 bit raw: 8 pixels always fill bpp/2 whole 16 bit words, so the image
+   is packed and unpacked in independent groups of 8 pixels by shuffle + shift */
+#define BITPACK_BLOCK 1024 /* groups per parallel block */
+
+typedef struct
+{
+    __m128i unpack_shuf_a; /* word holding the pixel start */
+    __m128i unpack_shuf_b; /* word after it */
+    __m128i unpack_mul;    /* 1 << bit offset of the pixel in its word */
+    __m128i pack_shuf[3];  /* up to 3 pixels touch one packed word */
+    __m128i pack_mul_lo[3];
+    __m128i pack_mul_hi[3];
+    __m128i pack_swap;     /* byte order of packed words */
+    __m128i mask;
+    __m128i shift;
+} bitpack_t;
+
+static void bitpack_setup(bitpack_t * bp, uint32_t bpp, int big_endian)
+{
+    uint8_t shuf_a[16], shuf_b[16], pack_shuf[3][16], swap[16];
+    uint16_t mul[8], mul_lo[3][8], mul_hi[3][8];
+    memset(pack_shuf, 0x80, sizeof(pack_shuf));
+    memset(mul_lo, 0, sizeof(mul_lo));
+    memset(mul_hi, 0, sizeof(mul_hi));
+
+    for (int i = 0; i < 8; i++)
+    {
+        int word = (i * bpp) / 16;
+        shuf_a[2 * i] = 2 * word;
+        shuf_a[2 * i + 1] = 2 * word + 1;
+        shuf_b[2 * i] = 2 * word + 2;
+        shuf_b[2 * i + 1] = 2 * word + 3;
+        mul[i] = 1 << ((i * bpp) % 16);
+    }
+
+    /* packed word j gets every pixel overlapping it, shifted left (mullo)
+       or right (mulhi) so that the pixel end lands on its bit position */
+    for (int j = 0; j < (int)bpp / 2; j++)
+    {
+        int term = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            if (i * (int)bpp >= 16 * (j + 1) || (i + 1) * (int)bpp <= 16 * j) continue;
+            int shift = 16 * (j + 1) - (i + 1) * bpp;
+            pack_shuf[term][2 * j] = 2 * i;
+            pack_shuf[term][2 * j + 1] = 2 * i + 1;
+            if (shift >= 0) mul_lo[term][j] = 1 << shift;
+            else mul_hi[term][j] = 1 << (16 + shift);
+            term++;
+        }
+    }
+
+    for (int i = 0; i < 16; i++) swap[i] = (big_endian) ? i ^ 1 : i;
+
+    bp->unpack_shuf_a = _mm_loadu_si128((__m128i *)shuf_a);
+    bp->unpack_shuf_b = _mm_loadu_si128((__m128i *)shuf_b);
+    bp->unpack_mul = _mm_loadu_si128((__m128i *)mul);
+    for (int t = 0; t < 3; t++)
+    {
+        bp->pack_shuf[t] = _mm_loadu_si128((__m128i *)pack_shuf[t]);
+        bp->pack_mul_lo[t] = _mm_loadu_si128((__m128i *)mul_lo[t]);
+        bp->pack_mul_hi[t] = _mm_loadu_si128((__m128i *)mul_hi[t]);
+    }
+    bp->pack_swap = _mm_loadu_si128((__m128i *)swap);
+    bp->mask = _mm_set1_epi16((1 << bpp) - 1);
+    bp->shift = _mm_cvtsi32_si128(16 - bpp);
+}
+
+/* 8 pixels from 16 bytes starting at the group */
+static inline __m128i unpack_group(const bitpack_t * bp, const uint8_t * input)
+{
+    __m128i data = _mm_loadu_si128((const __m128i *)input);
+    __m128i hi = _mm_mullo_epi16(_mm_shuffle_epi8(data, bp->unpack_shuf_a), bp->unpack_mul);
+    __m128i lo = _mm_mulhi_epu16(_mm_shuffle_epi8(data, bp->unpack_shuf_b), bp->unpack_mul);
+    return _mm_srl_epi16(_mm_or_si128(hi, lo), bp->shift);
+}
+
+/* 8 pixels to bpp bytes, the upper 16 - bpp bytes of the result are garbage */
+static inline __m128i pack_group(const bitpack_t * bp, const uint16_t * input)
+{
+    __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i *)input), bp->mask);
+    __m128i result = _mm_setzero_si128();
+    for (int t = 0; t < 3; t++)
+    {
+        __m128i p = _mm_shuffle_epi8(pixels, bp->pack_shuf[t]);
+        result = _mm_or_si128(result, _mm_mullo_epi16(p, bp->pack_mul_lo[t]));
+        result = _mm_or_si128(result, _mm_mulhi_epu16(p, bp->pack_mul_hi[t]));
+    }
+    return _mm_shuffle_epi8(result, bp->pack_swap);
+}
+
+static void unpack_groups_ssse3(const bitpack_t * bp, const uint8_t * input, uint16_t * output, uint32_t groups, uint32_t bpp)
+{
+    for (uint32_t g = 0; g < groups; g++, input += bpp, output += 8)
+    {
+        _mm_storeu_si128((__m128i *)output, unpack_group(bp, input));
+    }
+}
+
+/* every group but the last is stored with 16 bytes, the next group overwrites the garbage */
+static void pack_groups_ssse3(const bitpack_t * bp, const uint16_t * input, uint8_t * output, uint32_t groups, uint32_t bpp)
+{
+    if (!groups) return;
+    for (uint32_t g = 0; g < groups - 1; g++, input += 8, output += bpp)
+    {
+        _mm_storeu_si128((__m128i *)output, pack_group(bp, input));
+    }
+    uint8_t last[16];
+    _mm_storeu_si128((__m128i *)last, pack_group(bp, input));
+    memcpy(output, last, bpp);
+}
+
+#ifdef BITPACK_AVX2
+/* same as above, two groups at once, one in each 128 bit lane */
+__attribute__((target("avx2")))
+static void unpack_groups_avx2(const bitpack_t * bp, const uint8_t * input, uint16_t * output, uint32_t groups, uint32_t bpp)
+{
+    __m256i shuf_a = _mm256_broadcastsi128_si256(bp->unpack_shuf_a);
+    __m256i shuf_b = _mm256_broadcastsi128_si256(bp->unpack_shuf_b);
+    __m256i mul = _mm256_broadcastsi128_si256(bp->unpack_mul);
+    uint32_t g = 0;
+    for (; g + 2 <= groups; g += 2, input += 2 * bpp, output += 16)
+    {
+        __m256i data = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)input)),
+                                               _mm_loadu_si128((const __m128i *)(input + bpp)), 1);
+        __m256i hi = _mm256_mullo_epi16(_mm256_shuffle_epi8(data, shuf_a), mul);
+        __m256i lo = _mm256_mulhi_epu16(_mm256_shuffle_epi8(data, shuf_b), mul);
+        _mm256_storeu_si256((__m256i *)output, _mm256_srl_epi16(_mm256_or_si256(hi, lo), bp->shift));
+    }
+    if (g < groups) _mm_storeu_si128((__m128i *)output, unpack_group(bp, input));
+}
+
+__attribute__((target("avx2")))
+static void pack_groups_avx2(const bitpack_t * bp, const uint16_t * input, uint8_t * output, uint32_t groups, uint32_t bpp)
+{
+    __m256i shuf[3], mul_lo[3], mul_hi[3];
+    for (int t = 0; t < 3; t++)
+    {
+        shuf[t] = _mm256_broadcastsi128_si256(bp->pack_shuf[t]);
+        mul_lo[t] = _mm256_broadcastsi128_si256(bp->pack_mul_lo[t]);
+        mul_hi[t] = _mm256_broadcastsi128_si256(bp->pack_mul_hi[t]);
+    }
+    __m256i swap = _mm256_broadcastsi128_si256(bp->pack_swap);
+    __m256i mask = _mm256_broadcastsi128_si256(bp->mask);
+    uint32_t g = 0;
+    /* keep at least one group for the exact sized store */
+    for (; g + 2 < groups; g += 2, input += 16, output += 2 * bpp)
+    {
+        __m256i pixels = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)input), mask);
+        __m256i result = _mm256_setzero_si256();
+        for (int t = 0; t < 3; t++)
+        {
+            __m256i p = _mm256_shuffle_epi8(pixels, shuf[t]);
+            result = _mm256_or_si256(result, _mm256_mullo_epi16(p, mul_lo[t]));
+            result = _mm256_or_si256(result, _mm256_mulhi_epu16(p, mul_hi[t]));
+        }
+        result = _mm256_shuffle_epi8(result, swap);
+        _mm_storeu_si128((__m128i *)output, _mm256_castsi256_si128(result));
+        _mm_storeu_si128((__m128i *)(output + bpp), _mm256_extracti128_si256(result, 1));
+    }
+    pack_groups_ssse3(bp, input, output, groups - g, bpp);
+}
+
+static int cpu_has_avx2(void)
+{
+    static int avx2 = -1;
+    if (avx2 < 0) avx2 = (__builtin_cpu_supports("avx2")) ? 1 : 0;
+    return avx2;
+}
+#endif
+
+static void unpack_image_bits_simd(uint16_t * output_buffer, uint16_t * input_buffer, uint32_t pixel_count, uint32_t bpp)
+{
+    bitpack_t bp;
+    bitpack_setup(&bp, bpp, 0);
+
+    void (*unpack_groups)(const bitpack_t *, const uint8_t *, uint16_t *, uint32_t, uint32_t) = unpack_groups_ssse3;
+#ifdef BITPACK_AVX2
+    if (cpu_has_avx2()) unpack_groups = unpack_groups_avx2;
+#endif
+
+    /* a group reads 16 bytes, never read past the packed image */
+    uint64_t packed_size = (uint64_t)pixel_count * bpp / 8;
+    uint32_t groups = (packed_size < 16) ? 0 : (packed_size - 16) / bpp + 1;
+    int blocks = (groups + BITPACK_BLOCK - 1) / BITPACK_BLOCK;
+
+    #pragma omp parallel for
+    for (int block = 0; block < blocks; block++)
+    {
+        uint32_t first = block * BITPACK_BLOCK;
+        uint32_t count = MIN(BITPACK_BLOCK, groups - first);
+        unpack_groups(&bp, (uint8_t *)input_buffer + (uint64_t)first * bpp, output_buffer + (uint64_t)first * 8, count, bpp);
+    }
+
+    unpack_tail_bits(output_buffer, input_buffer, groups * 8, pixel_count, bpp);
+}
+
+static void pack_image_bits_simd(uint16_t * output_buffer, uint16_t * input_buffer, uint32_t pixel_count, uint32_t bpp, int big_endian)
+{
+    bitpack_t bp;
+    bitpack_setup(&bp, bpp, big_endian);
+
+    void (*pack_groups)(const bitpack_t *, const uint16_t *, uint8_t *, uint32_t, uint32_t) = pack_groups_ssse3;
+#ifdef BITPACK_AVX2
+    if (cpu_has_avx2()) pack_groups = pack_groups_avx2;
+#endif
+
+    uint32_t groups = pixel_count / 8;
+    int blocks = (groups + BITPACK_BLOCK - 1) / BITPACK_BLOCK;
+
+    #pragma omp parallel for
+    for (int block = 0; block < blocks; block++)
+    {
+        uint32_t first = block * BITPACK_BLOCK;
+        uint32_t count = MIN(BITPACK_BLOCK, groups - first);
+        pack_groups(&bp, input_buffer + (uint64_t)first * 8, (uint8_t *)output_buffer + (uint64_t)first * bpp, count, bpp);
+    }
+
+    /* remaining pixels start on a word boundary, the last partial word stays little endian */
+    uint32_t mask = (1 << bpp) - 1;
+    uint16_t * packed_bits = output_buffer + (uint64_t)groups * bpp / 2;
+    uint32_t data = 0;
+    uint32_t bits = 0;
+    for (uint32_t pixel_index = groups * 8; pixel_index < pixel_count; pixel_index++)
+    {
+        data = (data << bpp) | (input_buffer[pixel_index] & mask);
+        bits += bpp;
+        if (bits >= 16)
+        {
+            bits -= 16;
+            uint16_t word = (uint16_t)(data >> bits);
+            *packed_bits++ = (big_endian) ? ROL16(word, 8) : word;
+        }
+    }
+    if (bits) *packed_bits = (uint16_t)(data << (16 - bits));
+}
+#endif
+
+/* unpack bits to 16 bit little endian and converts to real 14bit if less then 14bit depth detected
+   output_buffer - the buffer where the result will be written
+   input_buffer - a buffer containing the packed imaged data
+   width - image width
+   height - image height
+   bpp - raw data bits per pixel
+*/
+void dng_unpack_image_bits(uint16_t * output_buffer, uint16_t * input_buffer, int width, int height, uint32_t bpp)
+{
+    uint32_t pixel_count = width * height;
+#ifdef __SSSE3__
+    if (bpp == 10 || bpp == 12 || bpp == 14)
+    {
+        unpack_image_bits_simd(output_buffer, input_buffer, pixel_count, bpp);
+        return;
+    }
+#endif
+    uint32_t mask = (1 << bpp) - 1;
+    uint16_t *packed_bits = input_buffer;
+    uint16_t *unpacked_bits = output_buffer;
+    /* the last pixels go through unpack_tail_bits */
+    uint32_t tail_first = (pixel_count) ? (pixel_count - 1) & ~15u : 0;
+
+    #pragma omp parallel for
+    for (uint32_t pixel_index = 0; pixel_index < tail_first; pixel_index++)
+    {
+        uint32_t bits_offset = pixel_index * bpp;
+        uint32_t bits_address = bits_offset / 16;
+        uint32_t bits_shift = bits_offset % 16;
+
+        /* fetch two 16 bit words into a 32 bit register and correct it plus shift it as needed.
+        after the 32 bit fetch, the two 16 bit words will be swapped, so use a ROR to align them correctly.
+        ROR by 16 to swap 16 bit words plus the bits needed to put the needed pixel bits to right position */
+        uint32_t rotate_value = 16 + ((32 - bpp) - bits_shift);
+        uint32_t uncorrected_data = *((uint32_t *)&packed_bits[bits_address]);
+        uint32_t data = ROR32(uncorrected_data, rotate_value);
+
+        unpacked_bits[pixel_index] = (uint16_t)(data & mask);
+    }
+    unpack_tail_bits(output_buffer, input_buffer, tail_first, pixel_count, bpp);
+}
+
+/* pack bits to 16 bit little endian and convert to big endian (raw payload DNG spec)
+   output_buffer - the buffer where the result will be written
+   input_buffer - a buffer containing the unpacked imaged data
+   width - image width
+   height - image height
+   bpp - raw data bits per pixel 
+*/
+void dng_pack_image_bits(uint16_t * output_buffer, uint16_t * input_buffer, int width, int height, uint32_t bpp, int big_endian)
+{
+    uint32_t pixel_count = width * height;
+#ifdef __SSSE3__
+    if (bpp == 10 || bpp == 12 || bpp == 14)
+    {
+        pack_image_bits_simd(output_buffer, input_buffer, pixel_count, bpp, big_endian);
+        return;
+    }
+#endif
+    uint32_t bits_free = 16 - bpp;
+    uint16_t *unpacked_bits = input_buffer;
+    uint16_t *packed_bits = output_buffer;
+
+    packed_bits[0] = unpacked_bits[0] << bits_free;
+    for (uint32_t pixel_index = 1; pixel_index < pixel_count; pixel_index++)
+    {
+        uint32_t bits_offset = (pixel_index * bits_free) % 16;
+        uint32_t bits_to_rol = bits_free + bits_offset + (bits_offset > 0) * 16;
+
+        /* increment pointer by two bytes but fetch 32 bit words from input and outbut buffers.
+        after the 32 bit fetch, the two 16 bit words will be swapped, so use a ROL by 16 to swap
+        16 bit words plus shift to the left to put the needed pixel bits to right position.
+        mask/zero high 16 bits of 32 bit word of packed buffer and do logical OR to ROLed unpacked one.
+        make current packed 16 bit word big endian to satisfy DNG spec */
+        uint32_t data = ROL32((uint32_t)unpacked_bits[pixel_index], bits_to_rol);
+        *(uint32_t *)packed_bits = (*(uint32_t *)packed_bits & 0x0000FFFF) | data;
+
+        if(bits_offset > 0 && bits_offset <= bpp)
+        {
+            if(big_endian) *(uint16_t *)packed_bits = ROL16(*(uint16_t *)packed_bits, 8);
+            packed_bits++;
+        }
+    }
+}
+
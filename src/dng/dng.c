@@ -33,6 +33,7 @@
 #include "../mlv/camid/camera_id.h"
 
 #include "../mlv/liblj92/lj92.h"
+#include "../mlv/video_mlv.h"
 #include "../mlv/llrawproc/llrawproc.h"
 #include "../mlv/mcraw/mcraw.h"
 #include "../mlv/macros.h"
@@ -65,15 +66,6 @@
 #define FMT_SIZE "%zu"
 #endif
 
-static uint64_t file_set_pos(FILE *stream, uint64_t offset, int whence)
-{
-#if defined(__WIN32)
-    return fseeko64(stream, offset, whence);
-#else
-    return fseek(stream, offset, whence);
-#endif
-}
-
 enum { IMG_SIZE_UNPACKED, IMG_SIZE_PACKED, IMG_SIZE_LOSLESS };
 
 //MLV WB modes
@@ -656,7 +648,7 @@ static void dng_fill_header(mlvObject_t * mlv_data, dngObject_t * dng_data, uint
         char datetime[255];
 
         /* Baseline exposure stuff */
-        int32_t basline_exposure[2] = {mlv_data->RAWI.raw_info.exposure_bias[0],mlv_data->RAWI.raw_info.exposure_bias[1]};
+        int32_t basline_exposure[2] = {dng_data->baseline_exposure[0],dng_data->baseline_exposure[1]};
         if(basline_exposure[1] == 0)
         {
             basline_exposure[0] = 0;
@@ -764,74 +756,6 @@ static void dng_fill_header(mlvObject_t * mlv_data, dngObject_t * dng_data, uint
     }
 }
 
-/* unpack bits to 16 bit little endian and converts to real 14bit if less then 14bit depth detected
-   output_buffer - the buffer where the result will be written
-   input_buffer - a buffer containing the packed imaged data
-   width - image width
-   height - image height
-   bpp - raw data bits per pixel
-*/
-void dng_unpack_image_bits(uint16_t * output_buffer, uint16_t * input_buffer, int width, int height, uint32_t bpp)
-{
-    uint32_t pixel_count = width * height;
-    uint32_t mask = (1 << bpp) - 1;
-    uint16_t *packed_bits = input_buffer;
-    uint16_t *unpacked_bits = output_buffer;
-
-    #pragma omp parallel for
-    for (uint32_t pixel_index = 0; pixel_index < pixel_count; pixel_index++)
-    {
-        uint32_t bits_offset = pixel_index * bpp;
-        uint32_t bits_address = bits_offset / 16;
-        uint32_t bits_shift = bits_offset % 16;
-
-        /* fetch two 16 bit words into a 32 bit register and correct it plus shift it as needed.
-        after the 32 bit fetch, the two 16 bit words will be swapped, so use a ROR to align them correctly.
-        ROR by 16 to swap 16 bit words plus the bits needed to put the needed pixel bits to right position */
-        uint32_t rotate_value = 16 + ((32 - bpp) - bits_shift);
-        uint32_t uncorrected_data = *((uint32_t *)&packed_bits[bits_address]);
-        uint32_t data = ROR32(uncorrected_data, rotate_value);
-
-        unpacked_bits[pixel_index] = (uint16_t)(data & mask);
-    }
-}
-
-/* pack bits to 16 bit little endian and convert to big endian (raw payload DNG spec)
-   output_buffer - the buffer where the result will be written
-   input_buffer - a buffer containing the unpacked imaged data
-   width - image width
-   height - image height
-   bpp - raw data bits per pixel 
-*/
-void dng_pack_image_bits(uint16_t * output_buffer, uint16_t * input_buffer, int width, int height, uint32_t bpp, int big_endian)
-{
-    uint32_t pixel_count = width * height;
-    uint32_t bits_free = 16 - bpp;
-    uint16_t *unpacked_bits = input_buffer;
-    uint16_t *packed_bits = output_buffer;
-
-    packed_bits[0] = unpacked_bits[0] << bits_free;
-    for (uint32_t pixel_index = 1; pixel_index < pixel_count; pixel_index++)
-    {
-        uint32_t bits_offset = (pixel_index * bits_free) % 16;
-        uint32_t bits_to_rol = bits_free + bits_offset + (bits_offset > 0) * 16;
-
-        /* increment pointer by two bytes but fetch 32 bit words from input and outbut buffers.
-        after the 32 bit fetch, the two 16 bit words will be swapped, so use a ROL by 16 to swap
-        16 bit words plus shift to the left to put the needed pixel bits to right position.
-        mask/zero high 16 bits of 32 bit word of packed buffer and do logical OR to ROLed unpacked one.
-        make current packed 16 bit word big endian to satisfy DNG spec */
-        uint32_t data = ROL32((uint32_t)unpacked_bits[pixel_index], bits_to_rol);
-        *(uint32_t *)packed_bits = (*(uint32_t *)packed_bits & 0x0000FFFF) | data;
-
-        if(bits_offset > 0 && bits_offset <= bpp)
-        {
-            if(big_endian) *(uint16_t *)packed_bits = ROL16(*(uint16_t *)packed_bits, 8);
-            packed_bits++;
-        }
-    }
-}
-
 /* decompress LJ92 image to output_buffer */
 int dng_decompress_image(uint16_t * output_buffer, uint16_t * input_buffer, size_t input_buffer_size, int width, int height, uint32_t bpp)
 {
@@ -861,17 +785,27 @@ int dng_decompress_image(uint16_t * output_buffer, uint16_t * input_buffer, size
     return ret;
 }
 
-/* compress input_buffer to LJ92 image */
-int dng_compress_image(uint16_t * output_buffer, uint16_t * input_buffer, size_t * output_buffer_size, int width, int height, uint32_t bpp)
+/* compress input_buffer to LJ92 image, output_buffer holds width * height 16 bit values,
+   slices > 1 splits it into restart intervals which decode in parallel. Exported files use 1
+   unless the user opts in, other LJ92 readers may not know restart markers.
+   encoder keeps buffers and huffman table between frames, NULL for a one-off encoder */
+int dng_compress_image(lj92_encoder encoder, uint16_t * output_buffer, uint16_t * input_buffer, size_t * output_buffer_size, int width, int height, uint32_t bpp, int slices)
 {
-    uint8_t * compressed = NULL;
+    lj92_encoder own_encoder = NULL;
     int new_width = width * 2;
     int new_height = height / 2;
+    int compressed_size = 0;
 
-    int ret = lj92_encode(input_buffer, new_width, new_height, (int)bpp, new_width * new_height, 0, NULL, 0, &compressed, (int*)output_buffer_size);
+    int ret = (encoder) ? LJ92_ERROR_NONE : lj92_encoder_open(&own_encoder, 1);
+    if(ret == LJ92_ERROR_NONE)
+    {
+        ret = lj92_encoder_encode((encoder) ? encoder : own_encoder, input_buffer, new_width, new_height, (int)bpp, new_width * new_height, 0, NULL, 0, slices,
+                                  (uint8_t*)output_buffer, width * height * sizeof(uint16_t), &compressed_size);
+        lj92_encoder_close(own_encoder);
+    }
     if(ret == LJ92_ERROR_NONE)
     {
-        memcpy(output_buffer, compressed, *output_buffer_size);
+        *output_buffer_size = compressed_size;
 #ifndef STDOUT_SILENT
         size_t input_buffer_size = width * height * 2;
         printf("LJ92 encoder: "FMT_SIZE" -> "FMT_SIZE" (%2.2f%% ratio)\n", *output_buffer_size, input_buffer_size, ((float)*output_buffer_size * 100.0f) / (float)input_buffer_size);
@@ -886,7 +820,6 @@ int dng_compress_image(uint16_t * output_buffer, uint16_t * input_buffer, size_t
 #endif
     }
 
-    if(compressed) free(compressed);
     return ret;
 }
 
@@ -906,21 +839,33 @@ static void dng_reverse_byte_order(uint16_t * input_buffer, size_t buf_size)
     }
 }
 
+/* low level raw processing is thread safe, the deflicker result of this frame goes to dng_data */
+static void dng_apply_llrawproc(mlvObject_t * mlv_data, dngObject_t * dng_data)
+{
+    llrawprocFrame_t frame = { mlv_data->VIDF.panPosX, mlv_data->VIDF.panPosY,
+                               { dng_data->baseline_exposure[0], dng_data->baseline_exposure[1] } };
+    applyLLRawProcObjectFrame(mlv_data, dng_data->image_buf_unpacked, dng_data->image_size_unpacked, &frame);
+    dng_data->baseline_exposure[0] = frame.exposure_bias[0];
+    dng_data->baseline_exposure[1] = frame.exposure_bias[1];
+}
+
 /* build whole DNG frame (header + image), process image if needed and put to the dng struct ready to save */
 static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_t frame_index, const char *prop_filename)
 {
     int ret = 0;
 
-    FILE *fd = mlv_data->file[mlv_data->video_index[frame_index].chunk_num];
+    int chunk = mlv_data->video_index[frame_index].chunk_num;
+
+    /* without deflicker the clip value is used */
+    dng_data->baseline_exposure[0] = mlv_data->RAWI.raw_info.exposure_bias[0];
+    dng_data->baseline_exposure[1] = mlv_data->RAWI.raw_info.exposure_bias[1];
 
     if (isMcrawLoaded(mlv_data))
     {
-        /* Move to start of frame in file and read the RAW data */
-        file_set_pos(fd, mlv_data->video_index[frame_index].block_offset, SEEK_SET);
-
+        uint64_t item_offset = mlv_data->video_index[frame_index].block_offset;
         mr_item_t item = {};
 
-        if (fread(&item, sizeof(mr_item_t), 1, fd) != 1)
+        if (read_mlv_chunk_data(mlv_data, chunk, item_offset, &item, sizeof(mr_item_t)))
         {
 #ifndef STDOUT_SILENT
             printf("Can not read raw frame from %s\n", mlv_data->path);
@@ -930,20 +875,26 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
 
         size_t stored_size = item.size;
 
-        if (stored_size > dng_get_image_size(mlv_data, IMG_SIZE_UNPACKED, frame_index)) {
-            dng_data->image_buf2 = realloc(dng_data->image_buf2, stored_size);
-        }
-
-        if (fread(dng_data->image_buf2, stored_size, 1, fd) != 1)
+        /* decode straight from the mapped file if possible */
+        uint8_t * stored_data = (uint8_t *)get_mlv_chunk_data(mlv_data, chunk, item_offset + sizeof(mr_item_t), stored_size);
+        if (!stored_data)
         {
+            if (stored_size > dng_get_image_size(mlv_data, IMG_SIZE_UNPACKED, frame_index)) {
+                dng_data->image_buf2 = realloc(dng_data->image_buf2, stored_size);
+            }
+            stored_data = (uint8_t *)dng_data->image_buf2;
+
+            if (read_mlv_chunk_data(mlv_data, chunk, item_offset + sizeof(mr_item_t), stored_data, stored_size))
+            {
 #ifndef STDOUT_SILENT
-            printf("Can not read raw frame from %s\n", mlv_data->path);
+                printf("Can not read raw frame from %s\n", mlv_data->path);
 #endif
-            return -1;
+                return -1;
+            }
         }
 
         int64_t ret = mr_decode_video_frame((uint8_t*)dng_data->image_buf_unpacked,
-                                            (uint8_t*)dng_data->image_buf2,
+                                            stored_data,
                                             stored_size,
                                             mlv_data->RAWI.xRes,
                                             mlv_data->RAWI.yRes,
@@ -958,16 +909,18 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
         }
 
         /* apply low level raw processing to the unpacked_frame */
-        applyLLRawProcObject(mlv_data, dng_data->image_buf_unpacked, dng_data->image_size_unpacked);
+        dng_apply_llrawproc(mlv_data, dng_data);
 
         if (dng_data->raw_output_state == COMPRESSED_RAW || dng_data->raw_output_state == COMPRESSED_ORIG)
         {
-            ret = dng_compress_image(dng_data->image_buf,
+            ret = dng_compress_image(dng_data->lj92_enc,
+                                     dng_data->image_buf,
                                      dng_data->image_buf_unpacked,
                                      &dng_data->image_size,
                                      mlv_data->RAWI.xRes,
                                      mlv_data->RAWI.yRes,
-                                     mlv_data->RAWI.raw_info.bits_per_pixel);
+                                     mlv_data->RAWI.raw_info.bits_per_pixel,
+                                     dng_data->lj92_slices);
         }
         else   // uncompressed and fast pass
         {
@@ -981,13 +934,12 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
     }
     else
     {
-        /* Move to start of frame in file and read the RAW data */
-        file_set_pos(fd, mlv_data->video_index[frame_index].frame_offset, SEEK_SET);
+        uint64_t frame_offset = mlv_data->video_index[frame_index].frame_offset;
 
         if (dng_data->raw_input_state == COMPRESSED_RAW) /* If lossless, decompress or pass trough */
         {
             dng_data->image_size = dng_get_image_size(mlv_data, IMG_SIZE_LOSLESS, frame_index);
-            if(fread(dng_data->image_buf, dng_data->image_size, 1, fd) != 1)
+            if(read_mlv_chunk_data(mlv_data, chunk, frame_offset, dng_data->image_buf, dng_data->image_size))
             {
 #ifndef STDOUT_SILENT
                 printf("Can not read raw frame from %s\n", mlv_data->path);
@@ -1008,16 +960,18 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
                                            mlv_data->RAWI.raw_info.bits_per_pixel);
 
                 /* apply low level raw processing to the unpacked_frame */
-                applyLLRawProcObject(mlv_data, dng_data->image_buf_unpacked, dng_data->image_size_unpacked);
+                dng_apply_llrawproc(mlv_data, dng_data);
 
                 if(dng_data->raw_output_state == COMPRESSED_RAW)
                 {
-                    ret = dng_compress_image(dng_data->image_buf,
+                    ret = dng_compress_image(dng_data->lj92_enc,
+                                             dng_data->image_buf,
                                              dng_data->image_buf_unpacked,
                                              &dng_data->image_size,
                                              mlv_data->RAWI.xRes,
                                              mlv_data->RAWI.yRes,
-                                             (llrpHQDualIso(mlv_data)) ? 16 : mlv_data->RAWI.raw_info.bits_per_pixel);
+                                             (llrpHQDualIso(mlv_data)) ? 16 : mlv_data->RAWI.raw_info.bits_per_pixel,
+                                             dng_data->lj92_slices);
                 }
                 else
                 {
@@ -1042,7 +996,7 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
         else /* If uncompressed, unpack to 16bit or pass trough */
         {
             dng_data->image_size = dng_get_image_size(mlv_data, IMG_SIZE_PACKED, frame_index);
-            if(fread(dng_data->image_buf, dng_data->image_size, 1, fd) != 1)
+            if(read_mlv_chunk_data(mlv_data, chunk, frame_offset, dng_data->image_buf, dng_data->image_size))
             {
 #ifndef STDOUT_SILENT
                 printf("Can not read raw frame from %s\n", mlv_data->path);
@@ -1062,16 +1016,18 @@ static int dng_get_frame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_
                                       mlv_data->RAWI.raw_info.bits_per_pixel);
 
                 /* apply low level raw processing to the unpacked_frame */
-                applyLLRawProcObject(mlv_data, dng_data->image_buf_unpacked, dng_data->image_size_unpacked);
+                dng_apply_llrawproc(mlv_data, dng_data);
 
                 if(dng_data->raw_output_state == COMPRESSED_RAW)
                 {
-                    ret = dng_compress_image(dng_data->image_buf,
+                    ret = dng_compress_image(dng_data->lj92_enc,
+                                             dng_data->image_buf,
                                              dng_data->image_buf_unpacked,
                                              &dng_data->image_size,
                                              mlv_data->RAWI.xRes,
                                              mlv_data->RAWI.yRes,
-                                             (llrpHQDualIso(mlv_data)) ? 16 : mlv_data->RAWI.raw_info.bits_per_pixel);
+                                             (llrpHQDualIso(mlv_data)) ? 16 : mlv_data->RAWI.raw_info.bits_per_pixel,
+                                             dng_data->lj92_slices);
                 }
                 else
                 {
@@ -1109,6 +1065,8 @@ dngObject_t * initDngObject(mlvObject_t * mlv_data, int raw_state, double fps, i
 
     dng_data->raw_input_state = (mlv_data->MLVI.videoClass & MLV_VIDEO_CLASS_FLAG_LJ92) ? COMPRESSED_RAW : UNCOMPRESSED_RAW;
     dng_data->raw_output_state = (dng_data->raw_input_state && (raw_state == 2)) ? COMPRESSED_ORIG : raw_state;
+    dng_data->lj92_slices = 1;
+    lj92_encoder_open(&dng_data->lj92_enc, LJ92_TABLE_FRAMES);
 
     dng_data->header_size = HEADER_SIZE;
     dng_data->header_buf = malloc(dng_data->header_size);
@@ -1178,6 +1136,13 @@ int saveDngFrame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_t frame_
     return 0;
 }
 
+/* LJ92 restart intervals of lossless output, slices > 1 decode in parallel but some readers
+   don't know restart markers, so it stays 1 unless the user asks for it */
+void setDngLj92Slices(dngObject_t * dng_data, int slices)
+{
+    dng_data->lj92_slices = (slices > 1) ? slices : 1;
+}
+
 /* free all buffers used for DNG creation */
 void freeDngObject(dngObject_t * dng_data)
 {
@@ -1185,5 +1150,6 @@ void freeDngObject(dngObject_t * dng_data)
     if(dng_data->image_buf) free(dng_data->image_buf);
     if(dng_data->image_buf2) free(dng_data->image_buf2);
     if(dng_data->image_buf_unpacked) free(dng_data->image_buf_unpacked);
+    lj92_encoder_close(dng_data->lj92_enc);
     free(dng_data);
 }
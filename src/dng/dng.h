@@ -48,16 +48,22 @@ typedef struct
     uint16_t * image_buf2;          // pointer to image buffer for temporary decompression
     uint16_t * image_buf_unpacked;  // pointer to bit packed image buffer
 
+    int32_t baseline_exposure[2];   // per frame exposure bias (deflicker), copied when llrawproc ran
+    int lj92_slices;                // LJ92 restart intervals for lossless output, 1 - single stream (default)
+    lj92_encoder lj92_enc;          // LJ92 encoder, keeps its buffers and huffman table from frame to frame
+
 } dngObject_t;
 
 /* routines to unpack, pack, decompress or compress raw data */
 void dng_unpack_image_bits(uint16_t * input_buffer, uint16_t * output_buffer, int width, int height, uint32_t bpp);
 void dng_pack_image_bits(uint16_t * input_buffer, uint16_t * output_buffer, int width, int height, uint32_t bpp, int big_endian);
-int dng_compress_image(uint16_t * output_buffer, uint16_t * input_buffer, size_t * output_buffer_size, int width, int height, uint32_t bpp);
+int dng_compress_image(lj92_encoder encoder, uint16_t * output_buffer, uint16_t * input_buffer, size_t * output_buffer_size, int width, int height, uint32_t bpp, int slices);
 int dng_decompress_image(uint16_t * output_buffer, uint16_t * input_buffer, size_t input_buffer_size, int width, int height, uint32_t bpp);
 
-/* routines to initialize, save and free DNG exporting struct */
+/* routines to initialize, save and free DNG exporting struct.
+   saveDngFrame may run on several threads, each with its own dngObject_t */
 dngObject_t * initDngObject(mlvObject_t * mlv_data, int raw_state, double fps, int32_t par[4]);
+void setDngLj92Slices(dngObject_t * dng_data, int slices);
 int saveDngFrame(mlvObject_t * mlv_data, dngObject_t * dng_data, uint32_t frame_index, char * dng_filename, const char *props_filename);
 void freeDngObject(dngObject_t * dng_data);
 
@@ -169,6 +169,10 @@ void writeMlvAudioToWaveCut(mlvObject_t * video, char * path, uint32_t cut_in, u
     int32_t frames = cut_out - ( cut_in - 1 );
     if( frames <= 0 ) return;
 
+    /* Loading the audio from the .MAPP can change audio_size, so get it before the sizes */
+    uint8_t * audio_data = getMlvAudioData(video);
+    if( !audio_data ) return;
+
     /* Calculate the sum of audio sample sizes for all audio channels */
     uint64_t audio_sample_size = getMlvAudioChannels(video) * (getMlvAudioBitsPerSample(video) / 8);
     /* Calculate the audio alignement block size in bytes */
@@ -191,7 +195,7 @@ void writeMlvAudioToWaveCut(mlvObject_t * video, char * path, uint32_t cut_in, u
     /* Write header */
     fwrite(&wave_header, sizeof(wave_header_t), 1, wave_file);
     /* Write data, shift buffer by in_offset_aligned */
-    fwrite(video->audio_data + in_offset_aligned, wave_data_size, 1, wave_file);
+    fwrite(audio_data + in_offset_aligned, wave_data_size, 1, wave_file);
 
     fclose(wave_file);
 }
@@ -201,6 +205,10 @@ void writeMlvAudioToWave(mlvObject_t * video, char * path)
 {
     if (!doesMlvHaveAudio(video)) return;
 
+    /* Loading the audio from the .MAPP can change audio_size, so get it before the header */
+    uint8_t * audio_data = getMlvAudioData(video);
+    if( !audio_data ) return;
+
     /* Get wav header */
     wave_header_t wave_header = generateMlvAudioToWaveHeader(video, video->audio_size, 0);
 
@@ -209,7 +217,7 @@ void writeMlvAudioToWave(mlvObject_t * video, char * path)
     /* Write header */
     fwrite(&wave_header, sizeof(wave_header_t), 1, wave_file);
     /* Write data */
-    fwrite(video->audio_data, video->audio_size, 1, wave_file);
+    fwrite(audio_data, video->audio_size, 1, wave_file);
 
     fclose(wave_file);
 }
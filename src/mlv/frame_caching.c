@@ -2,13 +2,17 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <omp.h>
 
 #include "video_mlv.h"
 #include "../debayer/debayer.h"
 #include "../ca_correct/CA_correct_RT.h"
 #include "../debayer/wb_conversion.h"
+#include "../processing/core_budget.h"
+#include "liblj92/lj92.h"
 
 #include "librtprocesswrapper.h"
 
@@ -26,6 +30,8 @@ void resetMlvCache(mlvObject_t * video)
 {
     resetMlvCachedFrame(video);
     mark_mlv_uncached(video);
+    /* Cache threads stop when the window is cached, wake them to cache it again */
+    if (!video->stop_caching && isMlvActive(video)) start_mlv_cache_threads(video);
 }
 
 void disableMlvCaching(mlvObject_t * video)
@@ -46,12 +52,69 @@ void enableMlvCaching(mlvObject_t * video)
     setMlvRawCacheLimitMegaBytes(video, video->cache_limit_mb);
 }
 
+/* Size of a cache slot in uint16_t for the cache mode */
+static uint64_t cache_slot_pixels(mlvObject_t * video)
+{
+    uint64_t pixels = (uint64_t)getMlvWidth(video) * getMlvHeight(video);
+    switch (video->cache_mode)
+    {
+        case MLV_CACHE_BAYER16:
+            return pixels;
+        case MLV_CACHE_BAYER_LJ92:
+            /* LJ92 of 12/14 bit raw is about 1/2 of 16 bit, leave some room for noisy frames */
+            return pixels * 2 / 3 + 8;
+        case MLV_CACHE_RGB16:
+        default:
+            return pixels * 3;
+    }
+}
+
+/* New cache block with slot_count slots, all frames uncached. Cache threads must be stopped */
+static void resize_mlv_cache(mlvObject_t * video, uint64_t block_size, uint64_t slot_count)
+{
+    video->cache_memory_block = realloc(video->cache_memory_block, block_size);
+    /* Frame pointers into the slots, one per frame of the clip */
+    video->rgb_raw_frames = realloc(video->rgb_raw_frames, getMlvFrames(video) * sizeof(uint16_t *));
+    video->cache_slot_frame = realloc(video->cache_slot_frame, MAX(slot_count, 1) * sizeof(int64_t));
+    video->cache_slot_busy = realloc(video->cache_slot_busy, MAX(slot_count, 1) * sizeof(uint8_t));
+    video->cache_slot_bytes = realloc(video->cache_slot_bytes, MAX(slot_count, 1) * sizeof(uint32_t));
+    for (uint64_t i = 0; i < slot_count; ++i)
+    {
+        video->cache_slot_frame[i] = -1;
+        video->cache_slot_busy[i] = 0;
+        video->cache_slot_bytes[i] = 0;
+    }
+    if (video->cached_frames) mark_mlv_uncached(video);
+}
+
+void setMlvCacheMode(mlvObject_t * video, int cacheMode)
+{
+    if (cacheMode < MLV_CACHE_RGB16 || cacheMode > MLV_CACHE_BAYER_LJ92 || cacheMode == video->cache_mode) return;
+
+    /* Slot size changes, cache threads must not run meanwhile */
+    int stop_caching = video->stop_caching;
+    video->stop_caching = 1;
+    while (isMlvObjectCaching(video)) usleep(100);
+    video->cache_mode = cacheMode;
+    resetMlvCachedFrame(video);
+    /* Same memory, new number of slots */
+    setMlvRawCacheLimitMegaBytes(video, video->cache_limit_mb);
+    video->stop_caching = stop_caching;
+    if (!video->stop_caching && isMlvActive(video)) start_mlv_cache_threads(video);
+}
+
+int getMlvBayerCacheMode(mlvObject_t * video)
+{
+    uint64_t clip_bytes = (uint64_t)getMlvWidth(video) * getMlvHeight(video) * sizeof(uint16_t) * getMlvFrames(video);
+    return (clip_bytes > video->cache_limit_bytes) ? MLV_CACHE_BAYER_LJ92 : MLV_CACHE_BAYER16;
+}
+
 /* Hmmmm, did anyone need 2 ways of doing this? */
 
 /* What I call MegaBytes is actually MebiBytes! I'm so upset to find that out :( */
 void setMlvRawCacheLimitMegaBytes(mlvObject_t * video, uint64_t megaByteLimit)
 {
-    uint64_t frame_pix   = getMlvWidth(video) * getMlvHeight(video) * 3;
+    uint64_t frame_pix   = cache_slot_pixels(video);
     uint64_t frame_size  = frame_pix * sizeof(uint16_t);
     uint64_t bytes_limit = megaByteLimit * (1 << 20);
 
@@ -79,20 +142,14 @@ void setMlvRawCacheLimitMegaBytes(mlvObject_t * video, uint64_t megaByteLimit)
         }
 
         /* Resize cache block - to maximum allowed or enough to fit whole clip if it is smaller */
-        video->cache_memory_block = realloc(video->cache_memory_block, MIN(bytes_limit, cache_whole));
-        /* Array of frame pointers within the memory block */
-        video->rgb_raw_frames = realloc(video->rgb_raw_frames, frame_limit * sizeof(uint16_t *));
-        for (uint64_t i = 0; i < getMlvRawCacheLimitFrames(video); ++i) video->rgb_raw_frames[i] = video->cache_memory_block + (frame_pix * i);
+        resize_mlv_cache(video, MIN(bytes_limit, cache_whole), frame_limit);
 
         /* Restart caching if it had caching before */
         if (has_caching)
         {
             video->stop_caching = 0;
             /* Begin updating cached frames */
-            for (int i = 0; i < video->cpu_cores; ++i)
-            {
-                add_mlv_cache_thread(video);
-            }
+            start_mlv_cache_threads(video);
         }
     }
 
@@ -102,7 +159,7 @@ void setMlvRawCacheLimitMegaBytes(mlvObject_t * video, uint64_t megaByteLimit)
 /* Not recommended */
 void setMlvRawCacheLimitFrames(mlvObject_t * video, uint64_t frameLimit)
 {
-    uint64_t frame_pix   = getMlvWidth(video) * getMlvHeight(video) * 3;
+    uint64_t frame_pix   = cache_slot_pixels(video);
     uint64_t frame_size  = frame_pix * sizeof(uint16_t);
 
     /* Do only if clip is loaded */
@@ -114,7 +171,7 @@ void setMlvRawCacheLimitFrames(mlvObject_t * video, uint64_t frameLimit)
 
         video->cache_limit_bytes = bytes_limit;
         video->cache_limit_mb = mbyte_limit;
-        video->cache_limit_frames = frameLimit;
+        video->cache_limit_frames = MIN(frameLimit, getMlvFrames(video));
 
         /* Stop all cache for a bit */
         int has_caching = 0;
@@ -126,20 +183,14 @@ void setMlvRawCacheLimitFrames(mlvObject_t * video, uint64_t frameLimit)
         }
 
         /* Resize cache block - to maximum allowed or enough to fit whole clip if it is smaller */
-        video->cache_memory_block = realloc(video->cache_memory_block, MIN(bytes_limit, cache_whole));
-        /* Array of frame pointers within the memory block */
-        video->rgb_raw_frames = realloc(video->rgb_raw_frames, frameLimit * sizeof(uint16_t *));
-        for (uint64_t i = 0; i < getMlvRawCacheLimitFrames(video); ++i) video->rgb_raw_frames[i] = video->cache_memory_block + (frame_pix * i);
+        resize_mlv_cache(video, MIN(bytes_limit, cache_whole), getMlvRawCacheLimitFrames(video));
 
         /* Restart caching if it had caching before */
         if (has_caching)
         {
             video->stop_caching = 0;
             /* Begin updating cached frames */
-            for (int i = 0; i < video->cpu_cores; ++i)
-            {
-                add_mlv_cache_thread(video);
-            }
+            start_mlv_cache_threads(video);
         }
     }
 }
@@ -152,6 +203,11 @@ void mark_mlv_uncached(mlvObject_t * video)
     {
         video->cached_frames[i] = MLV_FRAME_NOT_CACHED;
     }
+    /* Busy slots stay busy, their cache thread sees the slot lost its frame and throws the result away */
+    for (uint64_t i = 0; i < getMlvRawCacheLimitFrames(video); ++i)
+    {
+        video->cache_slot_frame[i] = -1;
+    }
     pthread_mutex_unlock( &video->g_mutexFind );
 }
 
@@ -163,52 +219,232 @@ void clear_mlv_cache(mlvObject_t * video)
     video->cache_memory_block = malloc(video->cache_limit_bytes);
 }
 
-/* Returns 1 on success, or 0 if all are cached */
-int find_mlv_frame_to_cache(mlvObject_t * video, uint64_t * index) /* Outputs to *index */
+/* Distance of a frame from the playhead in playback direction, wrapping around at clip end (loop playback) */
+static uint64_t playhead_distance(mlvObject_t * video, uint64_t frame)
 {
+    uint64_t frames = getMlvFrames(video);
+    uint64_t playhead = video->cache_start_frame;
+    if (video->cache_direction < 0) return (playhead + frames - frame) % frames;
+    else return (frame + frames - playhead) % frames;
+}
+
+static uint64_t frame_at_playhead_distance(mlvObject_t * video, uint64_t distance)
+{
+    uint64_t frames = getMlvFrames(video);
+    uint64_t playhead = video->cache_start_frame;
+    if (video->cache_direction < 0) return (playhead + frames - distance) % frames;
+    else return (playhead + distance) % frames;
+}
+
+/* Returns 1 on success, or 0 if all frames of the window around the playhead are cached.
+ * Outputs the frame to *index and the slot it goes to to *slot, the frame is marked as being cached */
+int find_mlv_frame_to_cache(mlvObject_t * video, uint64_t * index, uint64_t * slot)
+{
+    uint64_t frames = getMlvFrames(video);
+    uint64_t slots = getMlvRawCacheLimitFrames(video);
+    if (!frames || !slots) return 0;
+
     pthread_mutex_lock( &video->g_mutexFind );
-    /* If a specific frame was requested */
-    if (video->cache_next) 
-    {
-        *index = video->cache_next;
-        video->cache_next = 0;
-        pthread_mutex_unlock( &video->g_mutexFind );
-        return 1;
-    }
-    else
+
+    /* Window: whole clip if it fits, else 1/8 of the slots behind the playhead, the rest ahead */
+    uint64_t window = MIN(slots, frames);
+    uint64_t behind = (slots >= frames) ? 0 : slots / 8;
+    uint64_t ahead = window - behind;
+    if (video->cache_start_frame >= frames) video->cache_start_frame = 0;
+
+    /* Nearest frames first: ahead of the playhead, then behind */
+    for (uint64_t i = 0; i < window; ++i)
     {
-        for (uint64_t frame = 0; frame < getMlvRawCacheLimitFrames(video); ++frame)
+        uint64_t distance = (i < ahead) ? i : frames - (i - ahead + 1);
+        uint64_t frame = frame_at_playhead_distance(video, distance);
+        if (video->cached_frames[frame] != MLV_FRAME_NOT_CACHED) continue;
+
+        /* A free slot, or else the one outside the window farthest behind the playhead */
+        int64_t free_slot = -1, evict_slot = -1;
+        uint64_t evict_distance = 0;
+        for (uint64_t s = 0; s < slots; ++s)
         {
-            /* Return index if it is not cached */
-            if (video->cached_frames[frame] == MLV_FRAME_NOT_CACHED)
+            if (video->cache_slot_busy[s]) continue;
+            if (video->cache_slot_frame[s] < 0)
             {
-                *index = frame;
-                pthread_mutex_unlock( &video->g_mutexFind );
-                return 1;
+                free_slot = s;
+                break;
             }
+            uint64_t d = playhead_distance(video, video->cache_slot_frame[s]);
+            if (d >= ahead && d < frames - behind && d >= evict_distance)
+            {
+                evict_slot = s;
+                evict_distance = d;
+            }
+        }
+
+        int64_t use_slot = (free_slot >= 0) ? free_slot : evict_slot;
+        /* All slots hold frames of the window (or are being written) */
+        if (use_slot < 0) break;
+
+        if (video->cache_slot_frame[use_slot] >= 0)
+        {
+            video->cached_frames[video->cache_slot_frame[use_slot]] = MLV_FRAME_NOT_CACHED;
         }
+
+        video->cache_slot_frame[use_slot] = frame;
+        video->cache_slot_busy[use_slot] = 1;
+        video->rgb_raw_frames[frame] = video->cache_memory_block + (cache_slot_pixels(video) * use_slot);
+        video->cached_frames[frame] = MLV_FRAME_BEING_CACHED;
+        *index = frame;
+        *slot = use_slot;
+
+        pthread_mutex_unlock( &video->g_mutexFind );
+        return 1;
     }
+
     pthread_mutex_unlock( &video->g_mutexFind );
     return 0;
 }
 
+/* Moves the cache window to the frame shown now, direction follows the playhead. Wakes cache threads if they are done */
+void setMlvCachePlayhead(mlvObject_t * video, uint64_t frameIndex)
+{
+    uint64_t frames = getMlvFrames(video);
+    if (frameIndex >= frames) return;
+
+    pthread_mutex_lock( &video->g_mutexFind );
+    uint64_t playhead = video->cache_start_frame;
+    if (frameIndex != playhead)
+    {
+        /* A jump from clip end to start (or the other way) is looping, not changing direction */
+        int forward = (frameIndex > playhead);
+        if ((forward ? frameIndex - playhead : playhead - frameIndex) > frames / 2) forward = !forward;
+        video->cache_direction = (forward) ? 1 : -1;
+        video->cache_start_frame = frameIndex;
+    }
+    pthread_mutex_unlock( &video->g_mutexFind );
+
+    if (frameIndex != playhead && !video->stop_caching && !isMlvObjectCaching(video))
+    {
+        start_mlv_cache_threads(video);
+    }
+}
+
+/* Runs a cache thread which is already counted in cache_thread_count */
+static void spawn_mlv_cache_thread(mlvObject_t * video)
+{
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, (void *)an_mlv_cache_thread, (void *)video) != 0)
+    {
+        pthread_mutex_lock( &video->g_mutexCount );
+        video->cache_thread_count--;
+        pthread_mutex_unlock( &video->g_mutexCount );
+    }
+    else pthread_detach(thread);
+}
+
 /* Adds one thread, active total can be checked in mlvObject->cache_thread_count */
 void add_mlv_cache_thread(mlvObject_t * video)
 {
-    pthread_t thread;
-    pthread_create(&thread, NULL, (void *)an_mlv_cache_thread, (void *)video);
+    /* Counted here, so a thread is known to be alive before it runs */
+    pthread_mutex_lock( &video->g_mutexCount );
+    video->cache_thread_count++;
+    pthread_mutex_unlock( &video->g_mutexCount );
+
+    spawn_mlv_cache_thread(video);
+}
+
+/* Starts cache threads, if none is running */
+void start_mlv_cache_threads(mlvObject_t * video)
+{
+    pthread_mutex_lock( &video->g_mutexCount );
+    int start = (video->cache_thread_count) ? 0 : video->cpu_cores;
+    video->cache_thread_count += start;
+    pthread_mutex_unlock( &video->g_mutexCount );
+
+    for (int i = 0; i < start; ++i)
+    {
+        spawn_mlv_cache_thread(video);
+    }
+}
+
+/* Bit depth LJ92 needs for a bayer frame (llrawproc may leave the original bit depth) */
+static int bayer_bitdepth(uint16_t * bayer, uint32_t pixels)
+{
+    uint16_t max = 0;
+    for (uint32_t i = 0; i < pixels; ++i) max = MAX(max, bayer[i]);
+    int bits = 2;
+    while (bits < 16 && (1 << bits) <= max) bits++;
+    return bits;
+}
+
+/* LJ92 layout of a bayer frame: two rows side by side, so the predictor sees pixels of the same colour */
+static void lj92_bayer_size(mlvObject_t * video, int * width, int * height)
+{
+    *width = getMlvWidth(video);
+    *height = getMlvHeight(video);
+    if (!(*height & 1))
+    {
+        *width *= 2;
+        *height /= 2;
+    }
+}
+
+/* Puts the bayer frame (after llrawproc) into a cache slot, LJ92 compressed in MLV_CACHE_BAYER_LJ92 mode.
+ * Returns 0 if the compressed frame is too big for the slot, or there is no memory to compress it */
+static int cache_bayer_frame(mlvObject_t * video, lj92_encoder encoder, uint64_t frame_index, uint16_t * slot, uint32_t * bytes, mlvFrameBuffers_t * buffers)
+{
+    uint32_t pixels = getMlvWidth(video) * getMlvHeight(video);
+
+    if (video->cache_mode == MLV_CACHE_BAYER16)
+    {
+        /* Decoding and llrawproc are thread safe, all cache threads work at the same time */
+        get_mlv_raw_frame_bayer16(video, frame_index, slot, buffers);
+        *bytes = pixels * sizeof(uint16_t);
+        return 1;
+    }
+
+    uint16_t * bayer = (buffers->unpacked_frame) ? buffers->unpacked_frame : take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+    if (!bayer) return 0;
+    get_mlv_raw_frame_bayer16(video, frame_index, bayer, buffers);
+
+    int width, height;
+    lj92_bayer_size(video, &width, &height);
+    int compressed_size = 0;
+    /* Straight into the slot. Private format: restart intervals let the playback thread decode it on all cores */
+    int ret = lj92_encoder_encode(encoder, bayer, width, height, bayer_bitdepth(bayer, pixels), width * height, 0, NULL, 0, getMlvCpuCores(video),
+                                  (uint8_t *)slot, cache_slot_pixels(video) * sizeof(uint16_t), &compressed_size);
+    if (bayer != buffers->unpacked_frame) give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer);
+
+    int fits = (ret == LJ92_ERROR_NONE);
+    if (fits)
+    {
+        *bytes = compressed_size;
+    }
+    else
+    {
+        DEBUG( printf("Frame %llu does not fit into a LJ92 cache slot (error %i)\n", frame_index+1, ret); )
+    }
+
+    return fits;
 }
 
 /* Add as many of these as you want :) */
 void an_mlv_cache_thread(mlvObject_t * video)
 {
-    if (!isMlvActive(video)) return;
-
     pthread_mutex_lock( &video->g_mutexCount );
-    video->cache_thread_count++;
+    if (!isMlvActive(video))
+    {
+        video->cache_thread_count--;
+        pthread_mutex_unlock( &video->g_mutexCount );
+        return;
+    }
+    /* First cache thread always works, the others only if the core budget has a free core */
+    int budget_free_thread = !video->cache_free_thread;
+    video->cache_free_thread = 1;
     pthread_mutex_unlock( &video->g_mutexCount );
 
-    uint32_t height = getMlvHeight(video);
+    /* Cache threads are the parallelism, no OpenMP team inside each of them */
+    omp_set_num_threads(1);
+
+    /* AMaZE buffers are only needed when caching debayered frames */
+    uint32_t height = (video->cache_mode == MLV_CACHE_RGB16) ? getMlvHeight(video) : 0;
     uint32_t width = getMlvWidth(video);
     uint32_t pixelsize = width * height;
 
@@ -235,46 +471,80 @@ void an_mlv_cache_thread(mlvObject_t * video)
         .winx    =  0,
         .winy    =  0,
         .winw    =  getMlvWidth(video),
-        .winh    =  getMlvHeight(video),
+        .winh    =  height,
         .cfa     =  0
     };
     pthread_mutex_unlock( &video->g_mutexCount );
 
+    /* Own decode buffers, so any number of cache threads stays out of the clip's buffer arena.
+     * If an allocation fails, that buffer is borrowed from the arena as before */
+    mlvFrameBuffers_t buffers = { 0 };
+    buffers.raw_frame = (uint8_t *)malloc(getMlvFrameBufferSize(video, MLV_BUFFER_RAW));
+    buffers.unpacked_frame = (uint16_t *)malloc(getMlvFrameBufferSize(video, MLV_BUFFER_BAYER16));
+
+    /* Keeps its buffers and huffman table from frame to frame */
+    lj92_encoder encoder;
+    lj92_encoder_open(&encoder, LJ92_TABLE_FRAMES);
+
     while (1 < 2)
     {
         if (video->stop_caching) break;
 
-        uint64_t cache_frame;
+        /* Caching has lowest priority, sleep until playback or export leave a core.
+         * The timeout only makes sure a stop request is seen */
+        int granted = (budget_free_thread) ? core_budget_acquire(CORE_BUDGET_CACHING, 1)
+                                           : core_budget_acquire_wait(CORE_BUDGET_CACHING, 1, 20);
+        if (!granted && !budget_free_thread) continue;
 
-        /* If cache finder reurns false, it's time t stop caching */
-        if (!find_mlv_frame_to_cache(video, &cache_frame)) break;
+        uint64_t cache_frame, cache_slot;
 
-        pthread_mutex_lock( &video->g_mutexFind );
-        video->cached_frames[cache_frame] = MLV_FRAME_BEING_CACHED;
-        pthread_mutex_unlock( &video->g_mutexFind );
+        /* If cache finder reurns false, the window is cached. Moving the playhead starts new threads */
+        if (!find_mlv_frame_to_cache(video, &cache_frame, &cache_slot))
+        {
+            core_budget_release(CORE_BUDGET_CACHING, granted);
+            break;
+        }
+
+        uint16_t * out = video->cache_memory_block + (cache_slot_pixels(video) * cache_slot);
+        uint32_t cache_bytes = 0;
+        int cacheable = 1;
 
-        pthread_mutex_lock( &video->cache_mutex ); //cache mutex used first time ;)
-        getMlvRawFrameFloat(video, cache_frame, imagefloat1d);
-        pthread_mutex_unlock( &video->cache_mutex );
+        if (video->cache_mode == MLV_CACHE_RGB16)
+        {
+            /* Decoding and llrawproc are thread safe, all cache threads work at the same time */
+            getMlvRawFrameFloatWithBuffers(video, cache_frame, imagefloat1d, &buffers);
 
-        /* Single thread AMaZE */
-        demosaic(&amaze_params);
+            /* Single thread AMaZE */
+            demosaic(&amaze_params);
 
-        /* To 16-bit */
-        uint16_t * out = video->rgb_raw_frames[cache_frame];
-        for (uint32_t i = 0; i < pixelsize-10; i++)
+            /* To 16-bit */
+            for (uint32_t i = 0; i < pixelsize-10; i++)
+            {
+                uint16_t * pix = out + (i*3);
+                pix[0] = (uint16_t)MIN(red1d[i], 65535);
+                pix[1] = (uint16_t)MIN(green1d[i], 65535);
+                pix[2] = (uint16_t)MIN(blue1d[i], 65535);
+            }
+        }
+        else
         {
-            uint16_t * pix = out + (i*3);
-            pix[0] = (uint16_t)MIN(red1d[i], 65535);
-            pix[1] = (uint16_t)MIN(green1d[i], 65535);
-            pix[2] = (uint16_t)MIN(blue1d[i], 65535);
+            cacheable = cache_bayer_frame(video, encoder, cache_frame, out, &cache_bytes, &buffers);
         }
 
         pthread_mutex_lock( &video->g_mutexFind );
-        video->cached_frames[cache_frame] = MLV_FRAME_IS_CACHED;
+        /* Cache was reset meanwhile, slot is free again and the frame stays uncached */
+        if (video->cache_slot_frame[cache_slot] == (int64_t)cache_frame)
+        {
+            video->cached_frames[cache_frame] = (cacheable) ? MLV_FRAME_IS_CACHED : MLV_FRAME_NOT_CACHEABLE;
+            video->cache_slot_bytes[cache_slot] = cache_bytes;
+            if (!cacheable) video->cache_slot_frame[cache_slot] = -1;
+        }
+        video->cache_slot_busy[cache_slot] = 0;
         pthread_mutex_unlock( &video->g_mutexFind );
 
-        DEBUG( printf("Debayered frame %llu/%llu has been cached.\n", cache_frame+1, video->cache_limit_frames); )
+        DEBUG( printf("Debayered frame %llu/%llu has been cached (slot %llu).\n", cache_frame+1, (uint64_t)getMlvFrames(video), cache_slot); )
+
+        core_budget_release(CORE_BUDGET_CACHING, granted);
     }
 
     free(red1d);
@@ -285,8 +555,12 @@ void an_mlv_cache_thread(mlvObject_t * video)
     free(blue2d);
     free(imagefloat2d);
     free(imagefloat1d);
+    free(buffers.raw_frame);
+    free(buffers.unpacked_frame);
+    lj92_encoder_close(encoder);
 
     pthread_mutex_lock( &video->g_mutexCount );
+    if (budget_free_thread) video->cache_free_thread = 0;
     video->cache_thread_count--;
     pthread_mutex_unlock( &video->g_mutexCount );
 }
@@ -296,14 +570,31 @@ void get_mlv_raw_frame_debayered( mlvObject_t * video,
                                   uint64_t frame_index,
                                   float * temp_memory, 
                                   uint16_t * output_frame, 
-                                  int debayer_type ) /* 0=bilinear 1=amaze ... */
+                                  int debayer_type, /* 0=bilinear 1=amaze ... */
+                                  mlvFrameBuffers_t * buffers )
 {
-    int width = getMlvWidth(video);
-    int height = getMlvHeight(video);
-
     /* Get the raw data in B&W */
-    getMlvRawFrameFloat(video, frame_index, temp_memory);
+    getMlvRawFrameFloatWithBuffers(video, frame_index, temp_memory, buffers);
+
+    debayer_mlv_raw_frame(video, temp_memory, output_frame, debayer_type);
+}
+
+/* Debayers a float bayer frame, WB conversion and CA correction happen in temp_memory */
+void debayer_mlv_raw_frame( mlvObject_t * video,
+                            float * temp_memory,
+                            uint16_t * output_frame,
+                            int debayer_type )
+{
+    debayer_mlv_raw_area(video, temp_memory, output_frame, getMlvWidth(video), getMlvHeight(video), debayer_type);
+}
 
+/* Same for a part of the frame which starts on a red pixel */
+void debayer_mlv_raw_area( mlvObject_t * video,
+                           float * temp_memory,
+                           uint16_t * output_frame,
+                           int width, int height,
+                           int debayer_type )
+{
     wb_convert_info_t wb_info;
 
     /* WB conversion for ideal debayer result, not for bilinear, easy and non debayer */
@@ -326,10 +617,17 @@ void get_mlv_raw_frame_debayered( mlvObject_t * video,
 
             lrtpCaCorrect( imagefloat2d, 0, 0, width, height,
                            0, 0, video->ca_red, video->ca_blue, 0 );
+
+            free(imagefloat2d);
         }
     }
 
-    /* Debayer */
+    /* Debayer, sharing the worker pool of the processing object. Runs for the viewer and export
+     * (cache threads debayer with their own single threaded AMaZE and never get here).
+     * If the pool is busy with another job, all tiles run on the calling thread */
+    processing_pool_t * pool = (video->processing) ? processingGetThreadPool(video->processing) : NULL;
+    int granted = core_budget_acquire(CORE_BUDGET_DEBAYER, getMlvCpuCores(video));
+    int threads = MAX(granted, 1);
     if (/*debayer_type == 1 ||*/ debayer_type == 4 || debayer_type == 5 || /*debayer_type == 6 ||*/ debayer_type == 7 || debayer_type == 8)
     {
         //AMaZE and AHD disabled from librtprocess because of bad artifacts
@@ -337,12 +635,12 @@ void get_mlv_raw_frame_debayered( mlvObject_t * video,
     }
     else if (debayer_type == 1 )
     {
-        debayerAmaze(output_frame, temp_memory, width, height, getMlvCpuCores(video), getMlvBlackLevel(video));
+        debayerAmazePool(output_frame, temp_memory, width, height, threads, getMlvBlackLevel(video), pool);
     }
     else if(debayer_type == 2 || debayer_type == 3)
     {
         /* threaded easy types */
-        debayerEasy(output_frame, temp_memory, width, height, getMlvCpuCores(video), debayer_type);
+        debayerEasyPool(output_frame, temp_memory, width, height, threads, debayer_type, pool);
     }
     else if (debayer_type == 6 )
     {
@@ -353,8 +651,193 @@ void get_mlv_raw_frame_debayered( mlvObject_t * video,
         /* Debayer quickly (bilinearly) */
         debayerBasic(output_frame, temp_memory, width, height, 1);
     }
+    core_budget_release(CORE_BUDGET_DEBAYER, granted);
 
     /* WB conversion undo for ideal debayer result */
     if( !( debayer_type == 0 || debayer_type == 2 || debayer_type == 3 ) )
         wb_undo(&wb_info, output_frame, width, height, getMlvBlackLevel(video));
 }
+
+/* Copies a cached frame to output_frame, bayer cache modes debayer it on the way. Returns 0 if frame is not cached */
+int get_mlv_cached_frame(mlvObject_t * video, uint64_t frame_index, uint16_t * output_frame, mlvFrameBuffers_t * buffers)
+{
+    size_t pixels = (size_t)getMlvWidth(video) * getMlvHeight(video);
+    int cache_mode = video->cache_mode;
+    void * copy = NULL;
+    uint32_t bytes = 0;
+
+    /* Copy under lock, so the slot can't be given to another frame meanwhile */
+    pthread_mutex_lock( &video->g_mutexFind );
+    if (video->cached_frames[frame_index] == MLV_FRAME_IS_CACHED)
+    {
+        uint16_t * slot = video->rgb_raw_frames[frame_index];
+        switch (cache_mode)
+        {
+            case MLV_CACHE_BAYER16:
+                copy = take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+                if (copy) memcpy(copy, slot, pixels * sizeof(uint16_t));
+                break;
+            case MLV_CACHE_BAYER_LJ92:
+                bytes = video->cache_slot_bytes[(slot - video->cache_memory_block) / cache_slot_pixels(video)];
+                copy = take_mlv_frame_buffer(video, MLV_BUFFER_RAW);
+                if (copy) memcpy(copy, slot, bytes);
+                break;
+            case MLV_CACHE_RGB16:
+            default:
+                memcpy(output_frame, slot, pixels * 3 * sizeof(uint16_t));
+                copy = output_frame;
+                break;
+        }
+    }
+    pthread_mutex_unlock( &video->g_mutexFind );
+
+    if (!copy) return 0;
+    if (cache_mode == MLV_CACHE_RGB16) return 1;
+
+    /* Bayer: decompress, then debayer like an uncached frame */
+    uint16_t * bayer = copy;
+    if (cache_mode == MLV_CACHE_BAYER_LJ92)
+    {
+        bayer = take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+        if (!bayer)
+        {
+            give_mlv_frame_buffer(video, MLV_BUFFER_RAW, copy);
+            return 0;
+        }
+        int width, height, bitdepth, components = 1;
+        lj92_bayer_size(video, &width, &height);
+        lj92 decoder_object;
+        int ret = lj92_open(&decoder_object, copy, bytes, &width, &height, &bitdepth, &components);
+        if (ret == LJ92_ERROR_NONE)
+        {
+            ret = lj92_decode(decoder_object, bayer, width * height * components, 0, NULL, 0);
+            lj92_close(decoder_object);
+        }
+        give_mlv_frame_buffer(video, MLV_BUFFER_RAW, copy);
+        if (ret != LJ92_ERROR_NONE)
+        {
+            DEBUG( printf("LJ92 cache decoder: Failed with error code (%d)\n", ret); )
+            give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer);
+            return 0;
+        }
+    }
+
+    float * own_raw_frame = (buffers) ? buffers->float_frame : NULL;
+    float * raw_frame = (own_raw_frame) ? own_raw_frame : take_mlv_frame_buffer(video, MLV_BUFFER_FLOAT);
+    if (!raw_frame)
+    {
+        give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer);
+        return 0;
+    }
+    mlv_bayer16_to_float(video, bayer, raw_frame);
+    give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer);
+    debayer_mlv_raw_frame(video, raw_frame, output_frame, doesMlvAlwaysUseAmaze(video));
+    if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_FLOAT, raw_frame);
+
+    return 1;
+}
+
+/* Size in bytes of a frame buffer of a MLV_BUFFER_* kind */
+size_t getMlvFrameBufferSize(mlvObject_t * video, int kind)
+{
+    size_t pixels = (size_t)getMlvWidth(video) * getMlvHeight(video);
+
+    switch (kind)
+    {
+        case MLV_BUFFER_RAW:
+            return video->raw_buffer_size;
+        case MLV_BUFFER_BAYER16:
+            return pixels * sizeof(uint16_t);
+        case MLV_BUFFER_FLOAT:
+            return pixels * sizeof(float);
+        case MLV_BUFFER_RGB16:
+        default:
+            return pixels * 3 * sizeof(uint16_t);
+    }
+}
+
+/* Borrow a buffer from the arena. If all slots are in use (should not happen), a temporary one is allocated.
+ * Returns NULL if there is no memory for it */
+void * take_mlv_frame_buffer(mlvObject_t * video, int kind)
+{
+    frame_buffer_pool_t * pool = &video->frame_buffers[kind];
+    size_t size = getMlvFrameBufferSize(video, kind);
+    void * buffer = NULL;
+
+    pthread_mutex_lock( &video->frame_buffers_mutex );
+    for (int i = 0; i < MLV_BUFFER_SLOTS; ++i)
+    {
+        if (pool->in_use[i]) continue;
+
+        /* First use or clip changed */
+        if (pool->size[i] != size)
+        {
+            free(pool->data[i]);
+            pool->data[i] = malloc(size);
+            pool->size[i] = (pool->data[i]) ? size : 0;
+            if (!pool->data[i]) break;
+        }
+        pool->in_use[i] = 1;
+        buffer = pool->data[i];
+        break;
+    }
+    pthread_mutex_unlock( &video->frame_buffers_mutex );
+
+    if (!buffer)
+    {
+        DEBUG( printf("Frame buffer arena: no free slot of kind %d\n", kind); )
+        buffer = malloc(size);
+        DEBUG( if (!buffer) printf("Frame buffer arena: out of memory\n"); )
+    }
+
+    return buffer;
+}
+
+/* Give a borrowed buffer back to the arena */
+void give_mlv_frame_buffer(mlvObject_t * video, int kind, void * buffer)
+{
+    frame_buffer_pool_t * pool = &video->frame_buffers[kind];
+
+    pthread_mutex_lock( &video->frame_buffers_mutex );
+    for (int i = 0; i < MLV_BUFFER_SLOTS; ++i)
+    {
+        if (pool->in_use[i] && pool->data[i] == buffer)
+        {
+            pool->in_use[i] = 0;
+            pthread_mutex_unlock( &video->frame_buffers_mutex );
+            return;
+        }
+    }
+    pthread_mutex_unlock( &video->frame_buffers_mutex );
+
+    /* Was a temporary one */
+    free(buffer);
+}
+
+/* Frees all arena buffers and calculates the raw buffer size for the current clip */
+void reset_mlv_frame_buffers(mlvObject_t * video)
+{
+    pthread_mutex_lock( &video->frame_buffers_mutex );
+    for (int kind = 0; kind < MLV_BUFFER_KINDS; ++kind)
+    {
+        for (int i = 0; i < MLV_BUFFER_SLOTS; ++i)
+        {
+            free(video->frame_buffers[kind].data[i]);
+            video->frame_buffers[kind].data[i] = NULL;
+            video->frame_buffers[kind].size[i] = 0;
+            video->frame_buffers[kind].in_use[i] = 0;
+        }
+    }
+
+    /* Biggest of: unpacked 16 bit frame, packed frame, any (lossless) frame in the index */
+    size_t raw_size = (size_t)getMlvWidth(video) * getMlvHeight(video) * sizeof(uint16_t);
+    if (video->video_index)
+    {
+        for (uint32_t i = 0; i < video->frames; ++i)
+        {
+            raw_size = MAX(raw_size, video->video_index[i].frame_size);
+        }
+    }
+    video->raw_buffer_size = raw_size + 4; // additional 4 bytes for safety
+    pthread_mutex_unlock( &video->frame_buffers_mutex );
+}
@@ -25,16 +25,30 @@ SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "lj92.h"
 
 typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
+typedef uint64_t u64;
 
-//#define SLOW_HUFF
 //#define DEBUG
 
+// Bits looked up at once in the combined huffman + extend table
+#define FASTBITS 14
+
+#if defined(__GNUC__)
+#define BSWAP32(x) __builtin_bswap32(x)
+#else
+#define BSWAP32(x) ((((x)&0xFF)<<24)|(((x)&0xFF00)<<8)|(((x)>>8)&0xFF00)|((x)>>24))
+#endif
+// Non zero if one of the 4 bytes of w is 0xFF
+#define HAS_FF(w) (((~(w)) - 0x01010101u) & (w) & 0x80808080u)
+
 typedef struct _ljp {
     u8* data;
     u8* dataend;
@@ -45,6 +59,7 @@ typedef struct _ljp {
     int y; // Height
     int bits; // Bit depth
     int components;  // Components(Nf)
+    int restart; // Restart interval in MCUs (DRI), 0 if none
     int writelen; // Write rows this long
     int skiplen; // Skip this many values after each row
     u16* linearize; // Linearization table
@@ -52,20 +67,10 @@ typedef struct _ljp {
     //int sssshist[16];
 
     // Huffman table - only one supported, and probably needed
-#ifdef SLOW_HUFF
-    int* maxcode;
-    int* mincode;
-    int* valptr;
-    u8* huffval;
-    int* huffsize;
-    int* huffcode;
-#else
     u16* hufflut;
     int huffbits;
-#endif
+    int32_t* fastlut; // Huffman code and extra bits decoded at once: diff<<8 | bits used, 0 if not in table
     // Parse state
-    int cnt;
-    u32 b;
     u16* image;
     u16* rowcache;
     u16* outrow[2];
@@ -88,132 +93,11 @@ static int find(ljp* self) {
 static int parseHuff(ljp* self) {
     int ret = LJ92_ERROR_CORRUPT;
     u8* huffhead = &self->data[self->ix]; // xstruct.unpack('>HB16B',self.data[self.ix:self.ix+19])
-    u8* bits = &huffhead[2];
-    bits[0] = 0; // Because table starts from 1
     int hufflen = BEH(huffhead[0]);
-    if ((self->ix + hufflen) >= self->datalen) return ret;
-#ifdef SLOW_HUFF
-    u8* huffval = calloc(hufflen - 19,sizeof(u8));
-    if (huffval == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->huffval = huffval;
-    for (int hix=0;hix<(hufflen-19);hix++) {
-        huffval[hix] = self->data[self->ix+19+hix];
-#ifdef DEBUG
-        printf("huffval[%d]=%d\n",hix,huffval[hix]);
-#endif
-    }
-    self->ix += hufflen;
-    // Generate huffman table
-    int k = 0;
-    int i = 1;
-    int j = 1;
-    int huffsize_needed = 1;
-    // First calculate how long huffsize needs to be
-    while (i<=16) {
-        while (j<=bits[i]) {
-            huffsize_needed++;
-            k = k+1;
-            j = j+1;
-        }
-        i = i+1;
-        j = 1;
-    }
-    // Now allocate and do it
-    int* huffsize = calloc(huffsize_needed,sizeof(int));
-    if (huffsize == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->huffsize = huffsize;
-    k = 0;
-    i = 1;
-    j = 1;
-    // First calculate how long huffsize needs to be
-    int hsix = 0;
-    while (i<=16) {
-        while (j<=bits[i]) {
-            huffsize[hsix++] = i;
-            k = k+1;
-            j = j+1;
-        }
-        i = i+1;
-        j = 1;
-    }
-    huffsize[hsix++] = 0;
-
-    // Calculate the size of huffcode array
-    int huffcode_needed = 0;
-    k = 0;
-    int code = 0;
-    int si = huffsize[0];
-    while (1) {
-        while (huffsize[k] == si) {
-            huffcode_needed++;
-            code = code+1;
-            k = k+1;
-        }
-        if (huffsize[k] == 0)
-            break;
-        while (huffsize[k] != si) {
-            code = code << 1;
-            si = si + 1;
-        }
-    }
-    // Now fill it
-    int* huffcode = calloc(huffcode_needed,sizeof(int));
-    if (huffcode == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->huffcode = huffcode;
-    int hcix = 0;
-    k = 0;
-    code = 0;
-    si = huffsize[0];
-    while (1) {
-        while (huffsize[k] == si) {
-            huffcode[hcix++] = code;
-            code = code+1;
-            k = k+1;
-        }
-        if (huffsize[k] == 0)
-            break;
-        while (huffsize[k] != si) {
-            code = code << 1;
-            si = si + 1;
-        }
-    }
-
-    i = 0;
-    j = 0;
-
-    int* maxcode = calloc(17,sizeof(int));
-    if (maxcode == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->maxcode = maxcode;
-    int* mincode = calloc(17,sizeof(int));
-    if (mincode == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->mincode = mincode;
-    int* valptr = calloc(17,sizeof(int));
-    if (valptr == NULL) return LJ92_ERROR_NO_MEMORY;
-    self->valptr = valptr;
-
-    while (1) {
-        while (1) {
-            i++;
-            if (i>16)
-                break;
-            if (bits[i]!=0)
-                break;
-            maxcode[i] = -1;
-        }
-        if (i>16)
-            break;
-        valptr[i] = j;
-        mincode[i] = huffcode[j];
-        j = j+bits[i]-1;
-        maxcode[i] = huffcode[j];
-        j++;
-    }
-    free(huffsize);
-    self->huffsize = NULL;
-    free(huffcode);
-    self->huffcode = NULL;
-    ret = LJ92_ERROR_NONE;
-#else
+    if ((self->ix + hufflen) >= self->datalen || hufflen < 19) return ret;
+    u8 bits[17]; // Copy, the data may be read only (memory mapped file)
+    memcpy(bits, &huffhead[2], sizeof(bits));
+    bits[0] = 0; // Because table starts from 1
     /* Calculate huffman direct lut */
     // How many bits in the table - find highest entry
     u8* huffvals = &self->data[self->ix+19];
@@ -224,7 +108,7 @@ static int parseHuff(ljp* self) {
     }
     self->huffbits = maxbits;
     /* Now fill the lut */
-    u16* hufflut = malloc((1<<maxbits) * sizeof(u16));
+    u16* hufflut = calloc((1<<maxbits), sizeof(u16));
     if (hufflut == NULL) return LJ92_ERROR_NO_MEMORY;
     self->hufflut = hufflut;
     int i = 0;
@@ -260,8 +144,31 @@ static int parseHuff(ljp* self) {
         i++;
         rv++;
     }
+
+    /* Combined table: codes which fit into FASTBITS together with their extra bits give the diff right away */
+    int32_t* fastlut = malloc((1<<FASTBITS) * sizeof(int32_t));
+    if (fastlut == NULL) return LJ92_ERROR_NO_MEMORY;
+    self->fastlut = fastlut;
+    for (int peek = 0; peek < (1<<FASTBITS); peek++) {
+        int index = (maxbits <= FASTBITS) ? peek >> (FASTBITS - maxbits) : peek << (maxbits - FASTBITS);
+        int usedbits = hufflut[index] & 0xFF;
+        int t = hufflut[index] >> 8;
+        int32_t entry = 0;
+        if (usedbits && usedbits <= FASTBITS) {
+            if (t == 16) {
+                entry = ((1 << 15) << 8) | usedbits;
+            } else if (t < 16 && usedbits + t <= FASTBITS) {
+                int diff = 0;
+                if (t) {
+                    diff = (peek >> (FASTBITS - usedbits - t)) & ((1 << t) - 1);
+                    if (diff < (1 << (t-1))) diff += 1 - (1 << t);
+                }
+                entry = diff * 256 + usedbits + t;
+            }
+        }
+        fastlut[peek] = entry;
+    }
     ret = LJ92_ERROR_NONE;
-#endif
     return ret;
 }
 
@@ -275,133 +182,117 @@ static int parseSof3(ljp* self) {
     return LJ92_ERROR_NONE;
 }
 
-static int parseBlock(ljp* self) {
+static int parseDri(ljp* self) {
+    if (self->ix+3 >= self->datalen) return LJ92_ERROR_CORRUPT;
+    self->restart = BEH(self->data[self->ix+2]);
     self->ix += BEH(self->data[self->ix]);
-    if (self->ix >= self->datalen) return LJ92_ERROR_CORRUPT;
     return LJ92_ERROR_NONE;
 }
 
-#ifdef SLOW_HUFF
-static int nextbit(ljp* self) {
-    u32 b = self->b;
-    if (self->cnt == 0) {
-        u8* data = &self->data[self->ix];
-        u32 next = *data++;
-        b = next;
-        if (next == 0xff) {
-            data++;
-            self->ix++;
-        }
-        self->ix++;
-        self->cnt = 8;
-    }
-    int bit = b >> 7;
-    self->cnt--;
-    self->b = (b << 1)&0xFF;
-    return bit;
+static int parseBlock(ljp* self) {
+    self->ix += BEH(self->data[self->ix]);
+    if (self->ix >= self->datalen) return LJ92_ERROR_CORRUPT;
+    return LJ92_ERROR_NONE;
 }
 
-static int decode(ljp* self) {
-    int i = 1;
-    int code = nextbit(self);
-    while (code > self->maxcode[i]) {
-        i++;
-        code = (code << 1) + nextbit(self);
-    }
-    int j = self->valptr[i];
-    j = j + code - self->mincode[i];
-    int value = self->huffval[j];
-    return value;
+/* Bit reader: cnt valid bits in the low end of a 64 bit reservoir.
+ * Reading stops at a marker, behind it zero bits are fed and counted in pad,
+ * so more bits used than there are (cnt < pad) means the data is cut */
+typedef struct {
+    u64 b;
+    int cnt;
+    int pad;
+    u8* ix;
+    u8* end;
+} ljbits;
+
+static void initbits(ljbits* br, u8* ix, u8* end) {
+    br->b = 0;
+    br->cnt = 0;
+    br->pad = 0;
+    br->ix = ix;
+    br->end = end;
 }
 
-static int receive(ljp* self,int ssss) {
-    if (ssss == 16) {
-        return 1 << 15;
-    }
-    int i = 0;
-    int v = 0;
-    while (i != ssss) {
-        i++;
-        v = (v<<1) + nextbit(self);
+static inline void fillbits(ljbits* br) {
+    while (br->cnt <= 56) {
+        // Fast path, 4 bytes without 0xFF (no stuffing, no marker)
+        if (br->cnt <= 32 && br->ix + 4 <= br->end) {
+            u32 w;
+            memcpy(&w, br->ix, 4);
+            if (!HAS_FF(w)) {
+                br->b = (br->b << 32) | BSWAP32(w);
+                br->cnt += 32;
+                br->ix += 4;
+                continue;
+            }
+        }
+        u32 byte = 0;
+        if (br->ix < br->end) {
+            byte = *br->ix++;
+            if (byte == 0xFF) {
+                if (br->ix < br->end && *br->ix == 0x00) {
+                    br->ix++; // Stuffed zero
+                } else {
+                    br->end = --br->ix; // Marker, end of scan
+                    byte = 0;
+                    br->pad += 8;
+                }
+            }
+        } else {
+            br->pad += 8;
+        }
+        br->b = (br->b << 8) | byte;
+        br->cnt += 8;
     }
-    return v;
 }
 
-static int extend(ljp* self,int v,int t) {
-    int vt = 1<<(t-1);
-    if (v < vt) {
-        vt = (-1 << t) + 1;
-        v = v + vt;
+inline static int nextdiff(ljp* self, ljbits* br) {
+    if (br->cnt < 32) fillbits(br); // Longest code + extra bits
+    int32_t fast = self->fastlut[(br->b >> (br->cnt - FASTBITS)) & ((1 << FASTBITS) - 1)];
+    if (fast & 0xFF) {
+        br->cnt -= fast & 0xFF;
+        return fast >> 8;
     }
-    return v;
+    int index = (br->b >> (br->cnt - self->huffbits)) & ((1 << self->huffbits) - 1);
+    u16 ssssused = self->hufflut[index];
+    int t = ssssused >> 8;
+    br->cnt -= ssssused & 0xFF;
+    if (t >= 16) return 1 << 15;
+    if (t == 0) return 0;
+    br->cnt -= t;
+    int diff = (br->b >> br->cnt) & ((1 << t) - 1);
+    if (diff < (1 << (t-1))) diff += 1 - (1 << t);
+    return diff;
 }
-#endif
 
-inline static int nextdiff(ljp* self) {
-#ifdef SLOW_HUFF
-    int t = decode(self);
-    int diff = receive(self,t);
-    diff = extend(self,diff,t);
-#else
-    u32 b = self->b;
-    int cnt = self->cnt;
-    int huffbits = self->huffbits;
-    int ix = self->ix;
-    int next;
-    while (cnt < huffbits) {
-        next = *(u16*)&self->data[ix];
-        int one = next&0xFF;
-        int two = next>>8;
-        b = (b<<16)|(one<<8)|two;
-        cnt += 16;
-        ix += 2;
-        if (one==0xFF) {
-            //printf("%x %x %x %x %d\n",one,two,b,b>>8,cnt);
-            b >>= 8;
-            cnt -= 8;
-        } else if (two==0xFF) ix++;
+// Predictor 6 into plain rows (no linearization), previous row is read from the output.
+// The first row is predicted like the first row of the image (start of scan or restart interval)
+static int parsePred6Rows(ljp* self, ljbits* br, u16* out, int rows, int stride) {
+    int x = self->x;
+    u16* lastrow;
+
+    // First row predicted from the left
+    int left = (u16)((1 << (self->bits-1)) + nextdiff(self, br));
+    out[0] = left;
+    for (int col = 1; col < x; col++) {
+        left = (u16)(left + nextdiff(self, br));
+        out[col] = left;
     }
-    int index = b >> (cnt - huffbits);
-    u16 ssssused = self->hufflut[index];
-    int usedbits = ssssused&0xFF;
-    int t = ssssused>>8;
-    //self->sssshist[t]++;
-    cnt -= usedbits;
-    int keepbitsmask = (1 << cnt)-1;
-    b &= keepbitsmask;
-    int diff;
-    if (t == 16) {
-        diff = 1 << 15;
-    } else {
-        while (cnt < t) {
-            next = *(u16*)&self->data[ix];
-            int one = next&0xFF;
-            int two = next>>8;
-            b = (b<<16)|(one<<8)|two;
-            cnt += 16;
-            ix += 2;
-            if (one==0xFF) {
-                b >>= 8;
-                cnt -= 8;
-            } else if (two==0xFF) ix++;
-        }
-        cnt -= t;
-        diff = b >> cnt;
-        int vt = 1<<(t-1);
-        if (diff < vt) {
-            vt = (-1 << t) + 1;
-            diff += vt;
+    if (br->cnt < br->pad) return LJ92_ERROR_CORRUPT;
+
+    for (int row = 1; row < rows; row++) {
+        lastrow = out;
+        out += stride;
+        left = (u16)(lastrow[0] + nextdiff(self, br)); // Use value above for first pixel in row
+        out[0] = left;
+        for (int col = 1; col < x; col++) {
+            left = (u16)(lastrow[col] + ((left - lastrow[col-1]) >> 1) + nextdiff(self, br));
+            out[col] = left;
         }
+        if (br->cnt < br->pad) return LJ92_ERROR_CORRUPT;
     }
-    keepbitsmask = (1 << cnt)-1;
-    self->b = b & keepbitsmask;
-    self->cnt = cnt;
-    self->ix = ix;
-    //printf("%d %d\n",t,diff);
-#ifdef DEBUG
-#endif
-#endif
-    return diff;
+    return LJ92_ERROR_NONE;
 }
 
 static int parsePred6(ljp* self) {
@@ -409,12 +300,13 @@ static int parsePred6(ljp* self) {
     self->ix = self->scanstart;
     //int compcount = self->data[self->ix+2];
     self->ix += BEH(self->data[self->ix]);
-    self->cnt = 0;
-    self->b = 0;
+    ljbits br;
+    initbits(&br, &self->data[self->ix], self->dataend);
     int write = self->writelen;
     // Now need to decode huffman coded values
     int c = 0;
     int pixels = self->y * self->x;
+    if (!self->linearize && write >= pixels) return parsePred6Rows(self, &br, self->image, self->y, self->x);
     u16* out = self->image;
     u16* temprow;
     u16* thisrow = self->outrow[0];
@@ -429,7 +321,7 @@ static int parsePred6(ljp* self) {
     int linear;
 
     // First pixel
-    diff = nextdiff(self);
+    diff = nextdiff(self, &br);
     Px = 1 << (self->bits-1);
     left = Px + diff;
     left = (u16) (left%65536);
@@ -439,11 +331,11 @@ static int parsePred6(ljp* self) {
         linear = left;
     thisrow[col++] = left;
     out[c++] = linear;
-    if (self->ix >= self->datalen) return ret;
+    if (br.cnt < br.pad) return ret;
     --write;
     int rowcount = self->x-1;
     while (rowcount--) {
-        diff = nextdiff(self);
+        diff = nextdiff(self, &br);
         Px = left;
         left = Px + diff;
         left = (u16) (left%65536);
@@ -454,7 +346,7 @@ static int parsePred6(ljp* self) {
         thisrow[col++] = left;
         out[c++] = linear;
         //printf("%d %d %d %d %x\n",col-1,diff,left,thisrow[col-1],&thisrow[col-1]);
-        if (self->ix >= self->datalen) return ret;
+        if (br.cnt < br.pad) return ret;
         if (--write==0) {
             out += self->skiplen;
             write = self->writelen;
@@ -467,7 +359,7 @@ static int parsePred6(ljp* self) {
     //printf("%x %x\n",thisrow,lastrow);
     while (c<pixels) {
         col = 0;
-        diff = nextdiff(self);
+        diff = nextdiff(self, &br);
         Px = lastrow[col]; // Use value above for first pixel in row
         left = Px + diff;
         left = (u16) (left%65536);
@@ -479,14 +371,14 @@ static int parsePred6(ljp* self) {
         thisrow[col++] = left;
         //printf("%d %d %d %d\n",col,diff,left,lastrow[col]);
         out[c++] = linear;
-        if (self->ix >= self->datalen) break;
+        if (br.cnt < br.pad) break;
         rowcount = self->x-1;
         if (--write==0) {
             out += self->skiplen;
             write = self->writelen;
         }
         while (rowcount--) {
-            diff = nextdiff(self);
+            diff = nextdiff(self, &br);
             Px = lastrow[col] + ((left - lastrow[col-1])>>1);
             left = Px + diff;
             left = (u16) (left%65536);
@@ -506,12 +398,148 @@ static int parsePred6(ljp* self) {
         temprow = lastrow;
         lastrow = thisrow;
         thisrow = temprow;
-        if (self->ix >= self->datalen) break;
+        if (br.cnt < br.pad) break;
     }
     if (c >= pixels) ret = LJ92_ERROR_NONE;
     return ret;
 }
 
+// Predictor 1 into plain rows (no linearization, MLV lossless from camera), previous row is read from the output
+static int parsePred1Rows(ljp* self, ljbits* br, u16* out, int rows, int stride) {
+    int comps = self->components;
+    int rowlen = self->x * comps;
+    u16* lastrow = NULL;
+
+    for (int row = 0; row < rows; row++) {
+        // First pixel of each component predicted from base value or the one above
+        for (int c = 0; c < comps; c++) {
+            int Px = (row == 0) ? 1 << (self->bits-1) : lastrow[c];
+            out[c] = (u16)(Px + nextdiff(self, br));
+        }
+        for (int i = comps; i < rowlen; i++) {
+            out[i] = (u16)(out[i - comps] + nextdiff(self, br));
+        }
+        lastrow = out;
+        out += stride;
+    }
+    return LJ92_ERROR_NONE;
+}
+
+// Any predictor into plain rows, only used for restart intervals
+static int parsePredRows(ljp* self, ljbits* br, int pred, u16* out, int rows, int stride) {
+    int comps = self->components;
+    int rowlen = self->x * comps;
+    if (pred == 6 && comps == 1) return parsePred6Rows(self, br, out, rows, stride);
+    if (pred == 1) return parsePred1Rows(self, br, out, rows, stride);
+
+    for (int row = 0; row < rows; row++) {
+        u16* lastrow = out - stride;
+        for (int i = 0; i < rowlen; i++) {
+            int Px;
+            if (row == 0)
+                Px = (i < comps) ? 1 << (self->bits-1) : out[i - comps];
+            else if (i < comps)
+                Px = lastrow[i];
+            else {
+                int Ra = out[i - comps], Rb = lastrow[i], Rc = lastrow[i - comps];
+                switch (pred) {
+                    case 1: Px = Ra; break;
+                    case 2: Px = Rb; break;
+                    case 3: Px = Rc; break;
+                    case 4: Px = Ra + Rb - Rc; break;
+                    case 5: Px = Ra + ((Rb - Rc) >> 1); break;
+                    case 6: Px = Rb + ((Ra - Rc) >> 1); break;
+                    case 7: Px = (Ra + Rb) >> 1; break;
+                    default: Px = 0; break;
+                }
+            }
+            out[i] = (u16)(Px + nextdiff(self, br));
+        }
+        if (br->cnt < br->pad) return LJ92_ERROR_CORRUPT;
+        out += stride;
+    }
+    return LJ92_ERROR_NONE;
+}
+
+// Restart intervals are independent of each other, so they are decoded in parallel
+static int parseRestart(ljp* self, int pred) {
+    if (self->x == 0 || self->restart % self->x) return LJ92_ERROR_CORRUPT;
+    int rows = self->restart / self->x; // Rows per interval
+    int count = (self->y + rows - 1) / rows;
+    int stride = self->x * self->components;
+    int ret = LJ92_ERROR_NONE;
+
+    // Every interval but the first starts behind a RSTn marker
+    u8** start = malloc(count * sizeof(u8*));
+    if (start == NULL) return LJ92_ERROR_NO_MEMORY;
+    u8* ix = &self->data[self->ix];
+    int found = 0;
+    start[found++] = ix;
+    while (found < count && ix + 1 < self->dataend) {
+        ix = memchr(ix, 0xFF, self->dataend - ix - 1);
+        if (ix == NULL) break;
+        if (ix[1] >= 0xD0 && ix[1] <= 0xD7) {
+            ix += 2;
+            start[found++] = ix;
+        } else if (ix[1] == 0x00 || ix[1] == 0xFF) {
+            ix += 1; // Stuffed zero or fill byte
+        } else break; // Any other marker ends the scan
+    }
+    if (found < count) {
+        free(start);
+        return LJ92_ERROR_CORRUPT;
+    }
+
+    // Decode straight into the target if it is a plain image
+    u16* out = self->image;
+    if (self->linearize || self->skiplen) {
+        out = malloc((size_t)stride * self->y * sizeof(u16));
+        if (out == NULL) {
+            free(start);
+            return LJ92_ERROR_NO_MEMORY;
+        }
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < count; i++) {
+        ljbits br;
+        initbits(&br, start[i], self->dataend);
+        int n = (i == count - 1) ? self->y - i * rows : rows;
+        int r = parsePredRows(self, &br, pred, out + (size_t)i * rows * stride, n, stride);
+        if (r == LJ92_ERROR_NONE && br.cnt < br.pad) r = LJ92_ERROR_CORRUPT;
+        if (r != LJ92_ERROR_NONE) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+            ret = r;
+        }
+    }
+
+    if (out != self->image) {
+        // Linearize and write as tile
+        u16* dst = self->image;
+        int write = self->writelen;
+        int pixels = stride * self->y;
+        for (int c = 0; c < pixels && ret == LJ92_ERROR_NONE; c++) {
+            int linear = out[c];
+            if (self->linearize) {
+                if (linear>self->linlen) ret = LJ92_ERROR_CORRUPT;
+                else linear = self->linearize[linear];
+            }
+            *dst++ = linear;
+            if (--write==0) {
+                dst += self->skiplen;
+                write = self->writelen;
+            }
+        }
+        free(out);
+    }
+    free(start);
+    return ret;
+}
+
 static int parseScan(ljp* self) {
     int ret = LJ92_ERROR_CORRUPT;
     //memset(self->sssshist,0,sizeof(self->sssshist));
@@ -519,10 +547,15 @@ static int parseScan(ljp* self) {
     int compcount = self->data[self->ix+2];
     int pred = self->data[self->ix+3+2*compcount];
     if (pred<0 || pred>7) return ret;
+    if (self->restart) {
+        self->ix += BEH(self->data[self->ix]);
+        return parseRestart(self, pred);
+    }
     if (pred==6) return parsePred6(self); // Fast path
     self->ix += BEH(self->data[self->ix]);
-    self->cnt = 0;
-    self->b = 0;
+    ljbits br;
+    initbits(&br, &self->data[self->ix], self->dataend);
+    if (pred==1 && !self->linearize) return parsePred1Rows(self, &br, self->image, self->y, self->x * self->components + self->skiplen); // Fast path
     u16* out = self->image;
     u16* thisrow = self->outrow[0];
     u16* lastrow = self->outrow[1];
@@ -573,7 +606,7 @@ static int parseScan(ljp* self) {
                     }
                 }
                 
-                diff = nextdiff(self);
+                diff = nextdiff(self, &br);
                 left = Px + diff;
                 left = (u16) (left%65536);
                 //printf("%d %d %d\n",c,diff,left);
@@ -608,6 +641,8 @@ static int parseImage(ljp* self) {
             ret = parseHuff(self);
         else if (nextMarker == 0xc3)
             ret = parseSof3(self);
+        else if (nextMarker == 0xdd) // Restart interval
+            ret = parseDri(self);
         else if (nextMarker == 0xfe)// Comment
             ret = parseBlock(self);
         else if (nextMarker == 0xd9) // End of image
@@ -634,23 +669,10 @@ static int findSoI(ljp* self) {
 }
 
 static void free_memory(ljp* self) {
-#ifdef SLOW_HUFF
-    free(self->maxcode);
-    self->maxcode = NULL;
-    free(self->mincode);
-    self->mincode = NULL;
-    free(self->valptr);
-    self->valptr = NULL;
-    free(self->huffval);
-    self->huffval = NULL;
-    free(self->huffsize);
-    self->huffsize = NULL;
-    free(self->huffcode);
-    self->huffcode = NULL;
-#else
     free(self->hufflut);
     self->hufflut = NULL;
-#endif
+    free(self->fastlut);
+    self->fastlut = NULL;
     free(self->rowcache);
     self->rowcache = NULL;
 }
@@ -727,80 +749,93 @@ typedef struct _lje {
     uint8_t* encoded;
     int encodedWritten;
     int encodedLength;
+    int restart; // Rows per restart interval, 0 if only one
     int hist[18]; // SSSS frequency histogram
     int bits[18];
     int huffval[18];
     u16 huffenc[18];
     u16 huffbits[18];
     int huffsym[18];
+    // Kept from frame to frame
+    int16_t* diffs; // Prediction differences of the whole image
+    int diffsize;
+    u16* rowcache; // Rows gathered from a tiled or delinearized image
+    int rowsize;
+    int tableframes; // Frames a Huffman table is used for
+    int tableage; // Frames encoded with the current table, 0 if there is none
+    int tablebits; // Bit depth the table was made for
 } lje;
 
-int frequencyScan(lje* self) {
-    // Scan through the tile using the standard type 6 prediction
-    // Need to cache the previous 2 row in target coordinates because of tiling
-    uint16_t* pixel = self->image;
-    int pixcount = self->width*self->height;
-    int scan = self->readLength;
-    uint16_t* rowcache = (uint16_t*)calloc(1,self->width*4);
-    uint16_t* rows[2];
-    rows[0] = rowcache;
-    rows[1] = &rowcache[self->width];
+// Predictor 6 differences of one row, first is set for the first row of the image or a restart interval
+static void predictRow(u16* cur, u16* up, int width, int first, int bitdepth, int16_t* diff) {
+    if (first) {
+        diff[0] = (int16_t)(cur[0] - (1 << (bitdepth-1)));
+        for (int col = 1; col < width; col++)
+            diff[col] = (int16_t)(cur[col] - cur[col-1]);
+        return;
+    }
+    diff[0] = (int16_t)(cur[0] - up[0]); // Use value above for first pixel in row
+    int col = 1;
+#ifdef __SSE2__
+    // (left - upleft) >> 1 is avg(left, ~upleft) - 0x8000, exact for all 16 bit values
+    const __m128i ones = _mm_set1_epi16(-1);
+    const __m128i half = _mm_set1_epi16((short)0x8000);
+    for (; col + 8 <= width; col += 8) {
+        __m128i left = _mm_loadu_si128((__m128i*)&cur[col-1]);
+        __m128i upleft = _mm_loadu_si128((__m128i*)&up[col-1]);
+        __m128i above = _mm_loadu_si128((__m128i*)&up[col]);
+        __m128i pixel = _mm_loadu_si128((__m128i*)&cur[col]);
+        __m128i grad = _mm_sub_epi16(_mm_avg_epu16(left, _mm_xor_si128(upleft, ones)), half);
+        __m128i Px = _mm_add_epi16(above, grad);
+        _mm_storeu_si128((__m128i*)&diff[col], _mm_sub_epi16(pixel, Px));
+    }
+#endif
+    for (; col < width; col++) {
+        int Px = up[col] + ((cur[col-1] - up[col-1]) >> 1);
+        diff[col] = (int16_t)(cur[col] - Px);
+    }
+}
 
-    int col = 0;
-    int row = 0;
-    int Px = 0;
-    int32_t diff = 0;
-    //int maxval = (1 << self->bitdepth);
-    while (pixcount--) {
-        uint16_t p = *pixel;
-        /* if (self->delinearize) {
-            if (p>=self->delinearizeLength) {
-                free(rowcache);
-                return LJ92_ERROR_TOO_WIDE;
+// One pass through the tile: prediction differences and, if a new table is due, their SSSS histogram
+static int predictImage(lje* self, int histogram) {
+    int width = self->width;
+    int16_t* diff = self->diffs;
+    // Rows can be used in place if the tile is one plain block
+    int plain = !self->delinearize && (self->readLength % width == 0) && (self->skipLength == 0 || self->readLength >= width*self->height);
+    u16* pixel = self->image;
+    int scan = self->readLength;
+    u16* rows[2] = { self->rowcache, self->rowcache + width };
+    u16* up = NULL;
+    int row = 0; // Row within the restart interval
+
+    memset(self->hist, 0, sizeof(self->hist));
+    for (int y = 0; y < self->height; y++) {
+        u16* cur;
+        if (plain) {
+            cur = self->image + (size_t)y * width;
+        } else {
+            cur = rows[y & 1];
+            for (int col = 0; col < width; col++) {
+                u16 p = *pixel++;
+                cur[col] = self->delinearize ? self->delinearize[p] : p;
+                if (--scan==0) { pixel += self->skipLength; scan = self->readLength; }
             }
-            p = self->delinearize[p];
         }
-        if (p>=maxval) {
-            free(rowcache);
-            return LJ92_ERROR_TOO_WIDE;
-        } */
-        rows[1][col] = p;
-
-        if ((row == 0)&&(col == 0))
-            Px = 1 << (self->bitdepth-1);
-        else if (row == 0)
-            Px = rows[1][col-1];
-        else if (col == 0)
-            Px = rows[0][col];
-        else
-            Px = rows[0][col] + ((rows[1][col-1] - rows[0][col-1])>>1);
-        diff = rows[1][col] - Px;
-        diff = diff%65536;
-        diff = (int16_t)diff;
-        int ssss = 32 - __builtin_clz(abs(diff));
-        if (diff==0) ssss=0;
-        self->hist[ssss]++;
-        //printf("%d %d %d %d %d %d\n",col,row,p,Px,diff,ssss);
-        pixel++;
-        scan--;
-        col++;
-        if (scan==0) { pixel += self->skipLength; scan = self->readLength; }
-        if (col==self->width) {
-            uint16_t* tmprow = rows[1];
-            rows[1] = rows[0];
-            rows[0] = tmprow;
-            col=0;
-            row++;
+        predictRow(cur, up, width, row == 0, self->bitdepth, diff);
+        if (histogram) {
+            for (int col = 0; col < width; col++) {
+                int d = diff[col];
+                self->hist[d ? 32 - __builtin_clz(abs(d)) : 0]++;
+            }
         }
+        diff += width;
+        up = cur;
+        row++;
+        if (row==self->restart) row = 0; // Prediction starts over in each restart interval
     }
 #ifdef DEBUG
-    int sort[17];
-    for (int h=0;h<17;h++) {
-        sort[h] = h;
-        printf("%d:%d\n",h,self->hist[h]);
-    }
+    for (int h=0;h<17;h++) printf("%d:%d\n",h,self->hist[h]);
 #endif
-    free(rowcache);
     return LJ92_ERROR_NONE;
 }
 
@@ -809,8 +844,9 @@ void createEncodeTable(lje* self) {
     int codesize[18];
     int others[18];
 
-    // Calculate frequencies
-    float totalpixels = self->width * self->height;
+    // Calculate frequencies (the histogram may hold more than the pixels for a reused table)
+    float totalpixels = 0;
+    for (int i=0;i<17;i++) totalpixels += self->hist[i];
     for (int i=0;i<17;i++) {
         freq[i] = (float)(self->hist[i])/totalpixels;
 #ifdef DEBUG
@@ -1013,6 +1049,12 @@ void writeHeader(lje* self) {
         e[w++] = 0; // Component ID
         e[w++] = 0x11; // Component X/Y
         e[w++] = 0; // Unused (Quantisation)
+    if (self->restart) {
+        int mcus = self->restart*self->width;
+        e[w++] = 0xff; e[w++] = 0xdd; //DRI
+        e[w++] = 0x0; e[w++] = 4; //Lr, restart interval length
+        e[w++] = mcus>>8; e[w++] = mcus&0xFF;
+    }
     e[w++] = 0xff; e[w++] = 0xda; //SCAN
     // Write SCAN
         e[w++] = 0x0; e[w++] = 8; //Ls, scan header length
@@ -1033,146 +1075,95 @@ void writePost(lje* self) {
 }
 
 int writeBody(lje* self) {
-    // Scan through the tile using the standard type 6 prediction
-    // Need to cache the previous 2 row in target coordinates because of tiling
-    uint16_t* pixel = self->image;
-    int pixcount = self->width*self->height;
-    int scan = self->readLength;
-    uint16_t* rowcache = (uint16_t*)calloc(1,self->width*4);
-    uint16_t* rows[2];
-    rows[0] = rowcache;
-    rows[1] = &rowcache[self->width];
-
-    int col = 0;
-    int row = 0;
-    int Px = 0;
-    int32_t diff = 0;
-    //int bitcount = 0;
-    uint8_t* out = self->encoded;
-    int w = self->encodedWritten;
-    uint8_t next = 0;
-    uint8_t nextbits = 8;
-    while (pixcount--) {
-        uint16_t p = *pixel;
-        if (self->delinearize) p = self->delinearize[p];
-        rows[1][col] = p;
-
-        if ((row == 0)&&(col == 0))
-            Px = 1 << (self->bitdepth-1);
-        else if (row == 0)
-            Px = rows[1][col-1];
-        else if (col == 0)
-            Px = rows[0][col];
-        else
-            Px = rows[0][col] + ((rows[1][col-1] - rows[0][col-1])>>1);
-        diff = rows[1][col] - Px;
-        diff = diff%65536;
-        diff = (int16_t)diff;
-        int ssss = 32 - __builtin_clz(abs(diff));
-        if (diff==0) ssss=0;
-        //printf("%d %d %d %d %d\n",col,row,Px,diff,ssss);
-
-        // Write the huffman code for the ssss value
+    // Huffman code and its length for each SSSS
+    u32 code[17];
+    int codelen[17];
+    for (int ssss = 0; ssss < 17; ssss++) {
         int huffcode = self->huffsym[ssss];
-        int huffenc = self->huffenc[huffcode];
-        int huffbits = self->huffbits[huffcode];
+        code[ssss] = self->huffenc[huffcode];
+        codelen[ssss] = self->huffbits[huffcode];
+    }
 
-        int vt = ssss>0?(1<<(ssss-1)):0;
-        //printf("%d %d %d %d\n",rows[1][col],Px,diff,Px+diff);
-#ifdef DEBUG
-#endif
-        if (diff < vt)
-            diff += (1 << (ssss))-1;
-
-        // Write the ssss
-        while (huffbits>0) {
-            int usebits = huffbits>nextbits?nextbits:huffbits;
-            // Add top usebits from huffval to next usebits of nextbits
-            int tophuff = huffenc >> (huffbits - usebits);
-            next |= (tophuff << (nextbits-usebits));
-            nextbits -= usebits;
-            huffbits -= usebits;
-            huffenc &= (1<<huffbits)-1;
-            if (nextbits==0) {
-                if(w >= self->encodedLength - 1)
-                {
-                    free(rowcache);
-                    return LJ92_ERROR_ENCODER;
-                }
-                out[w++] = next;
-                if (next==0xff) out[w++] = 0x0;
-                next = 0;
-                nextbits = 8;
-            }
-        }
-        // Write the rest of the bits for the value
-        if (ssss == 16) {
+    int16_t* diff = self->diffs;
+    u8* out = self->encoded + self->encodedWritten;
+    u8* limit = self->encoded + self->encodedLength - 16; // One value takes 32 bits at most, 8 bytes with stuffing
+    u64 b = 0;
+    int cnt = 0;
+    int rst = 0;
+    int row = 0;
+    for (int y = 0; y < self->height; y++) {
+        if (out >= limit) return LJ92_ERROR_ENCODER;
+        for (int col = 0; col < self->width; col++) {
+            int d = *diff++;
+            int ssss = d ? 32 - __builtin_clz(abs(d)) : 0;
+            u32 v = code[ssss];
+            int n = codelen[ssss];
             // Diff values (always 32678) for SSSS=16 are encoded with 0 bits
-            ssss = 0;
-        }
-        while (ssss>0) {
-            int usebits = ssss>nextbits?nextbits:ssss;
-            // Add top usebits from huffval to next usebits of nextbits
-            int tophuff = diff >> (ssss - usebits);
-            next |= (tophuff << (nextbits-usebits));
-            nextbits -= usebits;
-            ssss -= usebits;
-            diff &= (1<<ssss)-1;
-            if (nextbits==0) {
-                if(w >= self->encodedLength - 1)
-                {
-                    free(rowcache);
-                    return LJ92_ERROR_ENCODER;
-                }
-                out[w++] = next;
-                if (next==0xff) out[w++] = 0x0;
-                next = 0;
-                nextbits = 8;
+            if (ssss && ssss < 16) {
+                if (d < 0) d += (1 << ssss) - 1;
+                v = (v << ssss) | (d & ((1 << ssss) - 1));
+                n += ssss;
+            }
+            b = (b << n) | v;
+            cnt += n;
+            while (cnt >= 8) {
+                cnt -= 8;
+                u8 byte = (u8)(b >> cnt);
+                *out++ = byte;
+                if (byte==0xff) *out++ = 0x0;
             }
+            if (out >= limit) return LJ92_ERROR_ENCODER;
         }
-
-        //printf("%d %d\n",diff,ssss);
-        pixel++;
-        scan--;
-        col++;
-        if (scan==0) { pixel += self->skipLength; scan = self->readLength; }
-        if (col==self->width) {
-            uint16_t* tmprow = rows[1];
-            rows[1] = rows[0];
-            rows[0] = tmprow;
-            col=0;
-            row++;
+        row++;
+        if (row==self->restart && y < self->height - 1) {
+            // End of restart interval, pad with 1 bits and write RSTn
+            if (cnt) {
+                u8 byte = (u8)((b << (8 - cnt)) | ((1 << (8 - cnt)) - 1));
+                *out++ = byte;
+                if (byte==0xff) *out++ = 0x0;
+                cnt = 0;
+            }
+            *out++ = 0xff; *out++ = 0xd0 + (rst++ & 7);
+            row = 0;
         }
     }
     // Flush the final bits
-    if (nextbits<8) {
-        out[w++] = next;
-        if (next==0xff) out[w++] = 0x0;
-    }
-#ifdef DEBUG
-    int sort[18];
-    for (int h=0;h<18;h++) {
-        sort[h] = h;
-        printf("%d:%d\n",h,self->hist[h]);
+    if (cnt) {
+        u8 byte = (u8)(b << (8 - cnt));
+        *out++ = byte;
+        if (byte==0xff) *out++ = 0x0;
     }
-    printf("Total bytes: %d\n",bitcount>>3);
-#endif
-    free(rowcache);
-    self->encodedWritten = w;
+    self->encodedWritten = out - self->encoded;
     return LJ92_ERROR_NONE;
 }
-/* Encoder
- * Read tile from an image and encode in one shot
- * Return the encoded data
- */
-int lj92_encode(uint16_t* image, int width, int height, int bitdepth,
-                int readLength, int skipLength,
-                uint16_t* delinearize,int delinearizeLength,
-                uint8_t** encoded, int* encodedLength) {
-    int ret = LJ92_ERROR_NONE;
 
+/* Encoder context: buffers and Huffman table are kept from frame to frame */
+int lj92_encoder_open(lj92_encoder* enc, int tableFrames) {
     lje* self = (lje*)calloc(sizeof(lje),1);
+    *enc = self;
     if (self==NULL) return LJ92_ERROR_NO_MEMORY;
+    self->tableframes = tableFrames > 1 ? tableFrames : 1;
+    return LJ92_ERROR_NONE;
+}
+
+void lj92_encoder_close(lj92_encoder enc) {
+    lje* self = enc;
+    if (self == NULL) return;
+    free(self->diffs);
+    free(self->rowcache);
+    free(self);
+}
+
+int lj92_encoder_encode(lj92_encoder enc,
+                        uint16_t* image, int width, int height, int bitdepth,
+                        int readLength, int skipLength,
+                        uint16_t* delinearize,int delinearizeLength,
+                        int slices,
+                        uint8_t* encoded, int encodedSize, int* encodedLength) {
+    lje* self = enc;
+    if (self == NULL) return LJ92_ERROR_BAD_HANDLE;
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535 || bitdepth < 1 || bitdepth > 16) return LJ92_ERROR_TOO_WIDE;
+    if (encodedSize < 128) return LJ92_ERROR_ENCODER;
     self->image = image;
     self->width = width;
     self->height = height;
@@ -1181,39 +1172,105 @@ int lj92_encode(uint16_t* image, int width, int height, int bitdepth,
     self->skipLength = skipLength;
     self->delinearize = delinearize;
     self->delinearizeLength = delinearizeLength;
-    self->encodedLength = width*height*3+200;
-    self->encoded = malloc(self->encodedLength);
-    if (self->encoded==NULL) { free(self); return LJ92_ERROR_NO_MEMORY; }
-    // Scan through data to gather frequencies of ssss prefixes
-    ret = frequencyScan(self);
-    if (ret != LJ92_ERROR_NONE) {
-        free(self->encoded);
-        free(self);
-        return ret;
+    self->encoded = encoded;
+    self->encodedWritten = 0;
+    self->encodedLength = encodedSize;
+    self->restart = 0;
+    if (slices > 1) {
+        int rows = (height + slices - 1) / slices;
+        if (rows > 65535 / width) rows = 65535 / width; // DRI holds up to 65535 MCUs
+        if (rows < height) self->restart = rows;
     }
-    // Create encoded table based on frequencies
-    createEncodeTable(self);
-    // Write JPEG head and scan header
-    writeHeader(self);
-    // Scan through and do the compression
-    ret = writeBody(self);
-    if (ret != LJ92_ERROR_NONE) {
-        free(self->encoded);
-        free(self);
-        return ret;
+
+    // Buffers grow to the biggest image seen
+    int pixels = width * height;
+    if (pixels > self->diffsize) {
+        free(self->diffs);
+        self->diffs = malloc(pixels * sizeof(int16_t));
+        self->diffsize = self->diffs ? pixels : 0;
+        if (self->diffs == NULL) return LJ92_ERROR_NO_MEMORY;
+    }
+    if (width * 2 > self->rowsize) {
+        free(self->rowcache);
+        self->rowcache = malloc(width * 2 * sizeof(u16));
+        self->rowsize = self->rowcache ? width * 2 : 0;
+        if (self->rowcache == NULL) return LJ92_ERROR_NO_MEMORY;
+    }
+
+    // A new Huffman table every tableframes frames, frames in between skip the histogram
+    int newtable = (self->tableage == 0 || self->tableage >= self->tableframes || self->tablebits != bitdepth);
+    int ret;
+    while (1) {
+        ret = predictImage(self, newtable);
+        if (ret != LJ92_ERROR_NONE) return ret;
+        if (newtable) {
+            // A table which is reused needs a code for every SSSS
+            if (self->tableframes > 1)
+                for (int i = 0; i < 17; i++)
+                    if (self->hist[i] == 0) self->hist[i] = 1;
+            createEncodeTable(self);
+            self->tableage = 0;
+            self->tablebits = bitdepth;
+        }
+        self->tableage++;
+
+        // Write JPEG head and scan header
+        self->encodedWritten = 0;
+        writeHeader(self);
+        // Scan through and do the compression
+        ret = writeBody(self);
+        if (ret == LJ92_ERROR_NONE && self->encodedWritten + 2 > self->encodedLength) ret = LJ92_ERROR_ENCODER;
+        if (ret == LJ92_ERROR_NONE) break;
+        self->tableage = 0; // The histogram was not made for this frame
+        // A reused table may not suit this frame, it may still fit with its own
+        if (ret != LJ92_ERROR_ENCODER || newtable) return ret;
+        newtable = 1;
     }
     // Finish
     writePost(self);
 #ifdef DEBUG
     printf("written:%d\n",self->encodedWritten);
 #endif
-    self->encoded = realloc(self->encoded,self->encodedWritten);
-    self->encodedLength = self->encodedWritten;
-    *encoded = self->encoded;
-    *encodedLength = self->encodedLength;
+    *encodedLength = self->encodedWritten;
+    return LJ92_ERROR_NONE;
+}
 
-    free(self);
+/* Encoder
+ * Read tile from an image and encode in one shot
+ * Return the encoded data
+ */
+int lj92_encode(uint16_t* image, int width, int height, int bitdepth,
+                int readLength, int skipLength,
+                uint16_t* delinearize,int delinearizeLength,
+                uint8_t** encoded, int* encodedLength) {
+    return lj92_encode_slices(image, width, height, bitdepth, readLength, skipLength,
+                              delinearize, delinearizeLength, 1, encoded, encodedLength);
+}
 
+/* Same, but split into at least slices restart intervals which can be decoded in parallel.
+ * An interval holds whole rows and at most 65535 pixels, so there may be more slices */
+int lj92_encode_slices(uint16_t* image, int width, int height, int bitdepth,
+                       int readLength, int skipLength,
+                       uint16_t* delinearize,int delinearizeLength,
+                       int slices,
+                       uint8_t** encoded, int* encodedLength) {
+    lj92_encoder enc;
+    int ret = lj92_encoder_open(&enc, 1);
+    if (ret != LJ92_ERROR_NONE) return ret;
+    int size = width*height*3+200;
+    if (slices > 1) size += (slices + height) * 4; // Padding and RSTn
+    uint8_t* data = malloc(size);
+    if (data == NULL) {
+        lj92_encoder_close(enc);
+        return LJ92_ERROR_NO_MEMORY;
+    }
+    ret = lj92_encoder_encode(enc, image, width, height, bitdepth, readLength, skipLength,
+                              delinearize, delinearizeLength, slices, data, size, encodedLength);
+    lj92_encoder_close(enc);
+    if (ret != LJ92_ERROR_NONE) {
+        free(data);
+        return ret;
+    }
+    *encoded = realloc(data, *encodedLength);
     return ret;
 }
-
@@ -34,6 +34,7 @@ enum LJ92_ERRORS {
 };
 
 typedef struct _ljp* lj92;
+typedef struct _lje* lj92_encoder;
 
 /* Parse a lossless JPEG (1992) structure returning
  * - a handle that can be used to decode the data
@@ -68,4 +69,26 @@ int lj92_encode(uint16_t* image, int width, int height, int bitdepth,
                 int readLength, int skipLength,
                 uint16_t* delinearize,int delinearizeLength,
                 uint8_t** encoded, int* encodedLength);
+
+// Like lj92_encode, but the image is split into (at least) slices restart intervals.
+// lj92_decode decodes them in parallel, readers without restart marker support can't
+int lj92_encode_slices(uint16_t* image, int width, int height, int bitdepth,
+                       int readLength, int skipLength,
+                       uint16_t* delinearize,int delinearizeLength,
+                       int slices,
+                       uint8_t** encoded, int* encodedLength);
+
+// Encoder context for a sequence of frames, keeps its buffers and reuses a Huffman table
+// for tableFrames frames (1 = new table for every frame)
+int lj92_encoder_open(lj92_encoder* enc, int tableFrames);
+
+void lj92_encoder_close(lj92_encoder enc);
+
+// Encodes into encoded (encodedSize bytes), LJ92_ERROR_ENCODER if it does not fit
+int lj92_encoder_encode(lj92_encoder enc,
+                        uint16_t* image, int width, int height, int bitdepth,
+                        int readLength, int skipLength,
+                        uint16_t* delinearize,int delinearizeLength,
+                        int slices,
+                        uint8_t* encoded, int encodedSize, int* encodedLength);
 #endif
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "darkframe.h"
+#include "../video_mlv.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -42,6 +43,8 @@ static uint64_t file_set_pos(FILE *stream, uint64_t offset, int whence)
 static void df_unload( mlvObject_t* df_mlv )
 {
     /* Close all MLV file chunks */
+    unmap_mlv_chunks(df_mlv);
+    reset_mlv_frame_buffers(df_mlv);
     FILE** files = df_mlv->file;
     int entries = df_mlv->filenum;
     for(int i = 0; i < entries; i++)
@@ -67,6 +70,9 @@ static void df_unload( mlvObject_t* df_mlv )
         df_mlv->cached_frames = NULL;
     }
     if(df_mlv->rgb_raw_frames) free(df_mlv->rgb_raw_frames);
+    if(df_mlv->cache_slot_frame) free(df_mlv->cache_slot_frame);
+    if(df_mlv->cache_slot_busy) free(df_mlv->cache_slot_busy);
+    if(df_mlv->cache_slot_bytes) free(df_mlv->cache_slot_bytes);
     if(df_mlv->rgb_raw_current_frame) free(df_mlv->rgb_raw_current_frame);
     if(df_mlv->cache_memory_block) free(df_mlv->cache_memory_block);
     if(df_mlv->path) free(df_mlv->path);
@@ -77,7 +83,6 @@ static void df_unload( mlvObject_t* df_mlv )
     if(df_mlv->main_file_mutex) free(df_mlv->main_file_mutex);
     pthread_mutex_destroy(&df_mlv->g_mutexFind);
     pthread_mutex_destroy(&df_mlv->g_mutexCount);
-    pthread_mutex_destroy(&df_mlv->cache_mutex);
 }
 
 /* load dark frame from external averaged MLV file */
@@ -297,16 +302,28 @@ int df_validate(mlvObject_t * video, char * df_filename, char * error_message)
 /* process DF modes: Off, Ext or Int, if Off just free all DF data */
 int df_init(mlvObject_t * video)
 {
+    /* already loaded (or failed) for this mode, dark frame data is only read from here on */
+    if(video->llrawproc->dark_frame == video->llrawproc->dark_frame_loaded)
+    {
+        return (video->llrawproc->dark_frame_data) ? 0 : 1;
+    }
+
+    int ret;
     switch(video->llrawproc->dark_frame)
     {
         case DF_EXT:
-            return df_load_ext(video, NULL);
+            ret = df_load_ext(video, NULL);
+            break;
         case DF_INT:
-            return df_load_int(video);
+            ret = df_load_int(video);
+            break;
         default:
             df_free(video);
-            return 1; // DF mode = Off
+            ret = 1; // DF mode = Off
+            break;
     }
+    video->llrawproc->dark_frame_loaded = video->llrawproc->dark_frame;
+    return ret;
 }
 
 /* free all DF data */
@@ -322,4 +339,5 @@ void df_free(mlvObject_t * video)
         video->llrawproc->dark_frame_size = 0;
         memset(&video->llrawproc->dark_frame_hdr, 0, sizeof(mlv_dark_hdr_t));
     }
+    video->llrawproc->dark_frame_loaded = -1;
 }
@@ -39,7 +39,7 @@
 #define ABS(a) ((a) > 0 ? (a) : -(a))
 
 /* this is DNG feature only */
-static void deflicker(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size)
+static void deflicker(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size, int32_t exposure_bias[2])
 {
     uint16_t black = video->RAWI.raw_info.black_level;
     uint16_t white = (1 << video->RAWI.raw_info.bits_per_pixel) - 1;
@@ -48,8 +48,8 @@ static void deflicker(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw
     hist_add(hist, raw_image_buff + 1, (uint32_t)((raw_image_size - 1) / 2), 1);
     uint16_t median = hist_median(hist);
     double correction = log2((double) (video->llrawproc->deflicker_target - black) / (median - black));
-    video->RAWI.raw_info.exposure_bias[0] = correction * 10000;
-    video->RAWI.raw_info.exposure_bias[1] = 10000;
+    exposure_bias[0] = correction * 10000;
+    exposure_bias[1] = 10000;
 }
 
 /* convert uncompressed 10/12bit raw data to 14bit for subsequent processing */
@@ -162,12 +162,32 @@ void freeLLRawProcObject(mlvObject_t * video)
     free(video->llrawproc);
 }
 
-/* all low level raw processing takes place here */
-void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size)
+/* returns 1 if processing the next frame changes the llrawproc state: one time init, dark frame loading,
+   focus/bad pixel map loading or searching, stripe detection on the first frame, dual iso range scaling */
+static int llrp_needs_update(mlvObject_t * video)
 {
-    /* if 'fix_raw == false' skip raw processing alltogether */
-    if(!video->llrawproc->fix_raw) return;
+    llrawprocObject_t * llrawproc = video->llrawproc;
+
+    if(llrawproc->first_time) return 1;
+    if(llrawproc->dark_frame != llrawproc->dark_frame_loaded) return 1;
+    if(llrawproc->vertical_stripes && llrawproc->vertical_stripes != 2 && llrawproc->compute_stripes) return 1;
+    if(llrawproc->focus_pixels && llrawproc->fpm_status < 2) return 1;
+    if(llrawproc->bad_pixels && llrawproc->bpm_status < 2) return 1;
+
+    /* restricted lossless dual iso changes the processing levels for every frame */
+    if(llrawproc->diso_validity && llrawproc->dual_iso && (video->MLVI.videoClass & MLV_VIDEO_CLASS_FLAG_LJ92))
+    {
+        int32_t white_level = video->RAWI.raw_info.white_level;
+        if(video->RAWI.raw_info.bits_per_pixel < 14) white_level <<= 14 - video->RAWI.raw_info.bits_per_pixel;
+        if(white_level < 15000) return 1;
+    }
+
+    return 0;
+}
 
+/* all low level raw processing takes place here */
+static void apply_llrawproc(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size, llrawprocFrame_t * frame)
+{
     /* subtruct dark frame if Ext or Int mode specified and df_init is successful */
     if (!df_init(video))
     {
@@ -205,7 +225,11 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
     /* fix vertical stripes */
     if (video->llrawproc->vertical_stripes)
     {
-        fix_vertical_stripes(&video->llrawproc->stripe_corrections,
+        /* forced mode detects the coefficients for every frame, they stay local to the frame */
+        int forced = (video->llrawproc->vertical_stripes == 2);
+        stripes_correction frame_stripes = { 0 };
+        int frame_compute_stripes = 1;
+        fix_vertical_stripes((forced) ? &frame_stripes : &video->llrawproc->stripe_corrections,
                              raw_image_buff,
                              raw_info.black_level,
                              raw_info.white_level,
@@ -213,7 +237,7 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
                              video->RAWI.xRes,
                              video->RAWI.yRes,
                              video->llrawproc->vertical_stripes,
-                             &video->llrawproc->compute_stripes);
+                             (forced) ? &frame_compute_stripes : &video->llrawproc->compute_stripes);
     }
 
     /* fix focus pixels */
@@ -229,8 +253,8 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
                          video->IDNT.cameraModel,
                          video->RAWI.xRes,
                          video->RAWI.yRes,
-                         video->VIDF.panPosX,
-                         video->VIDF.panPosY,
+                         frame->pan_x,
+                         frame->pan_y,
                          raw_info.width,
                          raw_info.height,
                          crop_rec,
@@ -250,8 +274,8 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
                        video->IDNT.cameraModel,
                        video->RAWI.xRes,
                        video->RAWI.yRes,
-                       video->VIDF.panPosX,
-                       video->VIDF.panPosY,
+                       frame->pan_x,
+                       frame->pan_y,
                        raw_info.width,
                        raw_info.height,
                        raw_info.black_level,
@@ -315,11 +339,17 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
                                video->llrawproc->diso_frblending,
                                video->llrawproc->chroma_smooth);
 
-            /* for full20bit set diso levels and bit depth to 16 bit, needed for cDNG export */
+            /* for full20bit set diso levels and bit depth to 16 bit, needed for cDNG export.
+               same for every frame, so only written once (other threads may read them meanwhile) */
             int bits_shift = 16 - raw_info.bits_per_pixel;
-            video->llrawproc->dng_black_level = raw_info.black_level << bits_shift;
-            video->llrawproc->dng_white_level = raw_info.white_level << bits_shift;
-            video->llrawproc->dng_bit_depth = 16;
+            if (video->llrawproc->dng_bit_depth != 16
+             || video->llrawproc->dng_black_level != (int)raw_info.black_level << bits_shift
+             || video->llrawproc->dng_white_level != (int)raw_info.white_level << bits_shift)
+            {
+                video->llrawproc->dng_black_level = raw_info.black_level << bits_shift;
+                video->llrawproc->dng_white_level = raw_info.white_level << bits_shift;
+                video->llrawproc->dng_bit_depth = 16;
+            }
         }
         else if (video->llrawproc->dual_iso == 2) // Preview mode
         {
@@ -360,7 +390,7 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
 #ifndef STDOUT_SILENT
         printf("Per-frame exposure compensation: 'ON'\nDeflicker target: '%d'\n\n", video->llrawproc->deflicker_target);
 #endif
-        deflicker(video, raw_image_buff, raw_image_size);
+        deflicker(video, raw_image_buff, raw_image_size, frame->exposure_bias);
     }
 
 #ifndef STDOUT_SILENT
@@ -368,6 +398,38 @@ void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t
 #endif
 }
 
+void applyLLRawProcObjectFrame(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size, llrawprocFrame_t * frame)
+{
+    /* if 'fix_raw == false' skip raw processing alltogether */
+    if(!video->llrawproc->fix_raw) return;
+
+    /* frames which change the state are processed one at a time under the write lock.
+       after that the state is only read, so all following frames are processed in
+       parallel under the read lock, which keeps resets from freeing it meanwhile */
+    pthread_rwlock_rdlock(&video->llrawproc_lock);
+    if(!llrp_needs_update(video))
+    {
+        apply_llrawproc(video, raw_image_buff, raw_image_size, frame);
+        pthread_rwlock_unlock(&video->llrawproc_lock);
+        return;
+    }
+    pthread_rwlock_unlock(&video->llrawproc_lock);
+
+    pthread_rwlock_wrlock(&video->llrawproc_lock);
+    apply_llrawproc(video, raw_image_buff, raw_image_size, frame);
+    pthread_rwlock_unlock(&video->llrawproc_lock);
+}
+
+/* uses pan position of the last read VIDF and writes deflicker result to RAWI */
+void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size)
+{
+    llrawprocFrame_t frame = { video->VIDF.panPosX, video->VIDF.panPosY,
+                               { video->RAWI.raw_info.exposure_bias[0], video->RAWI.raw_info.exposure_bias[1] } };
+    applyLLRawProcObjectFrame(video, raw_image_buff, raw_image_size, &frame);
+    video->RAWI.raw_info.exposure_bias[0] = frame.exposure_bias[0];
+    video->RAWI.raw_info.exposure_bias[1] = frame.exposure_bias[1];
+}
+
 /* Detect focus dot fix mode according to RAWC block info (binning + skipping) and camera ID
    Return value 0 = off, 1 = On, 2 = CropRec */
 int llrpDetectFocusDotFixMode(mlvObject_t * video)
@@ -576,24 +638,34 @@ void llrpResetDngBWLevels(mlvObject_t * video)
 
 void llrpResetFpmStatus(mlvObject_t * video)
 {
+    pthread_rwlock_wrlock(&video->llrawproc_lock);
     reset_fpm_status(&(video->llrawproc->focus_pixel_map), &(video->llrawproc->fpm_status));
+    pthread_rwlock_unlock(&video->llrawproc_lock);
 }
 
 void llrpResetBpmStatus(mlvObject_t * video)
 {
+    pthread_rwlock_wrlock(&video->llrawproc_lock);
     reset_bpm_status(&(video->llrawproc->bad_pixel_map), &(video->llrawproc->bpm_status));
+    pthread_rwlock_unlock(&video->llrawproc_lock);
 }
 
 /* dark frame stuff */
 void llrpInitDarkFrameExtFileName(mlvObject_t * video, char * df_filename)
 {
+    pthread_rwlock_wrlock(&video->llrawproc_lock);
     df_free_filename(video);
     df_init_filename(video, df_filename);
+    /* new file, load it on next frame */
+    video->llrawproc->dark_frame_loaded = -1;
+    pthread_rwlock_unlock(&video->llrawproc_lock);
 }
 
 void llrpFreeDarkFrameExtFileName(mlvObject_t * video)
 {
+    pthread_rwlock_wrlock(&video->llrawproc_lock);
     df_free_filename(video);
+    pthread_rwlock_unlock(&video->llrawproc_lock);
 }
 
 int llrpGetDarkFrameMode(mlvObject_t * video)
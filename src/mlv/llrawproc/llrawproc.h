@@ -27,8 +27,18 @@
 llrawprocObject_t * initLLRawProcObject();
 void freeLLRawProcObject(mlvObject_t * video);
 
+/* per frame input and output of low level raw processing */
+typedef struct
+{
+    uint16_t pan_x;            // pan position from the VIDF header of the frame
+    uint16_t pan_y;
+    int32_t exposure_bias[2];  // deflicker result, unchanged if deflicker is off
+} llrawprocFrame_t;
+
 /* all low level raw processing takes place here */
 void applyLLRawProcObject(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size);
+/* same, but thread safe: many threads may process frames of one clip at once */
+void applyLLRawProcObjectFrame(mlvObject_t * video, uint16_t * raw_image_buff, size_t raw_image_size, llrawprocFrame_t * frame);
 
 /* Detect focus dot fix mode according to RAWC block info (binning + skipping) and camera ID
    Return value 0 = off, 1 = On, 2 = CropRec */
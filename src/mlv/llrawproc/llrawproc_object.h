@@ -37,7 +37,7 @@ typedef struct
     int focus_pixels;     // fix focus pixels, 0 - do not fix, 1 - fix, 2 - generates focus pixel map for crop_rec mode
     int fpi_method;       // focus pixel interpolation method: 0 - mlvfs, 1 - raw2dng
     int fpm_status;       // focus pixel map status: 0 = not loaded, 1 = loaded, 2 = not exist
-    int bad_pixels;       // fix bad pixels, 0 - do not fix, 1 - fix, 2 - force searching for every frame
+    int bad_pixels;       // fix bad pixels, 0 - do not fix, 1 - fix, 2 - force searching (once per clip, map reused for every frame)
     int bps_method;       // bad pixel search method: 0 - normal, 1 - aggresive
     int bpi_method;       // bad pixel interpolation method: 0 - mlvfs, 1 - raw2dng
     int bpm_status;       // bad pixel map status: 0 = not loaded, 1 = loaded, 2 = not exist, 3 = no bad pixels found
@@ -54,6 +54,7 @@ typedef struct
     int diso_alias_map;   // flag for Alias Map switchin on/off
     int diso_frblending;  // flag for Fullres Blending switching on/off
     int dark_frame;       // flag for Dark Frame subtraction mode 0 = off, 1 = ext, 2 = int
+    int dark_frame_loaded; // Dark Frame mode the current dark frame data was loaded for, -1 = reload needed
 
     /* cDNG bit depth and black/white levels */
     int dng_bit_depth;
@@ -1293,7 +1293,7 @@ bpm_check:
             switch(bpm_mode)
             {
                 case 1: // Auto mode
-                case 2: // Force mode
+                case 2: // Force mode, searched once per clip like auto mode
                 {
                    *bpm_status = 1; // search for bad pixels
                     break;
@@ -1470,15 +1470,6 @@ mem_err:
                     }
                 }
             }
-
-            if(bpm_mode == 2)
-            {
-                *bpm_status = 1;
-                bad_pixel_map->count = 0;
-#ifndef STDOUT_SILENT
-                printf("Searching bad pixels for every frame\n");
-#endif
-            }
             break;
         }
         default:
@@ -100,7 +100,14 @@ struct raw_8pixels
 #define F2H(ev) COERCE((int)(FIXP_RANGE/2 + ev * FIXP_RANGE/2), 0, FIXP_RANGE-1)
 #define H2F(x) ((double)((x) - FIXP_RANGE/2) / (FIXP_RANGE/2))
 
-static void add_pixel(int hist[8][FIXP_RANGE], int num[8], int offset, int pa, int pb, int32_t white_level)
+/* small LCG, rand() shares its state between all threads */
+static inline int dither_rand(uint32_t * seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7FFF;
+}
+
+static void add_pixel(int hist[8][FIXP_RANGE], int num[8], uint32_t * seed, int offset, int pa, int pb, int32_t white_level)
 {
     int a = pa;
     int b = pb;
@@ -121,8 +128,8 @@ static void add_pixel(int hist[8][FIXP_RANGE], int num[8], int offset, int pa, i
      * 
      * this removes spikes on the histogram, thus canceling bias towards "round" values
      */
-    double af = a + (rand() % 1024) / 1024.0 - 0.5;
-    double bf = b + (rand() % 1024) / 1024.0 - 0.5;
+    double af = a + (dither_rand(seed) % 1024) / 1024.0 - 0.5;
+    double bf = b + (dither_rand(seed) % 1024) / 1024.0 - 0.5;
     double factor = af / bf;
     double ev = log2(factor);
     
@@ -143,10 +150,10 @@ static void detect_vertical_stripes_coeffs(stripes_correction * correction,
                                            uint16_t width,
                                            uint16_t height)
 {
-    static int hist[8][FIXP_RANGE];
-    static int num[8];
-    memset(hist, 0, sizeof(hist));
-    memset(num, 0, sizeof(num));
+    /* not static, frames may be processed by several threads at once */
+    int (*hist)[FIXP_RANGE] = calloc(8, sizeof(*hist));
+    int num[8] = { 0 };
+    uint32_t seed = 1;
 
     int pitch = width * 2;
 
@@ -200,13 +207,13 @@ static void detect_vertical_stripes_coeffs(stripes_correction * correction,
              * and so on, to avoid getting tricked by smooth gradients.
              */
 
-            add_pixel(hist, num, 1, pa2, (pb * 1 + pb2 * 7) / 8, white_level);
-            add_pixel(hist, num, 2, pa2, (pc * 2 + pc2 * 6) / 8, white_level);
-            add_pixel(hist, num, 3, pa2, (pd * 3 + pd2 * 5) / 8, white_level);
-            add_pixel(hist, num, 4, pa2, (pe * 4 + pe2 * 4) / 8, white_level);
-            add_pixel(hist, num, 5, pa2, (pf * 5 + pf2 * 3) / 8, white_level);
-            add_pixel(hist, num, 6, pa2, (pg * 6 + pg2 * 2) / 8, white_level);
-            add_pixel(hist, num, 7, pa2, (ph * 7 + ph2 * 1) / 8, white_level);
+            add_pixel(hist, num, &seed, 1, pa2, (pb * 1 + pb2 * 7) / 8, white_level);
+            add_pixel(hist, num, &seed, 2, pa2, (pc * 2 + pc2 * 6) / 8, white_level);
+            add_pixel(hist, num, &seed, 3, pa2, (pd * 3 + pd2 * 5) / 8, white_level);
+            add_pixel(hist, num, &seed, 4, pa2, (pe * 4 + pe2 * 4) / 8, white_level);
+            add_pixel(hist, num, &seed, 5, pa2, (pf * 5 + pf2 * 3) / 8, white_level);
+            add_pixel(hist, num, &seed, 6, pa2, (pg * 6 + pg2 * 2) / 8, white_level);
+            add_pixel(hist, num, &seed, 7, pa2, (ph * 7 + ph2 * 1) / 8, white_level);
         }
     }
 
@@ -261,6 +268,8 @@ static void detect_vertical_stripes_coeffs(stripes_correction * correction,
     //system("octave-cli --persist debug_graph.m");
 #endif
 
+    free(hist);
+
     correction->coeffficients[0] = FIXP_ONE;
 
     /* do we really need stripe correction, or it won't be noticeable? or maybe it's just computation error? */
@@ -7,7 +7,8 @@
 #define getMlvRawCacheLimitMegaBytes(video) (video)->cache_limit_mb
 #define getMlvRawCacheLimitFrames(video) (video)->cache_limit_frames
 #define isMlvObjectCaching(video) (video)->cache_thread_count
-/* And here's an UNUSED (at this moment) macrofuntion - ignored */
+#define getMlvCacheMode(video) (video)->cache_mode
+/* Playhead of the cache window, normally moved by getMlvRawFrameDebayered() */
 #define setMlvCacheStartFrame(video, startFrame) (video)->cache_start_frame = (startFrame)
 
 /* Do something like this before doing things: if (isMlvActive(your_mlvObject)) */
@@ -16,6 +17,9 @@
 /* Useful getting macros */
 #define getMlvWidth(video) (video)->RAWI.xRes
 #define getMlvHeight(video) (video)->RAWI.yRes
+/* Size of a reduced preview frame (getMlvProcessedPreviewFrame8), scale 1 is the full frame */
+#define getMlvPreviewWidth(video, scale) (getMlvWidth(video) / (scale))
+#define getMlvPreviewHeight(video, scale) (getMlvHeight(video) / (scale))
 #define getMlvMaxWidth(video) ((video)->RAWI.raw_info.active_area.x2 - (video)->RAWI.raw_info.active_area.x1)
 #define getMlvMaxHeight(video) ((video)->RAWI.raw_info.active_area.y2 - (video)->RAWI.raw_info.active_area.y1)
 #define getMlvFrames(video) (video)->frames
@@ -48,7 +52,6 @@
 #define getMlvAudioChannels(video) (video)->WAVI.channels
 #define getMlvAudioBytesPerSecond(video) (video)->WAVI.bytesPerSecond
 #define getMlvAudioBitsPerSample(video) (video)->WAVI.bitsPerSample
-#define getMlvAudioData(video) (video)->audio_data
 #define getMlvAudioSize(video) (video)->audio_size
 #define getMlvTmYear(video)    ((video)->RTCI.tm_year+1900)
 #define getMlvTmMonth(video)   ((video)->RTCI.tm_mon+1)
@@ -77,6 +80,10 @@
 #define setMlvCpuCores(video, cores) (video)->cpu_cores = (cores)
 #define getMlvCpuCores(video) (video)->cpu_cores
 
+/* Independent LJ92 slices per frame for MLV_COMPRESS export, 1 for compatibility with other tools */
+#define setMlvLj92Slices(video, slices) (video)->lj92_slices = (slices)
+#define getMlvLj92Slices(video) (video)->lj92_slices
+
 /* Use setMlvAlwaysUseAmaze() to always get AMaZE frames, for best quality always */
 #define setMlvAlwaysUseAmaze(video) (video)->use_amaze = 1; (video)->current_cached_frame_active = 0
 /* Or this one for speed/ultimate playback performance, will give AMaZE if it is in cache, 
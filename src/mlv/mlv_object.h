@@ -12,10 +12,39 @@
 
 #include "camid/camera_id.h"
 
+/* LJ92 encoder for MLV_COMPRESS export */
+#include "liblj92/lj92.h"
+
+/* Frames one LJ92 huffman table is used for when encoding a sequence (export, cache) */
+#define LJ92_TABLE_FRAMES 8
+
 /* cache states */
 #define MLV_FRAME_NOT_CACHED 0
 #define MLV_FRAME_IS_CACHED 1
 #define MLV_FRAME_BEING_CACHED 2
+#define MLV_FRAME_NOT_CACHEABLE 3 /* Compressed frame did not fit into a slot */
+
+/* cache modes, what a cache slot holds */
+#define MLV_CACHE_RGB16       0 /* Debayered (AMaZE) 16 bit RGB, 6 bytes per pixel */
+#define MLV_CACHE_BAYER16     1 /* Bayer after low level raw processing, 2 bytes per pixel, debayered when shown */
+#define MLV_CACHE_BAYER_LJ92  2 /* Same, LJ92 compressed into slots of 4/3 bytes per pixel */
+
+/* frame buffer arena, buffer kinds */
+#define MLV_BUFFER_RAW     0 /* Packed or compressed raw data as read from file */
+#define MLV_BUFFER_BAYER16 1 /* Unpacked 16 bit bayer */
+#define MLV_BUFFER_FLOAT   2 /* Float bayer for debayering */
+#define MLV_BUFFER_RGB16   3 /* 16 bit RGB */
+#define MLV_BUFFER_KINDS   4
+/* Buffers per kind which can be in use at the same time (render, export, cache threads) */
+#define MLV_BUFFER_SLOTS   8
+
+/* Reusable buffers of one kind, allocated on first use and kept until the clip is closed */
+typedef struct
+{
+    void * data[MLV_BUFFER_SLOTS];
+    size_t size[MLV_BUFFER_SLOTS];
+    int in_use[MLV_BUFFER_SLOTS];
+} frame_buffer_pool_t;
 
 /* Struct of index of video and audio frames for quick access */
 typedef struct
@@ -30,7 +59,7 @@ typedef struct
 } frame_index_t;
 
 /* MLV App map file header (.MAPP) */
-#define MAPP_VERSION 3
+#define MAPP_VERSION 4
 typedef struct {
     uint8_t     fileMagic[4];  /* MAPP */
     uint64_t    mapp_size;     /* total MAPP file size */
@@ -41,20 +70,38 @@ typedef struct {
     uint32_t    vers_blocks;   /* total VERS blocks */
     uint64_t    audio_size;    /* total size of audio data in bytes */
     uint64_t    df_offset;     /* offset to the dark frame location */
+    uint32_t    chunk_count;   /* a mapp_chunk_t for each chunk follows the header */
+    uint64_t    audio_offset;  /* audio data is stored behind the index and loaded when needed */
+    uint64_t    checksum;      /* of everything from the end of the header to the audio data */
+    uint64_t    audio_checksum;
 } mapp_header_t;
 
+/* Fingerprint of a chunk the .MAPP was made from */
+typedef struct {
+    uint64_t    size;          /* chunk file size */
+    int64_t     mtime;         /* chunk modification time */
+    uint64_t    scanned_end;   /* end of the last complete block, indexing goes on from here if the chunk grows */
+    uint64_t    block_num;     /* complete blocks before scanned_end */
+} mapp_chunk_t;
+
 /* Struct for MLV handling */
 typedef struct {
 
     /* Amount of MLV chunks (.MLV, .M00, .M01, ...) */
     int filenum;
     uint64_t block_num; /* How many file blocks in MLV file */
+    uint64_t index_bytes_total; /* Bytes to index on open, set before the scans start */
+    uint64_t index_bytes_done;  /* Bytes indexed so far, atomic, the scan threads add to it */
+    mapp_chunk_t * chunk_info;  /* Size, time and indexed part of each chunk, saved to the .MAPP */
 
     /* 0=no, 1=yes, mlv file open */
     int is_active;
 
     /* MLV/Lite file(s) */
     FILE ** file;
+    uint8_t ** file_map; /* Memory mapped chunks, NULL entry if not mapped */
+    uint64_t * file_map_size;
+    int file_map_count;
     char * path;
     pthread_mutex_t * main_file_mutex; /* One for each file */
     pthread_mutex_t g_mutexFind; /* 'g' mutexes should prevent pink frames */
@@ -107,6 +154,8 @@ typedef struct {
     uint8_t * audio_data;        /* Audio buffer pointer */
     uint64_t  audio_size;        /* Aligned usable audio size */
     uint64_t  audio_buffer_size; /* Full audio buffer size to be freed */
+    uint64_t  audio_mapp_offset; /* Audio is still in the .MAPP at this offset, getMlvAudioData() loads it */
+    uint64_t  audio_mapp_checksum;
 
     /* Version info */
     uint32_t    vers_blocks;     /* Number of audio blocks */
@@ -115,6 +164,7 @@ typedef struct {
     /* Image processing object pointer (it is to be made separately) */
     processingObject_t * processing;
     llrawprocObject_t * llrawproc;
+    pthread_rwlock_t llrawproc_lock; /* Read locked by every llrawproc frame, write locked while a frame or a reset changes its state (maps, stripes, one time init) */
 
     /* Restricted lossless raw data bit depth */
     int lossless_bpp;
@@ -126,8 +176,7 @@ typedef struct {
     /* 0 = no, 1 = (yes... cache threads are alive right now) */
     int is_caching;
     int cache_thread_count; /* Total active cache threads */
-    uint64_t cache_next; /* Like a cache request (any non-zero frame) */
-    pthread_mutex_t cache_mutex;
+    int cache_free_thread; /* 1 while a cache thread runs which works without core budget */
     /* Will be set to 1 for cache threads to stop (probably only by freeMlvObject) */
     int stop_caching;
 
@@ -139,22 +188,35 @@ typedef struct {
     float ca_red;    /* Range -5..5 */
     float ca_blue;   /* Range -5..5 */
 
+    /* What is cached, MLV_CACHE_* */
+    int cache_mode;
+
     /* Basically how much we can cache(can be set by MB or frames or bytes) */
     uint64_t cache_limit_bytes;
     uint64_t cache_limit_frames;
     uint64_t cache_limit_mb; /* How many MB of frames can be cached... 
      * Debayered frames are cached with 16 bit channel bitdepth (48bpp) */
 
-    /* Not used, cache always starts at frame zero... for now */
+    /* Playhead, the cache holds a window of frames around it: most of them ahead in playback direction, a few behind */
     uint64_t cache_start_frame;
+    int cache_direction; /* 1 = forward, -1 = backward */
 
     uint8_t * cached_frames; /* Basically an array with as many elements as frames, cache states are defined above */
-    uint16_t ** rgb_raw_frames; /* Pointers to 16bit cached RGB frames */
+    uint16_t ** rgb_raw_frames; /* Pointers to 16bit cached RGB frames (into a slot, valid if frame is not MLV_FRAME_NOT_CACHED) */
+
+    /* Cache slots (cache_limit_frames of them) within cache_memory_block */
+    int64_t * cache_slot_frame; /* Frame held by the slot, -1 = free */
+    uint8_t * cache_slot_busy; /* A cache thread is writing into the slot */
+    uint32_t * cache_slot_bytes; /* Compressed size of the frame in the slot (MLV_CACHE_BAYER_LJ92) */
 
     /* A single cached frame, speeds up when asking for the same (non-cached) frame over and over again */
     int current_cached_frame_active;
     uint64_t current_cached_frame; int times_requested;
+    int current_cached_frame_scale; /* 1, or 2/4 for a reduced preview frame, 0 for a region */
+    int current_cached_frame_area[4]; /* x, y, width, height of the region */
+    int current_cached_frame_overview; /* A region has its whole frame at 1/MLV_REGION_OVERVIEW_SCALE size */
     uint16_t * rgb_raw_current_frame;
+    uint16_t * rgb_raw_current_overview;
 
     /* Massive block of memory for all frames that will be cached, pointers in rgb_raw_frames will point within here, 
      * using one big block block to try and avoid fragmentation (I feel that may be one of the causes of growth) */
@@ -163,6 +225,16 @@ typedef struct {
     /* How many cores, will not neccesarily determine number of threads made in any case, but helps */
     int cpu_cores; /* Default 4 */
 
+    /* LJ92 restart intervals per frame when compressing on MLV export, decoded in parallel.
+     * Default 1 (one stream), other tools may not read restart markers */
+    int lj92_slices;
+    lj92_encoder lj92_enc; /* Made on first MLV_COMPRESS frame */
+
+    /* Frame buffer arena: getting a frame does not malloc */
+    frame_buffer_pool_t frame_buffers[MLV_BUFFER_KINDS];
+    pthread_mutex_t frame_buffers_mutex;
+    size_t raw_buffer_size; /* Biggest raw frame in the clip (+ 4 bytes for safety) */
+
 
 } mlvObject_t;
 
@@ -14,6 +14,16 @@
 #include <alloca.h>
 #endif
 
+#if defined(__WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "video_mlv.h"
 #include "audio_mlv.h"
 
@@ -169,35 +179,261 @@ static void close_all_chunks(FILE ** files, int entries)
     if(files) free(files);
 }
 
+/* Map a whole chunk file read only, returns NULL if not possible (e.g. too big for the address space) */
+static uint8_t * map_chunk(FILE * file, uint64_t * size)
+{
+    uint8_t * map = NULL;
+    *size = 0;
+
+#if defined(__WIN32)
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    LARGE_INTEGER file_size;
+    if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &file_size)) return NULL;
+    if (file_size.QuadPart <= 0 || (uint64_t)file_size.QuadPart > (uint64_t)SIZE_MAX) return NULL;
+
+    HANDLE mapping = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return NULL;
+    map = (uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    /* The view keeps the mapping alive */
+    CloseHandle(mapping);
+    if (!map) return NULL;
+    *size = file_size.QuadPart;
+#else
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) != 0) return NULL;
+    if (file_stat.st_size <= 0 || (uint64_t)file_stat.st_size > (uint64_t)SIZE_MAX) return NULL;
+
+    void * addr = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+    if (addr == MAP_FAILED) return NULL;
+    map = (uint8_t *)addr;
+    *size = file_stat.st_size;
+#endif
+
+    return map;
+}
+
+/* Size and modification time of a chunk, tells if a .MAPP still belongs to it */
+static void get_chunk_fingerprint(FILE * file, uint64_t * size, int64_t * mtime)
+{
+    *size = 0;
+    *mtime = 0;
+#if defined(__WIN32)
+    struct _stat64 file_stat;
+    if (_fstat64(_fileno(file), &file_stat) != 0) return;
+#else
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) != 0) return;
+#endif
+    *size = file_stat.st_size;
+    *mtime = file_stat.st_mtime;
+}
+
+static void unmap_chunk(uint8_t * map, uint64_t size)
+{
+    if (!map) return;
+#if defined(__WIN32)
+    (void)size;
+    UnmapViewOfFile(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+void map_mlv_chunks(mlvObject_t * video)
+{
+    unmap_mlv_chunks(video);
+    if (!video->file) return;
+
+    /* mcraw has a single file, owned by the mcraw decoder */
+    int count = (isMcrawLoaded(video)) ? 1 : video->filenum;
+    if (count <= 0) return;
+
+    video->file_map = calloc(count, sizeof(uint8_t *));
+    video->file_map_size = calloc(count, sizeof(uint64_t));
+    video->file_map_count = count;
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (!video->file[i]) continue;
+        video->file_map[i] = map_chunk(video->file[i], video->file_map_size + i);
+        DEBUG( if (!video->file_map[i]) printf("Chunk %d not mapped, using fread\n", i); )
+    }
+}
+
+void unmap_mlv_chunks(mlvObject_t * video)
+{
+    if (video->file_map)
+    {
+        for (int i = 0; i < video->file_map_count; ++i)
+            unmap_chunk(video->file_map[i], video->file_map_size[i]);
+        free(video->file_map);
+    }
+    if (video->file_map_size) free(video->file_map_size);
+    video->file_map = NULL;
+    video->file_map_size = NULL;
+    video->file_map_count = 0;
+}
+
+const uint8_t * get_mlv_chunk_data(mlvObject_t * video, int chunk, uint64_t offset, uint64_t size)
+{
+    if (!video->file_map || !video->file_map[chunk]) return NULL;
+    /* Bit unpacking reads up to 4 bytes behind the frame */
+    if (offset + size + 4 > video->file_map_size[chunk]) return NULL;
+    return video->file_map[chunk] + offset;
+}
+
+int read_mlv_chunk_data(mlvObject_t * video, int chunk, uint64_t offset, void * dst, uint64_t size)
+{
+    if (video->file_map && video->file_map[chunk] && offset + size <= video->file_map_size[chunk])
+    {
+        memcpy(dst, video->file_map[chunk] + offset, size);
+        return 0;
+    }
+
+    /* Not mapped, or behind the mapped size because the chunk grew since it was opened (still recording or copying) */
+    FILE * file = video->file[chunk];
+
+    pthread_mutex_lock(video->main_file_mutex + chunk);
+    file_set_pos(file, offset, SEEK_SET);
+    int ret = (fread(dst, size, 1, file) != 1);
+    pthread_mutex_unlock(video->main_file_mutex + chunk);
+
+    return ret;
+}
+
+/* Merges the sorted runs a[0..mid) and a[mid..end) into out, equal times keep their order */
+static void frame_index_merge(frame_index_t *a, uint32_t mid, uint32_t end, frame_index_t *out)
+{
+    uint32_t i = 0, j = mid, k = 0;
+    while (i < mid && j < end) out[k++] = (a[j].frame_time < a[i].frame_time) ? a[j++] : a[i++];
+    while (i < mid) out[k++] = a[i++];
+    while (j < end) out[k++] = a[j++];
+}
+
+/* Stable LSD radix sort by frame_time, 11 bits per pass, only as many passes as the biggest time needs */
+static void frame_index_radix_sort(frame_index_t *frame_index, uint32_t entries, frame_index_t *tmp)
+{
+    uint64_t max_time = 0;
+    for (uint32_t i = 0; i < entries; ++i) max_time = MAX(max_time, frame_index[i].frame_time);
+
+    frame_index_t *src = frame_index, *dst = tmp;
+    for (int shift = 0; shift < 64 && (max_time >> shift); shift += 11)
+    {
+        uint32_t count[2048] = { 0 };
+        for (uint32_t i = 0; i < entries; ++i) count[(src[i].frame_time >> shift) & 2047]++;
+        uint32_t pos = 0;
+        for (int d = 0; d < 2048; ++d)
+        {
+            uint32_t c = count[d];
+            count[d] = pos;
+            pos += c;
+        }
+        for (uint32_t i = 0; i < entries; ++i) dst[count[(src[i].frame_time >> shift) & 2047]++] = src[i];
+
+        frame_index_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != frame_index) memcpy(frame_index, src, entries * sizeof(frame_index_t));
+}
+
+/* Fallback without memory, stable too */
+static void frame_index_insertion_sort(frame_index_t *frame_index, uint32_t entries)
+{
+    for (uint32_t i = 1; i < entries; ++i)
+    {
+        frame_index_t entry = frame_index[i];
+        uint32_t j = i;
+        while (j > 0 && frame_index[j-1].frame_time > entry.frame_time)
+        {
+            frame_index[j] = frame_index[j-1];
+            j--;
+        }
+        frame_index[j] = entry;
+    }
+}
+
+/* Sorts frames by time stamp, keeping the order of frames with the same time.
+ * Frames of each chunk are in time order already, so the index is a few sorted runs (one per chunk),
+ * which are merged. Many runs (a badly broken file) get a radix sort */
 static void frame_index_sort(frame_index_t *frame_index, uint32_t entries)
 {
-    if (!entries) return;
+    if (entries < 2) return;
+
+    /* Run starts, usually already sorted (single chunk) */
+    uint32_t runs = 1;
+    for (uint32_t i = 1; i < entries; ++i)
+    {
+        if (frame_index[i].frame_time < frame_index[i-1].frame_time) runs++;
+    }
+    if (runs == 1) return;
+
+    frame_index_t *tmp = malloc(entries * sizeof(frame_index_t));
+    if (!tmp)
+    {
+        frame_index_insertion_sort(frame_index, entries);
+        return;
+    }
+
+    if (runs > 64)
+    {
+        frame_index_radix_sort(frame_index, entries, tmp);
+        free(tmp);
+        return;
+    }
 
-    uint32_t n = entries;
-    do
+    uint32_t *run_start = malloc((runs + 1) * sizeof(uint32_t));
+    if (!run_start)
     {
-        uint32_t new_n = 1;
-        for (uint32_t i = 0; i < n-1; ++i)
+        free(tmp);
+        frame_index_insertion_sort(frame_index, entries);
+        return;
+    }
+    run_start[0] = 0;
+    for (uint32_t i = 1, r = 1; i < entries; ++i)
+    {
+        if (frame_index[i].frame_time < frame_index[i-1].frame_time) run_start[r++] = i;
+    }
+    run_start[runs] = entries;
+
+    /* Merge neighbouring runs until one is left, ping-ponging between the two buffers */
+    frame_index_t *src = frame_index, *dst = tmp;
+    while (runs > 1)
+    {
+        uint32_t merged = 0;
+        for (uint32_t r = 0; r < runs; r += 2)
         {
-            if (frame_index[i].frame_time > frame_index[i+1].frame_time)
-            {
-                frame_index_t tmp = frame_index[i+1];
-                frame_index[i+1] = frame_index[i];
-                frame_index[i] = tmp;
-                new_n = i + 1;
-            }
+            uint32_t start = run_start[r];
+            uint32_t end = run_start[MIN(r + 2, runs)];
+            if (r + 1 < runs) frame_index_merge(src + start, run_start[r+1] - start, end - start, dst + start);
+            else memcpy(dst + start, src + start, (end - start) * sizeof(frame_index_t));
+            run_start[merged++] = start;
         }
-        n = new_n;
-    } while (n > 1);
+        run_start[merged] = entries;
+        runs = merged;
+
+        frame_index_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != frame_index) memcpy(frame_index, src, entries * sizeof(frame_index_t));
+
+    free(run_start);
+    free(tmp);
 }
 
 /* Unpack or decompress original raw data */
 int getMlvRawFrameUint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * unpackedFrame)
+{
+    return getMlvRawFrameUint16WithBuffers(video, frameIndex, unpackedFrame, NULL);
+}
+
+/* Reentrant: only reads the mlvObject, frame header goes to *vidf (may be NULL) */
+static int get_mlv_raw_frame_uint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * unpackedFrame, mlvFrameBuffers_t * buffers, mlv_vidf_hdr_t * vidf)
 {
     int bitdepth = video->RAWI.raw_info.bits_per_pixel;
     int width = video->RAWI.xRes;
     int height = video->RAWI.yRes;
-    int pixels_count = width * height;
 
     int chunk = video->video_index[frameIndex].chunk_num;
     uint32_t frame_size = video->video_index[frameIndex].frame_size;
@@ -206,46 +442,53 @@ int getMlvRawFrameUint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * un
 
     /* How many bytes is RAW frame */
     int raw_frame_size = (width * height * bitdepth) / 8;
-    /* Memory buffer for original RAW data */
-    uint8_t * raw_frame = (uint8_t *)malloc(raw_frame_size + 4); // additional 4 bytes for safety
-
-    FILE * file = video->file[chunk];
-
-    /* Move to start of frame in file and read the RAW data */
-    pthread_mutex_lock(video->main_file_mutex + chunk);
-
-    file_set_pos(file, frame_header_offset, SEEK_SET);
+    /* Memory buffer for original RAW data, from caller or arena */
+    uint8_t * own_raw_frame = (buffers) ? buffers->raw_frame : NULL;
+    uint8_t * raw_frame = (own_raw_frame) ? own_raw_frame : take_mlv_frame_buffer(video, MLV_BUFFER_RAW);
+    if (!raw_frame)
+    {
+        DEBUG( printf("No memory for the raw frame buffer\n"); )
+        return 1;
+    }
 
     if (isMcrawLoaded(video))
     {
         mr_item_t item = {};
 
-        if (fread(&item, sizeof(mr_item_t), 1, file) != 1)
+        if (read_mlv_chunk_data(video, chunk, frame_header_offset, &item, sizeof(mr_item_t)))
         {
             DEBUG( printf("Frame header read error\n"); )
-            free(raw_frame);
-            pthread_mutex_unlock(video->main_file_mutex + chunk);
+            if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
             return 1;
         }
 
         frame_size = item.size;
 
-        if (fread(raw_frame, frame_size, 1, file) != 1)
+        /* Decode straight from the mapped file, or read to the buffer. Stored mcraw size is not in the index, bigger frames need their own buffer */
+        uint8_t * item_frame = (uint8_t *)get_mlv_chunk_data(video, chunk, frame_header_offset + sizeof(mr_item_t), frame_size);
+        uint8_t * item_buffer = NULL;
+        if (!item_frame)
         {
-            DEBUG( printf("Frame data read error\n"); )
-            free(raw_frame);
-            pthread_mutex_unlock(video->main_file_mutex + chunk);
-            return 1;
+            item_frame = raw_frame;
+            if (frame_size + 4 > video->raw_buffer_size) item_frame = item_buffer = (uint8_t *)malloc(frame_size + 4);
+
+            if (read_mlv_chunk_data(video, chunk, frame_header_offset + sizeof(mr_item_t), item_frame, frame_size))
+            {
+                DEBUG( printf("Frame data read error\n"); )
+                if (item_buffer) free(item_buffer);
+                if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
+                return 1;
+            }
         }
 
-        pthread_mutex_unlock(video->main_file_mutex + chunk);
+        int64_t ret = mr_decode_video_frame((uint8_t*)unpackedFrame, item_frame, frame_size, width, height, video->compression_type);
 
-        int64_t ret = mr_decode_video_frame((uint8_t*)unpackedFrame, raw_frame, frame_size, width, height, video->compression_type);
+        if (item_buffer) free(item_buffer);
 
         if (ret <= 0)
         {
             DEBUG( printf("mcraw decoder: Failed with error code (%d)\n", ret); )
-            free(raw_frame);
+            if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
             return 1;
         }
 
@@ -300,35 +543,38 @@ int getMlvRawFrameUint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * un
     }
     else
     {
-        if (fread(&video->VIDF, sizeof(mlv_vidf_hdr_t), 1, file) != 1)
+        mlv_vidf_hdr_t frame_vidf;
+        if (read_mlv_chunk_data(video, chunk, frame_header_offset, &frame_vidf, sizeof(mlv_vidf_hdr_t)))
         {
             DEBUG( printf("Frame header read error\n"); )
-            free(raw_frame);
-            pthread_mutex_unlock(video->main_file_mutex + chunk);
+            if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
             return 1;
         }
 
-        file_set_pos(file, frame_offset, SEEK_SET);
+        if (vidf) *vidf = frame_vidf;
 
         if (video->MLVI.videoClass & MLV_VIDEO_CLASS_FLAG_LJ92)
         {
-            if(fread(raw_frame, frame_size, 1, file) != 1)
+            /* Decode straight from the mapped file, or read to the buffer */
+            uint8_t * frame_data = (uint8_t *)get_mlv_chunk_data(video, chunk, frame_offset, frame_size);
+            if (!frame_data)
             {
-                DEBUG( printf("Frame data read error\n"); )
-                free(raw_frame);
-                pthread_mutex_unlock(video->main_file_mutex + chunk);
-                return 1;
+                frame_data = raw_frame;
+                if (read_mlv_chunk_data(video, chunk, frame_offset, raw_frame, frame_size))
+                {
+                    DEBUG( printf("Frame data read error\n"); )
+                    if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
+                    return 1;
+                }
             }
 
-            pthread_mutex_unlock(video->main_file_mutex + chunk);
-
             int components = 1;
             lj92 decoder_object;
-            int ret = lj92_open(&decoder_object, raw_frame, frame_size, &width, &height, &bitdepth, &components);
+            int ret = lj92_open(&decoder_object, frame_data, frame_size, &width, &height, &bitdepth, &components);
             if(ret != LJ92_ERROR_NONE)
             {
                 DEBUG( printf("LJ92 decoder: Failed with error code (%d)\n", ret); )
-                free(raw_frame);
+                if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
                 return 1;
             }
             else
@@ -337,7 +583,7 @@ int getMlvRawFrameUint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * un
                 if(ret != LJ92_ERROR_NONE)
                 {
                     DEBUG( printf("LJ92 decoder: Failed with error code (%d)\n", ret); )
-                    free(raw_frame);
+                    if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
                     return 1;
                 }
             }
@@ -345,55 +591,58 @@ int getMlvRawFrameUint16(mlvObject_t * video, uint64_t frameIndex, uint16_t * un
         }
         else /* If not compressed just unpack to 16bit */
         {
-            if(fread(raw_frame, raw_frame_size, 1, file) != 1)
+            /* Unpack straight from the mapped file, or read to the buffer */
+            const uint8_t * frame_data = get_mlv_chunk_data(video, chunk, frame_offset, raw_frame_size);
+            if (!frame_data)
             {
-                DEBUG( printf("Frame data read error\n"); )
-                free(raw_frame);
-                pthread_mutex_unlock(video->main_file_mutex + chunk);
-                return 1;
+                frame_data = raw_frame;
+                if (read_mlv_chunk_data(video, chunk, frame_offset, raw_frame, raw_frame_size))
+                {
+                    DEBUG( printf("Frame data read error\n"); )
+                    if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
+                    return 1;
+                }
             }
 
-            pthread_mutex_unlock(video->main_file_mutex + chunk);
-
-            uint32_t mask = (1 << bitdepth) - 1;
-            #pragma omp parallel for
-            for (int i = 0; i < pixels_count; ++i)
-            {
-                uint32_t bits_offset = i * bitdepth;
-                uint32_t bits_address = bits_offset / 16;
-                uint32_t bits_shift = bits_offset % 16;
-                uint32_t rotate_value = 16 + ((32 - bitdepth) - bits_shift);
-                uint32_t uncorrected_data = *((uint32_t *)&((uint16_t *)raw_frame)[bits_address]);
-                uint32_t data = ROR32(uncorrected_data, rotate_value);
-                unpackedFrame[i] = ((uint16_t)(data & mask));
-            }
+            dng_unpack_image_bits(unpackedFrame, (uint16_t *)frame_data, width, height, bitdepth);
         }
     }
 
-    free(raw_frame);
+    if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RAW, raw_frame);
     return 0;
 }
 
-/* Unpacks the bits of a frame to get a bayer B&W image (without black level correction)
- * Needs memory to return to, sized: sizeof(float) * getMlvHeight(urvid) * getMlvWidth(urvid)
- * Output image's pixels will be in range 0-65535 as if it is 16 bit integers */
-void getMlvRawFrameFloat(mlvObject_t * video, uint64_t frameIndex, float * outputFrame)
+int getMlvRawFrameUint16WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * unpackedFrame, mlvFrameBuffers_t * buffers)
 {
-    int pixels_count = video->RAWI.xRes * video->RAWI.yRes;
+    return get_mlv_raw_frame_uint16(video, frameIndex, unpackedFrame, buffers, NULL);
+}
 
-    /* Memory buffer for decompressed or bit unpacked RAW data */
+/* Decodes a frame and applies low level raw processing, thread safe. Returns 1 on error (frame is black then) */
+int get_mlv_raw_frame_bayer16(mlvObject_t * video, uint64_t frameIndex, uint16_t * bayerFrame, mlvFrameBuffers_t * buffers)
+{
+    int pixels_count = video->RAWI.xRes * video->RAWI.yRes;
     size_t unpacked_frame_size = pixels_count * 2;
-    uint16_t * unpacked_frame = (uint16_t *)malloc( unpacked_frame_size );
 
-    if(getMlvRawFrameUint16(video, frameIndex, unpacked_frame))
+    /* Pan position of this frame, mcraw has no VIDF */
+    mlv_vidf_hdr_t vidf = video->VIDF;
+    if(get_mlv_raw_frame_uint16(video, frameIndex, bayerFrame, buffers, &vidf))
     {
-        memset(outputFrame, 0, pixels_count * sizeof(float));
-        free(unpacked_frame);
-        return;
+        memset(bayerFrame, 0, unpacked_frame_size);
+        return 1;
     }
 
-    /* apply low level raw processing to the unpacked_frame */
-    applyLLRawProcObject(video, unpacked_frame, unpacked_frame_size);
+    /* apply low level raw processing to the unpacked_frame, thread safe */
+    llrawprocFrame_t llrawproc_frame = { vidf.panPosX, vidf.panPosY,
+                                         { video->RAWI.raw_info.exposure_bias[0], video->RAWI.raw_info.exposure_bias[1] } };
+    applyLLRawProcObjectFrame(video, bayerFrame, unpacked_frame_size, &llrawproc_frame);
+
+    return 0;
+}
+
+/* Bayer frame from get_mlv_raw_frame_bayer16() to float in 0-65535 range */
+void mlv_bayer16_to_float(mlvObject_t * video, uint16_t * bayerFrame, float * outputFrame)
+{
+    int pixels_count = video->RAWI.xRes * video->RAWI.yRes;
 
     /* high quality dualiso buffer consists of real 16 bit values, no converting needed */
     int shift_val = (llrpHQDualIso(video)) ? 0 : (16 - video->RAWI.raw_info.bits_per_pixel);
@@ -402,10 +651,34 @@ void getMlvRawFrameFloat(mlvObject_t * video, uint64_t frameIndex, float * outpu
     #pragma omp parallel for
     for (volatile int i = 0; i < pixels_count; ++i)
     {
-        outputFrame[i] = (float)(unpacked_frame[i] << shift_val);
+        outputFrame[i] = (float)(bayerFrame[i] << shift_val);
+    }
+}
+
+/* Unpacks the bits of a frame to get a bayer B&W image (without black level correction)
+ * Needs memory to return to, sized: sizeof(float) * getMlvHeight(urvid) * getMlvWidth(urvid)
+ * Output image's pixels will be in range 0-65535 as if it is 16 bit integers */
+void getMlvRawFrameFloat(mlvObject_t * video, uint64_t frameIndex, float * outputFrame)
+{
+    getMlvRawFrameFloatWithBuffers(video, frameIndex, outputFrame, NULL);
+}
+
+void getMlvRawFrameFloatWithBuffers(mlvObject_t * video, uint64_t frameIndex, float * outputFrame, mlvFrameBuffers_t * buffers)
+{
+    /* Memory buffer for decompressed or bit unpacked RAW data, from caller or arena */
+    uint16_t * own_unpacked_frame = (buffers) ? buffers->unpacked_frame : NULL;
+    uint16_t * unpacked_frame = (own_unpacked_frame) ? own_unpacked_frame : take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+
+    if(!unpacked_frame || get_mlv_raw_frame_bayer16(video, frameIndex, unpacked_frame, buffers))
+    {
+        memset(outputFrame, 0, video->RAWI.xRes * video->RAWI.yRes * sizeof(float));
+    }
+    else
+    {
+        mlv_bayer16_to_float(video, unpacked_frame, outputFrame);
     }
 
-    free(unpacked_frame);
+    if (unpacked_frame != own_unpacked_frame) give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, unpacked_frame);
 }
 
 void setMlvProcessing(mlvObject_t * video, processingObject_t * processing)
@@ -483,74 +756,237 @@ void setMlvProcessing(mlvObject_t * video, processingObject_t * processing)
 }
 
 void getMlvRawFrameDebayered(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame)
+{
+    getMlvRawFrameDebayeredWithBuffers(video, frameIndex, outputFrame, NULL);
+}
+
+void getMlvRawFrameDebayeredWithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, mlvFrameBuffers_t * buffers)
 {
     int width = getMlvWidth(video);
     int height = getMlvHeight(video);
     int frame_size = width * height * sizeof(uint16_t) * 3;
 
-    /* If frame was requested last time and is sitting in the "current" frame cache */
-    if ( video->cached_frames[frameIndex] == MLV_FRAME_NOT_CACHED
+    /* Cache window follows what is shown */
+    setMlvCachePlayhead(video, frameIndex);
+
+    /* If frame was requested last time and is sitting in the "current" frame cache (RGB cache is preferred) */
+    if ( ( video->cached_frames[frameIndex] != MLV_FRAME_IS_CACHED || getMlvCacheMode(video) != MLV_CACHE_RGB16 )
          && video->current_cached_frame_active 
-         && video->current_cached_frame == frameIndex )
+         && video->current_cached_frame == frameIndex
+         && video->current_cached_frame_scale == 1 )
     {
         memcpy(outputFrame, video->rgb_raw_current_frame, frame_size);
+        return;
     }
-    /* Is this next bit even readable? */
-    else switch (video->cached_frames[frameIndex])
+
+    /* RGB cache frames are copied straight out, bayer cache frames are debayered into the 'current frame' */
+    uint16_t * cache_target = (getMlvCacheMode(video) == MLV_CACHE_RGB16) ? outputFrame : video->rgb_raw_current_frame;
+
+    /* Playhead is first in the cache window, so cache threads are on it. Wait for them if AMaZE is wanted anyway */
+    int copied = get_mlv_cached_frame(video, frameIndex, cache_target, buffers);
+    if (!copied && doesMlvAlwaysUseAmaze(video) && getMlvCacheMode(video) == MLV_CACHE_RGB16 && getMlvRawCacheLimitFrames(video))
     {
-        case MLV_FRAME_IS_CACHED:
+        while (isMlvObjectCaching(video) && !copied)
         {
-            memcpy(outputFrame, video->rgb_raw_frames[frameIndex], frame_size);
-            break;
+            usleep(100);
+            copied = get_mlv_cached_frame(video, frameIndex, cache_target, buffers);
         }
+    }
+    if (copied && cache_target == outputFrame) return;
 
-        /* Else cache it or store in the 'current frame' */
-        case MLV_FRAME_NOT_CACHED:
+    /* Else debayer it here */
+    if (!copied)
+    {
+        float * own_raw_frame = (buffers) ? buffers->float_frame : NULL;
+        float * raw_frame = (own_raw_frame) ? own_raw_frame : take_mlv_frame_buffer(video, MLV_BUFFER_FLOAT);
+        if (!raw_frame)
         {
-            /* If it is within the cache range, request for it to be cached */
-            if (isMlvObjectCaching(video) && frameIndex < getMlvRawCacheLimitFrames(video))
-            {
-                video->cache_next = frameIndex;
-            }
+            memset(outputFrame, 0, frame_size);
+            return;
         }
+        get_mlv_raw_frame_debayered(video, frameIndex, raw_frame, video->rgb_raw_current_frame, doesMlvAlwaysUseAmaze(video), buffers);
+        if (raw_frame != own_raw_frame) give_mlv_frame_buffer(video, MLV_BUFFER_FLOAT, raw_frame);
+    }
+
+    /* Store in the 'current frame' */
+    memcpy(outputFrame, video->rgb_raw_current_frame, frame_size);
+    video->current_cached_frame_active = 1;
+    video->current_cached_frame = frameIndex;
+    video->current_cached_frame_scale = 1;
+}
+
+void getMlvRawFrameDebayeredPreview(mlvObject_t * video, uint64_t frameIndex, int scale, uint16_t * outputFrame)
+{
+    if (scale <= 1)
+    {
+        getMlvRawFrameDebayered(video, frameIndex, outputFrame);
+        return;
+    }
+
+    int width = getMlvWidth(video);
+    int height = getMlvHeight(video);
+    int frame_size = getMlvPreviewWidth(video, scale) * getMlvPreviewHeight(video, scale) * sizeof(uint16_t) * 3;
+
+    /* Cache window follows what is shown */
+    setMlvCachePlayhead(video, frameIndex);
+
+    /* Same frame at same size as last time, it is sitting in the 'current frame' */
+    if ( video->current_cached_frame_active
+      && video->current_cached_frame == frameIndex
+      && video->current_cached_frame_scale == scale )
+    {
+        memcpy(outputFrame, video->rgb_raw_current_frame, frame_size);
+        return;
+    }
+
+    /* A cached AMaZE frame is better than binning */
+    int copied = 0;
+    if (getMlvCacheMode(video) == MLV_CACHE_RGB16 && video->cached_frames[frameIndex] == MLV_FRAME_IS_CACHED)
+    {
+        uint16_t * full_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+        if (full_frame) copied = get_mlv_cached_frame(video, frameIndex, full_frame, NULL);
+        if (copied) downscaleRgbBox(video->rgb_raw_current_frame, full_frame, width, height, scale);
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, full_frame);
+    }
 
-        case MLV_FRAME_BEING_CACHED:
+    /* Else bin the bayer data, no debayer at full size needed */
+    if (!copied)
+    {
+        uint16_t * bayer_frame = take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+        if (!bayer_frame)
         {
-            if (doesMlvAlwaysUseAmaze(video) && isMlvObjectCaching(video))
-            {
-                while (video->cached_frames[frameIndex] != MLV_FRAME_IS_CACHED) usleep(100);
-                memcpy(outputFrame, video->rgb_raw_frames[frameIndex], frame_size);
-            }
-            else
-            {
-                float * raw_frame = malloc(width * height * sizeof(float));
-                get_mlv_raw_frame_debayered(video, frameIndex, raw_frame, video->rgb_raw_current_frame, doesMlvAlwaysUseAmaze(video));
-                free(raw_frame);
-                memcpy(outputFrame, video->rgb_raw_current_frame, frame_size);
-                video->current_cached_frame_active = 1;
-                video->current_cached_frame = frameIndex;
-            }
-            break;
+            memset(outputFrame, 0, frame_size);
+            return;
+        }
+        get_mlv_raw_frame_bayer16(video, frameIndex, bayer_frame, NULL);
+        /* high quality dualiso buffer consists of real 16 bit values, no shifting needed */
+        int shift = (llrpHQDualIso(video)) ? 0 : (16 - video->RAWI.raw_info.bits_per_pixel);
+        debayerBinned(video->rgb_raw_current_frame, bayer_frame, width, height, scale, shift);
+        give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer_frame);
+    }
+
+    /* Store in the 'current frame' */
+    memcpy(outputFrame, video->rgb_raw_current_frame, frame_size);
+    video->current_cached_frame_active = 1;
+    video->current_cached_frame = frameIndex;
+    video->current_cached_frame_scale = scale;
+}
+
+/* Copies a region out of a whole RGB frame */
+static void copy_mlv_rgb_region(uint16_t * output, uint16_t * frame, int frame_width, int x, int y, int width, int height)
+{
+    for (int row = 0; row < height; ++row)
+    {
+        memcpy(output + row * width * 3, frame + ((y + row) * frame_width + x) * 3, width * 3 * sizeof(uint16_t));
+    }
+}
+
+void getMlvRawFrameDebayeredRegion(mlvObject_t * video, uint64_t frameIndex, int x, int y, int width, int height, uint16_t * outputFrame, uint16_t * overviewFrame)
+{
+    int frame_width = getMlvWidth(video);
+    int frame_height = getMlvHeight(video);
+    int overview_size = getMlvPreviewWidth(video, MLV_REGION_OVERVIEW_SCALE) * getMlvPreviewHeight(video, MLV_REGION_OVERVIEW_SCALE) * 3 * sizeof(uint16_t);
+
+    /* Cache window follows what is shown */
+    setMlvCachePlayhead(video, frameIndex);
+
+    /* The whole frame or the same region is sitting in the 'current frame' */
+    if (video->current_cached_frame_active && video->current_cached_frame == frameIndex)
+    {
+        int * area = video->current_cached_frame_area;
+        if (video->current_cached_frame_scale == 1)
+        {
+            copy_mlv_rgb_region(outputFrame, video->rgb_raw_current_frame, frame_width, x, y, width, height);
+            if (overviewFrame) downscaleRgbBox(overviewFrame, video->rgb_raw_current_frame, frame_width, frame_height, MLV_REGION_OVERVIEW_SCALE);
+            return;
+        }
+        if ( video->current_cached_frame_scale == 0 && area[0] == x && area[1] == y && area[2] == width && area[3] == height
+          && (!overviewFrame || video->current_cached_frame_overview) )
+        {
+            memcpy(outputFrame, video->rgb_raw_current_frame, width * height * 3 * sizeof(uint16_t));
+            if (overviewFrame) memcpy(overviewFrame, video->rgb_raw_current_overview, overview_size);
+            return;
         }
     }
+
+    /* Cut it out of a cached AMaZE frame */
+    if (getMlvCacheMode(video) == MLV_CACHE_RGB16 && video->cached_frames[frameIndex] == MLV_FRAME_IS_CACHED)
+    {
+        uint16_t * full_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+        int copied = (full_frame) ? get_mlv_cached_frame(video, frameIndex, full_frame, NULL) : 0;
+        if (copied)
+        {
+            copy_mlv_rgb_region(outputFrame, full_frame, frame_width, x, y, width, height);
+            if (overviewFrame) downscaleRgbBox(overviewFrame, full_frame, frame_width, frame_height, MLV_REGION_OVERVIEW_SCALE);
+        }
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, full_frame);
+        if (copied) return;
+    }
+
+    /* Else debayer only the region */
+    uint16_t * bayer_frame = take_mlv_frame_buffer(video, MLV_BUFFER_BAYER16);
+    float * raw_region = take_mlv_frame_buffer(video, MLV_BUFFER_FLOAT);
+    if (!bayer_frame || !raw_region)
+    {
+        give_mlv_frame_buffer(video, MLV_BUFFER_FLOAT, raw_region);
+        give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer_frame);
+        memset(outputFrame, 0, width * height * 3 * sizeof(uint16_t));
+        if (overviewFrame) memset(overviewFrame, 0, overview_size);
+        return;
+    }
+    get_mlv_raw_frame_bayer16(video, frameIndex, bayer_frame, NULL);
+    /* high quality dualiso buffer consists of real 16 bit values, no shifting needed */
+    int shift = (llrpHQDualIso(video)) ? 0 : (16 - video->RAWI.raw_info.bits_per_pixel);
+    #pragma omp parallel for
+    for (int row = 0; row < height; ++row)
+    {
+        uint16_t * in = bayer_frame + (y + row) * frame_width + x;
+        float * out = raw_region + row * width;
+        for (int col = 0; col < width; ++col) out[col] = (float)(in[col] << shift);
+    }
+    debayer_mlv_raw_area(video, raw_region, video->rgb_raw_current_frame, width, height, doesMlvAlwaysUseAmaze(video));
+    /* The whole frame binned, while the raw data is here */
+    if (overviewFrame) debayerBinned(video->rgb_raw_current_overview, bayer_frame, frame_width, frame_height, MLV_REGION_OVERVIEW_SCALE, shift);
+    give_mlv_frame_buffer(video, MLV_BUFFER_FLOAT, raw_region);
+    give_mlv_frame_buffer(video, MLV_BUFFER_BAYER16, bayer_frame);
+
+    /* Store in the 'current frame' */
+    memcpy(outputFrame, video->rgb_raw_current_frame, width * height * 3 * sizeof(uint16_t));
+    if (overviewFrame) memcpy(overviewFrame, video->rgb_raw_current_overview, overview_size);
+    video->current_cached_frame_active = 1;
+    video->current_cached_frame = frameIndex;
+    video->current_cached_frame_scale = 0;
+    video->current_cached_frame_area[0] = x;
+    video->current_cached_frame_area[1] = y;
+    video->current_cached_frame_area[2] = width;
+    video->current_cached_frame_area[3] = height;
+    video->current_cached_frame_overview = (overviewFrame != NULL);
 }
 
 /* Get a processed frame in 16 bit, only use more than one thread for preview as
  * it may have minor artifacts (though I haven't found them yet) */
 void getMlvProcessedFrame16(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, int threads)
+{
+    getMlvProcessedFrame16WithBuffers(video, frameIndex, outputFrame, threads, NULL);
+}
+
+void getMlvProcessedFrame16WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, int threads, mlvFrameBuffers_t * buffers)
 {
     /* Useful */
     int width = getMlvWidth(video);
     int height = getMlvHeight(video);
 
-    /* Size of RAW frame */
-    int rgb_frame_size = height * width * 3;
-
-    /* Unprocessed debayered frame (RGB) */
-    uint16_t * unprocessed_frame = malloc( rgb_frame_size * sizeof(uint16_t) );
+    /* Unprocessed debayered frame (RGB), from caller or arena */
+    uint16_t * own_unprocessed_frame = (buffers) ? buffers->debayered_frame : NULL;
+    uint16_t * unprocessed_frame = (own_unprocessed_frame) ? own_unprocessed_frame : take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+    if (!unprocessed_frame)
+    {
+        memset(outputFrame, 0, width * height * 3 * sizeof(uint16_t));
+        return;
+    }
 
     /* Get the raw data in B&W */
-    getMlvRawFrameDebayered(video, frameIndex, unprocessed_frame);
+    getMlvRawFrameDebayeredWithBuffers(video, frameIndex, unprocessed_frame, buffers);
 
     /* Do processing.......... */
     applyProcessingObject( video->processing,
@@ -559,19 +995,30 @@ void getMlvProcessedFrame16(mlvObject_t * video, uint64_t frameIndex, uint16_t *
                            outputFrame,
                            threads, 1, frameIndex );
 
-    free(unprocessed_frame);
+    if (unprocessed_frame != own_unprocessed_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, unprocessed_frame);
 }
 
 /* Get a processed frame in 8 bit */
 void getMlvProcessedFrame8(mlvObject_t * video, uint64_t frameIndex, uint8_t * outputFrame, int threads)
+{
+    getMlvProcessedFrame8WithBuffers(video, frameIndex, outputFrame, threads, NULL);
+}
+
+void getMlvProcessedFrame8WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint8_t * outputFrame, int threads, mlvFrameBuffers_t * buffers)
 {
     /* Size of RAW frame */
     int rgb_frame_size = getMlvWidth(video) * getMlvHeight(video) * 3;
 
-    /* Processed frame (RGB) */
-    uint16_t * processed_frame = malloc( rgb_frame_size * sizeof(uint16_t) );
+    /* Processed frame (RGB), from caller or arena */
+    uint16_t * own_processed_frame = (buffers) ? buffers->processed_frame : NULL;
+    uint16_t * processed_frame = (own_processed_frame) ? own_processed_frame : take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+    if (!processed_frame)
+    {
+        memset(outputFrame, 0, rgb_frame_size);
+        return;
+    }
 
-    getMlvProcessedFrame16(video, frameIndex, processed_frame, threads);
+    getMlvProcessedFrame16WithBuffers(video, frameIndex, processed_frame, threads, buffers);
 
     /* Copy (and 8-bitize) */
     #pragma omp parallel for
@@ -580,27 +1027,145 @@ void getMlvProcessedFrame8(mlvObject_t * video, uint64_t frameIndex, uint8_t * o
         outputFrame[i] = processed_frame[i] >> 8;
     }
 
-    free(processed_frame);
+    if (processed_frame != own_processed_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, processed_frame);
 }
 
-/* To initialise mlv object with a clip
- * Two functions in one */
-mlvObject_t * initMlvObjectWithClip(char * mlvPath, int preview, int * err, char * error_message)
+/* Get a processed frame in 8 bit at 1/scale size, the whole processing runs at that size */
+void getMlvProcessedPreviewFrame8(mlvObject_t * video, uint64_t frameIndex, int scale, uint8_t * outputFrame, int threads)
 {
-    mlvObject_t * video = initMlvObject();
-    char error_message_tmp[256] = {0};
-    int err_tmp =  openMlvClip(video, mlvPath, preview, error_message_tmp);
-    if (err != NULL) *err = err_tmp;
-    if (error_message != NULL) strcpy(error_message, error_message_tmp);
-    return video;
-}
+    if (scale <= 1)
+    {
+        getMlvProcessedFrame8(video, frameIndex, outputFrame, threads);
+        return;
+    }
 
-/* To initialise mlv object with a clip
- * Two functions in one */
-mlvObject_t * initMlvObjectWithMcrawClip(char * mlvPath, int preview, int * err, char * error_message)
-{
-    mlvObject_t * video = initMlvObject();
-    char error_message_tmp[256] = {0};
+    int width = getMlvPreviewWidth(video, scale);
+    int height = getMlvPreviewHeight(video, scale);
+    int rgb_frame_size = width * height * 3;
+
+    uint16_t * unprocessed_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+    uint16_t * processed_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+    if (!unprocessed_frame || !processed_frame)
+    {
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, processed_frame);
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, unprocessed_frame);
+        memset(outputFrame, 0, rgb_frame_size);
+        return;
+    }
+
+    getMlvRawFrameDebayeredPreview(video, frameIndex, scale, unprocessed_frame);
+
+    /* Do processing.......... */
+    applyProcessingObjectRegion( video->processing,
+                                 width, height,
+                                 unprocessed_frame,
+                                 processed_frame,
+                                 threads, 1, frameIndex,
+                                 0, 0, scale, NULL, 0, 0, 1 );
+
+    /* Copy (and 8-bitize) */
+    #pragma omp parallel for
+    for (int i = 0; i < rgb_frame_size; ++i)
+    {
+        outputFrame[i] = processed_frame[i] >> 8;
+    }
+
+    give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, processed_frame);
+    give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, unprocessed_frame);
+}
+
+void getMlvProcessedRegionFrame8(mlvObject_t * video, uint64_t frameIndex, int x, int y, int width, int height, uint8_t * outputFrame, int threads)
+{
+    int frame_width = getMlvWidth(video);
+    int frame_height = getMlvHeight(video);
+
+    /* Pixels processed around the region, so filters have their neighbours */
+    int margin = processingGetRegionMargin(video->processing);
+
+    /* Region as stored in the raw frame, 180 degree rotation is done by processing */
+    int rotated = (video->processing->transformation == TR_ROT180);
+    int raw_x = (rotated) ? frame_width - x - width : x;
+    int raw_y = (rotated) ? frame_height - y - height : y;
+
+    /* Add the margin, starting on a red pixel */
+    int area_x = MAX(raw_x - margin, 0) & ~1;
+    int area_y = MAX(raw_y - margin, 0) & ~1;
+    int area_width = MIN(raw_x + width + margin, frame_width) - area_x;
+    int area_height = MIN(raw_y + height + margin, frame_height) - area_y;
+
+    /* Most of the frame anyway (long reaching filters), just do all of it */
+    if ((int64_t)area_width * area_height * 4 >= (int64_t)frame_width * frame_height * 3)
+    {
+        area_x = 0;
+        area_y = 0;
+        area_width = frame_width;
+        area_height = frame_height;
+    }
+
+    /* And where the area is in the shown frame */
+    int shown_x = (rotated) ? frame_width - area_x - area_width : area_x;
+    int shown_y = (rotated) ? frame_height - area_y - area_height : area_y;
+
+    uint16_t * unprocessed_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+    uint16_t * processed_frame = take_mlv_frame_buffer(video, MLV_BUFFER_RGB16);
+
+    /* Dual iso highlights are found on the whole frame, not on what is visible */
+    uint16_t * overview_frame = (llrpGetDualIsoMode(video)) ? take_mlv_frame_buffer(video, MLV_BUFFER_RGB16) : NULL;
+
+    if (!unprocessed_frame || !processed_frame || (llrpGetDualIsoMode(video) && !overview_frame))
+    {
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, overview_frame);
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, processed_frame);
+        give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, unprocessed_frame);
+        memset(outputFrame, 0, width * height * 3);
+        return;
+    }
+
+    getMlvRawFrameDebayeredRegion(video, frameIndex, area_x, area_y, area_width, area_height, unprocessed_frame, overview_frame);
+
+    applyProcessingObjectRegion( video->processing,
+                                 area_width, area_height,
+                                 unprocessed_frame,
+                                 processed_frame,
+                                 threads, 1, frameIndex,
+                                 shown_x, shown_y, 1,
+                                 overview_frame,
+                                 getMlvPreviewWidth(video, MLV_REGION_OVERVIEW_SCALE),
+                                 getMlvPreviewHeight(video, MLV_REGION_OVERVIEW_SCALE),
+                                 MLV_REGION_OVERVIEW_SCALE );
+
+    /* Copy the region without margin (and 8-bitize) */
+    #pragma omp parallel for
+    for (int row = 0; row < height; ++row)
+    {
+        uint16_t * in = processed_frame + ((y - shown_y + row) * area_width + (x - shown_x)) * 3;
+        uint8_t * out = outputFrame + row * width * 3;
+        for (int i = 0; i < width * 3; ++i) out[i] = in[i] >> 8;
+    }
+
+    if (overview_frame) give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, overview_frame);
+    give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, processed_frame);
+    give_mlv_frame_buffer(video, MLV_BUFFER_RGB16, unprocessed_frame);
+}
+
+/* To initialise mlv object with a clip
+ * Two functions in one */
+mlvObject_t * initMlvObjectWithClip(char * mlvPath, int preview, int * err, char * error_message)
+{
+    mlvObject_t * video = initMlvObject();
+    char error_message_tmp[256] = {0};
+    int err_tmp =  openMlvClip(video, mlvPath, preview, error_message_tmp);
+    if (err != NULL) *err = err_tmp;
+    if (error_message != NULL) strcpy(error_message, error_message_tmp);
+    return video;
+}
+
+/* To initialise mlv object with a clip
+ * Two functions in one */
+mlvObject_t * initMlvObjectWithMcrawClip(char * mlvPath, int preview, int * err, char * error_message)
+{
+    mlvObject_t * video = initMlvObject();
+    char error_message_tmp[256] = {0};
     int err_tmp =  openMcrawClip(video, mlvPath, preview, error_message_tmp);
     if (err != NULL) *err = err_tmp;
     if (error_message != NULL) strcpy(error_message, error_message_tmp);
@@ -625,7 +1190,13 @@ mlvObject_t * initMlvObject()
     /* Cache things, only one element for now as it is empty */
     video->rgb_raw_frames = NULL;
     video->rgb_raw_current_frame = NULL;
+    video->rgb_raw_current_overview = NULL;
     video->cached_frames = NULL;
+    video->cache_slot_frame = NULL;
+    video->cache_slot_busy = NULL;
+    video->cache_slot_bytes = NULL;
+    video->cache_mode = MLV_CACHE_RGB16;
+    video->cache_direction = 1;
     /* All frames in one block of memory for least mallocing during usage */
     video->cache_memory_block = NULL;
     /* Path (so separate cache threads can have their own FILE*s) */
@@ -634,7 +1205,8 @@ mlvObject_t * initMlvObject()
     /* Will avoid main file conflicts with audio and stuff */
     pthread_mutex_init(&video->g_mutexFind, NULL);
     pthread_mutex_init(&video->g_mutexCount, NULL);
-    pthread_mutex_init(&video->cache_mutex, NULL);
+    pthread_rwlock_init(&video->llrawproc_lock, NULL);
+    pthread_mutex_init(&video->frame_buffers_mutex, NULL);
 
     /* Set cache limit to allow ~1 second of 1080p and be safe for low ram PCs */
     setMlvRawCacheLimitMegaBytes(video, 290);
@@ -642,6 +1214,7 @@ mlvObject_t * initMlvObject()
 
     /* Seems about right */
     setMlvCpuCores(video, 4);
+    setMlvLj92Slices(video, 1);
 
     /* Init low level raw processing object */
     video->llrawproc = initLLRawProcObject();
@@ -669,11 +1242,16 @@ void freeMlvObject(mlvObject_t * video)
     while (video->cache_thread_count) usleep(100);
 
     /* Close all MLV file chunks */
+    unmap_mlv_chunks(video);
     if(video->file) close_all_chunks(video->file, video->filenum);
     /* Free all memory */
+    reset_mlv_frame_buffers(video);
     if(video->video_index) free(video->video_index);
     if(video->audio_index) free(video->audio_index);
     if(video->vers_index) free(video->vers_index);
+    if(video->chunk_info) free(video->chunk_info);
+    lj92_encoder_close(video->lj92_enc);
+    video->lj92_enc = NULL;
 
     /* Free audio buffer */
     if(video->audio_data)
@@ -689,7 +1267,11 @@ void freeMlvObject(mlvObject_t * video)
         video->cached_frames = NULL;
     }
     if(video->rgb_raw_frames) free(video->rgb_raw_frames);
+    if(video->cache_slot_frame) free(video->cache_slot_frame);
+    if(video->cache_slot_busy) free(video->cache_slot_busy);
+    if(video->cache_slot_bytes) free(video->cache_slot_bytes);
     if(video->rgb_raw_current_frame) free(video->rgb_raw_current_frame);
+    if(video->rgb_raw_current_overview) free(video->rgb_raw_current_overview);
     if(video->cache_memory_block) free(video->cache_memory_block);
     if(video->path) free(video->path);
     freeLLRawProcObject(video);
@@ -700,57 +1282,94 @@ void freeMlvObject(mlvObject_t * video)
     if(video->main_file_mutex) free(video->main_file_mutex);
     pthread_mutex_destroy(&video->g_mutexFind);
     pthread_mutex_destroy(&video->g_mutexCount);
-    pthread_mutex_destroy(&video->cache_mutex);
+    pthread_rwlock_destroy(&video->llrawproc_lock);
+    pthread_mutex_destroy(&video->frame_buffers_mutex);
 
     /* Main 1 */
     free(video);
 }
 
-/* Save MLV App map file (.MAPP) */
-static int save_mapp(mlvObject_t * video)
+/* Indexes chunks which changed since the .MAPP was saved, defined with the indexer below */
+static int update_mlv_index(mlvObject_t * video, mapp_chunk_t * cached, uint32_t cached_count);
+
+/* FNV-1a over 64 bit words, checks .MAPP contents */
+static uint64_t mapp_checksum(const uint8_t * data, uint64_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; i < size; ++i) hash = (hash ^ data[i]) * 1099511628211ULL;
+    return hash;
+}
+
+/* .MAPP file name of a clip, free it after use */
+static char * mapp_file_name(mlvObject_t * video)
 {
     int mapp_name_len = strlen(video->path);
-    char * mapp_filename = alloca(mapp_name_len + 4);
-    memset(mapp_filename, 0x00, mapp_name_len + 4);
+    char * mapp_filename = calloc(mapp_name_len + 6, 1);
     memcpy(mapp_filename, video->path, mapp_name_len);
     char * dot = strrchr(mapp_filename, '.');
+    if(!dot) dot = mapp_filename + mapp_name_len;
     memcpy(dot, ".MAPP\0", 6);
+    return mapp_filename;
+}
+
+/* Size of the .MAPP index part: chunk fingerprints, MLV headers and frame indexes */
+static uint64_t mapp_index_size(uint32_t chunk_count, uint64_t video_frames, uint64_t audio_frames, uint64_t vers_blocks)
+{
+    return sizeof(mapp_header_t) +
+           chunk_count * sizeof(mapp_chunk_t) +
+           sizeof(mlv_file_hdr_t) +
+           sizeof(mlv_rawi_hdr_t) +
+           sizeof(mlv_rawc_hdr_t) +
+           sizeof(mlv_idnt_hdr_t) +
+           sizeof(mlv_expo_hdr_t) +
+           sizeof(mlv_lens_hdr_t) +
+           sizeof(mlv_elns_hdr_t) +
+           sizeof(mlv_rtci_hdr_t) +
+           sizeof(mlv_wbal_hdr_t) +
+           sizeof(mlv_styl_hdr_t) +
+           sizeof(mlv_wavi_hdr_t) +
+           sizeof(mlv_diso_hdr_t) +
+           sizeof(mlv_dark_hdr_t) +
+           sizeof(mlv_info_hdr_t) +
+           sizeof(((mlvObject_t *)0)->INFO_STRING) +
+           sizeof(camera_id_t) +
+           (video_frames + audio_frames + vers_blocks) * sizeof(frame_index_t);
+}
+
+/* Save MLV App map file (.MAPP)
+ * Layout: header, chunk fingerprints, MLV headers, frame indexes, audio data.
+ * Audio starts 8 byte aligned behind the index, so index part can be mapped and checked in one go */
+static int save_mapp(mlvObject_t * video)
+{
+    if(!video->chunk_info) return 1;
+
+    uint8_t * audio_data = getMlvAudioData(video);
+    uint64_t audio_size = (audio_data) ? video->audio_size : 0;
 
     size_t video_index_size = video->frames * sizeof(frame_index_t);
     size_t audio_index_size = video->audios * sizeof(frame_index_t);
     size_t vers_index_size = video->vers_blocks * sizeof(frame_index_t);
-    size_t mapp_buf_size = sizeof(mapp_header_t) +
-                           sizeof(mlv_file_hdr_t) +
-                           sizeof(mlv_rawi_hdr_t) +
-                           sizeof(mlv_rawc_hdr_t) +
-                           sizeof(mlv_idnt_hdr_t) +
-                           sizeof(mlv_expo_hdr_t) +
-                           sizeof(mlv_lens_hdr_t) +
-                           sizeof(mlv_elns_hdr_t) +
-                           sizeof(mlv_rtci_hdr_t) +
-                           sizeof(mlv_wbal_hdr_t) +
-                           sizeof(mlv_styl_hdr_t) +
-                           sizeof(mlv_wavi_hdr_t) +
-                           sizeof(mlv_diso_hdr_t) +
-                           sizeof(mlv_dark_hdr_t) +
-                           sizeof(camera_id_t) +
-                           video_index_size +
-                           audio_index_size +
-                           vers_index_size;
-
-    uint8_t * mapp_buf = malloc(mapp_buf_size);
+    size_t mapp_buf_size = mapp_index_size(video->filenum, video->frames, video->audios, video->vers_blocks);
+    size_t audio_offset = (mapp_buf_size + 7) & ~(size_t)7;
+
+    uint8_t * mapp_buf = calloc(audio_offset, 1);
     if(!mapp_buf)
     {
         return 1;
     }
 
-    /* init mapp header */
-    mapp_header_t mapp_header = { "MAPP", mapp_buf_size + video->audio_size, MAPP_VERSION, video->block_num, video->frames, video->audios, video->vers_blocks, video->audio_size, video->dark_frame_offset };
-    /* copy pointer to mapp buffer */
-    uint8_t * ptr = mapp_buf;
+    /* copy pointer to mapp buffer, header is filled last */
+    uint8_t * ptr = mapp_buf + sizeof(mapp_header_t);
     /* fill mapp buffer */
-    memcpy(ptr, (uint8_t*)&mapp_header, sizeof(mapp_header_t));
-    memcpy(ptr += sizeof(mapp_header_t), (uint8_t*)&(video->MLVI), sizeof(mlv_file_hdr_t));
+    memcpy(ptr, (uint8_t*)video->chunk_info, video->filenum * sizeof(mapp_chunk_t));
+    memcpy(ptr += video->filenum * sizeof(mapp_chunk_t), (uint8_t*)&(video->MLVI), sizeof(mlv_file_hdr_t));
     memcpy(ptr += sizeof(mlv_file_hdr_t), (uint8_t*)&(video->RAWI), sizeof(mlv_rawi_hdr_t));
     memcpy(ptr += sizeof(mlv_rawi_hdr_t), (uint8_t*)&(video->RAWC), sizeof(mlv_rawc_hdr_t));
     memcpy(ptr += sizeof(mlv_rawc_hdr_t), (uint8_t*)&(video->IDNT), sizeof(mlv_idnt_hdr_t));
@@ -763,7 +1382,9 @@ static int save_mapp(mlvObject_t * video)
     memcpy(ptr += sizeof(mlv_styl_hdr_t), (uint8_t*)&(video->WAVI), sizeof(mlv_wavi_hdr_t));
     memcpy(ptr += sizeof(mlv_wavi_hdr_t), (uint8_t*)&(video->DISO), sizeof(mlv_diso_hdr_t));
     memcpy(ptr += sizeof(mlv_diso_hdr_t), (uint8_t*)&(video->DARK), sizeof(mlv_dark_hdr_t));
-    memcpy(ptr += sizeof(mlv_dark_hdr_t), (uint8_t*)&(video->camid), sizeof(camera_id_t));
+    memcpy(ptr += sizeof(mlv_dark_hdr_t), (uint8_t*)&(video->INFO), sizeof(mlv_info_hdr_t));
+    memcpy(ptr += sizeof(mlv_info_hdr_t), (uint8_t*)video->INFO_STRING, sizeof(video->INFO_STRING));
+    memcpy(ptr += sizeof(video->INFO_STRING), (uint8_t*)&(video->camid), sizeof(camera_id_t));
     ptr += sizeof(camera_id_t);
     if(video->video_index)
     {
@@ -781,55 +1402,78 @@ static int save_mapp(mlvObject_t * video)
         ptr += vers_index_size;
     }
 
+    /* init mapp header */
+    mapp_header_t mapp_header = {
+        .fileMagic = { 'M', 'A', 'P', 'P' },
+        .mapp_size = audio_offset + audio_size,
+        .mapp_version = MAPP_VERSION,
+        .block_num = video->block_num,
+        .video_frames = video->frames,
+        .audio_frames = video->audios,
+        .vers_blocks = video->vers_blocks,
+        .audio_size = audio_size,
+        .df_offset = video->dark_frame_offset,
+        .chunk_count = video->filenum,
+        .audio_offset = audio_offset,
+        .checksum = mapp_checksum(mapp_buf + sizeof(mapp_header_t), audio_offset - sizeof(mapp_header_t)),
+        .audio_checksum = mapp_checksum(audio_data, audio_size)
+    };
+    memcpy(mapp_buf, (uint8_t*)&mapp_header, sizeof(mapp_header_t));
+
     /* open .MAPP file for writing */
+    char * mapp_filename = mapp_file_name(video);
     FILE* mappf = fopen(mapp_filename, "wb");
     if (!mappf)
     {
         DEBUG( printf("Could not open %s\n\n", mapp_filename); )
+        free(mapp_filename);
         free(mapp_buf);
         return 1;
     }
 
     /* write mapp buffer */
-    if(fwrite(mapp_buf, mapp_buf_size, 1, mappf) != 1)
+    if(fwrite(mapp_buf, audio_offset, 1, mappf) != 1)
     {
         DEBUG( printf("\nCould not save header and metadata to %s\n", mapp_filename); )
         fclose(mappf);
+        free(mapp_filename);
         free(mapp_buf);
         return 1;
     }
     DEBUG( printf("\nHeader and metadata saved to %s\n", mapp_filename); )
 
-    /* write mapp buffer */
-    if(fwrite(video->audio_data, video->audio_size, 1, mappf) != 1)
+    /* write audio data */
+    if(audio_size && fwrite(audio_data, audio_size, 1, mappf) != 1)
     {
         DEBUG( printf("Could not save audio data to %s\n", mapp_filename); )
         fclose(mappf);
+        free(mapp_filename);
         free(mapp_buf);
         return 1;
     }
     DEBUG( printf("Audio data saved to %s\n", mapp_filename); )
 
     fclose(mappf);
+    free(mapp_filename);
     free(mapp_buf);
     return 0;
 }
 
-/* Load MLV App map file (.MAPP) */
+/* Load MLV App map file (.MAPP), audio data stays in the file until getMlvAudioData() needs it.
+ * Chunks which changed since the .MAPP was saved are indexed again and the .MAPP is updated */
 static int load_mapp(mlvObject_t * video)
 {
-    int mapp_name_len = strlen(video->path);
-    char * mapp_filename = alloca(mapp_name_len + 4);
-    memset(mapp_filename, 0x00, mapp_name_len + 4);
-    memcpy(mapp_filename, video->path, mapp_name_len);
-    char * dot = strrchr(mapp_filename, '.');
-    memcpy(dot, ".MAPP\0", 6);
+    char * mapp_filename = mapp_file_name(video);
+    uint8_t * mapp_map = NULL;
+    uint64_t mapp_map_size = 0;
+    uint8_t * mapp_buf = NULL;
 
     /* open .MAPP file for reading */
     FILE* mappf = fopen(mapp_filename, "rb");
     if (!mappf)
     {
         DEBUG( printf("Could not open %s\n\n", mapp_filename); )
+        free(mapp_filename);
         return 1;
     }
 
@@ -843,9 +1487,9 @@ static int load_mapp(mlvObject_t * video)
     DEBUG( printf("Header loaded from %s\n", mapp_filename); )
 
     DEBUG(
-        printf("Magic %s, Size %lu, Version %d, Total Blocks %d, Total VIDF %d, Total AUDF %d, Total VERS %d, Audio Size %lu, DF Offset %lu\n",
+        printf("Magic %s, Size %lu, Version %d, Total Blocks %d, Total VIDF %d, Total AUDF %d, Total VERS %d, Audio Size %lu, DF Offset %lu, Chunks %d\n",
         mapp_header.fileMagic, mapp_header.mapp_size, mapp_header.mapp_version, mapp_header.block_num, mapp_header.video_frames,
-        mapp_header.audio_frames, mapp_header.vers_blocks, mapp_header.audio_size, mapp_header.df_offset);
+        mapp_header.audio_frames, mapp_header.vers_blocks, mapp_header.audio_size, mapp_header.df_offset, mapp_header.chunk_count);
     )
 
     /* Check MAPP validity */
@@ -857,116 +1501,84 @@ static int load_mapp(mlvObject_t * video)
     /* Check MAPP version */
     if( mapp_header.mapp_version != MAPP_VERSION )
     {
-        DEBUG( printf("Wrong MAPP version: %d. Please rebuild all MAPPs\n", mapp_header.mapp_version); )
+        DEBUG( printf("Wrong MAPP version: %d. MAPP will be rebuilt\n", mapp_header.mapp_version); )
         goto mapp_error;
     }
 
-    uint64_t mark_pos = file_get_pos(mappf);
     file_set_pos(mappf, 0, SEEK_END);
     uint64_t mapp_file_size = file_get_pos(mappf);
-    file_set_pos(mappf, mark_pos, SEEK_SET);
-    if( mapp_header.mapp_size != mapp_file_size )
+    uint64_t index_size = mapp_index_size(mapp_header.chunk_count, mapp_header.video_frames, mapp_header.audio_frames, mapp_header.vers_blocks);
+    if( mapp_header.mapp_size != mapp_file_size
+     || mapp_header.audio_offset < index_size
+     || mapp_header.audio_offset + mapp_header.audio_size != mapp_file_size
+     || mapp_header.chunk_count == 0 || mapp_header.chunk_count > 100 )
     {
         DEBUG( printf("MAPP file size is wrong: %s\n", mapp_filename); )
         goto mapp_error;
     }
 
-    /* Read MLV block headers */
-    int ret = 0;
-    ret += fread(&(video->MLVI), sizeof(mlv_file_hdr_t), 1, mappf);
-    ret += fread(&(video->RAWI), sizeof(mlv_rawi_hdr_t), 1, mappf);
-    ret += fread(&(video->RAWC), sizeof(mlv_rawc_hdr_t), 1, mappf);
-    ret += fread(&(video->IDNT), sizeof(mlv_idnt_hdr_t), 1, mappf);
-    ret += fread(&(video->EXPO), sizeof(mlv_expo_hdr_t), 1, mappf);
-    ret += fread(&(video->LENS), sizeof(mlv_lens_hdr_t), 1, mappf);
-    ret += fread(&(video->ELNS), sizeof(mlv_elns_hdr_t), 1, mappf);
-    ret += fread(&(video->RTCI), sizeof(mlv_rtci_hdr_t), 1, mappf);
-    ret += fread(&(video->WBAL), sizeof(mlv_wbal_hdr_t), 1, mappf);
-    ret += fread(&(video->STYL), sizeof(mlv_styl_hdr_t), 1, mappf);
-    ret += fread(&(video->WAVI), sizeof(mlv_wavi_hdr_t), 1, mappf);
-    ret += fread(&(video->DISO), sizeof(mlv_diso_hdr_t), 1, mappf);
-    ret += fread(&(video->DARK), sizeof(mlv_dark_hdr_t), 1, mappf);
-    ret += fread(&(video->camid), sizeof(camera_id_t), 1, mappf);
-    if(ret != 14)
-    {
-        DEBUG( printf("ret = %d, could not read metadata from %s\n", ret, mapp_filename); )
-        goto mapp_error;
-    }
-    DEBUG( printf("Metadata loaded from %s\n", mapp_filename); )
-
-    /* Read video index */
-    if(mapp_header.video_frames)
+    /* Index part is mapped if possible, else read */
+    mapp_map = map_chunk(mappf, &mapp_map_size);
+    if(mapp_map)
     {
-        size_t video_index_size = mapp_header.video_frames * sizeof(frame_index_t);
-
-        video->video_index = malloc(video_index_size);
-        if(!video->video_index)
-        {
-            DEBUG( printf("Malloc error: video index\n"); )
-            goto mapp_error;
-        }
-
-        if ( fread(video->video_index, video_index_size, 1, mappf) != 1 )
-        {
-            DEBUG( printf("Could not read video index from %s\n", mapp_filename); )
-            goto mapp_error;
-        }
-        DEBUG( printf("Video index loaded from %s\n", mapp_filename); )
+        mapp_buf = mapp_map;
     }
-
-    /* Read audio index */
-    if(mapp_header.audio_frames)
+    else
     {
-        size_t audio_index_size = mapp_header.audio_frames * sizeof(frame_index_t);
-
-        video->audio_index = malloc(audio_index_size);
-        if(!video->audio_index)
+        mapp_buf = malloc(mapp_header.audio_offset);
+        file_set_pos(mappf, 0, SEEK_SET);
+        if( !mapp_buf || fread(mapp_buf, mapp_header.audio_offset, 1, mappf) != 1 )
         {
-            DEBUG( printf("Malloc error: audio index\n"); )
+            DEBUG( printf("Could not read index from %s\n", mapp_filename); )
             goto mapp_error;
         }
-
-        if ( fread(video->audio_index, audio_index_size, 1, mappf) != 1 )
-        {
-            DEBUG( printf("Could not read audio index from %s\n", mapp_filename); )
-            goto mapp_error;
-        }
-        DEBUG( printf("Audio index loaded from %s\n", mapp_filename); )
     }
-
-    /* Read vers index */
-    if(mapp_header.vers_blocks)
+    if( mapp_checksum(mapp_buf + sizeof(mapp_header_t), mapp_header.audio_offset - sizeof(mapp_header_t)) != mapp_header.checksum )
     {
-        size_t vers_index_size = mapp_header.vers_blocks * sizeof(frame_index_t);
-
-        video->vers_index = malloc(vers_index_size);
-        if(!video->vers_index)
-        {
-            DEBUG( printf("Malloc error: VERS index\n"); )
-            goto mapp_error;
-        }
-
-        if ( fread(video->vers_index, vers_index_size, 1, mappf) != 1 )
-        {
-            DEBUG( printf("Could not read VERS index from %s\n", mapp_filename); )
-            goto mapp_error;
-        }
-        DEBUG( printf("VERS index loaded from %s\n", mapp_filename); )
+        DEBUG( printf("MAPP checksum is wrong: %s\n", mapp_filename); )
+        goto mapp_error;
     }
 
-    /* Read audio data */
-    if(mapp_header.audio_size)
+    /* Chunk fingerprints and MLV block headers */
+    const uint8_t * ptr = mapp_buf + sizeof(mapp_header_t);
+    mapp_chunk_t * cached_chunks = (mapp_chunk_t *)ptr;
+    ptr += mapp_header.chunk_count * sizeof(mapp_chunk_t);
+    memcpy(&(video->MLVI), ptr, sizeof(mlv_file_hdr_t));
+    memcpy(&(video->RAWI), ptr += sizeof(mlv_file_hdr_t), sizeof(mlv_rawi_hdr_t));
+    memcpy(&(video->RAWC), ptr += sizeof(mlv_rawi_hdr_t), sizeof(mlv_rawc_hdr_t));
+    memcpy(&(video->IDNT), ptr += sizeof(mlv_rawc_hdr_t), sizeof(mlv_idnt_hdr_t));
+    memcpy(&(video->EXPO), ptr += sizeof(mlv_idnt_hdr_t), sizeof(mlv_expo_hdr_t));
+    memcpy(&(video->LENS), ptr += sizeof(mlv_expo_hdr_t), sizeof(mlv_lens_hdr_t));
+    memcpy(&(video->ELNS), ptr += sizeof(mlv_lens_hdr_t), sizeof(mlv_elns_hdr_t));
+    memcpy(&(video->RTCI), ptr += sizeof(mlv_elns_hdr_t), sizeof(mlv_rtci_hdr_t));
+    memcpy(&(video->WBAL), ptr += sizeof(mlv_rtci_hdr_t), sizeof(mlv_wbal_hdr_t));
+    memcpy(&(video->STYL), ptr += sizeof(mlv_wbal_hdr_t), sizeof(mlv_styl_hdr_t));
+    memcpy(&(video->WAVI), ptr += sizeof(mlv_styl_hdr_t), sizeof(mlv_wavi_hdr_t));
+    memcpy(&(video->DISO), ptr += sizeof(mlv_wavi_hdr_t), sizeof(mlv_diso_hdr_t));
+    memcpy(&(video->DARK), ptr += sizeof(mlv_diso_hdr_t), sizeof(mlv_dark_hdr_t));
+    memcpy(&(video->INFO), ptr += sizeof(mlv_dark_hdr_t), sizeof(mlv_info_hdr_t));
+    memcpy(video->INFO_STRING, ptr += sizeof(mlv_info_hdr_t), sizeof(video->INFO_STRING));
+    memcpy(&(video->camid), ptr += sizeof(video->INFO_STRING), sizeof(camera_id_t));
+    ptr += sizeof(camera_id_t);
+    video->INFO_STRING[sizeof(video->INFO_STRING) - 1] = 0;
+    DEBUG( printf("Metadata loaded from %s\n", mapp_filename); )
+
+    /* Video, audio and VERS index */
+    size_t video_index_size = mapp_header.video_frames * sizeof(frame_index_t);
+    size_t audio_index_size = mapp_header.audio_frames * sizeof(frame_index_t);
+    size_t vers_index_size = mapp_header.vers_blocks * sizeof(frame_index_t);
+    video->video_index = malloc(video_index_size + sizeof(frame_index_t));
+    video->audio_index = malloc(audio_index_size + sizeof(frame_index_t));
+    video->vers_index = malloc(vers_index_size + sizeof(frame_index_t));
+    if(!video->video_index || !video->audio_index || !video->vers_index)
     {
-        video->audio_buffer_size = mapp_header.audio_size;
-        video->audio_size = mapp_header.audio_size;
-        video->audio_data = malloc(mapp_header.audio_size);
-        if ( fread(video->audio_data, mapp_header.audio_size, 1, mappf) != 1 )
-        {
-            DEBUG( printf("Could not read audio data from %s\n", mapp_filename); )
-            goto mapp_error;
-        }
-        DEBUG( printf("Audio data loaded from %s\n", mapp_filename); )
+        DEBUG( printf("Malloc error: index\n"); )
+        goto mapp_error;
     }
+    memcpy(video->video_index, ptr, video_index_size);
+    memcpy(video->audio_index, ptr += video_index_size, audio_index_size);
+    memcpy(video->vers_index, ptr += audio_index_size, vers_index_size);
+    DEBUG( printf("Index loaded from %s\n", mapp_filename); )
 
     /* Set video and audio frame counts */
     video->frames = mapp_header.video_frames;
@@ -977,9 +1589,42 @@ static int load_mapp(mlvObject_t * video)
     video->dark_frame_offset = mapp_header.df_offset;
     video->vers_blocks = mapp_header.vers_blocks;
 
+    /* Audio data is read when needed */
+    video->audio_size = mapp_header.audio_size;
+    video->audio_buffer_size = mapp_header.audio_size;
+    video->audio_mapp_offset = (mapp_header.audio_size) ? mapp_header.audio_offset : 0;
+    video->audio_mapp_checksum = mapp_header.audio_checksum;
+
+    /* Are the chunks still the same? */
+    int changed = (mapp_header.chunk_count != (uint32_t)video->filenum);
+    for (int i = 0; i < video->filenum && !changed; ++i)
+    {
+        uint64_t size;
+        int64_t mtime;
+        get_chunk_fingerprint(video->file[i], &size, &mtime);
+        if (size != cached_chunks[i].size || mtime != cached_chunks[i].mtime) changed = 1;
+    }
+    if(changed)
+    {
+        DEBUG( printf("Chunks changed since %s was saved, updating index\n", mapp_filename); )
+        if(update_mlv_index(video, cached_chunks, mapp_header.chunk_count)) goto mapp_error;
+    }
+    else
+    {
+        video->chunk_info = malloc(video->filenum * sizeof(mapp_chunk_t));
+        if(video->chunk_info) memcpy(video->chunk_info, cached_chunks, video->filenum * sizeof(mapp_chunk_t));
+    }
+
     DEBUG( printf("MAPP version %u loaded: %s\n", mapp_header.mapp_version, mapp_filename); )
 
+    if(mapp_map) unmap_chunk(mapp_map, mapp_map_size);
+    else free(mapp_buf);
     fclose(mappf);
+
+    /* Write the updated index */
+    if(changed) save_mapp(video);
+
+    free(mapp_filename);
     return 0;
 
 mapp_error:
@@ -1004,11 +1649,63 @@ mapp_error:
         free(video->audio_data);
         video->audio_data = NULL;
     }
+    if(video->chunk_info)
+    {
+        free(video->chunk_info);
+        video->chunk_info = NULL;
+    }
+    video->frames = video->audios = video->vers_blocks = 0;
+    video->audio_size = video->audio_buffer_size = 0;
+    video->audio_mapp_offset = 0;
+    if(mapp_map) unmap_chunk(mapp_map, mapp_map_size);
+    else if(mapp_buf) free(mapp_buf);
     if(mappf) fclose(mappf);
+    free(mapp_filename);
 
     return 1;
 }
 
+/* Reads audio data from the .MAPP, or from the MLV if the .MAPP does not have it (anymore) */
+static void load_mapp_audio(mlvObject_t * video)
+{
+    uint64_t offset = video->audio_mapp_offset;
+    video->audio_mapp_offset = 0;
+
+    char * mapp_filename = mapp_file_name(video);
+    FILE * mappf = fopen(mapp_filename, "rb");
+    video->audio_data = malloc(video->audio_size);
+    int loaded = 0;
+    if(mappf && video->audio_data)
+    {
+        file_set_pos(mappf, offset, SEEK_SET);
+        loaded = ( fread(video->audio_data, video->audio_size, 1, mappf) == 1
+                && mapp_checksum(video->audio_data, video->audio_size) == video->audio_mapp_checksum );
+    }
+    if(mappf) fclose(mappf);
+
+    if(loaded)
+    {
+        DEBUG( printf("Audio data loaded from %s\n", mapp_filename); )
+    }
+    else
+    {
+        DEBUG( printf("Could not load audio data from %s, reading it from MLV\n", mapp_filename); )
+        if(video->audio_data) free(video->audio_data);
+        video->audio_data = NULL;
+        video->audio_size = 0;
+        readMlvAudioData(video);
+    }
+    free(mapp_filename);
+}
+
+uint8_t * getMlvAudioData(mlvObject_t * video)
+{
+    pthread_mutex_lock( &video->g_mutexCount );
+    if(video->audio_mapp_offset) load_mapp_audio(video);
+    pthread_mutex_unlock( &video->g_mutexCount );
+    return video->audio_data;
+}
+
 /* Save MLV headers */
 int saveMlvHeaders(mlvObject_t * video, FILE * output_mlv, int export_audio, int export_mode, uint32_t frame_start, uint32_t frame_end, const char * version, char * error_message)
 {
@@ -1431,7 +2128,8 @@ int saveMlvAVFrame(mlvObject_t * video, FILE * output_mlv, int export_audio, int
         if(!ret)
         {
             dng_unpack_image_bits(frame_buf_unpacked, (uint16_t*)frame_buf, video->RAWI.xRes, video->RAWI.yRes, video->RAWI.raw_info.bits_per_pixel);
-            ret = dng_compress_image(frame_buf_compressed, frame_buf_unpacked, &frame_size_compressed, video->RAWI.xRes, video->RAWI.yRes, video->RAWI.raw_info.bits_per_pixel);
+            if(!video->lj92_enc) lj92_encoder_open(&video->lj92_enc, LJ92_TABLE_FRAMES);
+            ret = dng_compress_image(video->lj92_enc, frame_buf_compressed, frame_buf_unpacked, &frame_size_compressed, video->RAWI.xRes, video->RAWI.yRes, video->RAWI.raw_info.bits_per_pixel, getMlvLj92Slices(video));
             if(ret == LJ92_ERROR_NONE)
             {
                 vidf_hdr.blockSize = sizeof(mlv_vidf_hdr_t) + frame_size_compressed;
@@ -1509,6 +2207,8 @@ int saveMlvAVFrame(mlvObject_t * video, FILE * output_mlv, int export_audio, int
     {
         /* initialize AUDF header */
         mlv_audf_hdr_t audf_hdr = { { 'A','U','D','F' }, 0, 0, 0, 0 };
+        /* loading the audio from the .MAPP can change audio_size, so get it before the sizes */
+        uint8_t * audio_data = getMlvAudioData(video);
 
         /* Calculate the sum of audio sample sizes for all audio channels */
         uint64_t audio_sample_size = getMlvAudioChannels(video) * (getMlvAudioBitsPerSample(video) / 8);
@@ -1542,7 +2242,7 @@ int saveMlvAVFrame(mlvObject_t * video, FILE * output_mlv, int export_audio, int
         }
 
         /* write audio data */
-        if(fwrite(video->audio_data + audio_start_offset_aligned, cut_audio_size_aligned, 1, output_mlv) != 1)
+        if(!audio_data || fwrite(audio_data + audio_start_offset_aligned, cut_audio_size_aligned, 1, output_mlv) != 1)
         {
             sprintf(error_message, "Could not write AUDF block audio data");
             DEBUG( printf("\n%s\n", error_message); )
@@ -1791,8 +2491,15 @@ short_cut:
     /* For frame cache */
     video->rgb_raw_frames = (uint16_t **)malloc( sizeof(uint16_t *) * video->frames );
     video->rgb_raw_current_frame = (uint16_t *)malloc( getMlvWidth(video) * getMlvHeight(video) * 3 * sizeof(uint16_t) );
+    video->rgb_raw_current_overview = (uint16_t *)malloc( getMlvPreviewWidth(video, MLV_REGION_OVERVIEW_SCALE) * getMlvPreviewHeight(video, MLV_REGION_OVERVIEW_SCALE) * 3 * sizeof(uint16_t) );
     video->cached_frames = (uint8_t *)calloc( sizeof(uint8_t), video->frames );
 
+    /* Frame data is read from memory mapped chunks where possible */
+    map_mlv_chunks(video);
+
+    /* Frame buffer arena sized for this clip */
+    reset_mlv_frame_buffers(video);
+
     isMlvActive(video) = 5;
 
     /* Start caching unless it was disabled already */
@@ -1807,353 +2514,799 @@ short_cut:
     return MLV_ERR_NONE;
 }
 
-/* Reads an MLV file in to a mlv object(mlvObject_t struct) 
- * only puts metadata in to the mlvObject_t, 
- * no debayering or bit unpacking */
-int openMlvClip(mlvObject_t * video, char * mlvPath, int open_mode, char * error_message)
+/* Size of the read window of the indexer. Headers of small blocks (audio, small frames) come with one read,
+ * for big frames one read of the window gets the next header */
+#define INDEX_WINDOW (64 * 1024)
+/* Chunks scanned at once, reads of several files keep disks and network shares busy */
+#define INDEX_THREADS 8
+
+/* Which header blocks an index scan has found */
+enum {
+    INDEX_RAWI = 1 << 0, INDEX_RAWC = 1 << 1, INDEX_WAVI = 1 << 2, INDEX_EXPO = 1 << 3,
+    INDEX_LENS = 1 << 4, INDEX_ELNS = 1 << 5, INDEX_WBAL = 1 << 6, INDEX_STYL = 1 << 7,
+    INDEX_RTCI = 1 << 8, INDEX_IDNT = 1 << 9, INDEX_INFO = 1 << 10, INDEX_DISO = 1 << 11,
+    INDEX_DARK = 1 << 12, INDEX_VIDF = 1 << 13, INDEX_AUDF = 1 << 14, INDEX_VERS = 1 << 15
+};
+
+/* Everything found in one chunk */
+typedef struct
 {
-    video->path = malloc( strlen(mlvPath) + 1 );
-    memcpy(video->path, mlvPath, strlen(mlvPath));
-    video->path[strlen(mlvPath)] = 0x0;
-    video->file = load_all_chunks(mlvPath, &video->filenum);
-    if(!video->file)
+    mlvObject_t * video;
+    int chunk;
+    int open_mode;
+    int skip;                /* Chunk is already indexed */
+    uint64_t start;          /* Index from here, 0 = whole chunk */
+    int error;               /* MLV_ERR_* */
+    char error_message[256];
+    int fread_err;           /* Flips to 0 if a read failed */
+    uint64_t block_num;
+    uint64_t file_size;
+    uint64_t scanned_end;    /* End of the last complete block */
+    uint64_t scanned_blocks; /* Complete blocks from start to scanned_end */
+
+    frame_index_t * video_index;
+    uint64_t video_frames, video_index_max;
+    frame_index_t * audio_index;
+    uint64_t audio_frames, audio_index_max;
+    frame_index_t * vers_index;
+    uint64_t vers_blocks, vers_index_max;
+
+    /* Last header of each kind in this chunk, or the first one for LENS, ELNS, WBAL, STYL and RTCI */
+    uint32_t found;
+    mlv_file_hdr_t MLVI;
+    mlv_rawi_hdr_t RAWI;
+    mlv_rawc_hdr_t RAWC;
+    mlv_wavi_hdr_t WAVI;
+    mlv_expo_hdr_t EXPO;
+    mlv_lens_hdr_t LENS;
+    mlv_elns_hdr_t ELNS;
+    mlv_wbal_hdr_t WBAL;
+    mlv_styl_hdr_t STYL;
+    mlv_rtci_hdr_t RTCI;
+    mlv_idnt_hdr_t IDNT;
+    mlv_info_hdr_t INFO;
+    char INFO_STRING[256];
+    mlv_diso_hdr_t DISO;
+    mlv_dark_hdr_t DARK;
+    uint64_t dark_frame_offset;
+    mlv_vidf_hdr_t VIDF;
+    mlv_audf_hdr_t AUDF;
+    mlv_vers_hdr_t VERS;
+
+    /* Read window */
+    uint8_t * window;
+    uint64_t window_start;
+    uint64_t window_size;
+} index_scan_t;
+
+/* Shared by the index threads */
+typedef struct
+{
+    index_scan_t * scans;
+    int count;
+    int next;
+    pthread_mutex_t mutex;
+} index_job_t;
+
+/* Copies size bytes at offset of the chunk to dst, from the read window if they are in it */
+static int index_read(index_scan_t * scan, uint64_t offset, uint64_t size, void * dst)
+{
+    FILE * file = scan->video->file[scan->chunk];
+    if (offset < scan->window_start || offset + size > scan->window_start + scan->window_size)
     {
-        sprintf(error_message, "Could not open file:  %s", video->path);
-        DEBUG( printf("\n%s\n", error_message); )
-        return MLV_ERR_OPEN; // can not open file
+        file_set_pos(file, offset, SEEK_SET);
+        /* Too big for the window, read directly */
+        if (size > INDEX_WINDOW) return (fread(dst, size, 1, file) == 1);
+
+        scan->window_start = offset;
+        scan->window_size = fread(scan->window, 1, MIN(INDEX_WINDOW, scan->file_size - offset), file);
+        if (offset + size > scan->window_start + scan->window_size) return 0;
     }
+    memcpy(dst, scan->window + (offset - scan->window_start), size);
+    return 1;
+}
 
-    /* Mutexes for every file */
-    video->main_file_mutex = calloc(sizeof(pthread_mutex_t), video->filenum);
-    for (int i = 0; i < video->filenum; ++i)
+/* Reads a header block struct */
+#define INDEX_READ_BLOCK(scan, offset, hdr) index_read((scan), (offset), sizeof(hdr), &(hdr))
+
+/* Returns the next free entry of an index, which grows if needed */
+static frame_index_t * index_add(frame_index_t ** index, uint64_t * count, uint64_t * max)
+{
+    if (*count >= *max)
+    {
+        uint64_t new_max = (*max) ? *max * 2 : 128;
+        frame_index_t * new_index = realloc(*index, new_max * sizeof(frame_index_t));
+        if (!new_index) return NULL;
+        *index = new_index;
+        *max = new_max;
+    }
+    frame_index_t * entry = *index + *count;
+    memset(entry, 0, sizeof(frame_index_t));
+    (*count)++;
+    return entry;
+}
+
+static void index_error(index_scan_t * scan, int error, const char * message)
+{
+    scan->error = error;
+    snprintf(scan->error_message, sizeof(scan->error_message), "%s:  %s", message, scan->video->path);
+}
+
+/* Collects all blocks of one chunk */
+static void index_mlv_chunk(index_scan_t * scan)
+{
+    mlvObject_t * video = scan->video;
+    FILE * file = video->file[scan->chunk];
+    int chunk = scan->chunk;
+    mlv_hdr_t block_header;
+
+    scan->fread_err = 1;
+    scan->window = malloc(INDEX_WINDOW);
+    scan->window_start = scan->window_size = 0;
+    if ( !scan->window )
     {
-        pthread_mutex_init(video->main_file_mutex + i, NULL);
+        index_error(scan, MLV_ERR_IO, "Could not allocate the index read buffer");
+        return;
     }
 
-    /* In preview mode we don't need to waste time on audio loading from MAPP */
-    if(open_mode != MLV_OPEN_PREVIEW)
+    /* Getting size of file in bytes */
+    file_set_pos(file, 0, SEEK_END);
+    scan->file_size = file_get_pos(file);
+    if ( !scan->file_size )
     {
-        if(!load_mapp(video)) goto short_cut;
+        index_error(scan, MLV_ERR_INVALID, "Zero byte size file");
+        return;
     }
 
-    uint64_t block_num = 0; /* Number of blocks in file */
-    mlv_hdr_t block_header; /* Basic MLV block header */
-    uint64_t video_frames = 0; /* Number of frames in video */
-    uint64_t audio_frames = 0; /* Number of audio blocks in video */
-    uint32_t vers_blocks = 0; /* Number of VERS blocks in MLV */
-    uint64_t video_index_max = 0; /* initial size of frame index */
-    uint64_t audio_index_max = 0; /* initial size of audio index */
-    uint32_t vers_index_max = 0; /* initial size of VERS index */
-    int mlvi_read = 0; /* Flips to 1 if 1st chunk MLVI block was read */
-    int rtci_read = 0; /* Flips to 1 if 1st RTCI block was read */
-    int lens_read = 0; /* Flips to 1 if 1st LENS block was read */
-    int elns_read = 0; /* Flips to 1 if 1st ELNS block was read */
-    int wbal_read = 0; /* Flips to 1 if 1st WBAL block was read */
-    int styl_read = 0; /* Flips to 1 if 1st STYL block was read */
-    int fread_err = 1;
+    /* Read file header */
+    if ( !index_read(scan, 0, sizeof(mlv_hdr_t), &block_header) )
+    {
+        index_error(scan, MLV_ERR_INVALID, "File is too short to be a valid MLV");
+        return;
+    }
+    if ( memcmp(block_header.blockType, "MLVI", 4) != 0 )
+    {
+        index_error(scan, MLV_ERR_INVALID, "File header is missing, invalid MLV");
+        return;
+    }
+    scan->fread_err &= INDEX_READ_BLOCK(scan, 0, scan->MLVI);
 
-    for(int i = 0; i < video->filenum; i++)
+    /* Blocks start after the MLVI of the first chunk, MLVI of the others is skipped like an unknown block */
+    uint64_t block_start = (chunk == 0) ? sizeof(mlv_file_hdr_t) : 0;
+    if (scan->start) block_start = scan->start;
+    scan->scanned_end = block_start;
+    uint64_t progress = 0;
+    while ( block_start < scan->file_size ) /* Check if were at end of file yet */
     {
-        /* Getting size of file in bytes */
-        file_set_pos(video->file[i], 0, SEEK_END);
-        uint64_t file_size = file_get_pos(video->file[i]);
-        if ( !file_size )
+        /* Read block header */
+        if ( !index_read(scan, block_start, sizeof(mlv_hdr_t), &block_header) )
         {
-            sprintf(error_message, "Zero byte size file:  %s", video->path);
-            DEBUG( printf("\n%s\n", error_message); )
-            --video->filenum;
-            return MLV_ERR_INVALID;
+            scan->fread_err = 0;
+            break;
         }
-        file_set_pos(video->file[i], 0, SEEK_SET); /* Start of file */
-
-        /* Read file header */
-        if ( fread(&block_header, sizeof(mlv_hdr_t), 1, video->file[i]) != 1 )
+        if(block_header.blockSize < sizeof(mlv_hdr_t))
         {
-            sprintf(error_message, "File is too short to be a valid MLV:  %s", video->path);
-            DEBUG( printf("\n%s\n", error_message); )
-            --video->filenum;
-            return MLV_ERR_INVALID;
+            char message[64];
+            snprintf(message, sizeof(message), "Invalid blockSize '%u', corrupted file", block_header.blockSize);
+            index_error(scan, MLV_ERR_INVALID, message);
+            return;
         }
-        file_set_pos(video->file[i], 0, SEEK_SET); /* Start of file */
 
-        if ( memcmp(block_header.blockType, "MLVI", 4) == 0 )
+        /* Next block location */
+        uint64_t next_block = block_start + (uint64_t)block_header.blockSize;
+
+        /* Now check what kind of block it is and read it in to the mlv object */
+        if ( memcmp(block_header.blockType, "NULL", 4) == 0 || memcmp(block_header.blockType, "BKUP", 4) == 0)
         {
-            if( !mlvi_read )
-            {
-                fread_err &= fread(&video->MLVI, sizeof(mlv_file_hdr_t), 1, video->file[i]);
-                mlvi_read = 1; // read MLVI only for first chunk
-            }
+            /* do nothing, skip this block */
         }
-        else
+        else if ( memcmp(block_header.blockType, "VIDF", 4) == 0 )
         {
-            sprintf(error_message, "File header is missing, invalid MLV:  %s", video->path);
-            DEBUG( printf("\n%s\n", error_message); )
-            --video->filenum;
-            return MLV_ERR_INVALID;
-        }
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->VIDF);
+            scan->found |= INDEX_VIDF;
 
-        while ( file_get_pos(video->file[i]) < file_size ) /* Check if were at end of file yet */
-        {
-            /* Record position to go back to it later if block is read */
-            uint64_t block_start = file_get_pos(video->file[i]);
-            /* Read block header */
-            fread_err &= fread(&block_header, sizeof(mlv_hdr_t), 1, video->file[i]);
-            if(block_header.blockSize < sizeof(mlv_hdr_t))
-            {
-                sprintf(error_message, "Invalid blockSize '%u', corrupted file:  %s", block_header.blockSize, video->path);
-                DEBUG( printf("\n%s\n", error_message); )
-                --video->filenum;
-                return MLV_ERR_INVALID;
-            }
+            DEBUG( printf("video frame %i | chunk %i | size %lu | offset %lu | time %lu\n",
+                           scan->VIDF.frameNumber, chunk, scan->VIDF.blockSize - sizeof(mlv_vidf_hdr_t) - scan->VIDF.frameSpace,
+                           block_start + scan->VIDF.frameSpace, scan->VIDF.timestamp); )
 
-            /* Next block location */
-            uint64_t next_block = (uint64_t)block_start + (uint64_t)block_header.blockSize;
-            /* Go back to start of block for next bit */
-            file_set_pos(video->file[i], block_start, SEEK_SET);
-
-            /* Now check what kind of block it is and read it in to the mlv object */
-            if ( memcmp(block_header.blockType, "NULL", 4) == 0 || memcmp(block_header.blockType, "BKUP", 4) == 0)
+            frame_index_t * entry = index_add(&scan->video_index, &scan->video_frames, &scan->video_index_max);
+            if (!entry)
             {
-                /* do nothing, skip this block */
+                scan->fread_err = 0;
+                break;
             }
-            else if ( memcmp(block_header.blockType, "VIDF", 4) == 0 )
-            {
-                fread_err &= fread(&video->VIDF, sizeof(mlv_vidf_hdr_t), 1, video->file[i]);
-
-                DEBUG( printf("video frame %i | chunk %i | size %lu | offset %lu | time %lu\n",
-                               video->VIDF.frameNumber, i, video->VIDF.blockSize - sizeof(mlv_vidf_hdr_t) - video->VIDF.frameSpace,
-                               block_start + video->VIDF.frameSpace, video->VIDF.timestamp); )
-
-                /* Dynamically resize the frame index buffer */
-                if(!video_index_max)
-                {
-                    video_index_max = 128;
-                    video->video_index = (frame_index_t *)calloc(video_index_max, sizeof(frame_index_t));
-                }
-                else if(video_frames >= video_index_max - 1)
-                {
-                    uint64_t video_index_new_size = video_index_max * 2;
-                    frame_index_t * video_index_new = (frame_index_t *)calloc(video_index_new_size, sizeof(frame_index_t));
-                    memcpy(video_index_new, video->video_index, video_index_max * sizeof(frame_index_t));
-                    free(video->video_index);
-                    video->video_index = video_index_new;
-                    video_index_max = video_index_new_size;
-                }
-
-                /* Fill frame index */
-                video->video_index[video_frames].frame_type = 1;
-                video->video_index[video_frames].chunk_num = i;
-                video->video_index[video_frames].frame_size = video->VIDF.blockSize - sizeof(mlv_vidf_hdr_t) - video->VIDF.frameSpace;
-                video->video_index[video_frames].frame_offset = file_get_pos(video->file[i]) + video->VIDF.frameSpace;
-                video->video_index[video_frames].frame_number = video->VIDF.frameNumber;
-                video->video_index[video_frames].frame_time = video->VIDF.timestamp;
-                video->video_index[video_frames].block_offset = block_start;
+            entry->frame_type = 1;
+            entry->chunk_num = chunk;
+            entry->frame_size = scan->VIDF.blockSize - sizeof(mlv_vidf_hdr_t) - scan->VIDF.frameSpace;
+            entry->frame_offset = block_start + sizeof(mlv_vidf_hdr_t) + scan->VIDF.frameSpace;
+            entry->frame_number = scan->VIDF.frameNumber;
+            entry->frame_time = scan->VIDF.timestamp;
+            entry->block_offset = block_start;
+
+            /* In preview mode stop after first VIDF */
+            if (scan->open_mode == MLV_OPEN_PREVIEW) break;
+        }
+        else if ( memcmp(block_header.blockType, "AUDF", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->AUDF);
+            scan->found |= INDEX_AUDF;
 
-                /* Count actual video frames */
-                video_frames++;
+            DEBUG( printf("audio frame %i | chunk %i | size %lu | offset %lu | time %lu\n",
+                           scan->AUDF.frameNumber, chunk, scan->AUDF.blockSize - sizeof(mlv_audf_hdr_t) - scan->AUDF.frameSpace,
+                           block_start + scan->AUDF.frameSpace, scan->AUDF.timestamp); )
 
-                /* In preview mode exit loop after first videf read */
-                if(open_mode == MLV_OPEN_PREVIEW)
-                {
-                    video->frames = video_frames;
-                    video->audios = audio_frames;
-                    goto preview_out;
-                }
+            frame_index_t * entry = index_add(&scan->audio_index, &scan->audio_frames, &scan->audio_index_max);
+            if (!entry)
+            {
+                scan->fread_err = 0;
+                break;
             }
-            else if ( memcmp(block_header.blockType, "AUDF", 4) == 0 )
+            entry->frame_type = 2;
+            entry->chunk_num = chunk;
+            entry->frame_size = scan->AUDF.blockSize - sizeof(mlv_audf_hdr_t) - scan->AUDF.frameSpace;
+            entry->frame_offset = block_start + sizeof(mlv_audf_hdr_t) + scan->AUDF.frameSpace;
+            entry->frame_number = scan->AUDF.frameNumber;
+            entry->frame_time = scan->AUDF.timestamp;
+            entry->block_offset = block_start;
+        }
+        else if ( memcmp(block_header.blockType, "RAWI", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->RAWI);
+            scan->found |= INDEX_RAWI;
+        }
+        else if ( memcmp(block_header.blockType, "RAWC", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->RAWC);
+            scan->found |= INDEX_RAWC;
+        }
+        else if ( memcmp(block_header.blockType, "WAVI", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->WAVI);
+            scan->found |= INDEX_WAVI;
+        }
+        else if ( memcmp(block_header.blockType, "EXPO", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->EXPO);
+            scan->found |= INDEX_EXPO;
+        }
+        else if ( memcmp(block_header.blockType, "LENS", 4) == 0 )
+        {
+            if( !(scan->found & INDEX_LENS) )
             {
-                fread_err &= fread(&video->AUDF, sizeof(mlv_audf_hdr_t), 1, video->file[i]);
-
-                DEBUG( printf("audio frame %i | chunk %i | size %lu | offset %lu | time %lu\n",
-                               video->AUDF.frameNumber, i, video->AUDF.blockSize - sizeof(mlv_audf_hdr_t) - video->AUDF.frameSpace,
-                               block_start + video->AUDF.frameSpace, video->AUDF.timestamp); )
-
-                /* Dynamically resize the audio index buffer */
-                if(!audio_index_max)
-                {
-                    audio_index_max = 32;
-                    video->audio_index = (frame_index_t *)malloc(sizeof(frame_index_t) * audio_index_max);
-                }
-                else if(audio_frames >= audio_index_max - 1)
-                {
-                    uint64_t audio_index_new_size = audio_index_max * 2;
-                    frame_index_t * audio_index_new = (frame_index_t *)calloc(audio_index_new_size, sizeof(frame_index_t));
-                    memcpy(audio_index_new, video->audio_index, audio_index_max * sizeof(frame_index_t));
-                    free(video->audio_index);
-                    video->audio_index = audio_index_new;
-                    audio_index_max = audio_index_new_size;
-                }
-
-                /* Fill audio index */
-                video->audio_index[audio_frames].frame_type = 2;
-                video->audio_index[audio_frames].chunk_num = i;
-                video->audio_index[audio_frames].frame_size = video->AUDF.blockSize - sizeof(mlv_audf_hdr_t) - video->AUDF.frameSpace;
-                video->audio_index[audio_frames].frame_offset = file_get_pos(video->file[i]) + video->AUDF.frameSpace;
-                video->audio_index[audio_frames].frame_number = video->AUDF.frameNumber;
-                video->audio_index[audio_frames].frame_time = video->AUDF.timestamp;
-                video->audio_index[audio_frames].block_offset = block_start;
-
-                /* Count actual audio frames */
-                audio_frames++;
+                scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->LENS);
+                scan->found |= INDEX_LENS; //read only first one
+                //Terminate string, if it isn't terminated.
+                scan->LENS.lensName[31] = '\0';
             }
-            else if ( memcmp(block_header.blockType, "RAWI", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "ELNS", 4) == 0 )
+        {
+            if( !(scan->found & INDEX_ELNS) )
             {
-                fread_err &= fread(&video->RAWI, sizeof(mlv_rawi_hdr_t), 1, video->file[i]);
+                scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->ELNS);
+                scan->found |= INDEX_ELNS; //read only first one
             }
-            else if ( memcmp(block_header.blockType, "RAWC", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "WBAL", 4) == 0 )
+        {
+            if( !(scan->found & INDEX_WBAL) )
             {
-                fread_err &= fread(&video->RAWC, sizeof(mlv_rawc_hdr_t), 1, video->file[i]);
+                scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->WBAL);
+                scan->found |= INDEX_WBAL; //read only first one
             }
-            else if ( memcmp(block_header.blockType, "WAVI", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "STYL", 4) == 0 )
+        {
+            if( !(scan->found & INDEX_STYL) )
             {
-                fread_err &= fread(&video->WAVI, sizeof(mlv_wavi_hdr_t), 1, video->file[i]);
+                scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->STYL);
+                scan->found |= INDEX_STYL; //read only first one
             }
-            else if ( memcmp(block_header.blockType, "EXPO", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "RTCI", 4) == 0 )
+        {
+            if( !(scan->found & INDEX_RTCI) )
             {
-                fread_err &= fread(&video->EXPO, sizeof(mlv_expo_hdr_t), 1, video->file[i]);
+                scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->RTCI);
+                scan->found |= INDEX_RTCI; //read only first one
             }
-            else if ( memcmp(block_header.blockType, "LENS", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "IDNT", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->IDNT);
+            scan->found |= INDEX_IDNT;
+        }
+        else if ( memcmp(block_header.blockType, "INFO", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->INFO);
+            scan->found |= INDEX_INFO;
+            memset(scan->INFO_STRING, 0, sizeof(scan->INFO_STRING));
+            if(scan->INFO.blockSize > sizeof(mlv_info_hdr_t))
             {
-                if( !lens_read )
-                {
-                    fread_err &= fread(&video->LENS, sizeof(mlv_lens_hdr_t), 1, video->file[i]);
-                    lens_read = 1; //read only first one
-                    //Terminate string, if it isn't terminated.
-                    for( int n = 0; n < 32; n++ )
-                    {
-                        if( video->LENS.lensName[n] == '\0' ) break;
-                        if( n == 31 ) video->LENS.lensName[n] = '\0';
-                    }
-                }
+                /* String is cut if longer than INFO_STRING */
+                uint64_t length = MIN(scan->INFO.blockSize - sizeof(mlv_info_hdr_t), sizeof(scan->INFO_STRING) - 1);
+                scan->fread_err &= index_read(scan, block_start + sizeof(mlv_info_hdr_t), length, scan->INFO_STRING);
             }
-            else if ( memcmp(block_header.blockType, "ELNS", 4) == 0 )
+        }
+        else if ( memcmp(block_header.blockType, "DISO", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->DISO);
+            scan->found |= INDEX_DISO;
+        }
+        else if ( memcmp(block_header.blockType, "MARK", 4) == 0
+               || memcmp(block_header.blockType, "ELVL", 4) == 0
+               || memcmp(block_header.blockType, "DEBG", 4) == 0 )
+        {
+            /* do nothing atm */
+        }
+        else if ( memcmp(block_header.blockType, "VERS", 4) == 0 )
+        {
+            /* Find all VERS blocks and make index for them */
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->VERS);
+            scan->found |= INDEX_VERS;
+
+            DEBUG( printf("VERS | chunk %i | size %lu | offset %lu | time %lu\n",
+                           chunk, scan->VERS.blockSize - sizeof(mlv_vers_hdr_t),
+                           block_start, scan->VERS.timestamp); )
+
+            frame_index_t * entry = index_add(&scan->vers_index, &scan->vers_blocks, &scan->vers_index_max);
+            if (!entry)
             {
-                if( !elns_read )
-                {
-                    fread_err &= fread(&video->ELNS, sizeof(mlv_elns_hdr_t), 1, video->file[i]);
-                    elns_read = 1; //read only first one
-                }
+                scan->fread_err = 0;
+                break;
             }
-            else if ( memcmp(block_header.blockType, "WBAL", 4) == 0 )
+            /* frame_number (count of all VERS blocks before) is set when chunks are merged */
+            entry->frame_type = 3;
+            entry->chunk_num = chunk;
+            entry->frame_size = scan->VERS.blockSize - sizeof(mlv_vers_hdr_t);
+            entry->frame_offset = block_start + sizeof(mlv_vers_hdr_t);
+            entry->frame_time = scan->VERS.timestamp;
+            entry->block_offset = block_start;
+        }
+        else if ( memcmp(block_header.blockType, "DARK", 4) == 0 )
+        {
+            scan->fread_err &= INDEX_READ_BLOCK(scan, block_start, scan->DARK);
+            scan->found |= INDEX_DARK;
+            scan->dark_frame_offset = block_start + sizeof(mlv_dark_hdr_t);
+        }
+        else
+        {
+            /* block name is wrong, so try to brute force the position of next valid block */
+            file_set_pos(file, block_start, SEEK_SET);
+            if(!seek_to_next_known_block(file))
             {
-                if( !wbal_read )
-                {
-                    fread_err &= fread(&video->WBAL, sizeof(mlv_wbal_hdr_t), 1, video->file[i]);
-                    wbal_read = 1; //read only first one
-                }
+                char message[64];
+                char block_type[5] = { 0 };
+                memcpy(block_type, block_header.blockType, 4);
+                snprintf(message, sizeof(message), "Unknown blockType '%s' or corrupted file", block_type);
+                index_error(scan, MLV_ERR_CORRUPTED, message);
+                return;
             }
-            else if ( memcmp(block_header.blockType, "STYL", 4) == 0 )
+            next_block = file_get_pos(file);
+            block_start = scan->scanned_end = next_block;
+            continue;
+        }
+
+        /* Progress, added in steps so the scan threads don't fight over the counter */
+        progress += next_block - block_start;
+        if (progress >= INDEX_WINDOW * 16)
+        {
+            __atomic_fetch_add(&video->index_bytes_done, progress, __ATOMIC_RELAXED);
+            progress = 0;
+        }
+
+        /* Move to next block */
+        block_start = next_block;
+        scan->block_num++;
+        if (next_block <= scan->file_size)
+        {
+            scan->scanned_end = next_block;
+            scan->scanned_blocks = scan->block_num;
+        }
+    }
+
+    __atomic_fetch_add(&video->index_bytes_done, progress, __ATOMIC_RELAXED);
+}
+
+static void * index_mlv_thread(void * arg)
+{
+    index_job_t * job = (index_job_t *)arg;
+    while (1)
+    {
+        pthread_mutex_lock( &job->mutex );
+        int chunk = job->next++;
+        pthread_mutex_unlock( &job->mutex );
+        if (chunk >= job->count) break;
+        if (job->scans[chunk].skip) continue;
+
+        index_mlv_chunk(job->scans + chunk);
+        free(job->scans[chunk].window);
+        job->scans[chunk].window = NULL;
+    }
+    return NULL;
+}
+
+/* Scans all chunks, INDEX_THREADS at a time */
+static void run_index_scans(index_scan_t * scans, int chunks)
+{
+    index_job_t job = { .scans = scans, .count = chunks, .next = 0 };
+    pthread_mutex_init(&job.mutex, NULL);
+    int thread_count = MIN(chunks, INDEX_THREADS);
+    pthread_t * threads = calloc(thread_count, sizeof(pthread_t));
+    int started = 0;
+    for (int i = 1; i < thread_count; ++i)
+    {
+        if (pthread_create(threads + started, NULL, index_mlv_thread, &job) == 0) started++;
+    }
+    /* This thread scans too, so nothing is lost if no thread could be started */
+    index_mlv_thread(&job);
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&job.mutex);
+}
+
+/* Takes the headers a chunk scan found, later headers replace earlier ones,
+ * except for the blocks where the first one counts (these are in *found already) */
+static void index_merge_headers(mlvObject_t * video, index_scan_t * scan, uint32_t * found)
+{
+    uint32_t take = scan->found & ~(*found & (INDEX_LENS | INDEX_ELNS | INDEX_WBAL | INDEX_STYL | INDEX_RTCI));
+    if (scan->chunk == 0 && !scan->start) video->MLVI = scan->MLVI;
+    if (take & INDEX_RAWI) video->RAWI = scan->RAWI;
+    if (take & INDEX_RAWC) video->RAWC = scan->RAWC;
+    if (take & INDEX_WAVI) video->WAVI = scan->WAVI;
+    if (take & INDEX_EXPO) video->EXPO = scan->EXPO;
+    if (take & INDEX_LENS) video->LENS = scan->LENS;
+    if (take & INDEX_ELNS) video->ELNS = scan->ELNS;
+    if (take & INDEX_WBAL) video->WBAL = scan->WBAL;
+    if (take & INDEX_STYL) video->STYL = scan->STYL;
+    if (take & INDEX_RTCI) video->RTCI = scan->RTCI;
+    if (take & INDEX_IDNT) video->IDNT = scan->IDNT;
+    if (take & INDEX_INFO)
+    {
+        video->INFO = scan->INFO;
+        memcpy(video->INFO_STRING, scan->INFO_STRING, sizeof(video->INFO_STRING));
+    }
+    if (take & INDEX_DISO) video->DISO = scan->DISO;
+    if (take & INDEX_DARK)
+    {
+        video->DARK = scan->DARK;
+        video->dark_frame_offset = scan->dark_frame_offset;
+    }
+    if (take & INDEX_VIDF) video->VIDF = scan->VIDF;
+    if (take & INDEX_AUDF) video->AUDF = scan->AUDF;
+    if (take & INDEX_VERS) video->VERS = scan->VERS;
+    *found |= scan->found;
+}
+
+/* Appends the index of a chunk to a clip index */
+static int index_append(frame_index_t ** index, uint64_t * count, frame_index_t * part, uint64_t part_count)
+{
+    if (!part_count) return 1;
+    frame_index_t * new_index = realloc(*index, (*count + part_count) * sizeof(frame_index_t));
+    if (!new_index) return 0;
+    memcpy(new_index + *count, part, part_count * sizeof(frame_index_t));
+    *index = new_index;
+    *count += part_count;
+    return 1;
+}
+
+/* Scans all chunks at once (INDEX_THREADS at a time), then merges their blocks in chunk order,
+ * so headers and indexes are the same as if the chunks were read one after the other.
+ * Progress can be polled meanwhile with getMlvIndexProgress() */
+static int index_mlv_chunks(mlvObject_t * video, int open_mode, char * error_message,
+                            uint64_t * block_num, uint64_t * video_frames, uint64_t * audio_frames, uint32_t * vers_blocks, int * fread_err)
+{
+    int chunks = video->filenum;
+    index_scan_t * scans = (chunks > 0) ? calloc(chunks, sizeof(index_scan_t)) : NULL;
+    if (!scans)
+    {
+        sprintf(error_message, "Could not allocate the chunk index");
+        DEBUG( printf("\n%s\n", error_message); )
+        return MLV_ERR_IO;
+    }
+
+    uint64_t bytes_total = 0;
+    for (int i = 0; i < chunks; ++i)
+    {
+        scans[i].video = video;
+        scans[i].chunk = i;
+        scans[i].open_mode = open_mode;
+        file_set_pos(video->file[i], 0, SEEK_END);
+        bytes_total += file_get_pos(video->file[i]);
+    }
+    __atomic_store_n(&video->index_bytes_done, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&video->index_bytes_total, bytes_total, __ATOMIC_RELAXED);
+
+    if (open_mode == MLV_OPEN_PREVIEW)
+    {
+        /* Preview only needs the first frame, chunk by chunk until there is one */
+        for (int i = 0; i < chunks; ++i)
+        {
+            index_mlv_chunk(scans + i);
+            free(scans[i].window);
+            scans[i].window = NULL;
+            if (scans[i].error || scans[i].video_frames)
             {
-                if( !styl_read )
-                {
-                    fread_err &= fread(&video->STYL, sizeof(mlv_styl_hdr_t), 1, video->file[i]);
-                    styl_read = 1; //read only first one
-                }
+                chunks = i + 1;
+                break;
             }
-            else if ( memcmp(block_header.blockType, "RTCI", 4) == 0 )
+        }
+    }
+    else
+    {
+        run_index_scans(scans, chunks);
+    }
+
+    /* First chunk with an error, like reading them in order */
+    int ret = MLV_ERR_NONE;
+    for (int i = 0; i < chunks && ret == MLV_ERR_NONE; ++i)
+    {
+        if (scans[i].error)
+        {
+            ret = scans[i].error;
+            strcpy(error_message, scans[i].error_message);
+            DEBUG( printf("\n%s\n", error_message); )
+        }
+    }
+
+    /* Merge in chunk order: later headers replace earlier ones, except for the blocks where the first one counts */
+    uint32_t found = 0;
+    *block_num = *video_frames = *audio_frames = *vers_blocks = 0;
+    *fread_err = 1;
+    uint64_t video_count = 0, audio_count = 0, vers_count = 0;
+    for (int i = 0; i < chunks && ret == MLV_ERR_NONE; ++i)
+    {
+        index_scan_t * scan = scans + i;
+        index_merge_headers(video, scan, &found);
+
+        /* VERS blocks are numbered through all chunks */
+        for (uint64_t v = 0; v < scan->vers_blocks; ++v) scan->vers_index[v].frame_number = vers_count + v;
+
+        int appended = index_append(&video->video_index, &video_count, scan->video_index, scan->video_frames)
+                    && index_append(&video->audio_index, &audio_count, scan->audio_index, scan->audio_frames)
+                    && index_append(&video->vers_index, &vers_count, scan->vers_index, scan->vers_blocks);
+        *fread_err &= scan->fread_err & appended;
+        *block_num += scan->block_num;
+    }
+    *video_frames = video_count;
+    *audio_frames = audio_count;
+    *vers_blocks = vers_count;
+
+    /* Chunk fingerprints for the .MAPP */
+    if (ret == MLV_ERR_NONE && open_mode != MLV_OPEN_PREVIEW)
+    {
+        if (video->chunk_info) free(video->chunk_info);
+        /* Without it there is just no .MAPP */
+        video->chunk_info = calloc(chunks, sizeof(mapp_chunk_t));
+        for (int i = 0; i < chunks && video->chunk_info; ++i)
+        {
+            get_chunk_fingerprint(video->file[i], &video->chunk_info[i].size, &video->chunk_info[i].mtime);
+            video->chunk_info[i].scanned_end = scans[i].scanned_end;
+            video->chunk_info[i].block_num = scans[i].scanned_blocks;
+        }
+    }
+
+    for (int i = 0; i < chunks; ++i)
+    {
+        free(scans[i].video_index);
+        free(scans[i].audio_index);
+        free(scans[i].vers_index);
+    }
+    free(scans);
+
+    return ret;
+}
+
+double getMlvIndexProgress(mlvObject_t * video)
+{
+    uint64_t total = __atomic_load_n(&video->index_bytes_total, __ATOMIC_RELAXED);
+    uint64_t done = __atomic_load_n(&video->index_bytes_done, __ATOMIC_RELAXED);
+    double progress = (total) ? (double)done / total : 0.0;
+    return MIN(progress, 1.0);
+}
+
+/* Brings an index loaded from a .MAPP up to date with the chunks: unchanged chunks are kept,
+ * chunks which grew (still recording or copying) are indexed on from where the last scan stopped,
+ * other chunks are indexed again. Returns 0 on success */
+static int update_mlv_index(mlvObject_t * video, mapp_chunk_t * cached, uint32_t cached_count)
+{
+    int chunks = video->filenum;
+    if (chunks < 1) return 1;
+    index_scan_t * scans = calloc(chunks, sizeof(index_scan_t));
+    mapp_chunk_t * info = calloc(chunks, sizeof(mapp_chunk_t));
+    if (!scans || !info)
+    {
+        free(scans);
+        free(info);
+        return 1;
+    }
+    uint64_t bytes_total = 0;
+    for (int i = 0; i < chunks; ++i)
+    {
+        scans[i].video = video;
+        scans[i].chunk = i;
+        scans[i].open_mode = MLV_OPEN_FULL;
+        get_chunk_fingerprint(video->file[i], &info[i].size, &info[i].mtime);
+        if (i < (int)cached_count && info[i].size == cached[i].size && info[i].mtime == cached[i].mtime)
+        {
+            scans[i].skip = 1;
+        }
+        else if (i < (int)cached_count && info[i].size > cached[i].size && cached[i].scanned_end)
+        {
+            scans[i].start = cached[i].scanned_end;
+        }
+        if (!scans[i].skip) bytes_total += info[i].size - scans[i].start;
+        DEBUG( printf("MAPP chunk %i: %s\n", i, (scans[i].skip) ? "unchanged" : (scans[i].start) ? "grew" : "changed"); )
+    }
+    __atomic_store_n(&video->index_bytes_done, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&video->index_bytes_total, bytes_total, __ATOMIC_RELAXED);
+
+    run_index_scans(scans, chunks);
+
+    int ret = 0;
+    for (int i = 0; i < chunks; ++i)
+    {
+        if (scans[i].error) ret = 1;
+    }
+
+    /* Kept entries of a chunk, then the new ones, chunk by chunk */
+    frame_index_t * old_index[3] = { video->video_index, video->audio_index, video->vers_index };
+    uint64_t old_count[3] = { video->frames, video->audios, video->vers_blocks };
+    frame_index_t * new_index[3] = { NULL, NULL, NULL };
+    uint64_t new_count[3] = { 0, 0, 0 };
+    for (int k = 0; k < 3 && !ret; ++k)
+    {
+        new_index[k] = malloc((old_count[k] + 1) * sizeof(frame_index_t));
+        uint64_t new_max = old_count[k] + 1;
+        for (int i = 0; i < chunks && new_index[k]; ++i)
+        {
+            index_scan_t * scan = scans + i;
+            if (scan->skip || scan->start)
             {
-                if( !rtci_read )
+                for (uint64_t j = 0; j < old_count[k]; ++j)
                 {
-                    fread_err &= fread(&video->RTCI, sizeof(mlv_rtci_hdr_t), 1, video->file[i]);
-                    rtci_read = 1; //read only first one
+                    frame_index_t * entry = old_index[k] + j;
+                    if (entry->chunk_num != i || (scan->start && entry->block_offset >= scan->start)) continue;
+                    new_index[k][new_count[k]++] = *entry;
                 }
             }
-            else if ( memcmp(block_header.blockType, "IDNT", 4) == 0 )
-            {
-                fread_err &= fread(&video->IDNT, sizeof(mlv_idnt_hdr_t), 1, video->file[i]);
-            }
-            else if ( memcmp(block_header.blockType, "INFO", 4) == 0 )
+            frame_index_t * part = (k == 0) ? scan->video_index : (k == 1) ? scan->audio_index : scan->vers_index;
+            uint64_t part_count = (k == 0) ? scan->video_frames : (k == 1) ? scan->audio_frames : scan->vers_blocks;
+            if (new_count[k] + part_count > new_max)
             {
-                fread_err &= fread(&video->INFO, sizeof(mlv_info_hdr_t), 1, video->file[i]);
-                if(video->INFO.blockSize > sizeof(mlv_info_hdr_t))
+                new_max = new_count[k] + part_count;
+                frame_index_t * grown = realloc(new_index[k], new_max * sizeof(frame_index_t));
+                if (!grown)
                 {
-                    fread_err &= fread(&video->INFO_STRING, video->INFO.blockSize - sizeof(mlv_info_hdr_t), 1, video->file[i]);
+                    free(new_index[k]);
+                    new_index[k] = NULL;
+                    break;
                 }
+                new_index[k] = grown;
             }
-            else if ( memcmp(block_header.blockType, "DISO", 4) == 0 )
-            {
-                fread_err &= fread(&video->DISO, sizeof(mlv_diso_hdr_t), 1, video->file[i]);
-            }
-            else if ( memcmp(block_header.blockType, "MARK", 4) == 0 )
-            {
-                /* do nothing atm */
-                //fread(&video->MARK, sizeof(mlv_mark_hdr_t), 1, video->file[i]);
-            }
-            else if ( memcmp(block_header.blockType, "ELVL", 4) == 0 )
-            {
-                /* do nothing atm */
-                //fread(&video->ELVL, sizeof(mlv_elvl_hdr_t), 1, video->file[i]);
-            }
-            else if ( memcmp(block_header.blockType, "DEBG", 4) == 0 )
+            if (part_count) memcpy(new_index[k] + new_count[k], part, part_count * sizeof(frame_index_t));
+            new_count[k] += part_count;
+        }
+        if (!new_index[k]) ret = 1;
+    }
+    if (!ret && !new_count[0]) ret = 1;
+
+    if (!ret)
+    {
+        /* Headers of the indexed chunks, first ones count for blocks the .MAPP has already */
+        uint32_t found = 0;
+        if (video->LENS.blockType[0]) found |= INDEX_LENS;
+        if (video->ELNS.blockType[0]) found |= INDEX_ELNS;
+        if (video->WBAL.blockType[0]) found |= INDEX_WBAL;
+        if (video->STYL.blockType[0]) found |= INDEX_STYL;
+        if (video->RTCI.blockType[0]) found |= INDEX_RTCI;
+        uint64_t block_num = 0;
+        for (int i = 0; i < chunks; ++i)
+        {
+            index_scan_t * scan = scans + i;
+            if (scan->skip)
             {
-                /* do nothing atm */
-                //fread(&video->DEBG, sizeof(mlv_debg_hdr_t), 1, video->file[i]);
+                info[i] = cached[i];
+                block_num += cached[i].block_num;
+                continue;
             }
-            else if ( memcmp(block_header.blockType, "VERS", 4) == 0 )
-            {
-                /* Find all VERS blocks and make index for them */
-                fread_err &= fread(&video->VERS, sizeof(mlv_vers_hdr_t), 1, video->file[i]);
+            index_merge_headers(video, scan, &found);
+            info[i].scanned_end = scan->scanned_end;
+            info[i].block_num = ((scan->start) ? cached[i].block_num : 0) + scan->scanned_blocks;
+            /* A block cut at the end of the chunk counts, like on a full scan */
+            block_num += info[i].block_num + scan->block_num - scan->scanned_blocks;
+        }
 
-                DEBUG( printf("VERS blocknum %i | chunk %i | size %lu | offset %lu | time %lu\n",
-                               vers_blocks, i, video->VERS.blockSize - sizeof(mlv_vers_hdr_t),
-                               block_start, video->VERS.timestamp); )
+        free(video->video_index);
+        free(video->audio_index);
+        free(video->vers_index);
+        video->video_index = new_index[0];
+        video->audio_index = new_index[1];
+        video->vers_index = new_index[2];
+        frame_index_sort(video->video_index, new_count[0]);
+        frame_index_sort(video->audio_index, new_count[1]);
+        for (uint64_t j = 0; j < new_count[2]; ++j) video->vers_index[j].frame_number = j;
+        video->frames = new_count[0];
+        video->audios = new_count[1];
+        video->vers_blocks = new_count[2];
+        video->block_num = block_num;
+
+        if (video->chunk_info) free(video->chunk_info);
+        video->chunk_info = info;
+        info = NULL;
+
+        /* Audio of the .MAPP is outdated */
+        video->audio_mapp_offset = 0;
+        if (video->audio_data) free(video->audio_data);
+        video->audio_data = NULL;
+        video->audio_size = 0;
+        readMlvAudioData(video);
+    }
+    else
+    {
+        for (int k = 0; k < 3; ++k) free(new_index[k]);
+    }
 
-                /* Dynamically resize the index buffer */
-                if(!vers_index_max)
-                {
-                    vers_index_max = 128;
-                    video->vers_index = (frame_index_t *)calloc(vers_index_max, sizeof(frame_index_t));
-                }
-                else if(vers_blocks >= vers_index_max - 1)
-                {
-                    uint64_t vers_index_new_size = vers_index_max * 2;
-                    frame_index_t * vers_index_new = (frame_index_t *)calloc(vers_index_new_size, sizeof(frame_index_t));
-                    memcpy(vers_index_new, video->vers_index, vers_index_max * sizeof(frame_index_t));
-                    free(video->vers_index);
-                    video->vers_index = vers_index_new;
-                    vers_index_max = vers_index_new_size;
-                }
+    for (int i = 0; i < chunks; ++i)
+    {
+        free(scans[i].video_index);
+        free(scans[i].audio_index);
+        free(scans[i].vers_index);
+    }
+    free(scans);
+    free(info);
 
-                /* Fill frame index */
-                video->vers_index[vers_blocks].frame_type = 3;
-                video->vers_index[vers_blocks].chunk_num = i;
-                video->vers_index[vers_blocks].frame_size = video->VERS.blockSize - sizeof(mlv_vers_hdr_t);
-                video->vers_index[vers_blocks].frame_offset = file_get_pos(video->file[i]);
-                video->vers_index[vers_blocks].frame_number = vers_blocks;
-                video->vers_index[vers_blocks].frame_time = video->VERS.timestamp;
-                video->vers_index[vers_blocks].block_offset = block_start;
-
-                /* Count actual VERS blocks */
-                vers_blocks++;
-            }
-            else if ( memcmp(block_header.blockType, "DARK", 4) == 0 )
-            {
-                fread_err &= fread(&video->DARK, sizeof(mlv_dark_hdr_t), 1, video->file[i]);
-                video->dark_frame_offset = file_get_pos(video->file[i]);
-            }
-            else
-            {
-                /* block name is wrong, so try to brute force the position of next valid block */
-                if(!seek_to_next_known_block(video->file[i]))
-                {
-                    char block_type[5] = { 0 };
-                    memcpy(block_type, block_header.blockType, 4);
-                    sprintf(error_message, "Unknown blockType '%s' or corrupted file:  %s", block_type, video->path);
-                    DEBUG( printf("\n%s\n", error_message); )
-                            --video->filenum;
-                    return MLV_ERR_CORRUPTED;
-                }
-                continue;
-            }
+    return ret;
+}
 
-            /* Printing stuff for fun */
-            //DEBUG( printf("Block #%4i  |  %.4s  |%9i Bytes\n", block_num, block_header.blockType, block_header.blockSize); )
+/* Reads an MLV file in to a mlv object(mlvObject_t struct) 
+ * only puts metadata in to the mlvObject_t, 
+ * no debayering or bit unpacking */
+int openMlvClip(mlvObject_t * video, char * mlvPath, int open_mode, char * error_message)
+{
+    video->path = malloc( strlen(mlvPath) + 1 );
+    memcpy(video->path, mlvPath, strlen(mlvPath));
+    video->path[strlen(mlvPath)] = 0x0;
+    video->file = load_all_chunks(mlvPath, &video->filenum);
+    if(!video->file)
+    {
+        sprintf(error_message, "Could not open file:  %s", video->path);
+        DEBUG( printf("\n%s\n", error_message); )
+        return MLV_ERR_OPEN; // can not open file
+    }
 
-            /* Move to next block */
-            file_set_pos(video->file[i], next_block, SEEK_SET);
+    /* Mutexes for every file */
+    video->main_file_mutex = calloc(sizeof(pthread_mutex_t), video->filenum);
+    for (int i = 0; i < video->filenum; ++i)
+    {
+        pthread_mutex_init(video->main_file_mutex + i, NULL);
+    }
 
-            block_num++;
-        }
+    /* In preview mode we don't need to waste time on audio loading from MAPP */
+    if(open_mode != MLV_OPEN_PREVIEW)
+    {
+        if(!load_mapp(video)) goto short_cut;
+    }
+
+    uint64_t block_num = 0; /* Number of blocks in file */
+    uint64_t video_frames = 0; /* Number of frames in video */
+    uint64_t audio_frames = 0; /* Number of audio blocks in video */
+    uint32_t vers_blocks = 0; /* Number of VERS blocks in MLV */
+    int fread_err = 1;
+
+    int ret = index_mlv_chunks(video, open_mode, error_message, &block_num, &video_frames, &audio_frames, &vers_blocks, &fread_err);
+    if (ret != MLV_ERR_NONE)
+    {
+        --video->filenum;
+        return ret;
+    }
+
+    /* In preview mode only the first frame is indexed */
+    if(open_mode == MLV_OPEN_PREVIEW && video_frames)
+    {
+        video->frames = 1;
+        video->audios = audio_frames;
+        goto preview_out;
     }
 
     /* Return with error if no video frames found */
@@ -2215,8 +3368,15 @@ preview_out:
     /* For frame cache */
     video->rgb_raw_frames = (uint16_t **)malloc( sizeof(uint16_t *) * video->frames );
     video->rgb_raw_current_frame = (uint16_t *)malloc( getMlvWidth(video) * getMlvHeight(video) * 3 * sizeof(uint16_t) );
+    video->rgb_raw_current_overview = (uint16_t *)malloc( getMlvPreviewWidth(video, MLV_REGION_OVERVIEW_SCALE) * getMlvPreviewHeight(video, MLV_REGION_OVERVIEW_SCALE) * 3 * sizeof(uint16_t) );
     video->cached_frames = (uint8_t *)calloc( sizeof(uint8_t), video->frames );
 
+    /* Frame data is read from memory mapped chunks where possible */
+    map_mlv_chunks(video);
+
+    /* Frame buffer arena sized for this clip */
+    reset_mlv_frame_buffers(video);
+
     isMlvActive(video) = 1;
 
     /* Start caching unless it was disabled already */
@@ -26,6 +26,10 @@ void printMlvInfo(mlvObject_t * video);
  * no debayering or processing */
 int openMlvClip(mlvObject_t * video, char * mlvPath, int open_mode, char * error_message);
 int openMcrawClip(mlvObject_t * video, char * mcrawPath, int open_mode, char * error_message);
+/* How far openMlvClip() got with indexing the chunks (0..1), can be polled from another thread */
+double getMlvIndexProgress(mlvObject_t * video);
+/* Audio buffer of the clip, is read from the .MAPP on first use */
+uint8_t * getMlvAudioData(mlvObject_t * video);
 
 /* return error codes of and open modes of openMlvClip() */
 enum mlv_err { MLV_ERR_NONE, MLV_ERR_OPEN, MLV_ERR_IO, MLV_ERR_CORRUPTED, MLV_ERR_INVALID };
@@ -49,6 +53,12 @@ void resetMlvCache(mlvObject_t * video);
 /* For setting how much can be cached - "MegaBytes" == MebiBytes (thanks dmilligan) */
 void setMlvRawCacheLimitMegaBytes(mlvObject_t * video, uint64_t megaByteLimit);
 void setMlvRawCacheLimitFrames(mlvObject_t * video, uint64_t frameLimit);
+/* What the cache holds (MLV_CACHE_*). Bayer modes hold 3x (LJ92 ~4.5x) more frames, but debayer when shown */
+void setMlvCacheMode(mlvObject_t * video, int cacheMode);
+/* Bayer cache mode for the clip: MLV_CACHE_BAYER16, or MLV_CACHE_BAYER_LJ92 if the uncompressed frames don't fit the cache limit */
+int getMlvBayerCacheMode(mlvObject_t * video);
+/* Cache follows the playhead: frames ahead in playback direction are cached, frames far behind are dropped */
+void setMlvCachePlayhead(mlvObject_t * video, uint64_t frameIndex);
 
 /* Links processing settings() with an MLV object */
 void setMlvProcessing(mlvObject_t * video, processingObject_t * processing);
@@ -61,6 +71,12 @@ void findMlvWhiteBalance(mlvObject_t * video, uint64_t frameIndex, int posX, int
  * as it may have minor artifacts (though I haven't found them yet) */
 void getMlvProcessedFrame8(mlvObject_t * video, uint64_t frameIndex, uint8_t * outputFrame, int threads);
 void getMlvProcessedFrame16(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, int threads);
+/* Processed frame at 1/scale size for the viewer (scale 2 or 4, 1 = same as getMlvProcessedFrame8), not for export.
+ * Output size is getMlvPreviewWidth() x getMlvPreviewHeight() */
+void getMlvProcessedPreviewFrame8(mlvObject_t * video, uint64_t frameIndex, int scale, uint8_t * outputFrame, int threads);
+/* Processed frame of only the region x, y, width, height for the zoomed in viewer, not for export.
+ * Output is width x height, processing runs on the region plus a margin */
+void getMlvProcessedRegionFrame8(mlvObject_t * video, uint64_t frameIndex, int x, int y, int width, int height, uint8_t * outputFrame, int threads);
 
 /* Unpacks the bits of a frame to get a bayer B&W image (without black level correction)
  * Needs memory to return to, sized: sizeof(float) * getMlvHeight(urvid) * getMlvWidth(urvid)
@@ -70,6 +86,30 @@ void getMlvRawFrameFloat(mlvObject_t * video, uint64_t frameIndex, float * outpu
 
 /* Gets a debayered 16 bit frame */
 void getMlvRawFrameDebayered(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame);
+/* Same at 1/scale size: cached RGB frames are box filtered down, others are binned from bayer without debayering */
+void getMlvRawFrameDebayeredPreview(mlvObject_t * video, uint64_t frameIndex, int scale, uint16_t * outputFrame);
+/* Only the region x, y, width, height of a debayered frame (x and y even), uncached frames get only this part debayered.
+ * overviewFrame (optional) gets the whole frame at 1/MLV_REGION_OVERVIEW_SCALE size, binned like the preview */
+#define MLV_REGION_OVERVIEW_SCALE 4
+void getMlvRawFrameDebayeredRegion(mlvObject_t * video, uint64_t frameIndex, int x, int y, int width, int height, uint16_t * outputFrame, uint16_t * overviewFrame);
+
+/* Scratch buffers owned by the caller (e.g. one set per export thread). Any member may be NULL,
+ * missing ones are borrowed from the clip's frame buffer arena. Sizes in bytes: getMlvFrameBufferSize() */
+typedef struct
+{
+    uint8_t  * raw_frame;       /* MLV_BUFFER_RAW */
+    uint16_t * unpacked_frame;  /* MLV_BUFFER_BAYER16 */
+    float    * float_frame;     /* MLV_BUFFER_FLOAT */
+    uint16_t * debayered_frame; /* MLV_BUFFER_RGB16 */
+    uint16_t * processed_frame; /* MLV_BUFFER_RGB16, only for 8 bit output */
+} mlvFrameBuffers_t;
+
+size_t getMlvFrameBufferSize(mlvObject_t * video, int kind);
+int getMlvRawFrameUint16WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * unpackedFrame, mlvFrameBuffers_t * buffers);
+void getMlvRawFrameFloatWithBuffers(mlvObject_t * video, uint64_t frameIndex, float * outputFrame, mlvFrameBuffers_t * buffers);
+void getMlvRawFrameDebayeredWithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, mlvFrameBuffers_t * buffers);
+void getMlvProcessedFrame16WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint16_t * outputFrame, int threads, mlvFrameBuffers_t * buffers);
+void getMlvProcessedFrame8WithBuffers(mlvObject_t * video, uint64_t frameIndex, uint8_t * outputFrame, int threads, mlvFrameBuffers_t * buffers);
 
 /* For processing only, no use to average library user ;) Camera RGB -> sRGB */
 void getMlvCameraTosRGBMatrix(mlvObject_t * video, double * outputMatrix); /* Still havent had any success here */
@@ -93,12 +133,15 @@ void mark_mlv_uncached(mlvObject_t * video);
 /* Clears cache by freeing then reallocating (RAM usage down until frames written) */
 void clear_mlv_cache(mlvObject_t * video);
 
-/* Returns 1 on success, or 0 if all are cached */
-int find_mlv_frame_to_cache(mlvObject_t * video, uint64_t *index); /* Outputs to *index */
+/* Returns 1 on success, or 0 if all frames around the playhead are cached */
+int find_mlv_frame_to_cache(mlvObject_t * video, uint64_t *index, uint64_t *slot); /* Outputs to *index and *slot */
 
 /* Adds one thread, active total can be checked in mlvObject->cache_thread_count */
 void add_mlv_cache_thread(mlvObject_t * video);
 
+/* Starts cpu_cores cache threads, if none is running */
+void start_mlv_cache_threads(mlvObject_t * video);
+
 /* OLD DEPRACTEDFSDJKHJKLAJSKDLJ KLSDJKL AJSD LKSAJDLKSAJDLK DKJS */
 void cache_mlv_frames(mlvObject_t * video);
 
@@ -108,7 +151,41 @@ void get_mlv_raw_frame_debayered(mlvObject_t * video,
                                   uint64_t frame_index,
                                   float * temp_memory,
                                   uint16_t * output_frame,
-                                  int debayer_type ); /* Debayer type: 0=bilinear 1=amaze */
+                                  int debayer_type, /* Debayer type: 0=bilinear 1=amaze */
+                                  mlvFrameBuffers_t * buffers ); /* May be NULL */
+
+/* Debayers a float bayer frame (from getMlvRawFrameFloat), temp_memory is changed */
+void debayer_mlv_raw_frame(mlvObject_t * video,
+                           float * temp_memory,
+                           uint16_t * output_frame,
+                           int debayer_type );
+/* Same for width x height bayer data cut out of a frame at even x and y */
+void debayer_mlv_raw_area(mlvObject_t * video,
+                          float * temp_memory,
+                          uint16_t * output_frame,
+                          int width, int height,
+                          int debayer_type );
+
+/* Copies a cached frame to output_frame, debayering it if the cache holds bayer frames. Returns 0 if frame is not cached */
+int get_mlv_cached_frame(mlvObject_t * video, uint64_t frame_index, uint16_t * output_frame, mlvFrameBuffers_t * buffers);
+
+/* Decoded frame after low level raw processing, returns 1 on error. And its conversion to float */
+int get_mlv_raw_frame_bayer16(mlvObject_t * video, uint64_t frameIndex, uint16_t * bayerFrame, mlvFrameBuffers_t * buffers);
+void mlv_bayer16_to_float(mlvObject_t * video, uint16_t * bayerFrame, float * outputFrame);
+
+/* Frame buffer arena: borrow a buffer of a MLV_BUFFER_* kind and give it back after use */
+void * take_mlv_frame_buffer(mlvObject_t * video, int kind);
+void give_mlv_frame_buffer(mlvObject_t * video, int kind, void * buffer);
+/* Frees all arena buffers, sizes are recalculated for the current clip */
+void reset_mlv_frame_buffers(mlvObject_t * video);
+
+/* Memory mapped chunk files: map_mlv_chunks is called on clip opening, chunks that can not be mapped are read by fread */
+void map_mlv_chunks(mlvObject_t * video);
+void unmap_mlv_chunks(mlvObject_t * video);
+/* Pointer to size bytes at offset of a mapped chunk, NULL if not mapped. 4 bytes behind the data are readable too */
+const uint8_t * get_mlv_chunk_data(mlvObject_t * video, int chunk, uint64_t offset, uint64_t size);
+/* Copies size bytes at offset of a chunk to dst, from the mapping or by fread. Returns 0 on success */
+int read_mlv_chunk_data(mlvObject_t * video, int chunk, uint64_t offset, void * dst, uint64_t size);
 
 
 #endif
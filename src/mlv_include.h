@@ -12,6 +12,7 @@ extern "C" {
 
 /* RAW processing part */
 #include "processing/raw_processing.h"
+#include "processing/core_budget.h"
 #include "debayer/debayer.h"
 #include "mlv/llrawproc/llrawproc.h"
 #include "dng/dng.h"
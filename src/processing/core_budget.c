@@ -0,0 +1,231 @@
+/*!
+ * \file core_budget.c
+ * \author masc4ii
+ * \copyright 2024
+ * \brief one budget of cpu cores for all parts of the app which start threads
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <omp.h>
+#include "core_budget.h"
+
+#ifndef STDOUT_SILENT
+#define DEBUG(CODE) CODE
+#else
+#define DEBUG(CODE)
+#endif
+
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+#define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
+
+typedef struct {
+    int priority;
+    int quota;     /* 0 = all cores */
+    int active;
+    int peak;
+    uint64_t requests;
+    uint64_t throttled;
+    double core_seconds;
+    double last_change;
+} subsystem_t;
+
+static pthread_mutex_t budget_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Signalled when cores are given back or the budget grows */
+static pthread_cond_t budget_cond = PTHREAD_COND_INITIALIZER;
+static int budget_cores = 0;
+static double budget_start = 0;
+
+/* Interactive work first, export next, background caching takes what's left */
+static subsystem_t budget[CORE_BUDGET_SUBSYSTEMS] = {
+    [CORE_BUDGET_CACHING]    = { .priority = 0 },
+    [CORE_BUDGET_DEBAYER]    = { .priority = 2 },
+    [CORE_BUDGET_PROCESSING] = { .priority = 2 },
+    [CORE_BUDGET_SCALING]    = { .priority = 1 },
+    [CORE_BUDGET_ENCODING]   = { .priority = 1 }
+};
+
+static const char * budget_names[CORE_BUDGET_SUBSYSTEMS] = {
+    "caching", "debayer", "processing", "scaling", "encoding"
+};
+
+/* Needs budget_mutex */
+static void init_budget(void)
+{
+    if (budget_cores) return;
+    budget_cores = MAX(omp_get_num_procs(), 1);
+    budget_start = omp_get_wtime();
+    for (int i = 0; i < CORE_BUDGET_SUBSYSTEMS; ++i) budget[i].last_change = budget_start;
+}
+
+/* Adds used core time until now, needs budget_mutex */
+static void account_subsystem(subsystem_t * sub, double now)
+{
+    sub->core_seconds += sub->active * (now - sub->last_change);
+    sub->last_change = now;
+}
+
+static int valid_subsystem(int subsystem)
+{
+    return (subsystem >= 0 && subsystem < CORE_BUDGET_SUBSYSTEMS);
+}
+
+void core_budget_set_cores(int cores)
+{
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    budget_cores = MAX(cores, 1);
+    pthread_cond_broadcast(&budget_cond);
+    pthread_mutex_unlock(&budget_mutex);
+}
+
+int core_budget_get_cores(void)
+{
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    int cores = budget_cores;
+    pthread_mutex_unlock(&budget_mutex);
+    return cores;
+}
+
+void core_budget_set_quota(int subsystem, int priority, int quota)
+{
+    if (!valid_subsystem(subsystem)) return;
+    pthread_mutex_lock(&budget_mutex);
+    budget[subsystem].priority = priority;
+    budget[subsystem].quota = MAX(quota, 0);
+    pthread_cond_broadcast(&budget_cond);
+    pthread_mutex_unlock(&budget_mutex);
+}
+
+/* Cores the subsystem could get right now, needs budget_mutex */
+static int free_cores(subsystem_t * sub, int wanted)
+{
+    /* Cores used by everything this subsystem has to give way to (itself included) */
+    int used = 0;
+    for (int i = 0; i < CORE_BUDGET_SUBSYSTEMS; ++i)
+    {
+        if (budget[i].priority >= sub->priority) used += budget[i].active;
+    }
+
+    int quota = (sub->quota) ? MIN(sub->quota, budget_cores) : budget_cores;
+    int granted = MIN(wanted, MIN(budget_cores - used, quota - sub->active));
+    return MAX(granted, 0);
+}
+
+/* Books the granted cores, needs budget_mutex */
+static void grant_cores(subsystem_t * sub, int wanted, int granted)
+{
+    account_subsystem(sub, omp_get_wtime());
+    sub->active += granted;
+    sub->peak = MAX(sub->peak, sub->active);
+    sub->requests++;
+    if (granted < wanted) sub->throttled++;
+}
+
+int core_budget_acquire(int subsystem, int wanted)
+{
+    if (!valid_subsystem(subsystem) || wanted < 1) return 0;
+
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    subsystem_t * sub = &budget[subsystem];
+    int granted = free_cores(sub, wanted);
+    grant_cores(sub, wanted, granted);
+    pthread_mutex_unlock(&budget_mutex);
+
+    return granted;
+}
+
+int core_budget_acquire_wait(int subsystem, int wanted, int timeout_ms)
+{
+    if (!valid_subsystem(subsystem) || wanted < 1) return 0;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t deadline_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec + (uint64_t)MAX(timeout_ms, 0) * 1000;
+    struct timespec deadline = { .tv_sec = deadline_us / 1000000, .tv_nsec = (deadline_us % 1000000) * 1000 };
+
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    subsystem_t * sub = &budget[subsystem];
+    int granted;
+    while (!(granted = free_cores(sub, wanted)))
+    {
+        if (pthread_cond_timedwait(&budget_cond, &budget_mutex, &deadline) == ETIMEDOUT) break;
+    }
+    grant_cores(sub, wanted, granted);
+    pthread_mutex_unlock(&budget_mutex);
+
+    return granted;
+}
+
+void core_budget_release(int subsystem, int granted)
+{
+    if (!valid_subsystem(subsystem) || granted < 1) return;
+
+    pthread_mutex_lock(&budget_mutex);
+    subsystem_t * sub = &budget[subsystem];
+    account_subsystem(sub, omp_get_wtime());
+    sub->active = MAX(sub->active - granted, 0);
+    pthread_cond_broadcast(&budget_cond);
+    pthread_mutex_unlock(&budget_mutex);
+}
+
+void core_budget_get_usage(int subsystem, core_budget_usage_t * usage)
+{
+    memset(usage, 0, sizeof(core_budget_usage_t));
+    if (!valid_subsystem(subsystem)) return;
+
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    subsystem_t * sub = &budget[subsystem];
+    double now = omp_get_wtime();
+    account_subsystem(sub, now);
+
+    usage->priority = sub->priority;
+    usage->quota = (sub->quota) ? sub->quota : budget_cores;
+    usage->active = sub->active;
+    usage->peak = sub->peak;
+    usage->requests = sub->requests;
+    usage->throttled = sub->throttled;
+    usage->core_seconds = sub->core_seconds;
+    if (now > budget_start) usage->utilization = sub->core_seconds / ((now - budget_start) * budget_cores);
+    pthread_mutex_unlock(&budget_mutex);
+}
+
+const char * core_budget_subsystem_name(int subsystem)
+{
+    return (valid_subsystem(subsystem)) ? budget_names[subsystem] : "";
+}
+
+void core_budget_print_usage(void)
+{
+    for (int i = 0; i < CORE_BUDGET_SUBSYSTEMS; ++i)
+    {
+        core_budget_usage_t usage;
+        core_budget_get_usage(i, &usage);
+        DEBUG( printf("Core budget %-10s priority %i, quota %2i, peak %2i, %llu of %llu requests throttled, %5.1f%% utilization\n",
+                      budget_names[i], usage.priority, usage.quota, usage.peak,
+                      (unsigned long long)usage.throttled, (unsigned long long)usage.requests, usage.utilization * 100.0); )
+    }
+}
+
+void core_budget_reset_usage(void)
+{
+    pthread_mutex_lock(&budget_mutex);
+    init_budget();
+    budget_start = omp_get_wtime();
+    for (int i = 0; i < CORE_BUDGET_SUBSYSTEMS; ++i)
+    {
+        budget[i].peak = budget[i].active;
+        budget[i].requests = 0;
+        budget[i].throttled = 0;
+        budget[i].core_seconds = 0;
+        budget[i].last_change = budget_start;
+    }
+    pthread_mutex_unlock(&budget_mutex);
+}
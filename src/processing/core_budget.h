@@ -0,0 +1,57 @@
+/*!
+ * \file core_budget.h
+ * \author masc4ii
+ * \copyright 2024
+ * \brief one budget of cpu cores for all parts of the app which start threads
+ */
+
+#ifndef _core_budget_
+#define _core_budget_
+
+#include <stdint.h>
+
+/* Parts of the app which share the cores */
+enum
+{
+    CORE_BUDGET_CACHING,
+    CORE_BUDGET_DEBAYER,
+    CORE_BUDGET_PROCESSING,
+    CORE_BUDGET_SCALING,
+    CORE_BUDGET_ENCODING,
+    CORE_BUDGET_SUBSYSTEMS
+};
+
+/* What a subsystem used since start or last reset */
+typedef struct {
+    int priority;
+    int quota;
+    int active;            /* Cores in use right now */
+    int peak;              /* Most cores used at once */
+    uint64_t requests;     /* Calls of core_budget_acquire() */
+    uint64_t throttled;    /* Requests which got less cores than wanted */
+    double core_seconds;   /* Sum of time * cores in use */
+    double utilization;    /* core_seconds / (elapsed time * all cores), 0..1 */
+} core_budget_usage_t;
+
+/* Number of cores shared by everything, default is number of processors */
+void core_budget_set_cores(int cores);
+int core_budget_get_cores(void);
+
+/* Priority: a subsystem only has to leave cores to subsystems with same or higher priority.
+ * Quota: max cores a subsystem gets at once */
+void core_budget_set_quota(int subsystem, int priority, int quota);
+
+/* Returns cores granted (0..wanted), must be given back with core_budget_release().
+ * Never blocks. Callers which must do their work anyway run on their own thread if they get 0. */
+int core_budget_acquire(int subsystem, int wanted);
+/* Same, but sleeps until at least one core is free or timeout_ms ran out (returns 0 then) */
+int core_budget_acquire_wait(int subsystem, int wanted, int timeout_ms);
+void core_budget_release(int subsystem, int granted);
+
+/* Utilization report */
+void core_budget_get_usage(int subsystem, core_budget_usage_t * usage);
+const char * core_budget_subsystem_name(int subsystem);
+void core_budget_print_usage(void);
+void core_budget_reset_usage(void);
+
+#endif //_core_budget_
@@ -8,6 +8,9 @@
 #include "cube_lut.h"
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
@@ -193,20 +196,44 @@ int load_lut( lut_t *lut, char *filename, char *error_message )
     }
 
     fclose( fp );
+    pack_lut( lut );
     return 0;
 }
 
+//Prepare the 3D lattice for apply_lut: one aligned RGB(A) node per vector load, values already scaled to 16 bit and limited
+void pack_lut( lut_t *lut )
+{
+    if( lut->packed ) free( lut->packed );
+    lut->packed = NULL;
+    if( !lut->is3d || lut->dimension <= 1 || !lut->cube ) return;
+
+    uint32_t nodes = (uint32_t)lut->dimension * (uint32_t)lut->dimension * (uint32_t)lut->dimension;
+    lut->packed = malloc( nodes * 4 * sizeof( float ) );
+
+    for( uint32_t i = 0; i < nodes; i++ )
+    {
+        for( int c = 0; c < 3; c++ )
+        {
+            lut->packed[i*4+c] = LIMIT16( lut->cube[i*3+c] * 65535.0f );
+        }
+        lut->packed[i*4+3] = 0.0f;
+    }
+}
+
 //Unload the LUT
 void unload_lut( lut_t *lut )
 {
     if( !lut ) return;
     if( lut->dimension == 0 ) return;
     if( lut->cube ) free( lut->cube );
+    if( lut->packed ) free( lut->packed );
+    lut->cube = NULL;
+    lut->packed = NULL;
     lut->dimension = 0;
 }
 
-//Apply LUT on picture
-void apply_lut(lut_t *lut, int width, int height, uint16_t *image)
+//Apply LUT on picture, scalar reference implementation
+void apply_lut_reference(lut_t *lut, int width, int height, uint16_t *image)
 {
     if( lut->dimension <= 1 || !lut->cube ) return;
     if( lut->intensity > 100 ) lut->intensity = 100;
@@ -340,3 +367,161 @@ void apply_lut(lut_t *lut, int width, int height, uint16_t *image)
         }
     }
 }
+
+//Lattice position of one channel: lower node and fraction
+static inline void lut_position( float value, float dimMax, int *node, float *frac )
+{
+    if( value < 0.0f ) value = 0.0f;
+    if( value > dimMax ) value = dimMax;
+    *node = (int)value;
+    *frac = value - *node;
+}
+
+//Tetrahedral interpolation on the packed lattice of one pixel, blended with the original value
+static inline void lut_tetrahedral( const float *lattice, int dim, int dim2, const float dimMax,
+                                    float red, float green, float blue,
+                                    float factor1, float factor2, uint16_t *pix )
+{
+    int r0, g0, b0;
+    lut_position( red, dimMax, &r0, &red );
+    lut_position( green, dimMax, &g0, &green );
+    lut_position( blue, dimMax, &b0, &blue );
+
+    //Node offsets (4 floats per node) of the neighbours, zero at the upper limit
+    int dr = ( r0 < dimMax ) ? 4 : 0;
+    int dg = ( g0 < dimMax ) ? 4*dim : 0;
+    int db = ( b0 < dimMax ) ? 4*dim2 : 0;
+
+    const float *q000 = lattice + ( r0 + g0*dim + b0*dim2 ) * 4;
+    const float *q111 = q000 + dr + dg + db;
+    const float *qA, *qB;
+    float w0, wA, wB, w1;
+
+    //Same tetrahedra as the reference
+    if( green >= blue && blue >= red ) //T1
+    {
+        qA = q000 + dg; qB = q000 + dg + db;
+        w0 = 1.0f - green; wA = green - blue; wB = blue - red; w1 = red;
+    }
+    else if( blue > red && red > green ) //T2
+    {
+        qA = q000 + db; qB = q000 + dr + db;
+        w0 = 1.0f - blue; wA = blue - red; wB = red - green; w1 = green;
+    }
+    else if( blue > green && green >= red ) //T3
+    {
+        qA = q000 + db; qB = q000 + dg + db;
+        w0 = 1.0f - blue; wA = blue - green; wB = green - red; w1 = red;
+    }
+    else if( red >= green && green > blue ) //T4
+    {
+        qA = q000 + dr; qB = q000 + dr + dg;
+        w0 = 1.0f - red; wA = red - green; wB = green - blue; w1 = blue;
+    }
+    else if( green > red && red >= blue ) //T5
+    {
+        qA = q000 + dg; qB = q000 + dr + dg;
+        w0 = 1.0f - green; wA = green - red; wB = red - blue; w1 = blue;
+    }
+    else //T6
+    {
+        qA = q000 + dr; qB = q000 + dr + db;
+        w0 = 1.0f - red; wA = red - blue; wB = blue - green; w1 = green;
+    }
+
+    //Strength blending is folded in: all weights scaled by factor1, plus factor2 * original
+#ifdef __SSE2__
+    __m128 f1 = _mm_set1_ps( factor1 );
+    __m128 out = _mm_mul_ps( _mm_loadu_ps( q000 ), _mm_set1_ps( w0 ) );
+    out = _mm_add_ps( out, _mm_mul_ps( _mm_loadu_ps( qA ), _mm_set1_ps( wA ) ) );
+    out = _mm_add_ps( out, _mm_mul_ps( _mm_loadu_ps( qB ), _mm_set1_ps( wB ) ) );
+    out = _mm_add_ps( out, _mm_mul_ps( _mm_loadu_ps( q111 ), _mm_set1_ps( w1 ) ) );
+    out = _mm_mul_ps( out, f1 );
+    __m128 orig = _mm_cvtepi32_ps( _mm_setr_epi32( pix[0], pix[1], pix[2], 0 ) );
+    out = _mm_add_ps( out, _mm_mul_ps( orig, _mm_set1_ps( factor2 ) ) );
+    __m128i result = _mm_cvttps_epi32( out );
+    pix[0] = _mm_cvtsi128_si32( result );
+    pix[1] = _mm_cvtsi128_si32( _mm_srli_si128( result, 4 ) );
+    pix[2] = _mm_cvtsi128_si32( _mm_srli_si128( result, 8 ) );
+#else
+    for( int i = 0; i < 3; i++ )
+    {
+        float out = q000[i] * w0 + qA[i] * wA + qB[i] * wB + q111[i] * w1;
+        pix[i] = out * factor1 + pix[i] * factor2;
+    }
+#endif
+}
+
+//Apply LUT on picture
+void apply_lut(lut_t *lut, int width, int height, uint16_t *image)
+{
+    if( lut->dimension <= 1 || !lut->cube ) return;
+    if( lut->intensity > 100 ) lut->intensity = 100;
+    //Not prepared (e.g. cube filled by hand)? Use the reference.
+    if( lut->is3d && !lut->packed )
+    {
+        apply_lut_reference( lut, width, height, image );
+        return;
+    }
+
+    apply_lut_strength( lut, width, height, image, (float)lut->intensity / 100.0f );
+}
+
+//Apply LUT on picture with a strength 0.0-1.0 instead of lut->intensity
+void apply_lut_strength(lut_t *lut, int width, int height, uint16_t *image, float strength)
+{
+    if( lut->dimension <= 1 || !lut->cube ) return;
+    if( lut->is3d && !lut->packed ) return;
+    if( strength > 1.0f ) strength = 1.0f;
+    if( strength <= 0.0f ) return;
+
+    const float factor1 = strength;
+    const float factor2 = 1.0f - factor1;
+
+    const int dim = lut->dimension;
+    const int dim2 = dim * dim;
+    const float dimMax = dim - 1;
+    const float factorA = ( lut->dimension - 1 ) / 65536.0 / ( lut->domain_max[0] - lut->domain_min[0] );
+    const float factorB = ( lut->dimension - 1 ) / 65536.0 / ( lut->domain_max[1] - lut->domain_min[1] );
+    const float factorC = ( lut->dimension - 1 ) / 65536.0 / ( lut->domain_max[2] - lut->domain_min[2] );
+    const float minA = lut->domain_min[0];
+    const float minB = lut->domain_min[1];
+    const float minC = lut->domain_min[2];
+    const float *cube = lut->cube;
+    const float *lattice = lut->packed;
+    const int is3d = lut->is3d;
+
+#pragma omp parallel for
+    for( int y = 0; y < height; y++ )
+    {
+        uint16_t * pix = image + y * width * 3;
+        uint16_t * end = pix + width * 3;
+
+        if( is3d )
+        {
+            for( ; pix < end; pix += 3 )
+            {
+                lut_tetrahedral( lattice, dim, dim2, dimMax,
+                                 ( pix[0] * factorA ) - minA,
+                                 ( pix[1] * factorB ) - minB,
+                                 ( pix[2] * factorC ) - minC,
+                                 factor1, factor2, pix );
+            }
+        }
+        else
+        {
+            for( ; pix < end; pix += 3 )
+            {
+                float value[3] = { ( pix[0] * factorA ) - minA, ( pix[1] * factorB ) - minB, ( pix[2] * factorC ) - minC };
+                for( int i = 0; i < 3; i++ )
+                {
+                    int x0; float frac;
+                    lut_position( value[i], dimMax, &x0, &frac );
+                    int x1 = ( x0 < dimMax ) ? x0 + 1 : x0;
+                    float out = cube[x0 * 3 + i] + ( cube[x1 * 3 + i] - cube[x0 * 3 + i] ) * frac;
+                    pix[i] = pix[i] * factor2 + LIMIT16( out * 65535.0f ) * factor1;
+                }
+            }
+        }
+    }
+}
@@ -18,12 +18,18 @@ typedef struct {
     float *cube;
     int is3d;
     uint8_t intensity;
+    float *packed; /* 3D lattice prepared for apply_lut: 4 floats per node (r, g, b, pad), scaled to 0..65535 */
 } lut_t;
 
 lut_t * init_lut( void );
 void free_lut( lut_t *lut );
 int load_lut(lut_t *lut, char *filename, char *error_message);
 void unload_lut( lut_t *lut );
+void pack_lut( lut_t *lut );
 void apply_lut( lut_t *lut, int width, int height, uint16_t * image );
+/* Like apply_lut, but with strength 0.0-1.0 instead of lut->intensity. 3D luts must be packed */
+void apply_lut_strength( lut_t *lut, int width, int height, uint16_t * image, float strength );
+/* Scalar single threaded version of apply_lut, for comparing results */
+void apply_lut_reference( lut_t *lut, int width, int height, uint16_t * image );
 
 #endif // CUBE_LUT_H
@@ -9,42 +9,61 @@
 #include <string.h>
 #include "denoiser_2d_median.h"
 
-void swap(int *a, int *b)
-{
-    int temp;
-    temp=*a;
-    *a=*b;
-    *b=temp;
-}
+//Values processed at once per window element. The networks run elementwise over these blocks, so the compiler vectorizes min/max
+#define MEDIAN_BLOCK 64
+//Biggest supported window (7x7)
+#define MEDIAN_MAX_WINDOW 7
+
+//Sorting network comparators for the median of 9 values (result at index 4)
+static const uint8_t median9[][2] = {
+    {1,2},{4,5},{7,8},{0,1},{3,4},{6,7},{1,2},{4,5},{7,8},{0,3},{5,8},{4,7},
+    {3,6},{1,4},{2,5},{4,7},{4,2},{6,4},{4,2}
+};
 
-/* the aim of the partition is to return the subscript of the exact */
-/* position of the pivot when it is sorted */
-// the low variable is used to point to the position of the next lowest element
-int partition(int arr[], int first, int last)
+//Sorting network comparators for the median of 25 values (result at index 12)
+static const uint8_t median25[][2] = {
+    {0,1},{3,4},{2,4},{2,3},{6,7},{5,7},{5,6},{9,10},{8,10},{8,9},{12,13},{11,13},
+    {11,12},{15,16},{14,16},{14,15},{18,19},{17,19},{17,18},{21,22},{20,22},{20,21},{23,24},{2,5},
+    {3,6},{0,6},{0,3},{4,7},{1,7},{1,4},{11,14},{8,14},{8,11},{12,15},{9,15},{9,12},
+    {13,16},{10,16},{10,13},{20,23},{17,23},{17,20},{21,24},{18,24},{18,21},{19,22},{8,17},{9,18},
+    {0,18},{0,9},{10,19},{1,19},{1,10},{11,20},{2,20},{2,11},{12,21},{3,21},{3,12},{13,22},
+    {4,22},{4,13},{14,23},{5,23},{5,14},{15,24},{6,24},{6,15},{7,16},{7,19},{13,21},{15,23},
+    {7,13},{7,15},{1,9},{3,11},{5,17},{11,17},{9,17},{4,10},{6,12},{7,14},{4,6},{4,7},
+    {12,14},{10,14},{6,7},{10,12},{6,10},{6,17},{12,17},{7,17},{7,10},{12,18},{7,12},{10,18},
+    {12,20},{10,20},{10,12}
+};
+
+//Compare and swap two blocks: a gets the lower, b the higher values
+static inline void sort_blocks( uint16_t *a, uint16_t *b, int count )
 {
-    int pivot = arr[last]; // changed the pivot
-    int low = first;
-    int i = first; // changed
-    while(i <= last-1 ){// or you can do for(i=first;i<last;i++)
-        if(arr[i] < pivot){
-            swap(&arr[i], &arr[low]);
-            low++;
-        }
-        i++;
+    for( int k = 0; k < count; k++ )
+    {
+        uint16_t lo = ( a[k] < b[k] ) ? a[k] : b[k];
+        uint16_t hi = ( a[k] < b[k] ) ? b[k] : a[k];
+        a[k] = lo;
+        b[k] = hi;
     }
-    swap(&arr[last], &arr[low]);
-    // after finishing putting all the lower element than the pivot
-    // It's time to put the pivot into its place and return its position
-    return low;
 }
 
-void quick_sort(int arr[], int first, int last)
+//Median of all window blocks, result is in block "middle" afterwards
+static void median_blocks( uint16_t block[][MEDIAN_BLOCK], int winSize, int count )
 {
-    int pivot_pos;
-    if(first < last){
-        pivot_pos = partition(arr, first, last);
-        quick_sort(arr, first, pivot_pos-1);
-        quick_sort(arr, pivot_pos+1, last);
+    if( winSize == 9 )
+    {
+        for( int i = 0; i < (int)( sizeof( median9 ) / 2 ); i++ )
+            sort_blocks( block[median9[i][0]], block[median9[i][1]], count );
+    }
+    else if( winSize == 25 )
+    {
+        for( int i = 0; i < (int)( sizeof( median25 ) / 2 ); i++ )
+            sort_blocks( block[median25[i][0]], block[median25[i][1]], count );
+    }
+    else
+    {
+        //Odd-even transposition sort for all other sizes (2x2, 4x4...)
+        for( int round = 0; round < winSize; round++ )
+            for( int i = round & 1; i < winSize - 1; i += 2 )
+                sort_blocks( block[i], block[i+1], count );
     }
 }
 
@@ -53,6 +72,8 @@ void denoise_2D_median(uint16_t *data, int width, int height, uint8_t window, ui
 {
     //Parameter limitation and conversion
     if( strength > 100 ) strength = 100;
+    if( window > MEDIAN_MAX_WINDOW ) window = MEDIAN_MAX_WINDOW;
+    if( window < 2 ) return;
     float strengthF = strength / 100.0;
     float antiStrengthF = 1 - strengthF;
 
@@ -62,50 +83,46 @@ void denoise_2D_median(uint16_t *data, int width, int height, uint8_t window, ui
     uint16_t * noisy = malloc( imageSize * sizeof( uint16_t ) );
     memcpy( noisy, data, imageSize * sizeof( uint16_t ) );
 
-    //Allocate window
     uint16_t winSize = window * window;
-    uint16_t edgeX = window / 2;
-    uint16_t edgeY = window / 2;
+    int edgeX = window / 2;
+    int edgeY = window / 2;
     uint8_t middle = window * window / 2;
 
-#pragma omp parallel for// collapse(2) //collapse did not work here in test on Windows
-    for( uint16_t x = edgeX; x < width-edgeX; x++ )
+    //Row segment (all 3 channels interleaved) which has a full window
+    int rowStart = edgeX * 3;
+    int rowEnd = ( width - edgeX ) * 3;
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for( int y = edgeY; y < height-edgeY; y++ )
     {
-        for( uint16_t y = edgeY; y < height-edgeY; y++ )
+        //Window blocks live on the stack, nothing allocated per pixel
+        uint16_t block[MEDIAN_MAX_WINDOW*MEDIAN_MAX_WINDOW][MEDIAN_BLOCK];
+        uint16_t * out = data + y * width * 3;
+
+        for( int j = rowStart; j < rowEnd; j += MEDIAN_BLOCK )
         {
-            //Allocate window
-            int * windowR = malloc( winSize * sizeof( int ) );
-            int * windowB = malloc( winSize * sizeof( int ) );
-            int * windowG = malloc( winSize * sizeof( int ) );
-
-            //Fill window
-            uint32_t i = 0;
-            for( uint16_t fx = 0; fx < window; fx++ )
+            int count = rowEnd - j;
+            if( count > MEDIAN_BLOCK ) count = MEDIAN_BLOCK;
+
+            //Fill window: neighbour pixels of the same channel are 3 values apart
+            int i = 0;
+            for( int fy = 0; fy < window; fy++ )
             {
-                for( uint16_t fy = 0; fy < window; fy++ )
+                uint16_t * row = noisy + ( y + fy - edgeY ) * width * 3;
+                for( int fx = 0; fx < window; fx++ )
                 {
-                    uint16_t w = x + fx - edgeX;
-                    uint16_t h = y + fy - edgeY;
-                    windowR[i] = noisy[(h*width+w)*3+0];
-                    windowG[i] = noisy[(h*width+w)*3+1];
-                    windowB[i] = noisy[(h*width+w)*3+2];
+                    memcpy( block[i], row + j + ( fx - edgeX ) * 3, count * sizeof( uint16_t ) );
                     i++;
                 }
             }
-            //sort window values
-            quick_sort( windowR, 0, winSize-1 );
-            quick_sort( windowG, 0, winSize-1 );
-            quick_sort( windowB, 0, winSize-1 );
+
+            median_blocks( block, winSize, count );
 
             //write output
-            data[(y*width+x)*3+0] = strengthF*windowR[middle] + antiStrengthF*data[(y*width+x)*3+0];
-            data[(y*width+x)*3+1] = strengthF*windowG[middle] + antiStrengthF*data[(y*width+x)*3+1];
-            data[(y*width+x)*3+2] = strengthF*windowB[middle] + antiStrengthF*data[(y*width+x)*3+2];
-
-            //Cleanup window
-            free( windowR );
-            free( windowG );
-            free( windowB );
+            for( int k = 0; k < count; k++ )
+            {
+                out[j+k] = strengthF*block[middle][k] + antiStrengthF*out[j+k];
+            }
         }
     }
 
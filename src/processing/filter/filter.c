@@ -59,70 +59,122 @@ filterObject_t * initFilterObject()
     filter->net_cine3 = genann_read(filmprofile_cine3);
 
     filterObjectSetFilterStrength(filter, 1.0);
+    filter->filter_option = FILTER_FILM_FJ;
+
+    for (int i = 0; i < FILTER_COUNT; ++i) filter->baked[i] = NULL;
+    pthread_mutex_init(&filter->baked_mutex, NULL);
 
     return filter;
 }
 
+static genann * filterObjectGetNet(filterObject_t * filter, int filterID)
+{
+    switch (filterID)
+    {
+        case FILTER_FILM_FJ: return filter->net_fj;
+        case FILTER_FILM_VIS3: return filter->net_vis3;
+        case FILTER_FILM_P400: return filter->net_p400;
+        case FILTER_FILM_E100: return filter->net_kodak_ektar;
+        case FILTER_TOYC: return filter->net_toyc;
+        case FILTER_SEPIA: return filter->net_sepia;
+        case FILTER_CINE1: return filter->net_cine1;
+        case FILTER_CINE2: return filter->net_cine2;
+        case FILTER_CINE3: return filter->net_cine3;
+        default: return NULL;
+    }
+}
+
+/* Sample the network of a filter on a 3D grid, a film filter is just a RGB->RGB mapping */
+static lut_t * filterObjectBakeLut(filterObject_t * filter, int filterID)
+{
+    genann * net = filterObjectGetNet(filter, filterID);
+    if (!net) return NULL;
+
+    const int dim = FILTER_LUT_DIMENSION;
+    lut_t * lut = init_lut();
+    lut->dimension = dim;
+    lut->is3d = 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        lut->domain_min[i] = 0.0;
+        lut->domain_max[i] = 1.0;
+    }
+    lut->cube = malloc(dim * dim * dim * 3 * sizeof(float));
+
+    #pragma omp parallel for
+    for (int b = 0; b < dim; ++b)
+    {
+        /* genann_run writes to the net, so one copy per thread */
+        genann * thread_net = genann_copy(net);
+        double pixel[3];
+        for (int g = 0; g < dim; ++g)
+        {
+            for (int r = 0; r < dim; ++r)
+            {
+                pixel[0] = (double)r / (dim - 1);
+                pixel[1] = (double)g / (dim - 1);
+                pixel[2] = (double)b / (dim - 1);
+                const double * filtered = genann_run(thread_net, pixel);
+                float * node = lut->cube + (r + g * dim + b * dim * dim) * 3;
+                node[0] = filtered[0];
+                node[1] = filtered[1];
+                node[2] = filtered[2];
+            }
+        }
+        genann_free(thread_net);
+    }
+
+    pack_lut(lut);
+    return lut;
+}
+
+static lut_t * filterObjectGetLut(filterObject_t * filter)
+{
+    if (filter->filter_option < 0 || filter->filter_option >= FILTER_COUNT) return NULL;
+
+    /* Bake once per filter, strength is blended in when applying */
+    pthread_mutex_lock(&filter->baked_mutex);
+    lut_t * lut = filter->baked[filter->filter_option];
+    if (!lut)
+    {
+        lut = filterObjectBakeLut(filter, filter->filter_option);
+        filter->baked[filter->filter_option] = lut;
+    }
+    pthread_mutex_unlock(&filter->baked_mutex);
+
+    return lut;
+}
+
+void prepareFilterObject(filterObject_t * filter)
+{
+    if (filter->strength < 0.01) return;
+    filterObjectGetLut(filter);
+}
+
 void applyFilterObject( filterObject_t * filter,
                         int width, int height,
                         uint16_t * image )
 {
     if (filter->strength < 0.01) return;
 
-    double pixel[3];
-
-    uint16_t * end = image + (width * height * 3);
-
-    /* We need a copy or it gets messed up on many threads */
-    genann * net;
-    if (filter->filter_option == FILTER_FILM_FJ)
-        net = genann_copy(filter->net_fj);
-    else if (filter->filter_option == FILTER_FILM_VIS3)
-        net = genann_copy(filter->net_vis3);
-    else if (filter->filter_option == FILTER_FILM_P400)
-        net = genann_copy(filter->net_p400);
-    else if (filter->filter_option == FILTER_FILM_E100)
-        net = genann_copy(filter->net_kodak_ektar);
-    else if (filter->filter_option == FILTER_TOYC)
-        net = genann_copy(filter->net_toyc);
-    else if (filter->filter_option == FILTER_SEPIA)
-        net = genann_copy(filter->net_sepia);
-    else if (filter->filter_option == FILTER_CINE1)
-        net = genann_copy(filter->net_cine1);
-    else if (filter->filter_option == FILTER_CINE2)
-        net = genann_copy(filter->net_cine2);
-    else if (filter->filter_option == FILTER_CINE3)
-        net = genann_copy(filter->net_cine3);
-
-    for (uint16_t * pix = image; pix < end; pix += 3)
-    {
-        pixel[0] = ((double)pix[0])/65535.0;
-        pixel[1] = ((double)pix[1])/65535.0;
-        pixel[2] = ((double)pix[2])/65535.0;
-        const double * filtered = genann_run(net, pixel);
-        pix[0] = LIMIT16(filter->processed[(size_t)(filtered[0]*65535.0)] + filter->original[pix[0]]);
-        pix[1] = LIMIT16(filter->processed[(size_t)(filtered[1]*65535.0)] + filter->original[pix[1]]);
-        pix[2] = LIMIT16(filter->processed[(size_t)(filtered[2]*65535.0)] + filter->original[pix[2]]);
-    }
-
-    genann_free(net);
+    lut_t * lut = filterObjectGetLut(filter);
+    if (lut) apply_lut_strength(lut, width, height, image, filter->strength);
 }
 
 /* Set effect strength, 0.0-1.0 */
 void filterObjectSetFilterStrength(filterObject_t * filter, double strength)
 {
     filter->strength = strength;
-    double istrength = 1.0 - strength;
-    for (int i = 0; i < 65536; ++i)
-    {
-        filter->processed[i] = (int32_t)(strength * (double)i);
-        filter->original[i] = (int32_t)(istrength * (double)i);
-    }
 }
 
 void freeFilterObject(filterObject_t * filter)
 {
-    genann_free(filter->net_fj);
+    for (int i = 0; i < FILTER_COUNT; ++i)
+    {
+        genann_free(filterObjectGetNet(filter, i));
+        free_lut(filter->baked[i]);
+    }
+    pthread_mutex_destroy(&filter->baked_mutex);
     free(filter);
 }
 
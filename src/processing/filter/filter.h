@@ -2,7 +2,13 @@
 #define __processing_filter__
 
 #include "stdint.h"
+#include <pthread.h>
 #include "genann/genann.h"
+#include "../cube_lut.h"
+
+/* Nodes per axis of the 3D luts the networks are baked into */
+#define FILTER_LUT_DIMENSION 65
+#define FILTER_COUNT 9
 
 typedef struct {
     double strength;
@@ -16,9 +22,9 @@ typedef struct {
     genann * net_cine1;
     genann * net_cine2;
     genann * net_cine3;
-    /* Strength lut */
-    int32_t processed[65536];
-    int32_t original[65536];
+    /* Each network sampled once into a 3D lut, baked on first use */
+    lut_t * baked[FILTER_COUNT];
+    pthread_mutex_t baked_mutex;
 } filterObject_t;
 
 filterObject_t * initFilterObject();
@@ -27,6 +33,9 @@ void applyFilterObject( filterObject_t * filter,
                         int width, int height,
                         uint16_t * image );
 
+/* Bake the lut of the chosen filter now, so many threads applying it do not wait for it */
+void prepareFilterObject(filterObject_t * filter);
+
 /* Set effect strength, 0.0-1.0 */
 void filterObjectSetFilterStrength(filterObject_t * filter, double strength);
 
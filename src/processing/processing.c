@@ -438,9 +438,6 @@ void processing_update_matrices(processingObject_t * processing)
     double temp_matrix_b[9];
     //double temp_matrix_c[9];
 
-    /* (for shorter code) */
-    int32_t ** pm = processing->pre_calc_matrix;
-
     /* Create a camera to sRGB matrix in temp_matrix_a */
     // memcpy(temp_matrix_a, processing->cam_to_sRGB_matrix, 9 * sizeof(double));
     memcpy(temp_matrix_a, (double *)id_matrix, 9 * sizeof(double)); /* just nothjng for now */
@@ -473,30 +470,7 @@ void processing_update_matrices(processingObject_t * processing)
         for (int i = 0; i < 9; ++i) processing->final_matrix[i] *= exposure_factor;
     }
 
-    /* Matrix stuff done I guess */
-
-    if( processing->wbFindActive == 0 )
-    {
-        /* Precalculate 0-65535 */
-        #pragma omp parallel for collapse(2)
-        for (int i = 0; i < 9; ++i)
-        {
-            for (int j = 0; j < 65536; ++j)
-            {
-                pm[i][j] = (int32_t)((double)j * processing->final_matrix[i]);
-            }
-        }
-    }
-    else
-    {
-        /* If whitebalance find algorithm is on the run, we need it only for one single RGB -> faster */
-        for (int i = 0; i < 9; ++i)
-        {
-            pm[i][processing->wbR] = (int32_t)((double)processing->wbR * processing->final_matrix[i]);
-            pm[i][processing->wbG] = (int32_t)((double)processing->wbG * processing->final_matrix[i]);
-            pm[i][processing->wbB] = (int32_t)((double)processing->wbB * processing->final_matrix[i]);
-        }
-    }
+    /* Matrix stuff done I guess, it is applied per pixel (MATRIX_MUL) so nothing to precalculate */
 
     /* Highest green value - pixels at this value will need to be reconstructed */
     processing_update_highest_green(processing);
@@ -518,9 +492,6 @@ void processing_update_matrices_gradient(processingObject_t * processing)
     double temp_matrix_b[9];
     double final_matrix[9];
 
-    /* (for shorter code) */
-    int32_t ** pm = processing->pre_calc_matrix_gradient;
-
     /* Create a camera to sRGB matrix in temp_matrix_a */
     // memcpy(temp_matrix_a, processing->cam_to_sRGB_matrix, 9 * sizeof(double));
     memcpy(temp_matrix_a, (double *)id_matrix, 9 * sizeof(double)); /* just nothjng for now */
@@ -553,17 +524,8 @@ void processing_update_matrices_gradient(processingObject_t * processing)
         for (int i = 0; i < 9; ++i) final_matrix[i] *= exposure_factor;
     }
 
-    /* Matrix stuff done I guess */
-
-    /* Precalculate 0-65535 */
-    #pragma omp parallel for collapse(2)
-    for (int i = 0; i < 9; ++i)
-    {
-        for (int j = 0; j < 65536; ++j)
-        {
-            pm[i][j] = (int32_t)((double)j * final_matrix[i]);
-        }
-    }
+    /* Matrix stuff done I guess, it is applied per pixel (MATRIX_MUL) */
+    memcpy(processing->final_matrix_gradient, final_matrix, 9 * sizeof(double));
 
     /* Highest green value - pixels at this value will need to be reconstructed */
     processing_update_highest_green_gradient(processing);
@@ -572,17 +534,17 @@ void processing_update_matrices_gradient(processingObject_t * processing)
 void processing_update_highest_green(processingObject_t * processing)
 {
     /* Highest green value - pixels at this value will need to be reconstructed */
-    processing->highest_green = LIMIT16( MAX(processing->pre_calc_matrix[3][65535],processing->pre_calc_matrix[3][0])
-                                       + MAX(processing->pre_calc_matrix[4][65535],processing->pre_calc_matrix[4][0]) 
-                                       + MAX(processing->pre_calc_matrix[5][65535],processing->pre_calc_matrix[5][0]) );
+    processing->highest_green = LIMIT16( MAX(MATRIX_MUL(processing->final_matrix, 3, 65535),MATRIX_MUL(processing->final_matrix, 3, 0))
+                                       + MAX(MATRIX_MUL(processing->final_matrix, 4, 65535),MATRIX_MUL(processing->final_matrix, 4, 0)) 
+                                       + MAX(MATRIX_MUL(processing->final_matrix, 5, 65535),MATRIX_MUL(processing->final_matrix, 5, 0)) );
 }
 
 void processing_update_highest_green_gradient(processingObject_t * processing)
 {
     /* Highest green value - pixels at this value will need to be reconstructed */
-    processing->highest_green_gradient = LIMIT16( MAX(processing->pre_calc_matrix_gradient[3][65535],processing->pre_calc_matrix_gradient[3][0])
-                                                + MAX(processing->pre_calc_matrix_gradient[4][65535],processing->pre_calc_matrix_gradient[4][0])
-                                                + MAX(processing->pre_calc_matrix_gradient[5][65535],processing->pre_calc_matrix_gradient[5][0]) );
+    processing->highest_green_gradient = LIMIT16( MAX(MATRIX_MUL(processing->final_matrix_gradient, 3, 65535),MATRIX_MUL(processing->final_matrix_gradient, 3, 0))
+                                                + MAX(MATRIX_MUL(processing->final_matrix_gradient, 4, 65535),MATRIX_MUL(processing->final_matrix_gradient, 4, 0))
+                                                + MAX(MATRIX_MUL(processing->final_matrix_gradient, 5, 65535),MATRIX_MUL(processing->final_matrix_gradient, 5, 0)) );
 }
 
 /* Box blur */
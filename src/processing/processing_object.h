@@ -4,6 +4,7 @@
 #include "image_profile.h"
 #include "filter/filter.h"
 #include "cube_lut.h"
+#include "processing_pool.h"
 
 #include "tinyexpr/tinyexpr.h"
 
@@ -26,6 +27,9 @@ typedef struct {
     lut_t * lut;
     int lut_on;
 
+    /* Worker threads for applyProcessingObject, may be shared with debayering */
+    processing_pool_t * pool;
+
     /* If whitebalance find algorithm is on the run, we need it only for one single RGB -> faster */
     int wbFindActive;
     uint16_t wbR, wbG, wbB;
@@ -79,10 +83,8 @@ typedef struct {
 
     /* Main matrix: combined white balance + exposure + whatever the cmaera matrix does */
     double final_matrix[9];
-
-    /* Precalculated all matrix values 0-65535 */
-    int32_t * pre_calc_matrix[9];
-    int32_t * pre_calc_matrix_gradient[9];
+    /* Same for the gradient image */
+    double final_matrix_gradient[9];
 
     struct {
         /* "use chroma separation" */
@@ -204,6 +206,15 @@ typedef struct {
     float    * vignette_mask; //same size like picture, alpha mask
     float    * vignette_end;
 
+    /* Size the masks were made for, and both masks cut out for a preview or region image (applyProcessingObjectRegion) */
+    int        mask_width, mask_height;
+    uint32_t   mask_generation; //counts up when a mask is made
+    int        region_mask_x, region_mask_y, region_mask_scale;
+    int        region_mask_width, region_mask_height;
+    uint32_t   region_mask_generation;
+    uint16_t * region_gradient_mask;
+    float    * region_vignette_mask;
+
     /* Use Camera Matrix */
     uint8_t    use_cam_matrix;
     uint8_t    colour_gamut;
@@ -228,4 +239,7 @@ typedef struct {
 
 } processingObject_t;
 
+/* Matrix entry I times a 16 bit value, truncated to int like the old 65536 entry tables */
+#define MATRIX_MUL(M, I, V) ((int32_t)((double)(V) * (M)[I]))
+
 #endif
@@ -0,0 +1,163 @@
+/*!
+ * \file processing_pool.c
+ * \author masc4ii
+ * \copyright 2024
+ * \brief long living worker threads, sharing tiles of a job between them
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <omp.h>
+#include "processing_pool.h"
+
+struct processing_pool_s
+{
+    pthread_t * thread;
+    int count;
+    int started;
+
+    pthread_mutex_t run_mutex;  /* One job at a time */
+    pthread_mutex_t mutex;      /* Protects everything below */
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    void (*job)(void * arg, int tile);
+    void * arg;
+    int tiles;
+    int next_tile;
+    int done_tiles;
+    int max_threads;
+    unsigned int generation;
+    int stop;
+};
+
+typedef struct {
+    processing_pool_t * pool;
+    int index;
+} worker_args_t;
+
+static void * processing_pool_worker( void * a )
+{
+    worker_args_t * args = (worker_args_t *)a;
+    processing_pool_t * pool = args->pool;
+    int index = args->index;
+    free( args );
+
+    /* The pool is the parallelism, jobs must not start an OpenMP team per tile */
+    omp_set_num_threads( 1 );
+
+    pthread_mutex_lock( &pool->mutex );
+    unsigned int seen = pool->generation;
+    while( 1 )
+    {
+        while( !pool->stop && pool->generation == seen ) pthread_cond_wait( &pool->work_cond, &pool->mutex );
+        if( pool->stop ) break;
+        seen = pool->generation;
+
+        /* Not needed for this job */
+        if( index >= pool->max_threads ) continue;
+
+        /* Take tiles until none is left */
+        while( pool->next_tile < pool->tiles )
+        {
+            int tile = pool->next_tile++;
+            void (*job)(void *, int) = pool->job;
+            void * arg = pool->arg;
+            pthread_mutex_unlock( &pool->mutex );
+
+            job( arg, tile );
+
+            pthread_mutex_lock( &pool->mutex );
+            if( ++pool->done_tiles == pool->tiles ) pthread_cond_signal( &pool->done_cond );
+        }
+    }
+    pthread_mutex_unlock( &pool->mutex );
+
+    return NULL;
+}
+
+processing_pool_t * processing_pool_create( int threads )
+{
+    if( threads < 1 ) threads = 1;
+
+    processing_pool_t * pool = calloc( 1, sizeof( processing_pool_t ) );
+    pool->thread = calloc( threads, sizeof( pthread_t ) );
+
+    pthread_mutex_init( &pool->run_mutex, NULL );
+    pthread_mutex_init( &pool->mutex, NULL );
+    pthread_cond_init( &pool->work_cond, NULL );
+    pthread_cond_init( &pool->done_cond, NULL );
+
+    for( int i = 0; i < threads; i++ )
+    {
+        worker_args_t * args = malloc( sizeof( worker_args_t ) );
+        args->pool = pool;
+        args->index = i;
+        if( pthread_create( &pool->thread[pool->started], NULL, processing_pool_worker, args ) != 0 )
+        {
+            free( args );
+            break;
+        }
+        pool->started++;
+    }
+    pool->count = pool->started;
+
+    return pool;
+}
+
+void processing_pool_free( processing_pool_t * pool )
+{
+    if( !pool ) return;
+
+    pthread_mutex_lock( &pool->mutex );
+    pool->stop = 1;
+    pthread_cond_broadcast( &pool->work_cond );
+    pthread_mutex_unlock( &pool->mutex );
+
+    for( int i = 0; i < pool->started; i++ ) pthread_join( pool->thread[i], NULL );
+
+    pthread_cond_destroy( &pool->done_cond );
+    pthread_cond_destroy( &pool->work_cond );
+    pthread_mutex_destroy( &pool->mutex );
+    pthread_mutex_destroy( &pool->run_mutex );
+    free( pool->thread );
+    free( pool );
+}
+
+int processing_pool_threads( processing_pool_t * pool )
+{
+    return ( pool ) ? pool->count : 1;
+}
+
+void processing_pool_run( processing_pool_t * pool, int tiles, int max_threads,
+                          void (*job)(void * arg, int tile), void * arg )
+{
+    if( tiles <= 0 ) return;
+
+    /* Nothing to share, or pool busy: do it here */
+    if( !pool || pool->count < 2 || max_threads < 2 || tiles < 2
+     || pthread_mutex_trylock( &pool->run_mutex ) != 0 )
+    {
+        for( int tile = 0; tile < tiles; tile++ ) job( arg, tile );
+        return;
+    }
+
+    pthread_mutex_lock( &pool->mutex );
+    pool->job = job;
+    pool->arg = arg;
+    pool->tiles = tiles;
+    pool->next_tile = 0;
+    pool->done_tiles = 0;
+    pool->max_threads = max_threads;
+    pool->generation++;
+    pthread_cond_broadcast( &pool->work_cond );
+
+    while( pool->done_tiles < pool->tiles ) pthread_cond_wait( &pool->done_cond, &pool->mutex );
+
+    pool->job = NULL;
+    pool->arg = NULL;
+    pool->tiles = 0;
+    pthread_mutex_unlock( &pool->mutex );
+
+    pthread_mutex_unlock( &pool->run_mutex );
+}
@@ -0,0 +1,25 @@
+/*!
+ * \file processing_pool.h
+ * \author masc4ii
+ * \copyright 2024
+ * \brief long living worker threads, sharing tiles of a job between them
+ */
+
+#ifndef _processing_pool_
+#define _processing_pool_
+
+typedef struct processing_pool_s processing_pool_t;
+
+/* Starts threads workers, they sleep until there is a job */
+processing_pool_t * processing_pool_create( int threads );
+void processing_pool_free( processing_pool_t * pool );
+int processing_pool_threads( processing_pool_t * pool );
+
+/* Runs job(arg, tile) for tile 0..tiles-1 on max max_threads workers, returns when all tiles are done.
+ * Workers take the next free tile when they are done with one, so uneven tiles don't stall.
+ * If the pool is busy with another job (other thread or called from inside a job), all tiles
+ * run on the calling thread - so sharing the pool never oversubscribes the cores. */
+void processing_pool_run( processing_pool_t * pool, int tiles, int max_threads,
+                          void (*job)(void * arg, int tile), void * arg );
+
+#endif //_processing_pool_
@@ -5,7 +5,9 @@
 #include <math.h>
 #include <pthread.h>
 #include <ctype.h>
+#include <omp.h>
 #include "blur_threaded.h"
+#include "core_budget.h"
 #include "tinyexpr/tinyexpr.h"
 #if defined(__linux) || defined(__APPLE__)
 #include <locale.h>
@@ -95,16 +97,12 @@ processingObject_t * initProcessingObject()
 
     processing->filter = initFilterObject();
 
+    /* Workers live as long as the processing object, no thread creation per frame */
+    processing->pool = processing_pool_create(omp_get_num_procs());
+
     processing->lut = init_lut();
     processing->lut_on = 0;
 
-    /* For precalculated matrix values */
-    for (int i = 0; i < 9; ++i)
-    {
-        processing->pre_calc_matrix[i] = malloc( 65536 * sizeof(int32_t) );
-        processing->pre_calc_matrix_gradient[i] = malloc( 65536 * sizeof(int32_t) );
-    }
-
     /* A nothing matrix */
     // processing->cam_to_sRGB_matrix[0] = 1.0;
     // processing->cam_to_sRGB_matrix[4] = 1.0;
@@ -412,7 +410,420 @@ void processing_object_thread(apply_processing_parameters_t * p)
                              p->outputImage,
                              p->blurImage,
                              p->gradientMask,
-                             p->vignetteMask );
+                             p->vignetteMask,
+                             p->vignetteEnd );
+}
+
+/* Rows per tile for the worker pool; small enough to balance, big enough to keep overhead low */
+#define PROCESSING_TILE_ROWS 32
+
+typedef struct {
+    apply_processing_parameters_t * whole;
+    void (*stage)(apply_processing_parameters_t *);
+} processing_tiles_t;
+
+/* Pool job: runs the stage on one tile of rows */
+static void processing_tile_job(void * arg, int tile)
+{
+    processing_tiles_t * tiles = (processing_tiles_t *)arg;
+    apply_processing_parameters_t * whole = tiles->whole;
+    apply_processing_parameters_t p = *whole;
+
+    int startY = tile * PROCESSING_TILE_ROWS;
+    p.imageY = MIN(PROCESSING_TILE_ROWS, whole->imageY - startY);
+    p.sliceY = whole->sliceY + startY;
+
+    uint32_t offset = whole->imageX * startY * 3;
+    uint32_t offset_mask = whole->imageX * startY;
+    if (whole->inputImage) p.inputImage = whole->inputImage + offset;
+    if (whole->outputImage) p.outputImage = whole->outputImage + offset;
+    if (whole->blurImage) p.blurImage = whole->blurImage + offset;
+    if (whole->gradientMask) p.gradientMask = whole->gradientMask + offset_mask;
+    if (whole->vignetteMask) p.vignetteMask = whole->vignetteMask + offset_mask;
+
+    tiles->stage(&p);
+}
+
+/* Runs a stage on row tiles of the image, on the worker pool. Buffers in whole which are NULL stay NULL */
+static void run_processing_tiles(apply_processing_parameters_t * whole, int threads, void (*stage)(apply_processing_parameters_t *))
+{
+    processing_tiles_t tiles = { whole, stage };
+    int tile_count = (whole->imageY + PROCESSING_TILE_ROWS - 1) / PROCESSING_TILE_ROWS;
+
+    /* If threads is 1, no threads are needed, tiles still keep the stages in cache */
+    if (threads <= 1 || !whole->processing->pool)
+    {
+        for (int tile = 0; tile < tile_count; ++tile) processing_tile_job(&tiles, tile);
+        return;
+    }
+
+    processing_pool_run(whole->processing->pool, tile_count, threads, processing_tile_job, &tiles);
+}
+
+/* Grain (simple monochrome noise) generator on a slice of outputImage */
+static void apply_grain_slice(apply_processing_parameters_t * p)
+{
+    processingObject_t * processing = p->processing;
+    uint16_t * outputImage = p->outputImage;
+    int slice_s = p->imageX * p->imageY * 3;
+    /* Noise pattern depends on the position in the whole image, not in the slice */
+    int offset = p->sliceY * p->imageX * 3;
+    uint32_t randomseed1 = p->randomSeeds[0];
+    uint32_t randomseed2 = p->randomSeeds[1];
+    uint32_t randomseed3 = p->randomSeeds[2];
+    uint32_t randomseed4 = p->randomSeeds[3];
+    int strength = 50 * processing->grainStrength;
+
+#pragma omp parallel for
+    for( int j = 0; j < slice_s; j+=3 )
+    {
+        int i = j + offset;
+        uint32_t randomval = randomseed1 ^ ((i*randomseed2) * (randomseed3-i) * (i+randomseed4));
+        int grain = ( randomval % strength ) - ( strength >> 2 ); //change value for strength
+
+        if( processing->grainLumaWeight > 0 )
+        {
+            uint32_t sumL = outputImage[j+0] + outputImage[j+1] + outputImage[j+2];
+            double weight = sumL / 1.5 / 65535.0;
+            weight = ( weight * processing->grainLumaWeight / 100.0 ) + ( ( 100 - processing->grainLumaWeight ) / 100.0 );
+            grain *= weight;
+        }
+
+        outputImage[j+0] = LIMIT16( outputImage[j+0] + grain );
+        outputImage[j+1] = LIMIT16( outputImage[j+1] + grain );
+        outputImage[j+2] = LIMIT16( outputImage[j+2] + grain );
+    }
+}
+
+/* Scratch rows of apply_finish_slice for one tile */
+typedef struct {
+    uint16_t * work;
+    uint16_t * hblur;
+    uint16_t * halo_row;
+    int * sums;
+    uint16_t * gray;
+    uint16_t * contour_img;
+    int busy;
+} finish_scratch_t;
+
+/* One scratch set per worker, allocated once per frame */
+typedef struct finish_scratch_pool_s {
+    pthread_mutex_t mutex;
+    int count;
+    finish_scratch_t * sets;
+} finish_scratch_pool_t;
+
+static void finish_scratch_free(finish_scratch_pool_t * pool)
+{
+    if (!pool) return;
+    for (int i = 0; i < pool->count; ++i)
+    {
+        finish_scratch_t * s = &pool->sets[i];
+        free(s->work);
+        free(s->hblur);
+        free(s->halo_row);
+        free(s->sums);
+        free(s->gray);
+        free(s->contour_img);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->sets);
+    free(pool);
+}
+
+/* Sized for the largest tile with its halo rows, returns NULL if out of memory */
+static finish_scratch_pool_t * finish_scratch_create(int count, int width, int radius, int masking)
+{
+    finish_scratch_pool_t * pool = calloc(1, sizeof(finish_scratch_pool_t));
+    if (!pool) return NULL;
+    pool->sets = calloc(count, sizeof(finish_scratch_t));
+    if (!pool->sets)
+    {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->count = count;
+
+    size_t rl = (size_t)width * 3;
+    size_t work_rows = PROCESSING_TILE_ROWS + 2;
+    for (int i = 0; i < count; ++i)
+    {
+        finish_scratch_t * s = &pool->sets[i];
+        s->work = malloc(work_rows * rl * sizeof(uint16_t));
+        if (!s->work) goto fail;
+        if (radius > 0)
+        {
+            s->hblur = malloc((work_rows + radius * 2) * rl * sizeof(uint16_t));
+            s->halo_row = malloc(rl * sizeof(uint16_t));
+            s->sums = malloc(rl * sizeof(int));
+            if (!s->hblur || !s->halo_row || !s->sums) goto fail;
+        }
+        if (masking)
+        {
+            s->gray = malloc(work_rows * width * sizeof(uint16_t));
+            s->contour_img = malloc((size_t)PROCESSING_TILE_ROWS * width * sizeof(uint16_t));
+            if (!s->gray || !s->contour_img) goto fail;
+        }
+    }
+    return pool;
+
+fail:
+    finish_scratch_free(pool);
+    return NULL;
+}
+
+/* There are never more tiles running at once than sets */
+static finish_scratch_t * finish_scratch_take(finish_scratch_pool_t * pool)
+{
+    finish_scratch_t * s = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->count && !s; ++i)
+    {
+        if (!pool->sets[i].busy) s = &pool->sets[i];
+    }
+    if (s) s->busy = 1;
+    pthread_mutex_unlock(&pool->mutex);
+    return s;
+}
+
+static void finish_scratch_give(finish_scratch_pool_t * pool, finish_scratch_t * s)
+{
+    pthread_mutex_lock(&pool->mutex);
+    s->busy = 0;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Chroma separation, chroma blur, edge mask, sharpening and grain on a slice of outputImage.
+   Reads the frame copy in inputImage around the slice (halo rows), so slices are independent
+   and stay in cache. Same result as the whole frame convert_rgb_to_YCbCr_omp, blur_image
+   and sobelFilter, which stay as reference */
+static void apply_finish_slice(apply_processing_parameters_t * p)
+{
+    processingObject_t * processing = p->processing;
+    int width = p->imageX;
+    int height = p->wholeY;
+    int rl = width * 3;
+    int y_start = p->sliceY;
+    int y_end = p->sliceY + p->imageY;
+    uint16_t * source = p->inputImage - (size_t)y_start * rl;
+
+    int chroma = processingUsesChromaSeparation(processing);
+    int radius = (chroma) ? processingGetChromaBlurRadius(processing) : 0;
+    int sharpen = (processingGetSharpening(processing) > 0.005);
+    int masking = (sharpen && processing->sh_masking > 0);
+    int32_t ** to_YCbCr = processing->cs_zone.pre_calc_rgb_to_YCbCr;
+    finish_scratch_t * scratch = finish_scratch_take(p->scratch);
+
+    /* Rows of the separated and chroma blurred image, sharpening looks one row up and down */
+    int work_start = (sharpen) ? MAX(y_start - 1, 0) : y_start;
+    int work_end = (sharpen) ? MIN(y_end + 1, height) : y_end;
+    uint16_t * work = scratch->work;
+#define WORK_ROW(Y) (work + (size_t)((Y) - work_start) * rl)
+
+    for (int y = work_start; y < work_end; ++y)
+    {
+        memcpy(WORK_ROW(y), source + (size_t)y * rl, rl * sizeof(uint16_t));
+        if (chroma) convert_rgb_to_YCbCr(WORK_ROW(y), rl, to_YCbCr);
+    }
+
+    /* Chroma blur: box over rows and columns n-radius+1 .. n+radius+1, clamped at the borders like blur_image */
+    if (radius > 0)
+    {
+        int diameter = radius * 2 + 1;
+        int h_start = MAX(work_start - radius + 1, 0);
+        int h_end = MIN(work_end + radius + 1, height);
+        uint16_t * hblur = scratch->hblur;
+        uint16_t * halo_row = scratch->halo_row;
+        int * sums = scratch->sums;
+
+        /* Horizontal */
+        for (int y = h_start; y < h_end; ++y)
+        {
+            uint16_t * row = halo_row;
+            if (y >= work_start && y < work_end) row = WORK_ROW(y);
+            else
+            {
+                memcpy(row, source + (size_t)y * rl, rl * sizeof(uint16_t));
+                convert_rgb_to_YCbCr(row, rl, to_YCbCr);
+            }
+            uint16_t * out = hblur + (size_t)(y - h_start) * rl;
+            for (int c = 1; c < 3; ++c)
+            {
+                int sum = 0;
+                for (int i = -radius + 1; i <= radius + 1; ++i) sum += row[MAX(MIN(i, width - 1), 0) * 3 + c];
+                for (int x = 0; x < width; ++x)
+                {
+                    out[x * 3 + c] = sum / diameter;
+                    sum -= row[MAX(x - radius + 1, 0) * 3 + c];
+                    sum += row[MIN(x + radius + 2, width - 1) * 3 + c];
+                }
+            }
+        }
+
+        /* Vertical, running sums of all columns row by row */
+#define HBLUR_ROW(Y) (hblur + (size_t)(MAX(MIN((Y), height - 1), 0) - h_start) * rl)
+        memset(sums, 0, rl * sizeof(int));
+        for (int i = work_start - radius + 1; i <= work_start + radius + 1; ++i)
+        {
+            uint16_t * row = HBLUR_ROW(i);
+            for (int x = 0; x < rl; ++x) sums[x] += row[x];
+        }
+        for (int y = work_start; y < work_end; ++y)
+        {
+            uint16_t * out = WORK_ROW(y);
+            for (int x = 0; x < width; ++x)
+            {
+                out[x * 3 + 1] = sums[x * 3 + 1] / diameter;
+                out[x * 3 + 2] = sums[x * 3 + 2] / diameter;
+            }
+            if (y + 1 == work_end) break;
+            uint16_t * minus = HBLUR_ROW(y - radius + 1);
+            uint16_t * plus = HBLUR_ROW(y + radius + 2);
+            for (int x = 0; x < rl; ++x) sums[x] += plus[x] - minus[x];
+        }
+#undef HBLUR_ROW
+    }
+
+    /* Edge mask: sobel on the gray image, zero outside */
+    uint16_t * contour_img = NULL;
+    if (masking)
+    {
+        int sobel_h[] = {-1, 0, 1, -2, 0, 2, -1, 0, 1},
+            sobel_v[] = {1, 2, 1, 0, 0, 0, -1, -2, -1};
+        uint16_t * gray = scratch->gray;
+        contour_img = scratch->contour_img;
+        for (int y = work_start; y < work_end; ++y)
+        {
+            uint16_t * p_rgb = WORK_ROW(y);
+            uint16_t * p_gray = gray + (size_t)(y - work_start) * width;
+            for (int x = 0; x < width; ++x, p_rgb += 3) p_gray[x] = 0.30*p_rgb[0] + 0.59*p_rgb[1] + 0.11*p_rgb[2];
+        }
+        for (int y = y_start; y < y_end; ++y)
+        {
+            uint16_t * g_row = gray + (size_t)(y - work_start) * width;
+            uint16_t * cont_row = contour_img + (size_t)(y - y_start) * width;
+            for (int x = 0; x < width; ++x)
+            {
+                uint16_t op_mem[9];
+                int bottom = (y == 0), top = (y == height - 1), left = (x == 0), right = (x == width - 1);
+                op_mem[0] = !bottom && !left  ? g_row[x-width-1] : 0;
+                op_mem[1] = !bottom           ? g_row[x-width]   : 0;
+                op_mem[2] = !bottom && !right ? g_row[x-width+1] : 0;
+                op_mem[3] = !left             ? g_row[x-1]       : 0;
+                op_mem[4] = g_row[x];
+                op_mem[5] = !right            ? g_row[x+1]       : 0;
+                op_mem[6] = !top && !left     ? g_row[x+width-1] : 0;
+                op_mem[7] = !top              ? g_row[x+width]   : 0;
+                op_mem[8] = !top && !right    ? g_row[x+width+1] : 0;
+                uint16_t res_h = (uint16_t)abs(convolution(op_mem, sobel_h, 9));
+                uint16_t res_v = (uint16_t)abs(convolution(op_mem, sobel_v, 9));
+                int res = sqrt(pow(res_h, 2) + pow(res_v, 2));
+                cont_row[x] = (uint16_t)LIMIT16(res);
+            }
+        }
+    }
+
+    /* Sharpening, only luma if chroma is separated */
+    uint32_t sharp_start = 0; /* How many pixels offset to start at */
+    uint32_t sharp_skip = (chroma) ? 3 : 1; /* Skip how many pixels when applying sharpening */
+    uint32_t x_max = (width - 1) * 3; /* X in multiples of 3 for RGB */
+    uint32_t * ka = processing->pre_calc_sharp_a;
+    uint16_t * kx = processing->pre_calc_sharp_x;
+    uint16_t * ky = processing->pre_calc_sharp_y;
+
+    for (int y = y_start; y < y_end; ++y)
+    {
+        uint16_t * out_row = p->outputImage + (size_t)(y - y_start) * rl;
+        uint16_t * row = WORK_ROW(y);
+
+        if (!sharpen || sharp_skip != 1) memcpy(out_row, row, rl * sizeof(uint16_t));
+
+        if (sharpen)
+        {
+            /* minimize border artifact */
+            uint16_t * p_row = (y == 0 || y == height - 1) ? row : WORK_ROW(y - 1);
+            uint16_t * n_row = (y == height - 1) ? row : WORK_ROW(y + 1);
+            uint16_t * cont_row = (masking) ? contour_img + (size_t)(y - y_start) * width : NULL;
+
+            for (uint32_t x = 3+sharp_start; x < x_max; x+=sharp_skip)
+            {
+                int32_t sharp = ka[row[x]]
+                              - ky[p_row[x]]
+                              - ky[n_row[x]]
+                              - kx[row[x-3]]
+                              - kx[row[x+3]];
+
+                /* use the edge mask for sharpening only edges */
+                if (masking)
+                {
+                    uint32_t x1 = x / 3;
+                    /* more contrast & brightness for mask */
+                    uint32_t maskIntensity = 15000;
+                    uint32_t cont = cont_row[x1] + (100-(uint32_t)processing->sh_masking) * 150;
+                    if( cont > maskIntensity ) cont = maskIntensity;
+                    /* calc output in dependency to mask slider */
+                    out_row[x] = LIMIT16( ( cont / (float)maskIntensity) * LIMIT16(sharp)
+                                      + ( ( maskIntensity - cont ) / (float)maskIntensity ) * row[x] );
+                }
+                /* sharpen all */
+                else
+                {
+                    out_row[x] = LIMIT16(sharp);
+                }
+            }
+
+            /* Edge pixels (basically don't do any changes to them) */
+            out_row[0] = row[0];
+            out_row[1] = row[1];
+            out_row[2] = row[2];
+            out_row[rl-3] = row[rl-3];
+            out_row[rl-2] = row[rl-2];
+            out_row[rl-1] = row[rl-1];
+        }
+
+        /* Leave Y-Cb-Cr world */
+        if (chroma) convert_YCbCr_to_rgb(out_row, rl, processing->cs_zone.pre_calc_YCbCr_to_rgb);
+    }
+#undef WORK_ROW
+
+    finish_scratch_give(p->scratch, scratch);
+
+    /* Grain (simple monochrome noise) generator - must be applied after denoiser */
+    if( processing->grainStrength > 0 ) apply_grain_slice(p);
+}
+
+/* Cuts the vignette and gradient masks to the region the image shows, if not done yet */
+static void update_region_masks(processingObject_t * processing, int imageX, int imageY, int regionX, int regionY, int scale)
+{
+    if ( processing->region_mask_width == imageX
+      && processing->region_mask_height == imageY
+      && processing->region_mask_x == regionX
+      && processing->region_mask_y == regionY
+      && processing->region_mask_scale == scale
+      && processing->region_mask_generation == processing->mask_generation ) return;
+
+    processing->region_gradient_mask = realloc(processing->region_gradient_mask, imageX * imageY * sizeof(uint16_t));
+    processing->region_vignette_mask = realloc(processing->region_vignette_mask, imageX * imageY * sizeof(float));
+
+    #pragma omp parallel for
+    for (int y = 0; y < imageY; ++y)
+    {
+        int row = MIN(regionY + y * scale, processing->mask_height - 1) * processing->mask_width;
+        for (int x = 0; x < imageX; ++x)
+        {
+            int i = row + MIN(regionX + x * scale, processing->mask_width - 1);
+            processing->region_gradient_mask[y*imageX+x] = processing->gradient_mask[i];
+            processing->region_vignette_mask[y*imageX+x] = processing->vignette_mask[i];
+        }
+    }
+
+    processing->region_mask_width = imageX;
+    processing->region_mask_height = imageY;
+    processing->region_mask_x = regionX;
+    processing->region_mask_y = regionY;
+    processing->region_mask_scale = scale;
+    processing->region_mask_generation = processing->mask_generation;
 }
 
 /* Apply it with multiple threads */
@@ -422,6 +833,51 @@ void applyProcessingObject( processingObject_t * processing,
                             uint16_t * __restrict outputImage,
                             int threads, int imageChanged, uint64_t frameIndex )
 {
+    applyProcessingObjectRegion( processing, imageX, imageY, inputImage, outputImage,
+                                 threads, imageChanged, frameIndex, 0, 0, 1, NULL, 0, 0, 1 );
+}
+
+/* Shadows/highlights and clarity work on a blurred copy of the image */
+static int shadows_highlights_active(processingObject_t * processing)
+{
+    return ( processing->shadows_highlights.shadows <= -0.01 || processing->shadows_highlights.shadows >= 0.01 )
+        || ( processing->shadows_highlights.highlights <= -0.01 || processing->shadows_highlights.highlights >= 0.01 )
+        || ( processing->clarity <= -0.01 || processing->clarity >= 0.01 );
+}
+
+int processingGetRegionMargin(processingObject_t * processing)
+{
+    /* Enough for sharpening, chroma blur, median denoiser and CA filter */
+    int margin = 32;
+
+    /* The recursive bilateral filters reach much further: weights fall by alpha per pixel,
+     * the margin is where they are well below an 8 bit step (1/8192) */
+    float sigma_spatial = 0.0f;
+    if (shadows_highlights_active(processing)) sigma_spatial = 0.0005f;
+    if (processing->rbfDenoiserLuma > 0 || processing->rbfDenoiserChroma > 0) sigma_spatial = 0.0025f;
+    if (sigma_spatial > 0.0f)
+    {
+        double alpha = exp(-sqrt(2.0) / (sigma_spatial * 65535.0));
+        margin = MAX(margin, (int)ceil(log(1.0 / 8192.0) / log(alpha)));
+    }
+
+    return margin;
+}
+
+void applyProcessingObjectRegion( processingObject_t * processing,
+                                  int imageX, int imageY,
+                                  uint16_t * __restrict inputImage,
+                                  uint16_t * __restrict outputImage,
+                                  int threads, int imageChanged, uint64_t frameIndex,
+                                  int regionX, int regionY, int scale,
+                                  uint16_t * frameImage, int frameX, int frameY, int frameScale )
+{
+    /* Take the cores from the global budget, OpenMP stages on this thread keep to it as well */
+    int granted = core_budget_acquire(CORE_BUDGET_PROCESSING, threads);
+    threads = MAX(granted, 1);
+    int omp_threads = omp_get_max_threads();
+    omp_set_num_threads(MIN(threads, omp_threads));
+
     /* Do transformation */
     get_frame_transformed(processing, inputImage, imageX, imageY);
 
@@ -438,9 +894,7 @@ void applyProcessingObject( processingObject_t * processing,
     if (imageChanged) memcpy(get_buffer(processing->shadows_highlights.blur_image), inputImage, imageX * imageY * sizeof(uint16_t) * 3);
 
     /* If shadows/highlights off don't do anything. Maybe this blurring bit could b multithreaded I need to think */
-    if( ( processing->shadows_highlights.shadows <= -0.01 || processing->shadows_highlights.shadows >= 0.01 )
-     || ( processing->shadows_highlights.highlights <= -0.01 || processing->shadows_highlights.highlights >= 0.01 )
-     || ( processing->clarity <= -0.01 || processing->clarity >= 0.01 ) )
+    if( shadows_highlights_active(processing) )
     {
 
         /* Blur diameter depends on image diagonal */
@@ -456,7 +910,7 @@ void applyProcessingObject( processingObject_t * processing,
                 recursive_bf_wrap(
                         inputImage,
                         get_buffer(processing->shadows_highlights.blur_image),
-                        0.0005f, 0.075f+(((float)100.0-40.0f)/666.6f),
+                        0.0005f / scale, 0.075f+(((float)100.0-40.0f)/666.6f),
                         imageX, imageY, 3);
 
             /* Apply basic levels */
@@ -467,52 +921,40 @@ void applyProcessingObject( processingObject_t * processing,
         }
     }
 
-    /* Analyse dual iso frame to find highest green for highlight reconstruction */
-    analyse_frame_highest_green( processing, imageX, imageY, inputImage );
-
-    /* If threads is 1, no threads are needed */
-    if (threads == 1)
-    {
-        apply_processing_object(processing, imageX, imageY, inputImage, outputImage, get_buffer(processing->shadows_highlights.blur_image), processing->gradient_mask, processing->vignette_mask);
-    }
-    else
-    {
-        apply_processing_parameters_t * params = alloca(sizeof(apply_processing_parameters_t) * threads);
-
-        /* All chunks this height except possibly slightly longer last one */
-        int chunk_size = imageY/threads;
-        /* Size of a chunk */
-        uint32_t offset_chunk = imageX * chunk_size * 3;
-
-        /* Split in to chunks for each thread */
-        for (int t = 0; t < threads; ++t)
-        {
-            params[t].processing = processing;
-            params[t].imageX = imageX;
-            params[t].imageY = chunk_size;
-            params[t].inputImage = inputImage + offset_chunk*t;
-            params[t].outputImage = outputImage + offset_chunk*t;
-            params[t].blurImage = get_buffer(processing->shadows_highlights.blur_image) + offset_chunk*t;
-            params[t].gradientMask = processing->gradient_mask + (imageX * chunk_size * t);
-            params[t].vignetteMask = processing->vignette_mask + (imageX * chunk_size * t);
-        }
-
-        /* To make sure bottom is processed */
-        params[threads-1].imageY = imageY - chunk_size * (threads-1);
-
-        pthread_t * threadid = alloca(threads * sizeof(pthread_t));
-
-        /* Do threads */
-        for (int t = 0; t < threads; ++t)
-        {
-            pthread_create(&threadid[t], NULL, (void *)&processing_object_thread, (void *)(params + t));
-        }
-        /* let all threads finish */
-        for (int t = 0; t < threads; ++t)
-        {
-            pthread_join(threadid[t], NULL);
-        }
-    }
+    /* Analyse dual iso frame to find highest green for highlight reconstruction, on the whole frame */
+    if (frameImage) analyse_frame_highest_green( processing, frameX, frameY, frameImage, frameScale );
+    else analyse_frame_highest_green( processing, imageX, imageY, inputImage, scale );
+
+    /* Bake the film filter once, before the slices use it */
+    if (processing->filter_on) prepareFilterObject(processing->filter);
+
+    /* Main processing, LUT, film filter and toning on tiles of the worker pool */
+    apply_processing_parameters_t whole;
+    memset(&whole, 0, sizeof(whole));
+    whole.processing = processing;
+    whole.imageX = imageX;
+    whole.imageY = imageY;
+    whole.wholeY = imageY;
+    whole.inputImage = inputImage;
+    whole.outputImage = outputImage;
+    whole.blurImage = get_buffer(processing->shadows_highlights.blur_image);
+    whole.gradientMask = processing->gradient_mask;
+    whole.vignetteMask = processing->vignette_mask;
+    whole.vignetteEnd = processing->vignette_end;
+    if ( processing->mask_width
+      && ( regionX || regionY || scale != 1 || imageX != processing->mask_width || imageY != processing->mask_height ) )
+    {
+        /* Reduced size preview or a region of the frame */
+        update_region_masks(processing, imageX, imageY, regionX, regionY, scale);
+        whole.gradientMask = processing->region_gradient_mask;
+        whole.vignetteMask = processing->region_vignette_mask;
+        whole.vignetteEnd = processing->region_vignette_mask + imageX * imageY;
+    }
+    whole.randomSeeds[0] = randomseed1;
+    whole.randomSeeds[1] = randomseed2;
+    whole.randomSeeds[2] = randomseed3;
+    whole.randomSeeds[3] = randomseed4;
+    run_processing_tiles(&whole, threads, processing_object_thread);
 
     /* Denoiser must render on complete image, because of 2D median border problem */
     if( processing->denoiserStrength > 0 )
@@ -528,7 +970,7 @@ void applyProcessingObject( processingObject_t * processing,
         recursive_bf_wrap(
                 inputImage,
                 outputImage,
-                0.0025f, 0.075f+(((float)processing->rbfDenoiserRange-40.0f)/666.6f),
+                0.0025f / scale, 0.075f+(((float)processing->rbfDenoiserRange-40.0f)/666.6f),
                 imageX, imageY, 3);
 
         float outL = processing->rbfDenoiserLuma/100.0;
@@ -559,293 +1001,205 @@ void applyProcessingObject( processingObject_t * processing,
     }
 
 
-    uint32_t sharp_skip = 1; /* Skip how many pixels when applying sharpening */
-    uint32_t sharp_start = 0; /* How many pixels offset to start at */
-    memcpy( inputImage, outputImage, img_s * sizeof(uint16_t) );
-    uint8_t doChromaSeperation = processingUsesChromaSeparation(processing);
-
-    /* enter YCbCr world - https://en.wikipedia.org/wiki/YCbCr (I used the 'JPEG Transform') */
-    if (doChromaSeperation)
-    {
-        convert_rgb_to_YCbCr_omp(inputImage, img_s, processing->cs_zone.pre_calc_rgb_to_YCbCr);
-
-        sharp_start = 0; /* Start at 0 - Luma/Y channel */
-        sharp_skip = 3; /* Only sharpen every third (Y/luma) pixel */
-    }
-
-    /* Basic box blur */
-    if (processingGetChromaBlurRadius(processing) > 0 && doChromaSeperation)
+    /* Chroma separation, chroma blur, sharpening and grain per tile, reading the frame copy around it */
+    int finish_done = 0;
+    if (processingUsesChromaSeparation(processing) || processingGetSharpening(processing) > 0.005)
     {
-        memcpy(outputImage, inputImage, img_s * sizeof(uint16_t));
-        blur_image( inputImage, outputImage,
-                    imageX, imageY, processingGetChromaBlurRadius(processing),
-                    0,1,1,
-                    0,0 );
-    }
-
-    if (processingGetSharpening(processing) > 0.005)
-    {
-        /* Use sobel filter to create a edge mask */
-        uint16_t *gray,
-             *sobel_h_res,
-             *sobel_v_res,
-             *contour_img;
-        if( processing->sh_masking > 0 ) sobelFilter( inputImage, &gray, &sobel_h_res, &sobel_v_res, &contour_img, imageX, imageY );
-
-        /* Avoid gaps in pixels if skipping pixels during sharpen */
-        if (sharp_skip != 1) memcpy(outputImage, inputImage, img_s * sizeof(uint16_t));
-
-        uint32_t y_max = imageY - 1;
-        uint32_t x_max = (imageX - 1) * 3; /* X in multiples of 3 for RGB */
-
-        /* Center and outter lut */
-        uint32_t * ka = processing->pre_calc_sharp_a;
-        uint16_t * kx = processing->pre_calc_sharp_x;
-        uint16_t * ky = processing->pre_calc_sharp_y;
-
-        /* Row length elements */
-        uint32_t rl = imageX * 3;
-
-#pragma omp parallel for
-        for (uint32_t y = 0; y < y_max+1; ++y)
+        int radius = (processingUsesChromaSeparation(processing)) ? processingGetChromaBlurRadius(processing) : 0;
+        int masking = (processingGetSharpening(processing) > 0.005 && processing->sh_masking > 0);
+        int finish_threads = (threads > 1 && processing->pool) ? threads : 1;
+        whole.scratch = finish_scratch_create(finish_threads, imageX, radius, masking);
+        /* Not enough memory for every worker: one set, one tile after the other */
+        if (!whole.scratch && finish_threads > 1)
         {
-            uint16_t * out_row = outputImage + (y * rl); /* current row ouptut */
-            uint16_t * row = inputImage + (y * rl); /* current row */
-            uint16_t * p_row;
-            if( y == 0 ) p_row = row;        /* minimize border artifact */
-            else p_row = inputImage + ((y-1) * rl); /* previous */
-
-            uint16_t * n_row;
-            if( y == y_max ) p_row = row;    /* minimize border artifact */
-            else n_row = inputImage + ((y+1) * rl); /* next */
-
-            uint16_t * cont_row;
-            if( processing->sh_masking > 0 )
-            {
-                cont_row = contour_img + (y * imageX);
-            }
-
-            for (uint32_t x = 3+sharp_start; x < x_max; x+=sharp_skip)
-            {
-                int32_t sharp = ka[row[x]]
-                              - ky[p_row[x]]
-                              - ky[n_row[x]]
-                              - kx[row[x-3]]
-                              - kx[row[x+3]];
-
-                /* use the edge mask for sharpening only edges */
-                if( processing->sh_masking > 0 )
-                {
-                    uint32_t x1 = x / 3;
-                    /* more contrast & brightness for mask */
-                    uint32_t maskIntensity = 15000;
-                    uint32_t cont = cont_row[x1] + (100-(uint32_t)processing->sh_masking) * 150;
-                    if( cont > maskIntensity ) cont = maskIntensity;
-                    /* calc output in dependency to mask slider */
-                    out_row[x] = LIMIT16( ( cont / (float)maskIntensity) * LIMIT16(sharp)
-                                      + ( ( maskIntensity - cont ) / (float)maskIntensity ) * row[x] );
-                    /* Show mask */
-                    //out_row[x] = LIMIT16(cont/(float)maskIntensity*65535.0);
-                }
-                /* sharpen all */
-                else
-                {
-                    out_row[x] = LIMIT16(sharp);
-                }
-            }
-
-            /* Edge pixels (basically don't do any changes to them) */
-            out_row[0] = row[0];
-            out_row[1] = row[1];
-            out_row[2] = row[2];
-            out_row += rl;
-            row += rl;
-            out_row[-3] = row[-3];
-            out_row[-2] = row[-2];
-            out_row[-1] = row[-1];
+            finish_threads = 1;
+            whole.scratch = finish_scratch_create(finish_threads, imageX, radius, masking);
         }
-
-        /* Copy top and bottom row */
-        //memcpy(outputImage, inputImage, rl * sizeof(uint16_t));
-        //memcpy(outputImage + (rl*(imageY-1)), inputImage + (rl*(imageY-1)), rl * sizeof(uint16_t));
-
-        if( processing->sh_masking > 0 )
+        if (whole.scratch)
         {
-            if( gray ) free( gray );
-            if( sobel_h_res ) free( sobel_h_res );
-            if( sobel_v_res ) free( sobel_v_res );
-            if( contour_img ) free( contour_img );
+            memcpy( inputImage, outputImage, img_s * sizeof(uint16_t) );
+            run_processing_tiles(&whole, finish_threads, apply_finish_slice);
+            finish_scratch_free(whole.scratch);
+            whole.scratch = NULL;
+            finish_done = 1;
         }
+#ifndef STDOUT_SILENT
+        else printf("apply_processing_object: out of memory, chroma separation and sharpening skipped\n");
+#endif
     }
-    else
-    {
-        memcpy(outputImage, inputImage, img_s * sizeof(uint16_t));
-    }
-
-    /* Leave Y-Cb-Cr world */
-    if (doChromaSeperation)
-    {
-        convert_YCbCr_to_rgb_omp(outputImage, img_s, processing->cs_zone.pre_calc_YCbCr_to_rgb);
-    }
-
     /* Grain (simple monochrome noise) generator - must be applied after denoiser */
-    if( processing->grainStrength > 0 ) //Switch on/off
+    if( !finish_done && processing->grainStrength > 0 ) //Switch on/off
     {
-        int strength = 50 * processing->grainStrength;
-#pragma omp parallel for
-        for( int i = 0; i < img_s; i+=3 )
-        {
-            uint32_t randomval = randomseed1 ^ ((i*randomseed2) * (randomseed3-i) * (i+randomseed4));
-            int grain = ( randomval % strength ) - ( strength >> 2 ); //change value for strength
-
-            if( processing->grainLumaWeight > 0 )
-            {
-                uint32_t sumL = outputImage[i+0] + outputImage[i+1] + outputImage[i+2];
-                double weight = sumL / 1.5 / 65535.0;
-                weight = ( weight * processing->grainLumaWeight / 100.0 ) + ( ( 100 - processing->grainLumaWeight ) / 100.0 );
-                grain *= weight;
-            }
-
-            outputImage[i+0] = LIMIT16( outputImage[i+0] + grain );
-            outputImage[i+1] = LIMIT16( outputImage[i+1] + grain );
-            outputImage[i+2] = LIMIT16( outputImage[i+2] + grain );
-        }
+        run_processing_tiles(&whole, threads, apply_grain_slice);
     }
+
+    omp_set_num_threads(omp_threads);
+    core_budget_release(CORE_BUDGET_PROCESSING, granted);
 }
 
 /* Colour tonemap function for smooth gamut mapping */
 static float Reinhard_for_colour(float x) { return (x < 0.5f) ? x : (ReinhardTonemap_f((x-0.5f)/0.5f)*0.5f+0.5f); }
 static float Reinhard_for_blue(float x) { return (x < 0.7f) ? x : (ReinhardTonemap_f((x-0.7f)/0.3f)*0.3f+0.7f); }
 
-/* A private part of the processing machine */
-void apply_processing_object( processingObject_t * processing,
-                              int imageX, int imageY, 
-                              uint16_t * __restrict inputImage, 
-                              uint16_t * __restrict outputImage,
-                              uint16_t * __restrict blurImage,
-                              uint16_t * __restrict gradientMask,
-                              float * __restrict vignetteMask )
+/* Features of the main pixel loop, resolved once per tile. Every combination
+   is compiled as its own kernel, so the loop does not check sliders per pixel */
+#define PIXEL_VIGNETTE      (1 << 0)
+#define PIXEL_LOCAL         (1 << 1) /* shadows/highlights or clarity, from the blurred image */
+#define PIXEL_CONTRAST      (1 << 2) /* contrast, clarity or gradient contrast of the pixel */
+#define PIXEL_GRADIENT      (1 << 3)
+#define PIXEL_HIGHLIGHTS    (1 << 4) /* highlight reconstruction */
+#define PIXEL_CAM_MATRIX    (1 << 5)
+
+typedef struct {
+    processingObject_t * processing;
+    uint16_t * img;
+    uint16_t * img_end;
+    uint16_t * blurImage;
+    uint16_t * gradientMask;
+    float * vignetteMask;
+    float * vignetteEnd;
+    float * rgb_to_Y;
+    /* What the features above consist of */
+    int clarity;
+    int shadows_highlights;
+    int contrast;
+    int gradient_contrast;
+    int dual_iso;
+} pixel_loop_t;
+
+#define SLIDER_USED(X) ( (X) <= -0.01 || (X) >= 0.01 )
+
+static uint32_t pixel_features(processingObject_t * processing, pixel_loop_t * loop)
 {
-    /* Number of elements */
-    int img_s = imageX * imageY * 3;
+    uint32_t features = 0;
 
-    /* (for shorter code) */
-    int32_t ** pm = processing->pre_calc_matrix;
-    int32_t ** pmg = processing->pre_calc_matrix_gradient;
-    uint16_t * img = inputImage;
-    uint16_t * img_end = img + img_s;
-    uint16_t * gm = gradientMask;
-    float * vm = vignetteMask;
-    float * vmpix = vm;
+    if (processing->allow_creative_adjustments)
+    {
+        loop->clarity = SLIDER_USED(processing->clarity);
+        loop->shadows_highlights = SLIDER_USED(processing->shadows_highlights.shadows)
+                                || SLIDER_USED(processing->shadows_highlights.highlights);
+        loop->contrast = SLIDER_USED(processing->contrast);
+        loop->gradient_contrast = SLIDER_USED(processing->gradient_contrast);
 
-    /* For Y calculation */
-    float rgb_to_Y[3]; {
-        double inversemat[9];
-        invertMatrix(colour_gamuts[processing->colour_gamut], inversemat);
-        for (int i = 0; i < 3; ++i) rgb_to_Y[i] = inversemat[3+i];
+        if (loop->clarity || loop->shadows_highlights) features |= PIXEL_LOCAL;
+        if (loop->clarity || loop->contrast || loop->gradient_contrast) features |= PIXEL_CONTRAST;
     }
+    if (processing->vignette_strength != 0) features |= PIXEL_VIGNETTE;
+    if( processing->gradient_enable &&
+      ( ( processing->gradient_exposure_stops < -0.01 || processing->gradient_exposure_stops > 0.01 )
+     || ( processing->gradient_contrast       < -0.01 || processing->gradient_contrast       > 0.01 ) ) ) features |= PIXEL_GRADIENT;
+    if (processing->highlight_reconstruction)
+    {
+        features |= PIXEL_HIGHLIGHTS;
+        loop->dual_iso = (*processing->dual_iso != 0);
+    }
+    if (processing->use_cam_matrix > 0) features |= PIXEL_CAM_MATRIX;
 
-    double agx_inverse_matrix[9];
-    invertMatrix(agx_compressed_matrix, agx_inverse_matrix);
+    return features;
+}
 
-    /* In case of camera matrix */
-    //double (* tone_mapping_function)(double) = tonemap_functions[processing->tonemap_function];
+#ifdef __GNUC__
+#define PIXEL_KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define PIXEL_KERNEL_INLINE inline
+#endif
 
-    /* Apply some precalcuolated settings */
-    for (int i = 0; i < img_s; ++i)
-    {
-        /* Black + white level */
-        img[i] = processing->pre_calc_levels[ img[i] ];
-    }
+/* Black & white level, white balance & exposure & highlights & gamma & highlight reconstruction
+   and gradient. features is a constant in every instance */
+static PIXEL_KERNEL_INLINE void pixel_kernel(const pixel_loop_t * loop, const uint32_t features)
+{
+    processingObject_t * processing = loop->processing;
+    double * pm = processing->final_matrix;
+    double * pmg = processing->final_matrix_gradient;
+    const float * rgb_to_Y = loop->rgb_to_Y;
+    float * vmpix = loop->vignetteMask;
+    uint16_t * img = loop->img;
+    uint16_t * img_end = loop->img_end;
+    uint16_t * blurImage = loop->blurImage;
+    uint16_t * gm = loop->gradientMask;
 
-    /* white balance & exposure & highlights & gamma & highlight reconstruction */
     for (uint16_t * pix = img, * bpix = blurImage, *gmpix = gm; pix < img_end; pix += 3, bpix += 3, gmpix++)
     {
+        /* Black + white level */
+        pix[0] = processing->pre_calc_levels[ pix[0] ];
+        pix[1] = processing->pre_calc_levels[ pix[1] ];
+        pix[2] = processing->pre_calc_levels[ pix[2] ];
+
         double expo_correction = 1.0;
         double expo_correction_gradient = 1.0;
 
         /* Vignette correction */
-        if( processing->vignette_strength != 0 )
+        if( features & PIXEL_VIGNETTE )
         {
             vmpix++;
-            if( vmpix < processing->vignette_end )  /* just safety - sometimes parameters may change faster than processing */
+            if( vmpix < loop->vignetteEnd )  /* just safety - sometimes parameters may change faster than processing */
             {
                 expo_correction *= pow( 1.0 + ( vmpix[0] * processing->vignette_strength / 128.0 ), 4 );
             }
         }
 
-        if (processing->allow_creative_adjustments)
+        /* shadows & highlights, clarity part 1 */
+        if( features & PIXEL_LOCAL )
         {
-            /* shadows & highlights, clarity part 1 */
-            if( ( processing->shadows_highlights.shadows    <= -0.01 || processing->shadows_highlights.shadows    >= 0.01 )
-            || ( processing->shadows_highlights.highlights <= -0.01 || processing->shadows_highlights.highlights >= 0.01 )
-            || ( processing->clarity                       <= -0.01 || processing->clarity                       >= 0.01 ) )
-            {
-                /* Blur pixLZ */
-                int32_t bval = ( ((pm[0][bpix[0]] /* + pm[1][bpix[1]] + pm[2][bpix[2]] */) << 2)
-                            + ((/* pm[3][bpix[0]] + */ pm[4][bpix[1]] /* + pm[5][bpix[2]] */) * 11)
-                            +  (/* pm[6][bpix[0]] + pm[7][bpix[1]] + */ pm[8][bpix[2]]) ) >> 4;
+            /* Blur pixLZ */
+            int32_t bval = ( ((MATRIX_MUL(pm, 0, bpix[0]) /* + MATRIX_MUL(pm, 1, bpix[1]) + MATRIX_MUL(pm, 2, bpix[2]) */) << 2)
+                        + ((/* MATRIX_MUL(pm, 3, bpix[0]) + */ MATRIX_MUL(pm, 4, bpix[1]) /* + MATRIX_MUL(pm, 5, bpix[2]) */) * 11)
+                        +  (/* MATRIX_MUL(pm, 6, bpix[0]) + MATRIX_MUL(pm, 7, bpix[1]) + */ MATRIX_MUL(pm, 8, bpix[2])) ) >> 4;
 
-                if( processing->clarity <= -0.01 || processing->clarity >= 0.01 )
-                {
-                    /* clarity part 1 */
-                    double factor = processing->clarity_curve[LIMIT16(bval)];
-                    expo_correction /= (factor * factor);
-                }
-                if( ( processing->shadows_highlights.shadows <= -0.01 || processing->shadows_highlights.shadows >= 0.01 )
-                || ( processing->shadows_highlights.highlights <= -0.01 || processing->shadows_highlights.highlights >= 0.01 ) )
-                {
-                    /* highlight exposure factor */
-                    expo_correction *= processing->shadows_highlights.shadow_highlight_curve[LIMIT16(bval)];
-                }
+            if( loop->clarity )
+            {
+                /* clarity part 1 */
+                double factor = processing->clarity_curve[LIMIT16(bval)];
+                expo_correction /= (factor * factor);
             }
-
-            /* Contrast on untouched pixel */
-            if( ( processing->contrast          <= -0.01 || processing->contrast          >= 0.01 )
-            || ( processing->clarity           <= -0.01 || processing->clarity           >= 0.01 )
-            || ( processing->gradient_contrast <= -0.01 || processing->gradient_contrast >= 0.01 ) )
+            if( loop->shadows_highlights )
             {
-                int32_t cval = ( ((pm[0][pix[0]] /* + pm[1][pix[1]] + pm[2][pix[2]] */) << 2)
-                             + ((/* pm[3][pix[0]] + */ pm[4][pix[1]] /* + pm[5][pix[2]] */) * 11)
-                             +  (/* pm[6][pix[0]] + pm[7][pix[1]] + */ pm[8][pix[2]]) ) >> 4;
+                /* highlight exposure factor */
+                expo_correction *= processing->shadows_highlights.shadow_highlight_curve[LIMIT16(bval)];
+            }
+        }
 
-                if( processing->clarity <= -0.01 || processing->clarity >= 0.01 )
-                {
-                    /* clarity part 2 */
-                    double factor = processing->clarity_curve[LIMIT16(cval)];
-                    expo_correction *= factor * factor;
-                }
-                if( processing->contrast <= -0.01 || processing->contrast >= 0.01 )
-                {
-                    /* contrast factor */
-                    expo_correction *= processing->contrast_curve[LIMIT16(cval)];
-                }
-                if( processing->gradient_contrast <= -0.01 || processing->gradient_contrast >= 0.01 )
-                {
-                    /* gradient contrast factor */
-                    expo_correction_gradient *= processing->gradient_contrast_curve[LIMIT16(cval)];
-                }
+        /* Contrast on untouched pixel */
+        if( features & PIXEL_CONTRAST )
+        {
+            int32_t cval = ( ((MATRIX_MUL(pm, 0, pix[0]) /* + MATRIX_MUL(pm, 1, pix[1]) + MATRIX_MUL(pm, 2, pix[2]) */) << 2)
+                         + ((/* MATRIX_MUL(pm, 3, pix[0]) + */ MATRIX_MUL(pm, 4, pix[1]) /* + MATRIX_MUL(pm, 5, pix[2]) */) * 11)
+                         +  (/* MATRIX_MUL(pm, 6, pix[0]) + MATRIX_MUL(pm, 7, pix[1]) + */ MATRIX_MUL(pm, 8, pix[2])) ) >> 4;
+
+            if( loop->clarity )
+            {
+                /* clarity part 2 */
+                double factor = processing->clarity_curve[LIMIT16(cval)];
+                expo_correction *= factor * factor;
+            }
+            if( loop->contrast )
+            {
+                /* contrast factor */
+                expo_correction *= processing->contrast_curve[LIMIT16(cval)];
+            }
+            if( loop->gradient_contrast )
+            {
+                /* gradient contrast factor */
+                expo_correction_gradient *= processing->gradient_contrast_curve[LIMIT16(cval)];
             }
         }
 
         /* white balance & exposure */
-        float pix0 = (pm[0][pix[0]] /* + pm[1][pix[1]] + pm[2][pix[2]] */)*expo_correction;
-        float pix1 = (/* pm[3][pix[0]] + */ pm[4][pix[1]] /* + pm[5][pix[2]] */)*expo_correction;
-        float pix2 = (/* pm[6][pix[0]] + pm[7][pix[1]] + */ pm[8][pix[2]])*expo_correction;
-        float tmp1 = (/* pm[3][pix[0]] + */ pm[4][pix[1]] /* + pm[5][pix[2]] */);
+        float pix0 = (MATRIX_MUL(pm, 0, pix[0]) /* + MATRIX_MUL(pm, 1, pix[1]) + MATRIX_MUL(pm, 2, pix[2]) */)*expo_correction;
+        float pix1 = (/* MATRIX_MUL(pm, 3, pix[0]) + */ MATRIX_MUL(pm, 4, pix[1]) /* + MATRIX_MUL(pm, 5, pix[2]) */)*expo_correction;
+        float pix2 = (/* MATRIX_MUL(pm, 6, pix[0]) + MATRIX_MUL(pm, 7, pix[1]) + */ MATRIX_MUL(pm, 8, pix[2]))*expo_correction;
+        float tmp1 = (/* MATRIX_MUL(pm, 3, pix[0]) + */ MATRIX_MUL(pm, 4, pix[1]) /* + MATRIX_MUL(pm, 5, pix[2]) */);
 
         /* Gradient variables and part 1 */
         float pixg[3];
-        if( processing->gradient_enable && gmpix[0] != 0 &&
-          ( ( processing->gradient_exposure_stops < -0.01 || processing->gradient_exposure_stops > 0.01 )
-         || ( processing->gradient_contrast       < -0.01 || processing->gradient_contrast       > 0.01 ) ) )
+        if( (features & PIXEL_GRADIENT) && gmpix[0] != 0 )
         {
             /* do the same for gradient as for the pic itself, but before the values are overwritten */
             /* white balance & exposure */
-            float pix0g = (pmg[0][pix[0]] /* + pmg[1][pix[1]] + pmg[2][pix[2]] */) * expo_correction * expo_correction_gradient;
-            float pix1g = (/* pmg[3][pix[0]] + */ pmg[4][pix[1]] /* + pmg[5][pix[2]] */) * expo_correction * expo_correction_gradient;
-            float pix2g = (/* pmg[6][pix[0]] + pmg[7][pix[1]] */ + pmg[8][pix[2]]) * expo_correction * expo_correction_gradient;
-            float tmp1g = (/* pmg[3][pix[0]] + */ pmg[4][pix[1]] /* + pmg[5][pix[2]] */);
+            float pix0g = (MATRIX_MUL(pmg, 0, pix[0]) /* + MATRIX_MUL(pmg, 1, pix[1]) + MATRIX_MUL(pmg, 2, pix[2]) */) * expo_correction * expo_correction_gradient;
+            float pix1g = (/* MATRIX_MUL(pmg, 3, pix[0]) + */ MATRIX_MUL(pmg, 4, pix[1]) /* + MATRIX_MUL(pmg, 5, pix[2]) */) * expo_correction * expo_correction_gradient;
+            float pix2g = (/* MATRIX_MUL(pmg, 6, pix[0]) + MATRIX_MUL(pmg, 7, pix[1]) */ + MATRIX_MUL(pmg, 8, pix[2])) * expo_correction * expo_correction_gradient;
+            float tmp1g = (/* MATRIX_MUL(pmg, 3, pix[0]) + */ MATRIX_MUL(pmg, 4, pix[1]) /* + MATRIX_MUL(pmg, 5, pix[2]) */);
 
             pixg[0] = LIMIT16(pix0g);
             pixg[1] = LIMIT16(pix1g);
@@ -853,9 +1207,9 @@ void apply_processing_object( processingObject_t * processing,
             tmp1g   = LIMIT16(tmp1g);
 
             /* Now highlight reconstruction for gradient layer*/
-            if (processing->highlight_reconstruction)
+            if( features & PIXEL_HIGHLIGHTS )
             {
-                if(*processing->dual_iso != 0)
+                if( loop->dual_iso )
                 {
                     /* Check if its the range of highest green value possible */
                     /* the range makes it cleaner against pink noise */
@@ -884,9 +1238,9 @@ void apply_processing_object( processingObject_t * processing,
         tmp1   = LIMIT16(tmp1);
 
         /* Now highlight reconstruction */
-        if (processing->highlight_reconstruction)
+        if( features & PIXEL_HIGHLIGHTS )
         {
-            if(*processing->dual_iso != 0)
+            if( loop->dual_iso )
             {
                 /* Check if its the range of highest green value possible */
                 /* the range makes it cleaner against pink noise */
@@ -916,8 +1270,7 @@ void apply_processing_object( processingObject_t * processing,
             }
         }
 
-        /* I really don't like how this if is in a big loop :(( */
-        if( processing->use_cam_matrix > 0 )
+        if( features & PIXEL_CAM_MATRIX )
         {
             /* WB correction */
             float pix0b = pix[0], pix1b = pix[1], pix2b = pix[2];
@@ -1002,12 +1355,10 @@ void apply_processing_object( processingObject_t * processing,
         }
 
         /* Gradient part 2 & blending */
-        if( processing->gradient_enable && gmpix[0] != 0 &&
-          ( ( processing->gradient_exposure_stops < -0.01 || processing->gradient_exposure_stops > 0.01 )
-         || ( processing->gradient_contrast       < -0.01 || processing->gradient_contrast       > 0.01 ) ) )
+        if( (features & PIXEL_GRADIENT) && gmpix[0] != 0 )
         {
             /* WB correction gradient layer*/
-            if( processing->use_cam_matrix > 0 )
+            if( features & PIXEL_CAM_MATRIX )
             {
                 float pix0b = pixg[0], pix1b = pixg[1], pix2b = pixg[2];
                 double result[3];
@@ -1071,167 +1422,212 @@ void apply_processing_object( processingObject_t * processing,
             pix[2] = gmpix[0] / 65535.0 * pixg[2] + (65535 - gmpix[0]) / 65535.0 * pix[2];
         }
     }
+}
+
+#define PIXEL_KERNEL(F) case (F): pixel_kernel(loop, (F)); break;
+#define PIXEL_KERNEL4(F) PIXEL_KERNEL(F) PIXEL_KERNEL((F)+1) PIXEL_KERNEL((F)+2) PIXEL_KERNEL((F)+3)
+#define PIXEL_KERNEL16(F) PIXEL_KERNEL4(F) PIXEL_KERNEL4((F)+4) PIXEL_KERNEL4((F)+8) PIXEL_KERNEL4((F)+12)
 
-    //Code for HueVs...
-    if( (processing->allow_creative_adjustments )
-     && ( processing->hue_vs_luma_used
-       || processing->hue_vs_saturation_used
-       || processing->hue_vs_hue_used
-       || processing->luma_vs_saturation_used ) )
+static void run_pixel_kernel(const pixel_loop_t * loop, uint32_t features)
+{
+    switch (features)
     {
-        for (uint16_t * pix = img; pix < img_end; pix += 3)
+        PIXEL_KERNEL16(0)
+        PIXEL_KERNEL16(16)
+        PIXEL_KERNEL16(32)
+        PIXEL_KERNEL16(48)
+    }
+}
+
+/* Point stages after gamma, one pixel each, run fused by apply_processing_object */
+static inline void hue_vs_pixel(processingObject_t * processing, uint16_t * pix)
+{
+    float hsl[3];
+    float rgb[3];
+    for( int i = 0; i < 3; i++ ) rgb[i] = pix[i] / 65535.0f;
+    fromRGBtoHSV( rgb, hsl );
+    //rgb_to_hsl( pix, hsl );
+
+    /* Calculate saturation value of untouched pixel (taken from vibrance, gives better results than from rgb_to_hsl) */
+    // ///////////////////////
+    double sat = 0;
+    if( !( pix[0] == 0 && pix[1] == 0 && pix[2] == 0 ) )
+    {
+        uint16_t biggest = 0;
+        uint16_t smallest = 65535;
+        for( int i = 0; i < 3; i++ )
         {
-            float hsl[3];
-            float rgb[3];
-            for( int i = 0; i < 3; i++ ) rgb[i] = pix[i] / 65535.0f;
-            fromRGBtoHSV( rgb, hsl );
-            //rgb_to_hsl( pix, hsl );
-
-            /* Calculate saturation value of untouched pixel (taken from vibrance, gives better results than from rgb_to_hsl) */
-            // ///////////////////////
-            double sat = 0;
-            if( !( pix[0] == 0 && pix[1] == 0 && pix[2] == 0 ) )
-            {
-                uint16_t biggest = 0;
-                uint16_t smallest = 65535;
-                for( int i = 0; i < 3; i++ )
-                {
-                    if( pix[i] > biggest ) biggest = pix[i];
-                    if( pix[i] < smallest ) smallest = pix[i];
-                }
-                sat = ((double)biggest - (double)smallest) / (double)biggest;
-            }
-            /* Some cheat factor to make the effect more visible */
-            sat = 2.0 * sat / ( sat * sat + 1 );
-            if( sat > 1.0 ) sat = 1.0;
-            // ///////////////////////
+            if( pix[i] > biggest ) biggest = pix[i];
+            if( pix[i] < smallest ) smallest = pix[i];
+        }
+        sat = ((double)biggest - (double)smallest) / (double)biggest;
+    }
+    /* Some cheat factor to make the effect more visible */
+    sat = 2.0 * sat / ( sat * sat + 1 );
+    if( sat > 1.0 ) sat = 1.0;
+    // ///////////////////////
 
-            uint16_t hue = (uint16_t)(hsl[0] * 100.0);
+    uint16_t hue = (uint16_t)(hsl[0] * 100.0);
 
-            hsl[2] *= 1.0 + (processing->hue_vs_luma[hue] * sat * 2);
-            if( hsl[2] < 0.0 ) hsl[2] = 0.0;
-            //if( hsl[2] > 1.0 ) hsl[2] = 1.0;
+    hsl[2] *= 1.0 + (processing->hue_vs_luma[hue] * sat * 2);
+    if( hsl[2] < 0.0 ) hsl[2] = 0.0;
+    //if( hsl[2] > 1.0 ) hsl[2] = 1.0;
 
-            hsl[1] *= 1.0 + (processing->hue_vs_saturation[hue] * 2);
-            if( hsl[1] < 0.0 ) hsl[1] = 0.0;
-            //if( hsl[1] > 1.0 ) hsl[1] = 1.0;
+    hsl[1] *= 1.0 + (processing->hue_vs_saturation[hue] * 2);
+    if( hsl[1] < 0.0 ) hsl[1] = 0.0;
+    //if( hsl[1] > 1.0 ) hsl[1] = 1.0;
 
-            hsl[0] += 60 * processing->hue_vs_hue[hue];
-            if( hsl[0] < 0 ) hsl[0] += 360;
-            else if( hsl[0] >= 360 ) hsl[0] -= 360;
+    hsl[0] += 60 * processing->hue_vs_hue[hue];
+    if( hsl[0] < 0 ) hsl[0] += 360;
+    else if( hsl[0] >= 360 ) hsl[0] -= 360;
 
-            uint16_t luma = (uint16_t)((hsl[2]) * 36000.0);
-            hsl[1] *= 1.0 + (processing->luma_vs_saturation[luma] * 2);
-            if( hsl[1] < 0.0 ) hsl[1] = 0.0;
+    uint16_t luma = (uint16_t)((hsl[2]) * 36000.0);
+    hsl[1] *= 1.0 + (processing->luma_vs_saturation[luma] * 2);
+    if( hsl[1] < 0.0 ) hsl[1] = 0.0;
 
-            //hsl_to_rgb( hsl, pix );
-            fromHSVtoRGB( hsl, rgb );
-            for( int i = 0; i < 3; i++ ) pix[i] = LIMIT16( rgb[i] * 65535.0f + 0.5f );
-        }
-    }
+    //hsl_to_rgb( hsl, pix );
+    fromHSVtoRGB( hsl, rgb );
+    for( int i = 0; i < 3; i++ ) pix[i] = LIMIT16( rgb[i] * 65535.0f + 0.5f );
+}
 
-    if (processing->allow_creative_adjustments)
-    {
-        if( processing->vibrance > 1.01 || processing->vibrance < 0.99 )
-        {
-            /* Now vibrance, before saturation, because we need untouched colors (in terms of saturation) */
-            for (uint16_t * pix = img; pix < img_end; pix += 3)
-            {
-                /* Pixel brightness = 4/16 R, 11/16 G, 1/16 blue; Try swapping the channels, it will look worse */
-                int32_t Y1 = ((pix[0] << 2) + (pix[1] * 11) + pix[2]) >> 4;
-                int32_t Y2 = Y1 - 65536;
+/* Vibrance, before saturation, because we need untouched colors (in terms of saturation) */
+static inline void vibrance_pixel(processingObject_t * processing, uint16_t * pix)
+{
+    /* Pixel brightness = 4/16 R, 11/16 G, 1/16 blue; Try swapping the channels, it will look worse */
+    int32_t Y1 = ((pix[0] << 2) + (pix[1] * 11) + pix[2]) >> 4;
+    int32_t Y2 = Y1 - 65536;
 
-                /* Increase difference between channels and the saturation midpoint */
-                int32_t pix0 = processing->pre_calc_vibrance[pix[0] - Y2] + Y1;
-                int32_t pix1 = processing->pre_calc_vibrance[pix[1] - Y2] + Y1;
-                int32_t pix2 = processing->pre_calc_vibrance[pix[2] - Y2] + Y1;
+    /* Increase difference between channels and the saturation midpoint */
+    int32_t pix0 = processing->pre_calc_vibrance[pix[0] - Y2] + Y1;
+    int32_t pix1 = processing->pre_calc_vibrance[pix[1] - Y2] + Y1;
+    int32_t pix2 = processing->pre_calc_vibrance[pix[2] - Y2] + Y1;
 
-                /* Positive vibrance in dependency to raw saturation */
-                if( processing->vibrance > 1.0 )
-                {
-                    /* Calculate saturation value of untouched pixel */
-                    double sat = 0;
-                    if( !( pix[0] == 0 && pix[1] == 0 && pix[2] == 0 ) )
-                    {
-                        uint16_t biggest = 0;
-                        uint16_t smallest = 65535;
-                        for( int i = 0; i < 3; i++ )
-                        {
-                            if( pix[i] > biggest ) biggest = pix[i];
-                            if( pix[i] < smallest ) smallest = pix[i];
-                        }
-                        sat = ((double)biggest - (double)smallest) / (double)biggest;
-                    }
-                    /* Some cheat factor to make the effect more visible */
-                    sat = 2.0 * sat / ( sat * sat + 1 );
-                    if( sat > 1.0 ) sat = 1.0;
-                    /* The less saturated the pixel was, the more saturation it gets */
-                    pix[0] = LIMIT16( pix[0] * sat + pix0 * ( 1.0 - sat ) );
-                    pix[1] = LIMIT16( pix[1] * sat + pix1 * ( 1.0 - sat ) );
-                    pix[2] = LIMIT16( pix[2] * sat + pix2 * ( 1.0 - sat ) );
-                }
-                /* Negative vibrance is the same as (un)saturation */
-                else
-                {
-                    pix[0] = LIMIT16(pix0);
-                    pix[1] = LIMIT16(pix1);
-                    pix[2] = LIMIT16(pix2);
-                }
-            }
-        }
-
-        if( processing->saturation > 1.01 || processing->saturation < 0.99 )
+    /* Positive vibrance in dependency to raw saturation */
+    if( processing->vibrance > 1.0 )
+    {
+        /* Calculate saturation value of untouched pixel */
+        double sat = 0;
+        if( !( pix[0] == 0 && pix[1] == 0 && pix[2] == 0 ) )
         {
-            /* Now saturation (looks way better after gamma) */
-            for (uint16_t * pix = img; pix < img_end; pix += 3)
+            uint16_t biggest = 0;
+            uint16_t smallest = 65535;
+            for( int i = 0; i < 3; i++ )
             {
-                /* Pixel brightness = 4/16 R, 11/16 G, 1/16 blue; Try swapping the channels, it will look worse */
-                int32_t Y1 = ((pix[0] << 2) + (pix[1] * 11) + pix[2]) >> 4;
-                int32_t Y2 = Y1 - 65536;
-
-                /* Increase difference between channels and the saturation midpoint */
-                int32_t pix0 = processing->pre_calc_sat[pix[0] - Y2] + Y1;
-                int32_t pix1 = processing->pre_calc_sat[pix[1] - Y2] + Y1;
-                int32_t pix2 = processing->pre_calc_sat[pix[2] - Y2] + Y1;
-
-                pix[0] = LIMIT16(pix0);
-                pix[1] = LIMIT16(pix1);
-                pix[2] = LIMIT16(pix2);
+                if( pix[i] > biggest ) biggest = pix[i];
+                if( pix[i] < smallest ) smallest = pix[i];
             }
+            sat = ((double)biggest - (double)smallest) / (double)biggest;
         }
+        /* Some cheat factor to make the effect more visible */
+        sat = 2.0 * sat / ( sat * sat + 1 );
+        if( sat > 1.0 ) sat = 1.0;
+        /* The less saturated the pixel was, the more saturation it gets */
+        pix[0] = LIMIT16( pix[0] * sat + pix0 * ( 1.0 - sat ) );
+        pix[1] = LIMIT16( pix[1] * sat + pix1 * ( 1.0 - sat ) );
+        pix[2] = LIMIT16( pix[2] * sat + pix2 * ( 1.0 - sat ) );
+    }
+    /* Negative vibrance is the same as (un)saturation */
+    else
+    {
+        pix[0] = LIMIT16(pix0);
+        pix[1] = LIMIT16(pix1);
+        pix[2] = LIMIT16(pix2);
     }
+}
 
-    /* Toning */
-    if (processing->allow_creative_adjustments)
-    {
-        if( processing->toning_dry < 99.8 )
+/* Saturation (looks way better after gamma) */
+static inline void saturation_pixel(processingObject_t * processing, uint16_t * pix)
+{
+    /* Pixel brightness = 4/16 R, 11/16 G, 1/16 blue; Try swapping the channels, it will look worse */
+    int32_t Y1 = ((pix[0] << 2) + (pix[1] * 11) + pix[2]) >> 4;
+    int32_t Y2 = Y1 - 65536;
+
+    /* Increase difference between channels and the saturation midpoint */
+    int32_t pix0 = processing->pre_calc_sat[pix[0] - Y2] + Y1;
+    int32_t pix1 = processing->pre_calc_sat[pix[1] - Y2] + Y1;
+    int32_t pix2 = processing->pre_calc_sat[pix[2] - Y2] + Y1;
+
+    pix[0] = LIMIT16(pix0);
+    pix[1] = LIMIT16(pix1);
+    pix[2] = LIMIT16(pix2);
+}
+
+/* A private part of the processing machine */
+void apply_processing_object( processingObject_t * processing,
+                              int imageX, int imageY, 
+                              uint16_t * __restrict inputImage, 
+                              uint16_t * __restrict outputImage,
+                              uint16_t * __restrict blurImage,
+                              uint16_t * __restrict gradientMask,
+                              float * __restrict vignetteMask,
+                              float * vignetteEnd )
+{
+    /* Number of elements */
+    int img_s = imageX * imageY * 3;
+
+    /* (for shorter code) */
+    uint16_t * img = inputImage;
+    uint16_t * img_end = img + img_s;
+
+    /* For Y calculation */
+    float rgb_to_Y[3]; {
+        double inversemat[9];
+        invertMatrix(colour_gamuts[processing->colour_gamut], inversemat);
+        for (int i = 0; i < 3; ++i) rgb_to_Y[i] = inversemat[3+i];
+    }
+
+    double agx_inverse_matrix[9];
+    invertMatrix(agx_compressed_matrix, agx_inverse_matrix);
+
+    /* In case of camera matrix */
+    //double (* tone_mapping_function)(double) = tonemap_functions[processing->tonemap_function];
+
+    /* Main pixel loop, with the kernel for the features in use */
+    pixel_loop_t loop = {
+        .processing = processing,
+        .img = img,
+        .img_end = img_end,
+        .blurImage = blurImage,
+        .gradientMask = gradientMask,
+        .vignetteMask = vignetteMask,
+        .vignetteEnd = vignetteEnd,
+        .rgb_to_Y = rgb_to_Y
+    };
+    run_pixel_kernel(&loop, pixel_features(processing, &loop));
+
+    /* Point stages after gamma, fused to one pass over the tile that writes the output */
+    int creative = processing->allow_creative_adjustments;
+    int hue_vs = creative && ( processing->hue_vs_luma_used
+                            || processing->hue_vs_saturation_used
+                            || processing->hue_vs_hue_used
+                            || processing->luma_vs_saturation_used );
+    int vibrance = creative && ( processing->vibrance > 1.01 || processing->vibrance < 0.99 );
+    int saturation = creative && ( processing->saturation > 1.01 || processing->saturation < 0.99 );
+    int toning = creative && ( processing->toning_dry < 99.8 );
+
+    for (uint16_t * pix = img, * out = outputImage; pix < img_end; pix += 3, out += 3)
+    {
+        if (hue_vs) hue_vs_pixel(processing, pix);
+        if (vibrance) vibrance_pixel(processing, pix);
+        if (saturation) saturation_pixel(processing, pix);
+
+        /* Toning */
+        if (toning)
         {
-            for (uint16_t * pix = img; pix < img_end; pix += 3)
+            for( int i = 0; i < 3; i++ )
             {
-                for( int i = 0; i < 3; i++ )
-                {
-                    pix[i] = pix[i] * processing->toning_dry + pix[i] * processing->toning_wet[i];
-                }
+                pix[i] = pix[i] * processing->toning_dry + pix[i] * processing->toning_wet[i];
             }
         }
-    }
 
-    if (processing->allow_creative_adjustments)
-    {
-        /* Contrast Curve (OMG putting this after gamma made it 999x better) */
-        for (uint16_t * pix = img; pix < img_end; pix += 3)
+        if (creative)
         {
+            /* Contrast Curve (OMG putting this after gamma made it 999x better) */
             pix[0] = processing->pre_calc_curve_r[ pix[0] ];
             pix[1] = processing->pre_calc_curve_r[ pix[1] ];
             pix[2] = processing->pre_calc_curve_r[ pix[2] ];
-        }
-    }
 
-    if (processing->allow_creative_adjustments)
-    {
-        //Gradation curve
-        for (uint16_t * pix = img; pix < img_end; pix += 3)
-        {
+            //Gradation curve
             pix[0] = processing->gcurve_y[ pix[0] ];
             pix[1] = processing->gcurve_y[ pix[1] ];
             pix[2] = processing->gcurve_y[ pix[2] ];
@@ -1239,23 +1635,23 @@ void apply_processing_object( processingObject_t * processing,
             pix[1] = processing->gcurve_g[ pix[1] ];
             pix[2] = processing->gcurve_b[ pix[2] ];
         }
-    }
 
-    if (processing->AgX)
-    {
-        //Gradation curve
-        for (uint16_t * pix = img; pix < img_end; pix += 3)
+        if (processing->AgX)
         {
             float as_float[3] = {pix[0], pix[1], pix[2]};
             double * m = agx_inverse_matrix;
-            pix[0] = LIMIT16(as_float[0]*m[0]+as_float[1]*m[1]+as_float[2]*m[2]);
-            pix[1] = LIMIT16(as_float[0]*m[3]+as_float[1]*m[4]+as_float[2]*m[5]);
-            pix[2] = LIMIT16(as_float[0]*m[6]+as_float[1]*m[7]+as_float[2]*m[8]);
+            out[0] = LIMIT16(as_float[0]*m[0]+as_float[1]*m[1]+as_float[2]*m[2]);
+            out[1] = LIMIT16(as_float[0]*m[3]+as_float[1]*m[4]+as_float[2]*m[5]);
+            out[2] = LIMIT16(as_float[0]*m[6]+as_float[1]*m[7]+as_float[2]*m[8]);
+        }
+        else
+        {
+            out[0] = pix[0];
+            out[1] = pix[1];
+            out[2] = pix[2];
         }
     }
 
-    memcpy(outputImage, inputImage, img_s * sizeof(uint16_t));
-
     if (processing->lut_on)
     {
         apply_lut( processing->lut, imageX, imageY, outputImage );
@@ -1716,10 +2112,11 @@ void freeProcessingObject(processingObject_t * processing)
 {
     if(processing->gradient_mask) free(processing->gradient_mask);
     if(processing->vignette_mask) free(processing->vignette_mask);
+    free(processing->region_gradient_mask);
+    free(processing->region_vignette_mask);
     freeFilterObject(processing->filter);
+    processing_pool_free(processing->pool);
     free_lut(processing->lut);
-    for (int i = 8; i >= 0; --i) free(processing->pre_calc_matrix[i]);
-    for (int i = 8; i >= 0; --i) free(processing->pre_calc_matrix_gradient[i]);
     for (int i = 6; i >= 0; --i) free(processing->cs_zone.pre_calc_rgb_to_YCbCr[i]);
     for (int i = 3; i >= 0; --i) free(processing->cs_zone.pre_calc_YCbCr_to_rgb[i]);
     free_image_buffer(processing->shadows_highlights.blur_image);
@@ -1733,7 +2130,7 @@ void processingFindWhiteBalance(processingObject_t *processing, int imageX, int
     int img_s = imageX * imageY * 3;
 
     /* (for shorter code) */
-    int32_t ** pm = processing->pre_calc_matrix;
+    double * pm = processing->final_matrix;
     uint16_t * img = inputImage;
 
     /* Apply some precalcuolated settings */
@@ -1796,9 +2193,9 @@ void processingFindWhiteBalance(processingObject_t *processing, int imageX, int
 
             /* --- maybe this can also be exchanged by apply_processing_object, but here it is simplified and hopefully faster --- */
             /* white balance & exposure */
-            int32_t pix0 = LIMIT16(pm[0][pixR] /*+ pm[1][pixG] + pm[2][pixB]*/);
-            int32_t pix1 = LIMIT16(/*pm[3][pixR] +*/ pm[4][pixG] /*+ pm[5][pixB]*/);
-            int32_t pix2 = LIMIT16(/*pm[6][pixR] + pm[7][pixG] +*/ pm[8][pixB]);
+            int32_t pix0 = LIMIT16(MATRIX_MUL(pm, 0, pixR) /*+ MATRIX_MUL(pm, 1, pixG) + MATRIX_MUL(pm, 2, pixB)*/);
+            int32_t pix1 = LIMIT16(/*MATRIX_MUL(pm, 3, pixR) +*/ MATRIX_MUL(pm, 4, pixG) /*+ MATRIX_MUL(pm, 5, pixB)*/);
+            int32_t pix2 = LIMIT16(/*MATRIX_MUL(pm, 6, pixR) + MATRIX_MUL(pm, 7, pixG) +*/ MATRIX_MUL(pm, 8, pixB));
 
             /* standard highlight reconstruction */
             if( processing->highlight_reconstruction && pix1 == processing->highest_green )
@@ -1864,6 +2261,9 @@ void processingSetVignetteMask(processingObject_t *processing, uint16_t width, u
     double cosTerm = 2.0*M_PI/T/4.0;
 
     processing->vignette_end = processing->vignette_mask + (width*height);
+    processing->mask_width = width;
+    processing->mask_height = height;
+    processing->mask_generation++;
 
     //#pragma omp parallel for collapse(2)
     for( uint16_t x = 0; x < (uint16_t)wHalf; x++ )
@@ -1903,6 +2303,10 @@ void processingSetGradientMask(processingObject_t *processing, uint16_t width, u
     float C1 = A * x1 + B * y1;
     float C2 = A * x2 + B * y2;
 
+    processing->mask_width = width;
+    processing->mask_height = height;
+    processing->mask_generation++;
+
     for( uint16_t x = 0; x < width; x++ )
     {
         #pragma omp parallel for
@@ -1920,7 +2324,7 @@ void processingSetGradientMask(processingObject_t *processing, uint16_t width, u
 }
 
 /* Analyse dual iso frame to find highest green for highlight reconstruction */
-void analyse_frame_highest_green(processingObject_t *processing, int imageX, int imageY, uint16_t *inputImage)
+void analyse_frame_highest_green(processingObject_t *processing, int imageX, int imageY, uint16_t *inputImage, int scale)
 {
     //if not dual iso, we don't need to do this
     if ( *processing->dual_iso == 0 ) return;
@@ -1928,8 +2332,10 @@ void analyse_frame_highest_green(processingObject_t *processing, int imageX, int
     uint16_t * img = inputImage;
     int img_s = imageX * imageY * 3;
     uint16_t * img_end = img + img_s;
-    int32_t ** pm = processing->pre_calc_matrix;
-    int32_t ** pmg = processing->pre_calc_matrix_gradient;
+    double * pm = processing->final_matrix;
+    double * pmg = processing->final_matrix_gradient;
+    /* A reduced image counts like the frame it stands for */
+    uint32_t weight = scale * scale;
 
     //printf( "start algo. \r\n" );
 
@@ -1937,12 +2343,12 @@ void analyse_frame_highest_green(processingObject_t *processing, int imageX, int
     {
         /* for dual iso the highest green peak has to be searched */
         /* build histogram for green channel */
-        uint16_t tableG[256] = {0};
+        uint32_t tableG[256] = {0};
         for (uint16_t * pix = img; pix < img_end; pix += 3)
         {
-            uint16_t pix1 = LIMIT16( pm[4][processing->pre_calc_levels[pix[1]]] )>>8;
+            uint16_t pix1 = LIMIT16( MATRIX_MUL(pm, 4, processing->pre_calc_levels[pix[1]]) )>>8;
             if( pix1 > 255 ) pix1 = 255;
-            tableG[pix1]++;
+            tableG[pix1] += weight;
         }
         /* search the brightest (the most right) peak (I made it equivalent to the number of lines to process in the image or more) */
         int prevVal = 0;
@@ -1951,8 +2357,8 @@ void analyse_frame_highest_green(processingObject_t *processing, int imageX, int
         int lastPeak = 1;
         //PARAMETERS
         int abrtDelt = 5000;
-        int abrtPeak = imageX * imageY / 400;
-        int abrtSign = imageX * imageY / 4000;
+        int abrtPeak = imageX * imageY * weight / 400;
+        int abrtSign = imageX * imageY * weight / 4000;
         // /////////
         for( int32_t i = 255; i > 2; i-- ) //only down to 5, below we just have dark noise, but no highlight
         {
@@ -1989,12 +2395,12 @@ void analyse_frame_highest_green(processingObject_t *processing, int imageX, int
         if( processing->gradient_enable && ( ( processing->gradient_exposure_stops < -0.01 || processing->gradient_exposure_stops > 0.01 )
                                           || ( processing->gradient_contrast < -0.01 || processing->gradient_contrast > 0.01 ) ) )
         {
-            uint16_t tableGg[256] = {0};
+            uint32_t tableGg[256] = {0};
             for (uint16_t * pix = img; pix < img_end; pix += 3)
             {
-                uint16_t pix1 = LIMIT16( pmg[4][processing->pre_calc_levels[pix[1]]] )>>8;
+                uint16_t pix1 = LIMIT16( MATRIX_MUL(pmg, 4, processing->pre_calc_levels[pix[1]]) )>>8;
                 if( pix1 > 255 ) pix1 = 255;
-                tableGg[pix1]++;
+                tableGg[pix1] += weight;
             }
             /* search the brightest (the most right) peak (I made it equivalent to the number of lines to process in the image or more) */
             prevVal = 0;
@@ -87,6 +87,19 @@ void applyProcessingObject( processingObject_t * processing,
                             uint16_t * __restrict inputImage, 
                             uint16_t * __restrict outputImage,
                             int threads, int imageChanged, uint64_t frameIndex );
+/* Same for an image which is only a part of the frame (viewer): it starts at regionX, regionY
+ * of the frame and each of its pixels is scale x scale frame pixels. Vignette and gradient follow it.
+ * frameImage (frameX x frameY, at 1/frameScale size) is the whole frame for frame wide analysis
+ * like dual iso highlights, NULL if inputImage is the whole frame */
+void applyProcessingObjectRegion( processingObject_t * processing,
+                                  int imageX, int imageY,
+                                  uint16_t * __restrict inputImage,
+                                  uint16_t * __restrict outputImage,
+                                  int threads, int imageChanged, uint64_t frameIndex,
+                                  int regionX, int regionY, int scale,
+                                  uint16_t * frameImage, int frameX, int frameY, int frameScale );
+/* Pixels needed around a region for it to come out like the same part of the whole frame */
+int processingGetRegionMargin(processingObject_t * processing);
 
 /* This is for EXR output, works exactly the same as applyprocessing object,
  * except output is float and ready for EXR export. */
@@ -159,6 +172,9 @@ void processingSet3WayCorrection( processingObject_t * processing,
 #define processingUsesChromaSeparation(processing) (processing)->cs_zone.use_cs /* A checking function */
 
 
+/* Worker pool of the processing object, share it for other multithreaded work (e.g. debayering) */
+#define processingGetThreadPool(processing) (processing)->pool
+
 /* Chroma blur - to enable it, you MUST enable chroma separation too. */
 #define processingSetChromaBlurRadius(processing, radius) (processing)->cs_zone.chroma_blur_radius = (radius)
 #define processingGetChromaBlurRadius(processing) (processing)->cs_zone.chroma_blur_radius
@@ -311,7 +327,8 @@ void apply_processing_object(processingObject_t * processing,
                               uint16_t * __restrict outputImage,
                               uint16_t * __restrict blurImage,
                               uint16_t * __restrict gradientMask,
-                              float *vignetteMask);
+                              float *vignetteMask,
+                              float *vignetteEnd);
 
 /* Pass frame buffer and do the transform on it */
 void get_frame_transformed(processingObject_t * processing, uint16_t * frame_buf , uint16_t imageX, uint16_t imageY);
@@ -320,7 +337,7 @@ void get_frame_transformed(processingObject_t * processing, uint16_t * frame_buf
  * http://www.magiclantern.fm/forum/index.php?topic=19270
  * Thanks a1ex & g3gg0 */
 
-typedef struct {
+typedef struct apply_processing_parameters_s {
     processingObject_t * processing;
     int imageX, imageY;
     uint16_t * inputImage;
@@ -328,6 +345,12 @@ typedef struct {
     uint16_t * blurImage;
     uint16_t * gradientMask;
     float * vignetteMask;
+    float * vignetteEnd; /* End of the whole vignette mask */
+    int sliceY; /* First row of the slice in the whole image */
+    int wholeY; /* Rows of the whole image */
+    uint32_t randomSeeds[4]; /* Grain seeds of the frame */
+    struct finish_scratch_pool_s * scratch; /* Scratch buffers of the finish stage, one set per worker */
+    void (*stage)(struct apply_processing_parameters_s *); /* What the slice thread runs */
 } apply_processing_parameters_t;
 
 /* applyProcessingObject but with one argument for pthreading  */
@@ -364,10 +387,11 @@ void processing_update_highest_green_gradient(processingObject_t * processing);
 /* Precalculates curve with contrast and colour correction */
 void processing_update_curves(processingObject_t * processing);
 
-/* Analyse dual iso frame to find highest green for highlight reconstruction */
+/* Analyse dual iso frame to find highest green for highlight reconstruction,
+ * each pixel of the image stands for scale x scale frame pixels */
 void analyse_frame_highest_green(processingObject_t * processing,
                                   int imageX, int imageY,
-                                  uint16_t * __restrict inputImage);
+                                  uint16_t * __restrict inputImage, int scale);
 
 /* Pretty good function */
 void hsv_to_rgb(double hue, double saturation, double value, double * rgb);